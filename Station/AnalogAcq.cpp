@@ -0,0 +1,308 @@
+/*
+  Background acquisition and filtering of analog (ADC) sensors for the SmartGarden system.
+
+See AnalogAcq.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "AnalogAcq.h"
+#include "settings.h"
+#include <string.h>
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+AnalogAcqClass analogAcq;
+
+#ifdef ANALOGACQ_ENABLE
+
+// sum of ANALOGACQ_OVERSAMPLE 10 bit samples is shifted down to ANALOGACQ_BITS
+#define AA_DECIMATE_SHIFT		2
+
+struct AnalogAcqConfig
+{
+	uint8_t		pin;
+	bool		oversample;				// false - raw samples only (analog keys)
+};
+
+static const AnalogAcqConfig aaConfig[] = {
+
+#ifdef SENSOR_ENABLE_ANALOG
+#ifdef SENSOR_CHANNEL_ANALOG_1_PIN
+	{ SENSOR_CHANNEL_ANALOG_1_PIN, true },
+#endif
+#ifdef SENSOR_CHANNEL_ANALOG_2_PIN
+	{ SENSOR_CHANNEL_ANALOG_2_PIN, true },
+#endif
+#ifdef SENSOR_CHANNEL_ANALOG_3_PIN
+	{ SENSOR_CHANNEL_ANALOG_3_PIN, true },
+#endif
+#ifdef SENSOR_CHANNEL_ANALOG_4_PIN
+	{ SENSOR_CHANNEL_ANALOG_4_PIN, true },
+#endif
+#endif //SENSOR_ENABLE_ANALOG
+
+#ifdef SENSOR_ENABLE_THERMISTOR
+#ifdef SENSOR_CHANNEL_THERMISTOR_1_PIN
+	{ SENSOR_CHANNEL_THERMISTOR_1_PIN, true },
+#endif
+#endif //SENSOR_ENABLE_THERMISTOR
+
+#ifdef ANALOG_KEY_INPUT
+	{ KEY_ANALOG_CHANNEL, false },
+#endif
+};
+
+#define AA_NUM_CHANNELS		(sizeof(aaConfig)/sizeof(aaConfig[0]))
+
+struct AnalogAcqChannel
+{
+// ISR side
+	uint8_t				mux;			// ADC input of the pin
+	volatile uint16_t	raw;			// last raw sample
+	uint16_t			accum;			// sum of the raw samples of the current decimation period
+	uint8_t				count;
+	volatile uint16_t	sample;			// last decimated value, ANALOGACQ_BITS
+	volatile uint8_t	seq;			// incremented on each decimated value
+
+// main code side
+	uint8_t				lastSeq;
+	uint8_t				nWindow;		// number of values in the median window
+	uint16_t			window[3];		// last decimated values, for the median
+	uint16_t			ema;			// filtered value, scaled by 2^ANALOGACQ_EMA_SHIFT
+};
+
+static AnalogAcqChannel		aaChannels[AA_NUM_CHANNELS];
+static volatile uint8_t		aaCurrent = 0;			// channel of the running conversion
+static volatile uint16_t	aaIsrCount = 0;
+
+static uint16_t		aaSampleRate = 0;
+static uint16_t		aaFilterTime = 0;
+static uint16_t		aaFilterTimeMax = 0;
+static uint16_t		aaLastIsrCount = 0;
+static uint32_t		aaLastStats = 0;
+
+// ADC input of the Arduino analog pin (same mapping as analogRead())
+static uint8_t aaPinToMux(uint8_t pin)
+{
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	if( pin >= 54 ) pin -= 54;
+#elif defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__)
+	if( pin >= 24 ) pin -= 24;
+#else
+	if( pin >= 14 ) pin -= 14;
+#endif
+	return pin;
+}
+
+// Select ADC input for the next conversion. AVCC reference, same as analogRead() DEFAULT.
+static inline void aaSetMux(uint8_t mux)
+{
+#ifdef MUX5
+	ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((mux >> 3) & 0x01) << MUX5);
+#endif
+	ADMUX = (1 << REFS0) | (mux & 0x07);
+}
+
+// Conversion complete. Next conversion is started by the next Timer0 overflow, after the mux is switched.
+ISR(ADC_vect)
+{
+	AnalogAcqChannel	*pc = &aaChannels[aaCurrent];
+	uint16_t			s = ADC;
+
+	pc->raw = s;
+	pc->accum += s;
+	if( ++pc->count >= ANALOGACQ_OVERSAMPLE )
+	{
+		pc->sample = pc->accum >> AA_DECIMATE_SHIFT;
+		pc->seq++;
+		pc->accum = 0;
+		pc->count = 0;
+	}
+
+	uint8_t		next = aaCurrent + 1;
+	if( next >= AA_NUM_CHANNELS )
+		next = 0;
+	aaCurrent = next;
+	aaSetMux(aaChannels[next].mux);
+
+	aaIsrCount++;
+}
+
+// 16 bit values are updated by the ISR, read them until two reads match.
+static uint16_t aaRead16(volatile uint16_t *p)
+{
+	uint16_t	val;
+
+	do
+	{
+		val = *p;
+	}
+	while( val != *p );
+
+	return val;
+}
+
+static int8_t aaFindChannel(uint8_t pin)
+{
+	for( uint8_t i=0; i<AA_NUM_CHANNELS; i++ )
+		if( aaConfig[i].pin == pin )
+			return i;
+
+	return -1;
+}
+
+static uint16_t aaMedian3(uint16_t a, uint16_t b, uint16_t c)
+{
+	if( a > b ) { uint16_t t = a; a = b; b = t; }
+	if( b > c ) b = c;
+	return (a > b) ? a : b;
+}
+
+#endif //ANALOGACQ_ENABLE
+
+
+//
+// Raw values have to read as "no value" before begin() starts the sampling - localUI polls analog keys from the start,
+// and zero is a valid key press.
+//
+AnalogAcqClass::AnalogAcqClass()
+{
+#ifdef ANALOGACQ_ENABLE
+	for( uint8_t i=0; i<AA_NUM_CHANNELS; i++ )
+		aaChannels[i].raw = ANALOGACQ_NO_VALUE;
+#endif //ANALOGACQ_ENABLE
+}
+
+void AnalogAcqClass::begin(void)
+{
+#ifdef ANALOGACQ_ENABLE
+	if( AA_NUM_CHANNELS == 0 )
+		return;
+
+	for( uint8_t i=0; i<AA_NUM_CHANNELS; i++ )
+	{
+		pinMode(aaConfig[i].pin, INPUT);
+
+		memset(&aaChannels[i], 0, sizeof(AnalogAcqChannel));
+		aaChannels[i].mux = aaPinToMux(aaConfig[i].pin);
+		aaChannels[i].raw = ANALOGACQ_NO_VALUE;
+	}
+
+	aaCurrent = 0;
+	aaSetMux(aaChannels[0].mux);
+
+	// Auto trigger on Timer0 overflow, ADC prescaler is left as set by Arduino init (125kHz ADC clock at 16MHz)
+	ADCSRB = (ADCSRB & ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) | (1 << ADTS2);
+	ADCSRA |= (1 << ADEN) | (1 << ADATE) | (1 << ADIF) | (1 << ADIE);
+
+	aaLastStats = millis();
+	TRACE_INFO(F("AnalogAcq - sampling %u analog channels\n"), uint16_t(AA_NUM_CHANNELS));
+#endif //ANALOGACQ_ENABLE
+}
+
+//
+// Filter decimated values produced by the ISR since the last call. Each channel produces ~980/(16*channels) values per second,
+// so most of the calls have nothing to do.
+//
+void AnalogAcqClass::loop(void)
+{
+#ifdef ANALOGACQ_ENABLE
+	uint32_t	startTime = micros();
+
+	for( uint8_t i=0; i<AA_NUM_CHANNELS; i++ )
+	{
+		AnalogAcqChannel	*pc = &aaChannels[i];
+		uint8_t				seq = pc->seq;
+
+		if( !aaConfig[i].oversample || (seq == pc->lastSeq) )
+			continue;
+
+		uint16_t	val = aaRead16(&pc->sample);
+
+		pc->lastSeq = seq;
+		if( pc->nWindow == 0 )			// first value, prime the filter
+		{
+			pc->window[0] = pc->window[1] = pc->window[2] = val;
+			pc->ema = val << ANALOGACQ_EMA_SHIFT;
+			pc->nWindow = 1;
+			continue;
+		}
+
+		pc->window[0] = pc->window[1];
+		pc->window[1] = pc->window[2];
+		pc->window[2] = val;
+
+		int32_t		med = aaMedian3(pc->window[0], pc->window[1], pc->window[2]);
+
+		pc->ema = uint16_t(int32_t(pc->ema) + ((med << ANALOGACQ_EMA_SHIFT) - int32_t(pc->ema)) / (1 << ANALOGACQ_EMA_SHIFT));
+	}
+
+	uint16_t	t = uint16_t(micros() - startTime);
+	if( t > aaFilterTime )
+		aaFilterTime = t;
+
+	if( (millis() - aaLastStats) >= 60000ul )
+	{
+		uint16_t	isrCount = aaRead16(&aaIsrCount);
+
+		aaSampleRate = uint16_t(isrCount - aaLastIsrCount) / 60;
+		aaFilterTimeMax = aaFilterTime;
+		aaLastIsrCount = isrCount;
+		aaFilterTime = 0;
+		aaLastStats += 60000ul;
+
+		TRACE_INFO(F("AnalogAcq - %u samples/s, filter time max %uus\n"), aaSampleRate, aaFilterTimeMax);
+	}
+#endif //ANALOGACQ_ENABLE
+}
+
+uint16_t AnalogAcqClass::GetValue(uint8_t pin)
+{
+#ifdef ANALOGACQ_ENABLE
+	int8_t	i = aaFindChannel(pin);
+
+	if( (i < 0) || (aaChannels[i].nWindow == 0) )
+		return ANALOGACQ_NO_VALUE;
+
+	return (aaChannels[i].ema + (1 << (ANALOGACQ_EMA_SHIFT-1))) >> ANALOGACQ_EMA_SHIFT;
+#else
+	return ANALOGACQ_NO_VALUE;
+#endif //ANALOGACQ_ENABLE
+}
+
+uint16_t AnalogAcqClass::GetRaw(uint8_t pin)
+{
+#ifdef ANALOGACQ_ENABLE
+	int8_t	i = aaFindChannel(pin);
+
+	if( i < 0 )
+		return ANALOGACQ_NO_VALUE;
+
+	return aaRead16(&aaChannels[i].raw);
+#else
+	return ANALOGACQ_NO_VALUE;
+#endif //ANALOGACQ_ENABLE
+}
+
+uint16_t AnalogAcqClass::GetSampleRate(void)
+{
+#ifdef ANALOGACQ_ENABLE
+	return aaSampleRate;
+#else
+	return 0;
+#endif
+}
+
+uint16_t AnalogAcqClass::GetFilterTime(void)
+{
+#ifdef ANALOGACQ_ENABLE
+	return aaFilterTimeMax;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,60 @@
+/*
+  Background acquisition and filtering of analog (ADC) sensors for the SmartGarden system.
+
+  Analog and thermistor ports are sampled continuously by the ADC instead of a single analogRead() per poll. Conversions
+  are auto-triggered by the Timer0 overflow (the Arduino millis() timer, 1.024ms), the ADC interrupt stores the result and
+  switches the multiplexer to the next channel. This bounds the cost of sampling to ~980 short ISRs per second regardless of
+  the number of channels - free-running mode would take ~9600 interrupts per second at the Arduino ADC clock.
+
+  Each channel is oversampled: ANALOGACQ_OVERSAMPLE raw samples are summed up and decimated into one 12 bit value (2 extra
+  bits of resolution, the ADC noise provides the dither). Decimated values are filtered in loop() - median of the last 3 values
+  to drop spikes, then exponential moving average (1/2^ANALOGACQ_EMA_SHIFT weight of the new value) to smooth the noise.
+
+  Sensors poll reports the filtered value only (see GetValue()), so the reporting rate is still the sensors poll rate.
+
+  Sampling cost can be checked with GetSampleRate() (ISR calls per second, measured over the last minute) and GetFilterTime()
+  (max time spent in loop() filtering). Both are traced once a minute at TRACE_INFO level.
+
+  Analog keys (ANALOG_KEY_INPUT) are sampled on the same round robin without oversampling, see GetRaw().
+
+  Note: analogRead() must not be used while the acquisition is running.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _ANALOGACQ_h
+#define _ANALOGACQ_h
+
+#include <inttypes.h>
+#include "Defines.h"
+
+#if defined(SENSOR_ENABLE_ANALOG) || defined(SENSOR_ENABLE_THERMISTOR) || defined(ANALOG_KEY_INPUT)
+#define ANALOGACQ_ENABLE				1
+#endif
+
+#define ANALOGACQ_OVERSAMPLE			16			// raw samples per decimated value, 4^2 for 2 extra bits
+#define ANALOGACQ_BITS					12			// resolution of decimated and filtered values
+#define ANALOGACQ_EMA_SHIFT				3			// EMA weight of the new value is 1/8
+#define ANALOGACQ_NO_VALUE				0xFFFF		// channel is not sampled or has no value yet
+
+class AnalogAcqClass
+{
+public:
+				AnalogAcqClass();
+
+	void		begin(void);
+	void		loop(void);								// filter new decimated values, called on every main loop pass
+
+	uint16_t	GetValue(uint8_t pin);					// filtered value of the pin, 0..4095 (ANALOGACQ_BITS), or ANALOGACQ_NO_VALUE
+	uint16_t	GetRaw(uint8_t pin);					// last raw sample of the pin, 0..1023, or ANALOGACQ_NO_VALUE
+
+	uint16_t	GetSampleRate(void);					// ADC interrupts per second
+	uint16_t	GetFilterTime(void);					// max us spent in loop() during the last minute
+};
+
+extern AnalogAcqClass analogAcq;
+
+#endif //_ANALOGACQ_h
@@ -0,0 +1,140 @@
+/*
+  Table driven conversion of analog (ADC) readings for the SmartGarden system.
+
+See AnalogConv.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "AnalogConv.h"
+
+struct AnalogCurve
+{
+	const uint16_t	*pTable;		// PROGMEM, ascending ADC codes
+	uint8_t			size;
+	int16_t			outFirst;		// scaled output value of the first entry
+	int16_t			outStep;		// scaled output step between entries
+	int16_t			outDiv;			// scaled output is divided by this
+	int16_t			outOffset;		// and this is added to get the final value
+};
+
+/*
+   The Thermistor is incorporated into a Voltage Divider Circuit with Ra=Thermistor and Rb=10K,
+   ASCII circuit diagram, below:
+
+   +Vref---[Thermistor]---+--[10K]---GND
+                          |
+                         ADC @ thermPin
+
+   ADC Values were externally calculated from the Thermistor Resistance Table
+   using the formula:   ADC = 1023 * 10000/(Rtherm+10000)
+
+   The table contains the predicted ADC values for all temperatures between -20 deg C to + 69 deg C,
+   the array index starts at zero, which corresponds to a temperature of -20 deg C.
+*/
+static const uint16_t LUT_Therm10K[90] PROGMEM = {
+    105, 110, 116, 121, 127, 133, 139, 145, 152, 159,   // -20C to -11C
+    165, 173, 180, 187, 195, 203, 211, 219, 227, 236,   // -10C to -1C
+    245, 254, 264, 273, 283, 293, 303, 313, 324, 334,   //  0C  to +9C
+    345, 355, 366, 377, 388, 399, 410, 422, 433, 444,   //  10C to 19C
+    455, 467, 478, 489, 500, 512, 523, 534, 545, 555,   //  20C to 29C
+    566, 577, 588, 598, 608, 619, 629, 639, 648, 658,   //  30C to 39C
+    667, 677, 686, 695, 704, 712, 721, 729, 737, 745,   //  40C to 49C
+    753, 760, 768, 775, 782, 789, 795, 802, 808, 814,   //  50C to 59C
+    820, 826, 832, 837, 843, 848, 853, 858, 863, 867    //  60C to 69C
+  };
+
+// 10K NTC thermistor with B = 3950 (common waterproof probes) in the same circuit, -20C to 69C.
+// Calculated as ADC = 1023 * 10000/(Rtherm+10000), Rtherm = 10000 * exp(3950 * (1/T - 1/298.15)).
+static const uint16_t LUT_B3950[90] PROGMEM = {
+     89,  94,  99, 105, 110, 116, 123, 129, 136, 143,   // -20C to -11C
+    150, 157, 165, 173, 181, 189, 198, 207, 216, 225,   // -10C to -1C
+    235, 244, 254, 264, 274, 285, 295, 306, 317, 328,   //  0C  to +9C
+    339, 350, 362, 373, 384, 396, 408, 419, 431, 442,   //  10C to 19C
+    454, 466, 477, 489, 500, 512, 523, 534, 545, 556,   //  20C to 29C
+    567, 578, 589, 599, 610, 620, 630, 640, 650, 659,   //  30C to 39C
+    669, 678, 687, 696, 704, 713, 721, 729, 737, 745,   //  40C to 49C
+    753, 760, 768, 775, 782, 788, 795, 801, 807, 813,   //  50C to 59C
+    819, 825, 831, 836, 841, 846, 851, 856, 861, 865    //  60C to 69C
+  };
+
+// Capacitive soil moisture probe, 100% (in water) down to 0% (dry air) in 10% steps. Reading goes down as moisture goes up.
+static const uint16_t LUT_SoilMoisture[11] PROGMEM = {
+    280, 300, 322, 345, 370, 396, 424, 454, 486, 520, 556
+  };
+
+// Ratiometric pressure transducer, 0.5V to 4.5V of 5V reference
+static const uint16_t LUT_Pressure[2] PROGMEM = {
+    102, 921
+  };
+
+// Indexed by ANALOG_CURVE_*. Thermistor outputs are scaled by 100 for interpolation, F is produced as 1.8*C + 32.
+static const AnalogCurve analogCurves[ANALOG_NUM_CURVES] PROGMEM = {
+	{ LUT_Therm10K, 90, -20*180, 180, 100, 32 },		// ANALOG_CURVE_DEFAULT - same as ANALOG_CURVE_THERM10K_F
+	{ LUT_Therm10K, 90, -20*180, 180, 100, 32 },		// ANALOG_CURVE_THERM10K_F
+	{ LUT_Therm10K, 90, -20*100, 100, 100, 0 },			// ANALOG_CURVE_THERM10K_C
+	{ LUT_B3950, 90, -20*180, 180, 100, 32 },			// ANALOG_CURVE_B3950_F
+	{ LUT_B3950, 90, -20*100, 100, 100, 0 },			// ANALOG_CURVE_B3950_C
+	{ LUT_SoilMoisture, 11, 1000, -100, 10, 0 },		// ANALOG_CURVE_SOIL_MOISTURE
+	{ LUT_Pressure, 2, 0, 100, 1, 0 },					// ANALOG_CURVE_PRESSURE_PSI
+	{ LUT_Pressure, 2, 0, 1200, 1, 0 },					// ANALOG_CURVE_PRESSURE_KPA
+};
+
+//
+// Convert ADC reading using the curve.
+//
+// Returns ANALOG_UNDER_RANGE or ANALOG_OVER_RANGE if the reading falls outside of the table.
+//
+int16_t AnalogConvert(uint8_t curve, uint16_t adc)
+{
+	AnalogCurve		c;
+
+	if( curve >= ANALOG_NUM_CURVES )
+		curve = ANALOG_CURVE_DEFAULT;
+
+	memcpy_P(&c, &analogCurves[curve], sizeof(AnalogCurve));
+
+	uint8_t		lo = 0;
+	uint8_t		hi = c.size - 1;
+	uint16_t	adcLo = pgm_read_word_near(&c.pTable[lo]);
+	uint16_t	adcHi = pgm_read_word_near(&c.pTable[hi]);
+
+	if( adc < adcLo )
+		return ANALOG_UNDER_RANGE;
+	if( adc > adcHi )
+		return ANALOG_OVER_RANGE;
+	if( adc == adcHi )
+		return int16_t((int32_t(c.outFirst) + int32_t(hi)*c.outStep) / c.outDiv + c.outOffset);
+
+	// table[lo] <= adc < table[hi], narrow it down to adjacent entries
+	while( hi - lo > 1 )
+	{
+		uint8_t		mid = (lo + hi) >> 1;
+		uint16_t	adcMid = pgm_read_word_near(&c.pTable[mid]);
+
+		if( adcMid > adc )
+		{
+			hi = mid;
+			adcHi = adcMid;
+		}
+		else
+		{
+			lo = mid;
+			adcLo = adcMid;
+		}
+	}
+
+	int32_t		outLo = int32_t(c.outFirst) + int32_t(lo)*c.outStep;
+	int32_t		out = int32_t(adc - adcLo) * c.outStep / int32_t(adcHi - adcLo) + outLo;
+
+	return int16_t(out / c.outDiv + c.outOffset);
+}
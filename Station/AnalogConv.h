@@ -0,0 +1,50 @@
+/*
+  Table driven conversion of analog (ADC) readings for the SmartGarden system.
+
+  Each conversion curve is a PROGMEM table of ADC codes taken at equally spaced output values, in ascending order.
+  The reading is located in the table using binary search, and the output is linearly interpolated between the two
+  closest entries:
+
+	out = map(adc, table[i-1], table[i], outFirst + (i-1)*outStep, outFirst + i*outStep) / outDiv + outOffset
+
+  The scaled (outStep, outDiv) form keeps the interpolation in integer math while giving sub-step resolution.
+
+  Curve of a sensor is selected by SENSOR_FLAGS_CURVE bits of the sensor flags (ini file key Curve), so several
+  thermistor types and analog probes can share one converter. ANALOG_CURVE_DEFAULT keeps the default conversion of
+  the sensor port (10K thermistor in F for thermistor ports, linear scaling for analog ports). The flags have room for
+  8 curves.
+
+  Probe curves assume 5V probes powered from the ADC reference. Pressure transducers are 0.5-4.5V ratiometric, readings
+  below 0.5V (open wire) are ANALOG_UNDER_RANGE. Soil moisture table is typical for capacitive probes (v1.2), 0% is dry
+  air and 100% is water - probes vary, edit the table to calibrate.
+
+  Thermistor LUT and the original conversion logic are taken from: https://github.com/EasternStarGeek/Fun-with-Thermistors
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _ANALOGCONV_h
+#define _ANALOGCONV_h
+
+#include <inttypes.h>
+
+// Conversion curves
+#define ANALOG_CURVE_DEFAULT		0		// default conversion of the sensor port
+#define ANALOG_CURVE_THERM10K_F		1		// 10K NTC thermistor with 10K divider resistor, F
+#define ANALOG_CURVE_THERM10K_C		2		// 10K NTC thermistor with 10K divider resistor, C
+#define ANALOG_CURVE_B3950_F		3		// 10K NTC thermistor, B = 3950, with 10K divider resistor, F
+#define ANALOG_CURVE_B3950_C		4		// 10K NTC thermistor, B = 3950, with 10K divider resistor, C
+#define ANALOG_CURVE_SOIL_MOISTURE	5		// capacitive soil moisture probe, %
+#define ANALOG_CURVE_PRESSURE_PSI	6		// 0-100 psi pressure transducer, psi
+#define ANALOG_CURVE_PRESSURE_KPA	7		// 0-1.2 MPa pressure transducer, kPa
+#define ANALOG_NUM_CURVES			8
+
+#define ANALOG_UNDER_RANGE			-999	// reading is below the first table entry
+#define ANALOG_OVER_RANGE			999		// reading is above the last table entry
+
+int16_t	AnalogConvert(uint8_t curve, uint16_t adc);
+
+#endif //_ANALOGCONV_h
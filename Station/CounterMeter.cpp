@@ -0,0 +1,331 @@
+/*
+  Counter/Meter (waterflow meter) pulse counting engine for the SmartGarden system.
+
+See CounterMeter.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "CounterMeter.h"
+#include "sensors.h"
+#include "settings.h"
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+#ifdef SENSOR_ENABLE_COUNTERMETER
+
+#include "TimerOne.h"
+
+struct CounterMeterConfig
+{
+	uint8_t		pin;
+	uint8_t		active;					// active level of the meter output, LOW or HIGH
+	uint8_t		channel;				// logical channel of the counter
+	uint8_t		rateChannel;			// logical channel of the flow rate, or COUNTERMETER_NO_CHANNEL
+	uint16_t	mult;					// normalized ticks = raw ticks * mult / div
+	uint16_t	div;
+};
+
+static const CounterMeterConfig cmConfig[] = {
+
+#ifdef SENSOR_CHANNEL_COUNTERMETER_1_PIN
+#ifndef SENSOR_CHANNEL_COUNTERMETER_1_RATE_CHANNEL
+#define SENSOR_CHANNEL_COUNTERMETER_1_RATE_CHANNEL	COUNTERMETER_NO_CHANNEL
+#endif
+	{ SENSOR_CHANNEL_COUNTERMETER_1_PIN, SENSOR_CHANNEL_COUNTERMETER_1_ACTIVE, SENSOR_CHANNEL_COUNTERMETER_1_CHANNEL,
+	  SENSOR_CHANNEL_COUNTERMETER_1_RATE_CHANNEL, SENSOR_CHANNEL_COUNTERMETER_1_MULT, SENSOR_CHANNEL_COUNTERMETER_1_DIV },
+#endif
+
+#ifdef SENSOR_CHANNEL_COUNTERMETER_2_PIN
+#ifndef SENSOR_CHANNEL_COUNTERMETER_2_RATE_CHANNEL
+#define SENSOR_CHANNEL_COUNTERMETER_2_RATE_CHANNEL	COUNTERMETER_NO_CHANNEL
+#endif
+	{ SENSOR_CHANNEL_COUNTERMETER_2_PIN, SENSOR_CHANNEL_COUNTERMETER_2_ACTIVE, SENSOR_CHANNEL_COUNTERMETER_2_CHANNEL,
+	  SENSOR_CHANNEL_COUNTERMETER_2_RATE_CHANNEL, SENSOR_CHANNEL_COUNTERMETER_2_MULT, SENSOR_CHANNEL_COUNTERMETER_2_DIV },
+#endif
+
+#ifdef SENSOR_CHANNEL_COUNTERMETER_3_PIN
+#ifndef SENSOR_CHANNEL_COUNTERMETER_3_RATE_CHANNEL
+#define SENSOR_CHANNEL_COUNTERMETER_3_RATE_CHANNEL	COUNTERMETER_NO_CHANNEL
+#endif
+	{ SENSOR_CHANNEL_COUNTERMETER_3_PIN, SENSOR_CHANNEL_COUNTERMETER_3_ACTIVE, SENSOR_CHANNEL_COUNTERMETER_3_CHANNEL,
+	  SENSOR_CHANNEL_COUNTERMETER_3_RATE_CHANNEL, SENSOR_CHANNEL_COUNTERMETER_3_MULT, SENSOR_CHANNEL_COUNTERMETER_3_DIV },
+#endif
+
+#ifdef SENSOR_CHANNEL_COUNTERMETER_4_PIN
+#ifndef SENSOR_CHANNEL_COUNTERMETER_4_RATE_CHANNEL
+#define SENSOR_CHANNEL_COUNTERMETER_4_RATE_CHANNEL	COUNTERMETER_NO_CHANNEL
+#endif
+	{ SENSOR_CHANNEL_COUNTERMETER_4_PIN, SENSOR_CHANNEL_COUNTERMETER_4_ACTIVE, SENSOR_CHANNEL_COUNTERMETER_4_CHANNEL,
+	  SENSOR_CHANNEL_COUNTERMETER_4_RATE_CHANNEL, SENSOR_CHANNEL_COUNTERMETER_4_MULT, SENSOR_CHANNEL_COUNTERMETER_4_DIV },
+#endif
+};
+
+#define CM_NUM_CHANNELS		(sizeof(cmConfig)/sizeof(cmConfig[0]))
+
+struct CounterMeterPulse
+{
+	uint32_t	time;					// micros() of the pulse
+	uint16_t	pulses;					// raw counter including this pulse
+};
+
+struct CounterMeterChannel
+{
+// ISR side
+	volatile uint8_t	*inReg;			// input register and bit of the pin
+	uint8_t				mask;
+	uint8_t				pcGroup;		// pin change interrupt group, or 0xFF if the pin is sampled from Timer1
+	uint8_t				level;			// last seen level of the pin
+	uint32_t			lastChange;		// micros() of the last level change
+	volatile uint16_t	pulses;			// raw ticks counter, written by ISR only
+	volatile uint8_t	head;			// ring write index, written by ISR only
+	volatile uint8_t	tail;			// ring read index, written by main code only
+	CounterMeterPulse	ring[COUNTERMETER_RING_SIZE];
+
+// main code side
+	uint16_t			oldPulses;		// raw counter at the last Report()
+	uint16_t			normalized;		// output counter
+	uint16_t			lastPulses;		// raw counter of the last drained pulse
+	uint32_t			lastTime;		// micros() of the last drained pulse
+	uint32_t			interval;		// us between pulses, 0 - no flow
+	bool				fRunning;		// lastTime/lastPulses are valid
+	bool				fReported;		// counter was reported at least once
+};
+
+static CounterMeterChannel	cmChannels[CM_NUM_CHANNELS];
+
+CounterMeterClass counterMeter;
+
+
+//
+// Process possible level change of the channel. Called from ISR.
+//
+// Pulse is counted on the transition to the active level, if the line was stable for the debounce time before it.
+// Contact bounce on both press and release keeps pushing lastChange forward and is ignored.
+//
+static inline void cmSample(CounterMeterChannel *pc, uint8_t active, uint32_t t)
+{
+	uint8_t		level = (*pc->inReg & pc->mask) ? HIGH : LOW;
+
+	if( level == pc->level )
+		return;
+
+	uint32_t	stable = t - pc->lastChange;
+
+	pc->level = level;
+	pc->lastChange = t;
+
+	if( (level != active) || (stable < SENSOR_COUNTERMETER_DEBOUNCE) )
+		return;
+
+	uint16_t	pulses = pc->pulses + 1;
+	uint8_t		head = pc->head;
+	uint8_t		next = (head + 1) & (COUNTERMETER_RING_SIZE - 1);
+
+	pc->pulses = pulses;
+	if( next != pc->tail )				// ring full - the pulse is counted, only its timestamp is lost
+	{
+		pc->ring[head].time = t;
+		pc->ring[head].pulses = pulses;
+		pc->head = next;				// publish the entry
+	}
+}
+
+static void cmPinChange(uint8_t group)
+{
+	uint32_t	t = micros();
+
+	for( uint8_t i=0; i<CM_NUM_CHANNELS; i++ )
+	{
+		if( cmChannels[i].pcGroup == group )
+			cmSample(&cmChannels[i], cmConfig[i].active, t);
+	}
+}
+
+#ifdef PCINT0_vect
+ISR(PCINT0_vect) { cmPinChange(0); }
+#endif
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) { cmPinChange(1); }
+#endif
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) { cmPinChange(2); }
+#endif
+#ifdef PCINT3_vect
+ISR(PCINT3_vect) { cmPinChange(3); }
+#endif
+
+// Timer1 ISR, samples channels without pin change interrupt
+static void cmTimerIsr(void)
+{
+	cmPinChange(0xFF);
+}
+
+// Raw counter is 16 bit and is updated by ISR, read it until two reads match.
+static uint16_t cmReadPulses(CounterMeterChannel *pc)
+{
+	uint16_t	pulses;
+
+	do
+	{
+		pulses = pc->pulses;
+	}
+	while( pulses != pc->pulses );
+
+	return pulses;
+}
+
+#endif //SENSOR_ENABLE_COUNTERMETER
+
+
+CounterMeterClass::CounterMeterClass()
+{
+}
+
+void CounterMeterClass::begin(void)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	bool	fTimer = false;
+
+	for( uint8_t i=0; i<CM_NUM_CHANNELS; i++ )
+	{
+		CounterMeterChannel		*pc = &cmChannels[i];
+		uint8_t					pin = cmConfig[i].pin;
+
+		memset(pc, 0, sizeof(CounterMeterChannel));
+
+		pinMode(pin, INPUT);
+		digitalWrite(pin, HIGH);		// pull-up
+
+		pc->inReg = portInputRegister(digitalPinToPort(pin));
+		pc->mask = digitalPinToBitMask(pin);
+		pc->level = digitalRead(pin);
+		pc->lastChange = micros() - SENSOR_COUNTERMETER_DEBOUNCE;	// first edge is not a bounce
+
+		if( digitalPinToPCICR(pin) != 0 )
+		{
+			pc->pcGroup = digitalPinToPCICRbit(pin);
+
+			*digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+			PCIFR = _BV(pc->pcGroup);		// clear pending interrupt
+			*digitalPinToPCICR(pin) |= _BV(pc->pcGroup);
+		}
+		else
+		{
+			pc->pcGroup = 0xFF;
+			fTimer = true;
+			TRACE_INFO(F("CounterMeter - pin %u has no pin change interrupt, sampling it every 10ms\n"), uint16_t(pin));
+		}
+	}
+
+	if( fTimer )
+	{
+		Timer1.initialize(10000);			// timer will fire every 10ms (10,000 microseconds)
+		Timer1.attachInterrupt(cmTimerIsr);
+	}
+#endif //SENSOR_ENABLE_COUNTERMETER
+}
+
+//
+// Drain pulse rings. Flow rate is computed from the interval between the last drained pulse and the newest one.
+//
+void CounterMeterClass::loop(void)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	uint32_t	tNow = micros();
+
+	for( uint8_t i=0; i<CM_NUM_CHANNELS; i++ )
+	{
+		CounterMeterChannel		*pc = &cmChannels[i];
+		uint8_t					head = pc->head;
+
+		if( head != pc->tail )
+		{
+			CounterMeterPulse	*pPulse = &pc->ring[(head - 1) & (COUNTERMETER_RING_SIZE - 1)];
+			uint16_t			dp = pPulse->pulses - pc->lastPulses;
+
+			if( pc->fRunning && (dp != 0) )
+				pc->interval = (pPulse->time - pc->lastTime) / dp;
+
+			pc->lastTime = pPulse->time;
+			pc->lastPulses = pPulse->pulses;
+			pc->fRunning = true;			// first pulse after a stop, rate is known after the next one
+			pc->tail = head;				// release the entries
+		}
+		else if( pc->fRunning )
+		{
+			uint32_t	idle = tNow - pc->lastTime;
+
+			if( idle >= COUNTERMETER_STOP_TIMEOUT )
+			{
+				pc->fRunning = false;
+				pc->interval = 0;
+			}
+			else if( (pc->interval != 0) && (idle > pc->interval) )
+				pc->interval = idle;		// flow is slowing down, it is at most one pulse per idle time
+		}
+	}
+#endif //SENSOR_ENABLE_COUNTERMETER
+}
+
+void CounterMeterClass::Report(void)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	for( uint8_t i=0; i<CM_NUM_CHANNELS; i++ )
+	{
+		CounterMeterChannel		*pc = &cmChannels[i];
+		uint16_t				pulses = cmReadPulses(pc);
+
+		TRACE_VERBOSE(F("CounterMeter%u - counter=%u, interval=%lu us\n"), uint16_t(i+1), pulses, pc->interval);
+
+		if( (pulses != pc->oldPulses) || !pc->fReported )		// report the counter on change, and the initial (empty) value
+		{
+			uint32_t	delta = uint16_t(pulses - pc->oldPulses);		// raw change value
+
+			pc->oldPulses = pulses;
+			pc->normalized += uint16_t(delta * cmConfig[i].mult / cmConfig[i].div);
+			pc->fReported = true;
+
+			sensorsModule.ReportSensorReading( GetMyStationID(), cmConfig[i].channel, pc->normalized );
+		}
+
+		if( cmConfig[i].rateChannel != COUNTERMETER_NO_CHANNEL )
+			sensorsModule.ReportSensorReading( GetMyStationID(), cmConfig[i].rateChannel, GetRate(i) );
+	}
+#endif //SENSOR_ENABLE_COUNTERMETER
+}
+
+uint8_t CounterMeterClass::GetNumChannels(void)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	return CM_NUM_CHANNELS;
+#else
+	return 0;
+#endif //SENSOR_ENABLE_COUNTERMETER
+}
+
+uint16_t CounterMeterClass::GetCounter(uint8_t n)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	if( n < CM_NUM_CHANNELS )
+		return cmChannels[n].normalized;
+#endif //SENSOR_ENABLE_COUNTERMETER
+	return 0;
+}
+
+uint16_t CounterMeterClass::GetRate(uint8_t n)
+{
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	if( (n < CM_NUM_CHANNELS) && (cmChannels[n].interval != 0) )
+	{
+		uint32_t	perMinute = 60000000ul / cmChannels[n].interval;		// raw ticks per minute
+
+		return uint16_t(perMinute * cmConfig[n].mult / cmConfig[n].div);
+	}
+#endif //SENSOR_ENABLE_COUNTERMETER
+	return 0;
+}
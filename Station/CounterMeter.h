@@ -0,0 +1,61 @@
+/*
+  Counter/Meter (waterflow meter) pulse counting engine for the SmartGarden system.
+
+  CounterMeter input comes in the form of pulses counting water flow. Each channel reports the running counter of normalized
+  ticks (1/10 liter per tick), and optionally the flow rate (1/10 liter per minute) on a separate logical channel.
+
+  Pulses are counted by the pin change interrupt of the meter pin. The ISR debounces the input using edge timestamps - a pulse
+  is counted on the transition to the active level only if the line was stable for SENSOR_COUNTERMETER_DEBOUNCE us before it.
+  Each counted pulse is stored in a small per channel ring together with its micros() timestamp. The ring is single producer
+  (ISR) / single consumer (main code), so neither side disables interrupts. When the ring is full the ISR still counts the
+  pulse, only its timestamp is dropped.
+
+  Sensors::loop() drains the rings (see loop()), and computes the flow rate from the inter-pulse interval. Sensors poll reports
+  the totalized counters and rates (see Report()).
+
+  Pins without pin change interrupt (e.g. PORTF of ATmega2560) are sampled every 10ms from Timer1 instead, which limits them
+  to ~50 pulses per second.
+
+  Model-specific meter resolution is normalized using integer multiplication and then division (SENSOR_CHANNEL_COUNTERMETER_n_MULT
+  and _DIV), this is a lot faster than float but gives reasonable precision.
+
+  Note: PCINT interrupt vectors are defined here, this module cannot be used together with SoftwareSerial.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _COUNTERMETER_h
+#define _COUNTERMETER_h
+
+#include <inttypes.h>
+#include "Defines.h"
+
+#define COUNTERMETER_MAX_CHANNELS		4
+#define COUNTERMETER_RING_SIZE			8			// pulses, must be power of 2
+#define COUNTERMETER_NO_CHANNEL			0xFF		// flow rate is not reported
+#define COUNTERMETER_STOP_TIMEOUT		10000000ul	// us, no pulses for this long - flow stopped
+
+#ifndef SENSOR_COUNTERMETER_DEBOUNCE
+#define SENSOR_COUNTERMETER_DEBOUNCE	1000		// us
+#endif
+
+class CounterMeterClass
+{
+public:
+				CounterMeterClass();
+
+	void		begin(void);
+	void		loop(void);								// drain pulse rings and update flow rates, called from Sensors::loop()
+	void		Report(void);							// report counters and flow rates, called from the sensors poll
+
+	uint8_t		GetNumChannels(void);
+	uint16_t	GetCounter(uint8_t n);					// normalized counter of the channel (as of the last Report())
+	uint16_t	GetRate(uint8_t n);						// current flow rate, 1/10 liter per minute
+};
+
+extern CounterMeterClass counterMeter;
+
+#endif //_COUNTERMETER_h
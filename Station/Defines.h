@@ -41,15 +41,20 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 #define HW_V16_MASTER			4	// Master station, hardware version 1.6 (Moteino Mega-based, native Moteino RF module)
 #define HW_V16_REMOTE			5	// Remote station, hardware version 1.6 (Moteino Mega-based, native Moteino RF module)
 #define HW_V17_REMOTE			6	// Remote station, hardware version 1.7 (Moteino Mega-based, native Moteino RF module), different Button pins and 4 sensor connectors
+#define HW_HOST_MASTER			7	// Master station simulated on Linux host (RProtocol over UDP, see test/)
+#define HW_HOST_REMOTE			8	// Remote station simulated on Linux host
 
 //To select specific hardware version uncomment the line below corresponding to required HW version.
+// Host builds pass SG_HARDWARE on the command line.
 
+#ifndef SG_HARDWARE
 //#define SG_HARDWARE				HW_V15_REMOTE
 //#define SG_HARDWARE				HW_V15_MASTER
 //#define SG_HARDWARE				HW_V10_MASTER
 //#define SG_HARDWARE				HW_V16_MASTER
 #define SG_HARDWARE				HW_V16_REMOTE
 //#define SG_HARDWARE				HW_V17_REMOTE
+#endif //SG_HARDWARE
 
 //// delay between zones run in a schedule, in milliseconds
 #define SG_DELAY_BETWEEN_ZONES		5000ul
@@ -115,6 +120,20 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 
 #endif //HW_V16_REMOTE || HW_V17_REMOTE
 
+#if SG_HARDWARE == HW_HOST_MASTER
+
+#define SG_STATION_MASTER		1
+#define DEFAULT_STATION_ID		0
+
+#endif //HW_HOST_MASTER
+
+#if SG_HARDWARE == HW_HOST_REMOTE
+
+#define SG_RF_TIME_CLIENT		1
+#define DEFAULT_STATION_ID		2
+
+#endif //HW_HOST_REMOTE
+
 // Some common definitions
 
 #define SG_STATION_SLAVE		1	// allow acting as a slave (allow remote access via RF network)
@@ -127,12 +146,16 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 
 
 #define MAX_SCHEDULES	4
+#ifndef MAX_STATIONS					// host builds may simulate more stations, up to STATIONID_BROADCAST-1
 #define MAX_STATIONS	16
+#endif
 #define MAX_ZONES		64
 #define MAX_SENSORS		16
 
 // remote stations may have numbers from 1 to 9
+#ifndef MAX_REMOTE_STATIONS
 #define MAX_REMOTE_STATIONS  9
+#endif
 
 // My (master) station ID for network communication
 #define MY_STATION_ID		0
@@ -184,6 +207,33 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 #define SENSORS_POLL_DEFAULT_REPEAT  5		// on Remote station polling interval is 5minutes, to ensure local LCD display updates relatively quickly, and Remote station is not polling anybody else
 #endif
 
+// Remote station pushes sensor readings to the EvtMaster when any reading moves by more than the deadband for its sensor type,
+// or when the heartbeat interval expires. Master polls only stations whose readings became stale.
+#define SENSORS_PUSH_HEARTBEAT		30		// minutes
+#define SENSORS_STALE_TIMEOUT		45		// minutes, master considers readings older than this stale
+
+// Stations are polled concurrently, each on its own period (SENSORS_POLL_DEFAULT_REPEAT to start with) and with its own reply deadline.
+// A missed reply is retried after SENSORS_POLL_RETRY, further misses back the period off up to 2^SENSORS_POLL_MAX_BACKOFF times the default.
+#define SENSORS_POLL_MAX_INFLIGHT	4		// requests outstanding at once, must be below RPROTOCOL_MAX_PENDING
+#define SENSORS_POLL_DEADLINE		30		// seconds
+#define SENSORS_POLL_RETRY			1		// minutes
+#define SENSORS_POLL_MAX_BACKOFF	2
+#define SENSORS_POLL_SPREAD			2		// seconds between the first polls of consecutive stations
+
+// Adaptive sampling. Each sensor has its own sampling interval, SENSORS_POLL_DEFAULT_REPEAT to start with. A change of more than two deadbands
+// between samples halves the interval, SENSORS_SAMPLE_STABLE samples in a row within half a deadband double it. Station is sampled (polled)
+// at the shortest interval of its sensors, and stations with waterflow sensors are sampled every SENSORS_SAMPLE_MIN while a zone is running.
+#define SENSORS_SAMPLE_MIN			1		// minutes
+#define SENSORS_SAMPLE_MAX			(SENSORS_POLL_DEFAULT_REPEAT*4)		// minutes, max 255
+#define SENSORS_SAMPLE_STABLE		3
+
+#define SENSOR_DEADBAND_TEMPERATURE	1		// F
+#define SENSOR_DEADBAND_PRESSURE	1		// mbar
+#define SENSOR_DEADBAND_HUMIDITY	2		// %
+#define SENSOR_DEADBAND_WATERFLOW	0		// any change of the flow counter is reported
+#define SENSOR_DEADBAND_VOLTAGE		1
+#define SENSOR_DEADBAND_FLOWRATE	1		// 1/10 liter per minute
+
 // XBee RF network
 #define NETWORK_ADDRESS_BROADCAST	0x0FFFF
 
@@ -199,6 +249,7 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 #define SENSOR_TYPE_HUMIDITY			3
 #define SENSOR_TYPE_WATERFLOW			4
 #define SENSOR_TYPE_VOLTAGE				5
+#define SENSOR_TYPE_FLOWRATE			6		// 1/10 liter per minute
 
 // Watchdog timer config
 #define SG_WDT_ENABLED			1	// enable WDT 
@@ -0,0 +1,255 @@
+/*
+  Wear-leveled EEPROM journal for frequently updated values of the SmartGarden system.
+
+  See EEJournal.h for the description of the journal format.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "Defines.h"
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+#include "EEJournal.h"
+#include "sdlog.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <Time.h>
+
+#define JOURNAL_KEY_MAGIC			0xA0	// upper nibble of the key byte, helps to reject random data
+#define JOURNAL_CRC_INIT			0x5A
+#define JOURNAL_NO_SLOT				0xFF
+
+
+EEJournalClass::EEJournalClass() : m_head(0), m_seq(0), m_fValid(false)
+{
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+	{
+		m_values[k] = 0;
+		m_liveSlot[k] = JOURNAL_NO_SLOT;
+		m_liveSeq[k] = 0;
+	}
+}
+
+static inline uint8_t * slotAddr(uint8_t slot)
+{
+	if( slot < JOURNAL_SLOTS_BLOCK1 )
+		return (uint8_t *)(ADDR_JOURNAL_BLOCK1 + slot*JOURNAL_RECORD_SIZE);
+	else
+		return (uint8_t *)(ADDR_JOURNAL_BLOCK2 + (slot-JOURNAL_SLOTS_BLOCK1)*JOURNAL_RECORD_SIZE);
+}
+
+static uint8_t recordCRC(const uint8_t *pRec)
+{
+	uint8_t	crc = JOURNAL_CRC_INIT;
+
+	for( uint8_t i=0; i<JOURNAL_RECORD_SIZE; i++ )
+	{
+		if( i != 3 )								// skip crc field itself
+			crc = _crc8_ccitt_update(crc, pRec[i]);
+	}
+	return crc;
+}
+
+// Sequence numbers are compared with wraparound, all records in the journal are kept within JOURNAL_REFRESH_AGE of each other
+static inline bool isNewer(uint16_t seq1, uint16_t seq2)
+{
+	return int16_t(seq1 - seq2) > 0;
+}
+
+//
+// Read and validate one record.
+//
+// Returns true if the record is valid.
+//
+bool EEJournalClass::ReadSlot(uint8_t slot, uint16_t *pSeq, uint8_t *pKey, uint32_t *pValue)
+{
+	uint8_t		rec[JOURNAL_RECORD_SIZE];
+
+	eeprom_read_block(rec, slotAddr(slot), JOURNAL_RECORD_SIZE);
+
+	if( ((rec[2] & 0xF0) != JOURNAL_KEY_MAGIC) || ((rec[2] & 0x0F) >= JOURNAL_NUM_KEYS) )
+		return false;
+
+	if( recordCRC(rec) != rec[3] )
+		return false;
+
+	*pSeq = rec[0] | (uint16_t(rec[1]) << 8);
+	*pKey = rec[2] & 0x0F;
+	*pValue = *((uint32_t *)(rec+4));
+	return true;
+}
+
+bool EEJournalClass::IsLive(uint8_t slot)
+{
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+	{
+		if( m_liveSlot[k] == slot )
+			return true;
+	}
+	return false;
+}
+
+//
+// Write new record into the next free slot.
+//
+// Slots holding the latest copy of any key are skipped, so the previous value of a key survives a torn write.
+//
+void EEJournalClass::Append(uint8_t key, uint32_t value)
+{
+	uint8_t		rec[JOURNAL_RECORD_SIZE];
+
+	while( IsLive(m_head) )
+	{
+		m_head++;
+		if( m_head >= JOURNAL_NUM_SLOTS ) m_head = 0;
+	}
+
+	rec[0] = m_seq & 0x0FF;
+	rec[1] = m_seq >> 8;
+	rec[2] = JOURNAL_KEY_MAGIC | key;
+	*((uint32_t *)(rec+4)) = value;
+	rec[3] = recordCRC(rec);
+
+	eeprom_update_block(rec, slotAddr(m_head), JOURNAL_RECORD_SIZE);
+
+	m_liveSlot[key] = m_head;
+	m_liveSeq[key] = m_seq;
+	m_seq++;
+	m_head++;
+	if( m_head >= JOURNAL_NUM_SLOTS ) m_head = 0;
+}
+
+//
+// Update value.
+//
+// Only values that actually changed are written. Keys that were not updated for a long time are re-written as well,
+// to keep all sequence numbers in the journal comparable.
+//
+bool EEJournalClass::Write(uint8_t key, uint32_t value)
+{
+	if( key >= JOURNAL_NUM_KEYS )
+		return false;
+
+	if( m_fValid && (m_values[key] == value) )
+		return true;
+
+	m_values[key] = value;
+	if( !m_fValid )
+	{
+		TRACE_ERROR(F("EEJournal - write before init, key %u\n"), uint16_t(key));
+		return false;
+	}
+
+	Append(key, value);
+
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+	{
+		if( uint16_t(m_seq - m_liveSeq[k]) > JOURNAL_REFRESH_AGE )
+			Append(k, m_values[k]);
+	}
+	return true;
+}
+
+//
+// Erase the journal and write initial (zero) records for all keys
+//
+void EEJournalClass::Format(void)
+{
+	for( uint8_t slot=0; slot<JOURNAL_NUM_SLOTS; slot++ )
+	{
+		uint8_t *addr = slotAddr(slot);
+		for( uint8_t i=0; i<JOURNAL_RECORD_SIZE; i++ )
+			eeprom_update_byte(addr+i, 0xFF);
+	}
+
+	m_head = 0;
+	m_seq = 0;
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+	{
+		m_values[k] = 0;
+		m_liveSlot[k] = JOURNAL_NO_SLOT;
+	}
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+		Append(k, 0);
+
+	m_fValid = true;
+}
+
+//
+// Scan the journal and recover latest value for each key.
+//
+// If there are no valid records at all, the journal is created, and water counters are imported from their legacy fixed location.
+//
+// Returns true if the journal was recovered, false if it had to be created.
+//
+bool EEJournalClass::begin(void)
+{
+	bool		fFound = false;
+	uint16_t	newestSeq = 0;
+	uint8_t		newestSlot = 0;
+	uint8_t		numBad = 0;
+
+	for( uint8_t k=0; k<JOURNAL_NUM_KEYS; k++ )
+	{
+		m_values[k] = 0;
+		m_liveSlot[k] = JOURNAL_NO_SLOT;
+	}
+
+	for( uint8_t slot=0; slot<JOURNAL_NUM_SLOTS; slot++ )
+	{
+		uint16_t	seq;
+		uint8_t		key;
+		uint32_t	value;
+
+		if( !ReadSlot(slot, &seq, &key, &value) )
+		{
+			numBad++;
+			continue;
+		}
+
+		if( !fFound || isNewer(seq, newestSeq) )
+		{
+			newestSeq = seq;
+			newestSlot = slot;
+			fFound = true;
+		}
+
+		if( (m_liveSlot[key] == JOURNAL_NO_SLOT) || isNewer(seq, m_liveSeq[key]) )
+		{
+			m_values[key] = value;
+			m_liveSlot[key] = slot;
+			m_liveSeq[key] = seq;
+		}
+	}
+
+	if( !fFound )
+	{
+		uint32_t	legacy[8];
+
+		SYSEVT_ERROR(F("EEPROM journal not found, creating"));
+
+		for( uint8_t i=0; i<7; i++ )		// read legacy counters first, Format() will overwrite them
+			legacy[i] = (uint32_t(eeprom_read_dword((const uint32_t *)(ADDR_D_WWCOUNTERS+i*4)) / SECS_PER_DAY) << 16) | eeprom_read_word((const uint16_t *)(ADDR_WWCOUNTERS+i*2));
+		legacy[7] = eeprom_read_dword((const uint32_t *)ADDR_TOTAL_WCOUNTER);
+
+		Format();
+		for( uint8_t i=0; i<7; i++ )
+			Write(JOURNAL_KEY_WWCOUNTER+i, legacy[i]);
+		Write(JOURNAL_KEY_TOTAL_WCOUNTER, legacy[7]);
+
+		return false;
+	}
+
+	m_head = newestSlot + 1;
+	if( m_head >= JOURNAL_NUM_SLOTS ) m_head = 0;
+	m_seq = newestSeq + 1;
+	m_fValid = true;
+
+	TRACE_INFO(F("EEPROM journal recovered, seq=%u, empty or damaged slots: %u\n"), newestSeq, uint16_t(numBad));
+	return true;
+}
+
+EEJournalClass eeJournal;
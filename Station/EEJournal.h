@@ -0,0 +1,70 @@
+/*
+  Wear-leveled EEPROM journal for frequently updated values of the SmartGarden system.
+
+  Water counters and runtime state (like pause end time) change often, and writing them to fixed EEPROM addresses
+  wears out the same cells over and over. Instead these values are stored as small log records in a ring of EEPROM slots.
+  Each record carries a sequence number and CRC, new values are always written to the next free slot, and the slot holding
+  the latest value of each key is never overwritten until a newer copy exists.
+
+  At boot begin() scans the ring, drops damaged records (CRC mismatch, e.g. torn write on power loss) and picks the newest
+  valid record for each key. After that all values are served from RAM.
+
+  Record layout (8 bytes):	seq (2 bytes), key (1 byte, with JOURNAL_KEY_MAGIC in the upper nibble), crc8 (1 byte), value (4 bytes)
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _EEJOURNAL_h
+#define _EEJOURNAL_h
+
+#include <inttypes.h>
+#include "eepromMap.h"
+
+// Journal keys
+#define JOURNAL_KEY_WWCOUNTER		0		// 0-6, running water counters for each day of the week. Value: day number (upper 16 bits) and counter (lower 16 bits)
+#define JOURNAL_KEY_TOTAL_WCOUNTER	7		// lifetime water counter
+#define JOURNAL_KEY_PAUSE_END		8		// end of the pause period (time_t), or 0 if not paused
+
+#define JOURNAL_NUM_KEYS			9
+
+#define JOURNAL_RECORD_SIZE			8
+#define JOURNAL_SLOTS_BLOCK1		((END_OF_JOURNAL_BLOCK1 - ADDR_JOURNAL_BLOCK1) / JOURNAL_RECORD_SIZE)
+#define JOURNAL_SLOTS_BLOCK2		((END_OF_JOURNAL_BLOCK2 - ADDR_JOURNAL_BLOCK2) / JOURNAL_RECORD_SIZE)
+#define JOURNAL_NUM_SLOTS			(JOURNAL_SLOTS_BLOCK1 + JOURNAL_SLOTS_BLOCK2)
+
+#define JOURNAL_REFRESH_AGE			8192	// live records older than this (in sequence numbers) are re-written to keep all sequence numbers within comparable range
+
+class EEJournalClass
+{
+public:
+				EEJournalClass();
+
+	bool		begin(void);							// scan the ring and recover latest values. Returns false if the journal had to be re-created
+	void		Format(void);							// erase the journal, all values are set to zero
+
+	uint32_t	Read(uint8_t key)	{ return key < JOURNAL_NUM_KEYS ? m_values[key] : 0; };
+	bool		Write(uint8_t key, uint32_t value);
+
+private:
+	void		Append(uint8_t key, uint32_t value);
+	bool		ReadSlot(uint8_t slot, uint16_t *pSeq, uint8_t *pKey, uint32_t *pValue);
+	bool		IsLive(uint8_t slot);
+
+	uint32_t	m_values[JOURNAL_NUM_KEYS];
+	uint8_t		m_liveSlot[JOURNAL_NUM_KEYS];			// slot holding the latest record for each key
+	uint16_t	m_liveSeq[JOURNAL_NUM_KEYS];
+	uint8_t		m_head;									// next slot to write
+	uint16_t	m_seq;									// sequence number of the next record
+	bool		m_fValid;
+};
+
+extern EEJournalClass eeJournal;
+
+#if JOURNAL_NUM_SLOTS < (JOURNAL_NUM_KEYS * 2)
+#error EEPROM journal is too small for the number of keys
+#endif
+
+#endif //_EEJOURNAL_h
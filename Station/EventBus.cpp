@@ -0,0 +1,179 @@
+/*
+  Event bus for the SmartGarden system.
+
+  Publishers queue typed events, subscribers are called from the main loop when events are dispatched.
+  Subscribers are expected to do minimal amount of work in the handler (set a flag, send a short RF message, write a log record).
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "Defines.h"
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+#include "EventBus.h"
+#include "core.h"
+
+
+EventBusClass::EventBusClass() : m_numSubscribers(0), m_head(0), m_count(0), m_overflowCount(0)
+{
+	memset(m_zonesPending, 0, sizeof(m_zonesPending));
+	memset(m_remoteZonesPending, 0, sizeof(m_remoteZonesPending));
+	memset(m_remoteSensorsPending, 0, sizeof(m_remoteSensorsPending));
+}
+
+//
+// Register event handler for a group of event types
+//
+//	Input:	eventsMask	- bitmask of events to receive (constructed using SGEVT_MASK())
+//			handler		- subscriber callback
+//
+//	Returns true on success, false if there are no free subscriber slots.
+//
+bool EventBusClass::Subscribe(uint16_t eventsMask, PEventHandler handler)
+{
+	if( m_numSubscribers >= EVENTBUS_MAX_SUBSCRIBERS )
+	{
+		TRACE_ERROR(F("EventBus - no free subscriber slots\n"));
+		return false;
+	}
+
+	m_subscribers[m_numSubscribers].eventsMask = eventsMask;
+	m_subscribers[m_numSubscribers].handler = handler;
+	m_numSubscribers++;
+
+	return true;
+}
+
+//
+// Queue new event. Publish() never calls subscribers, it may be called from RF receive paths.
+//
+// Zone state and remote reports only mark the zone or station as pending. Other events replace queued event of the same type
+// and param1, if there is one. Queue has a slot for each of these event types, so it can fill up only if the same type is
+// published for several stations or schedules within one main loop pass. In this case the oldest event is dropped and counted
+// (see GetOverflowCount()).
+//
+bool EventBusClass::Publish(uint8_t type, uint8_t param1, uint8_t param2, int32_t value)
+{
+	uint8_t		*pPending = NULL;
+	uint8_t		size = MAX_STATIONS;
+
+	if( type == SGEVT_ZONE_STATE )
+	{
+		pPending = m_zonesPending;
+		size = MAX_ZONES;
+	}
+	else if( type == SGEVT_REMOTE_ZONES )
+		pPending = m_remoteZonesPending;
+	else if( type == SGEVT_REMOTE_SENSORS )
+		pPending = m_remoteSensorsPending;
+
+	if( pPending != NULL )
+	{
+		if( param1 >= size )
+			return false;
+
+		pPending[param1 >> 3] |= 1 << (param1 & 0x07);
+		return true;
+	}
+
+	register uint8_t  n = m_head;
+
+	for( uint8_t i=0; i<m_count; i++ )
+	{
+		if( (m_queue[n].type == type) && (m_queue[n].param1 == param1) )
+		{
+			m_queue[n].param2 = param2;
+			m_queue[n].value = value;
+			return true;
+		}
+		n++;
+		if( n >= EVENTBUS_QUEUE_SIZE ) n = 0;
+	}
+
+	if( m_count >= EVENTBUS_QUEUE_SIZE )
+	{
+		if( m_overflowCount != 0xFFFF )
+			m_overflowCount++;
+		TRACE_ERROR(F("EventBus - queue overflow, event %u dropped\n"), uint16_t(m_queue[m_head].type));
+
+		m_head++;
+		if( m_head >= EVENTBUS_QUEUE_SIZE ) m_head = 0;
+		m_count--;
+	}
+
+	register uint8_t  tail = m_head + m_count;
+	if( tail >= EVENTBUS_QUEUE_SIZE ) tail -= EVENTBUS_QUEUE_SIZE;
+
+	m_queue[tail].type = type;
+	m_queue[tail].param1 = param1;
+	m_queue[tail].param2 = param2;
+	m_queue[tail].value = value;
+	m_count++;
+
+	return true;
+}
+
+void EventBusClass::Dispatch(const SGEvent *pEvent)
+{
+	register uint16_t  mask = SGEVT_MASK(pEvent->type);
+
+	for( uint8_t i=0; i<m_numSubscribers; i++ )
+	{
+		if( m_subscribers[i].eventsMask & mask )
+			m_subscribers[i].handler(pEvent);
+	}
+}
+
+// Dispatch events marked in the pending bitmap. Bitmap is cleared first, so events published by the handlers stay pending.
+void EventBusClass::DispatchPending(uint8_t type, uint8_t *pPending, uint8_t size)
+{
+	uint8_t		pending[(max(MAX_ZONES, MAX_STATIONS)+7)/8];
+	SGEvent		evt = {type, 0, 0, 0};
+
+	memcpy(pending, pPending, (size+7)/8);
+	memset(pPending, 0, (size+7)/8);
+
+	for( uint8_t i=0; i<size; i++ )
+	{
+		if( !(pending[i >> 3] & (1 << (i & 0x07))) )
+			continue;
+
+		evt.param1 = i;
+		if( type == SGEVT_ZONE_STATE )
+		{
+			if( i >= GetNumZones() )
+				continue;
+			evt.param2 = GetZoneState(i+1);
+		}
+		Dispatch(&evt);
+	}
+}
+
+// Dispatch all pending events. Intended to be called from the main loop.
+//
+// Events published by subscribers during dispatch will be delivered on the next call.
+//
+void EventBusClass::loop(void)
+{
+	register uint8_t  n = m_count;
+
+	while( n-- && m_count )
+	{
+		SGEvent		evt = m_queue[m_head];			// take a copy, handlers may publish new events
+
+		m_head++;
+		if( m_head >= EVENTBUS_QUEUE_SIZE ) m_head = 0;
+		m_count--;
+
+		Dispatch(&evt);
+	}
+
+	DispatchPending(SGEVT_ZONE_STATE, m_zonesPending, MAX_ZONES);
+	DispatchPending(SGEVT_REMOTE_ZONES, m_remoteZonesPending, MAX_STATIONS);
+	DispatchPending(SGEVT_REMOTE_SENSORS, m_remoteSensorsPending, MAX_STATIONS);
+}
+
+EventBusClass eventBus;
@@ -0,0 +1,92 @@
+/*
+  Event bus for the SmartGarden system.
+
+  Lightweight in-process publish/subscribe mechanism. Modules that change system state (runState, zone handler, sensors,
+  RProtocol handlers) publish typed events, and modules interested in these changes (logging, LCD, web, EvtMaster reporting)
+  subscribe to event types they care about.
+
+  Everything is statically allocated - fixed number of subscriber slots and fixed size events queue.
+  Events are queued by Publish() and dispatched to subscribers from the main loop, so publishers never call into consumers directly.
+
+  Subscribers react to the current state, so a queued event that has not been dispatched yet is updated in place by a newer
+  event of the same type and param1. Zone state and remote station reports can come in bursts (all zones of a station, reports
+  from every station), these are not queued - pending zones and stations are kept in bitmaps and dispatched with the current
+  state, so they are never lost. Remaining events come from local commands and schedules, a few per main loop pass.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _EVENTBUS_h
+#define _EVENTBUS_h
+
+#include <inttypes.h>
+#include "port.h"
+
+//
+// Event types
+//
+#define SGEVT_ZONE_STATE			1		// zone state change. param1 - zone number (0-based), param2 - current state (ZONE_STATE_*)
+#define SGEVT_ZONES_LOCAL_CMD		2		// zones started/stopped by local command (UI, web). param1 - stationID
+#define SGEVT_SCHEDULE_START		3		// schedule started. param1 - schedule ID (100 for quick schedule)
+#define SGEVT_SCHEDULE_STOP			4		// schedule stopped. param1 - schedule ID, value - water used
+#define SGEVT_PAUSE					5		// pause state change. value - pause time in minutes, 0 means resumed
+// 6 is not used - sensor readings are logged by the Sensors module directly, these are too frequent for the queue
+#define SGEVT_REMOTE_ZONES			7		// zones report received from remote station. param1 - stationID
+#define SGEVT_REMOTE_SENSORS		8		// sensors report received from remote station. param1 - stationID
+#define SGEVT_RUN_SCHEDULES			9		// schedules enabled/disabled. param1 - new value
+#define SGEVT_FLOW_ALARM			10		// flow monitor alarm. param1 - FLOWMON_ALARM_*, value - measured flow rate
+
+#define SGEVT_MASK(evt)				(uint16_t(1) << (evt))
+
+// Event bus dimensions. Queue holds local command and schedule events of one main loop pass, with one slot per event type.
+#define EVENTBUS_MAX_SUBSCRIBERS	6
+#define EVENTBUS_QUEUE_SIZE			10
+
+struct SGEvent
+{
+	uint8_t		type;
+	uint8_t		param1;
+	uint8_t		param2;
+	int32_t		value;
+};
+
+typedef void (*PEventHandler)(const SGEvent *pEvent);
+
+class EventBusClass
+{
+public:
+				EventBusClass();
+
+	bool		Subscribe(uint16_t eventsMask, PEventHandler handler);
+	bool		Publish(uint8_t type, uint8_t param1, uint8_t param2, int32_t value = 0);
+	void		loop(void);						// dispatch queued events, called from the main loop
+
+	uint16_t	GetOverflowCount(void)	{ return m_overflowCount; };	// events dropped because the queue was full
+
+private:
+	void		Dispatch(const SGEvent *pEvent);
+	void		DispatchPending(uint8_t type, uint8_t *pPending, uint8_t size);
+
+	struct
+	{
+		uint16_t		eventsMask;
+		PEventHandler	handler;
+	}			m_subscribers[EVENTBUS_MAX_SUBSCRIBERS];
+	uint8_t		m_numSubscribers;
+
+	SGEvent		m_queue[EVENTBUS_QUEUE_SIZE];
+	uint8_t		m_head;							// next event to dispatch
+	uint8_t		m_count;						// number of queued events
+	uint16_t	m_overflowCount;
+
+	uint8_t		m_zonesPending[(MAX_ZONES+7)/8];			// SGEVT_ZONE_STATE, bit per zone
+	uint8_t		m_remoteZonesPending[(MAX_STATIONS+7)/8];	// SGEVT_REMOTE_ZONES, bit per station
+	uint8_t		m_remoteSensorsPending[(MAX_STATIONS+7)/8];	// SGEVT_REMOTE_SENSORS, bit per station
+};
+
+extern EventBusClass eventBus;
+
+#endif //_EVENTBUS_h
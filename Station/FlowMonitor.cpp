@@ -0,0 +1,250 @@
+/*
+  Water flow monitor (leak and stuck valve detection) for the SmartGarden system.
+
+See FlowMonitor.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "FlowMonitor.h"
+#include "CounterMeter.h"
+#include "EventBus.h"
+#include "settings.h"
+#include "core.h"
+#include "sdlog.h"
+#include <string.h>
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+FlowMonitorClass flowMonitor;
+
+#if defined(SENSOR_ENABLE_FLOWMON) && defined(SENSOR_ENABLE_COUNTERMETER)
+
+static uint16_t		fmNominal[MAX_ZONES];		// learned nominal flow, 1/10 liter per minute
+static uint8_t		fmLearned[MAX_ZONES];		// seconds the zone was learned for, saturates at FLOWMON_LEARN_MIN
+
+static uint32_t		fmChangeTime;				// millis() of the last change of the running zones set
+static uint8_t		fmOverCount;				// seconds the over-flow condition holds
+static uint8_t		fmStuckCount;				// seconds the stuck valve condition holds
+static uint8_t		fmAlarm = FLOWMON_ALARM_NONE;
+#ifdef FLOWMON_MASTER_VALVE_PIN
+static bool			fmValveClosed = false;
+#endif
+
+// Zone started or stopped - restart the settle period. Starting a zone re-opens the master valve.
+static void FlowMonOnEvent(const SGEvent *pEvent)
+{
+	fmChangeTime = millis();
+
+#ifdef FLOWMON_MASTER_VALVE_PIN
+	if( fmValveClosed && (pEvent->param2 != ZONE_STATE_OFF) )
+	{
+		digitalWrite(FLOWMON_MASTER_VALVE_PIN, !FLOWMON_MASTER_VALVE_CLOSED);
+		fmValveClosed = false;
+		SYSEVT_INFO(F("Flow monitor - zone %d started, master valve opened"), uint16_t(pEvent->param1)+1);
+	}
+#endif //FLOWMON_MASTER_VALVE_PIN
+}
+
+// Configured flow rate of the zone (1/100 gal per minute in the zone config), 1/10 liter per minute.
+// Zones are created with ZONE_DEFAULT_FLOWRATE, this value means the flow rate was never set and the zone is treated as unconfigured.
+static uint16_t fmZoneConfigured(uint8_t nZone)
+{
+	ShortZone	zone;
+
+	LoadShortZone(nZone, &zone);
+	if( zone.waterFlowRate == ZONE_DEFAULT_FLOWRATE )
+		return 0;
+
+	return uint16_t((uint32_t(zone.waterFlowRate) * 3785ul) / 10000ul);
+}
+
+// Flow expected from the zone. Until the zone is learned it is the configured flow rate, 0 if the zone has no flow rate configured.
+static uint16_t fmZoneExpected(uint8_t nZone)
+{
+	if( fmLearned[nZone] >= FLOWMON_LEARN_MIN )
+		return fmNominal[nZone];
+
+	return fmZoneConfigured(nZone);
+}
+
+// Keep learned flow within FLOWMON_LEARN_BAND of the configured flow rate, if there is one
+static uint16_t fmClampLearned(uint8_t nZone, uint16_t rate)
+{
+	uint32_t	configured = fmZoneConfigured(nZone);
+
+	if( configured == 0 )
+		return rate;
+
+	uint32_t	low = configured * (100 - FLOWMON_LEARN_BAND) / 100;
+	uint32_t	high = configured * (100 + FLOWMON_LEARN_BAND) / 100;
+
+	if( rate < low )	return uint16_t(low);
+	if( rate > high )	return uint16_t(high);
+	return rate;
+}
+
+static void fmRaiseAlarm(uint8_t alarm, uint16_t rate, uint16_t expected)
+{
+	if( fmAlarm == alarm )
+		return;					// already reported, waiting for the condition to clear
+
+	fmAlarm = alarm;
+	if( alarm == FLOWMON_ALARM_OVERFLOW )
+	{
+		SYSEVT_CRIT(F("Flow monitor - over-flow, %u l/min x10 while %u expected"), rate, expected);
+	}
+	else
+	{
+		SYSEVT_CRIT(F("Flow monitor - flow of %u l/min x10 while no zone is running, valve stuck"), rate);
+	}
+
+	eventBus.Publish(SGEVT_FLOW_ALARM, alarm, 0, rate);
+
+#ifdef FLOWMON_MASTER_VALVE_PIN
+	digitalWrite(FLOWMON_MASTER_VALVE_PIN, FLOWMON_MASTER_VALVE_CLOSED);
+	fmValveClosed = true;
+#endif //FLOWMON_MASTER_VALVE_PIN
+
+	if( alarm == FLOWMON_ALARM_OVERFLOW )
+		runState.TurnOffZones();
+}
+
+#endif //SENSOR_ENABLE_FLOWMON && SENSOR_ENABLE_COUNTERMETER
+
+
+FlowMonitorClass::FlowMonitorClass()
+{
+}
+
+void FlowMonitorClass::begin(void)
+{
+#if defined(SENSOR_ENABLE_FLOWMON) && defined(SENSOR_ENABLE_COUNTERMETER)
+	memset(fmNominal, 0, sizeof(fmNominal));
+	memset(fmLearned, 0, sizeof(fmLearned));
+	fmChangeTime = millis();
+
+#ifdef FLOWMON_MASTER_VALVE_PIN
+	pinMode(FLOWMON_MASTER_VALVE_PIN, OUTPUT);
+	digitalWrite(FLOWMON_MASTER_VALVE_PIN, !FLOWMON_MASTER_VALVE_CLOSED);
+#endif //FLOWMON_MASTER_VALVE_PIN
+
+	eventBus.Subscribe(SGEVT_MASK(SGEVT_ZONE_STATE), FlowMonOnEvent);
+#endif //SENSOR_ENABLE_FLOWMON && SENSOR_ENABLE_COUNTERMETER
+}
+
+//
+// Compare measured flow with the flow expected for the running zones. Called once a second.
+//
+void FlowMonitorClass::loop(void)
+{
+#if defined(SENSOR_ENABLE_FLOWMON) && defined(SENSOR_ENABLE_COUNTERMETER)
+	uint16_t	rate = counterMeter.GetRate(FLOWMON_METER);
+	uint32_t	expected = 0;
+	uint8_t		numRunning = 0;
+	uint8_t		nSingle = 0;
+	bool		fKnown = true;				// expected flow is known for all running zones
+	uint8_t		numZones = min(GetNumZones(), MAX_ZONES);
+
+	for( uint8_t i=0; i<numZones; i++ )
+	{
+		uint8_t		state = GetZoneState(i+1);
+
+		if( state == ZONE_STATE_OFF )
+			continue;
+
+		if( state != ZONE_STATE_RUNNING )		// remote zone is starting or stopping
+		{
+			fmChangeTime = millis();
+			break;
+		}
+
+		uint16_t	zoneExpected = fmZoneExpected(i);
+
+		if( zoneExpected == 0 )
+			fKnown = false;
+		expected += zoneExpected;
+		nSingle = i;
+		numRunning++;
+	}
+
+	if( (millis() - fmChangeTime) < FLOWMON_SETTLE*1000ul )
+	{
+		fmOverCount = fmStuckCount = 0;
+		return;
+	}
+
+	if( numRunning == 0 )
+	{
+		fmOverCount = 0;
+		if( rate < FLOWMON_MIN_FLOW )
+		{
+			fmStuckCount = 0;
+			if( fmAlarm == FLOWMON_ALARM_STUCK )
+				fmAlarm = FLOWMON_ALARM_NONE;
+			return;
+		}
+
+		if( ++fmStuckCount >= FLOWMON_CONFIRM )
+		{
+			fmStuckCount = FLOWMON_CONFIRM;
+			fmRaiseAlarm(FLOWMON_ALARM_STUCK, rate, 0);
+		}
+		return;
+	}
+
+	fmStuckCount = 0;
+	if( fKnown && (rate >= FLOWMON_MIN_FLOW) && (uint32_t(rate)*100ul > expected*FLOWMON_OVER_PCT) )
+	{
+		if( ++fmOverCount >= FLOWMON_CONFIRM )
+		{
+			fmOverCount = FLOWMON_CONFIRM;
+			fmRaiseAlarm(FLOWMON_ALARM_OVERFLOW, rate, uint16_t(expected));
+		}
+		return;
+	}
+
+	fmOverCount = 0;
+	if( fmAlarm == FLOWMON_ALARM_OVERFLOW )
+		fmAlarm = FLOWMON_ALARM_NONE;
+
+	// single zone running with a plausible flow - learn its nominal flow
+	if( numRunning == 1 )
+	{
+		if( fmLearned[nSingle] == 0 )
+			fmNominal[nSingle] = fmClampLearned(nSingle, rate);		// learning starts from the first measurement
+		else
+			fmNominal[nSingle] = fmClampLearned(nSingle, uint16_t(int32_t(fmNominal[nSingle]) + ((int32_t(rate) - int32_t(fmNominal[nSingle])) >> FLOWMON_LEARN_SHIFT)));
+
+		if( fmLearned[nSingle] < FLOWMON_LEARN_MIN )
+		{
+			if( ++fmLearned[nSingle] == FLOWMON_LEARN_MIN )
+				TRACE_INFO(F("Flow monitor - zone %u nominal flow %u l/min x10\n"), uint16_t(nSingle)+1, fmNominal[nSingle]);
+		}
+	}
+#endif //SENSOR_ENABLE_FLOWMON && SENSOR_ENABLE_COUNTERMETER
+}
+
+uint8_t FlowMonitorClass::GetAlarm(void)
+{
+#if defined(SENSOR_ENABLE_FLOWMON) && defined(SENSOR_ENABLE_COUNTERMETER)
+	return fmAlarm;
+#else
+	return FLOWMON_ALARM_NONE;
+#endif
+}
+
+uint16_t FlowMonitorClass::GetNominal(uint8_t nZone)
+{
+#if defined(SENSOR_ENABLE_FLOWMON) && defined(SENSOR_ENABLE_COUNTERMETER)
+	if( nZone >= MAX_ZONES )
+		return 0;
+	return fmZoneExpected(nZone);
+#else
+	return 0;
+#endif
+}
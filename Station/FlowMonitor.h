@@ -0,0 +1,69 @@
+/*
+  Water flow monitor (leak and stuck valve detection) for the SmartGarden system.
+
+  Flow rate measured by the Counter/Meter (see CounterMeter.h) is compared every second with the flow expected for the set of
+  zones that are running:
+
+	- Over-flow (burst pipe): flow is more than FLOWMON_OVER_PCT percent of the sum of nominal flows of the running zones.
+	- Stuck valve: there is flow while no zone is running.
+
+  The comparison starts FLOWMON_SETTLE seconds after the set of running zones changed (valves open and close, pipes fill and drain),
+  and the condition must hold for FLOWMON_CONFIRM seconds to raise the alarm. Alarm is reported as a system event and published as
+  SGEVT_FLOW_ALARM, it is raised again only after the condition clears.
+
+  Nominal flow of each zone is learned while the zone runs alone, as a moving average of the measured flow. Until the zone is learned
+  (FLOWMON_LEARN_MIN seconds) over-flow is checked against the configured zone flow rate, and learned values are kept within
+  FLOWMON_LEARN_BAND percent of it - a burst pipe right after restart does not become the nominal flow. Zones without configured
+  flow rate are not checked for over-flow until learned, and their learned flow is not limited. Default zone flow rate
+  (ZONE_DEFAULT_FLOWRATE, set when zones are created) counts as not configured. Learned values are kept in RAM only - they are re-learned after restart,
+  to avoid EEPROM wear.
+
+  If FLOWMON_MASTER_VALVE_PIN is defined, the master valve is closed on alarm and re-opened when a zone is started again. Over-flow
+  alarm also turns off all zones.
+
+  Flow monitor runs on the station that has both the meter and the zones (master with a local Counter/Meter).
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _FLOWMONITOR_h
+#define _FLOWMONITOR_h
+
+#include <inttypes.h>
+#include "Defines.h"
+
+#ifndef FLOWMON_METER
+#define FLOWMON_METER				0		// Counter/Meter channel (0-based) that measures the flow of all zones
+#endif
+
+#define FLOWMON_SETTLE				30		// seconds
+#define FLOWMON_CONFIRM				5		// seconds
+#define FLOWMON_OVER_PCT			150		// percent of the expected flow
+#define FLOWMON_MIN_FLOW			5		// 1/10 liter per minute, flow below this is no flow
+#define FLOWMON_LEARN_MIN			60		// seconds of running alone before the zone nominal flow is trusted
+#define FLOWMON_LEARN_SHIFT			4		// weight of the new measurement in the nominal flow is 1/16
+#define FLOWMON_LEARN_BAND			50		// percent, learned nominal flow stays within this band around the configured flow rate
+
+// Alarms
+#define FLOWMON_ALARM_NONE			0
+#define FLOWMON_ALARM_OVERFLOW		1
+#define FLOWMON_ALARM_STUCK			2
+
+class FlowMonitorClass
+{
+public:
+				FlowMonitorClass();
+
+	void		begin(void);
+	void		loop(void);								// called once a second from Sensors::loop(), after counterMeter.loop()
+
+	uint8_t		GetAlarm(void);							// FLOWMON_ALARM_*
+	uint16_t	GetNominal(uint8_t nZone);				// expected flow of the zone (0-based) - learned, or configured until learned. 1/10 liter per minute
+};
+
+extern FlowMonitorClass flowMonitor;
+
+#endif //_FLOWMONITOR_h
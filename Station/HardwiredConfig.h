@@ -117,6 +117,12 @@ Copyright 2014-2015 tony-osp (http://tony-osp.dreamwidth.org/)
 #define SENSOR_DEFAULT_LCD_TEMPERATURE	0		// if defined, this will be the sensor channel shown as Temperature reading on the local LCD
 #define SENSOR_DEFAULT_LCD_HUMIDITY		1		// if defined, this will be the sensor channel shown as Humidity reading on the local LCD
 
+// additional DHT sensors (up to 3 in total), each on its own pin
+//#define SENSOR_CHANNEL_DHT_2_PIN			A5
+//#define SENSOR_CHANNEL_DHT_2_TYPE			DHT21
+//#define SENSOR_CHANNEL_DHT_2_TEMPERATURE	2
+//#define SENSOR_CHANNEL_DHT_2_HUMIDITY		3
+
 #endif //SG_HARDWARE == HW_V16_REMOTE
 
 // when DHT sensor is connected, this defines the data pin
@@ -193,18 +199,27 @@ Copyright 2014-2015 tony-osp (http://tony-osp.dreamwidth.org/)
 // locally connected "counter" - type sensor, typically this would be Waterflow meter
 //#define SENSOR_ENABLE_COUNTERMETER			1	// enable Counter/Meter sensor port
 #define SENSOR_COUNTERMETER_CHANNELS		1	// one Counter/Meter channel
-#define SENSOR_COUNTERMETER_RING_DELAY		3	// 3 cycles (i.e. 30ms) delay before counter-meter change is registered
+#define SENSOR_COUNTERMETER_DEBOUNCE		1000	// us, input must be stable this long before the pulse is counted
 
 #define SENSOR_CHANNEL_COUNTERMETER_1_PIN		A5	// Arduino pin for this sensor
 #define SENSOR_CHANNEL_COUNTERMETER_1_ACTIVE	LOW	// active value for this CounterMeter is LOW or HIGH
 #define SENSOR_CHANNEL_COUNTERMETER_1_TYPE		SENSOR_TYPE_WATERFLOW	// waterflow meter/sensor
 #define SENSOR_CHANNEL_COUNTERMETER_1_CHANNEL	1	// logical channel this sensor is mapped to
+//#define SENSOR_CHANNEL_COUNTERMETER_1_RATE_CHANNEL	2	// if defined, flow rate of this meter is reported on this logical channel
 
 // Normalized CounterMeter reading is calculated by multiplying actual tick delta reading by a constant1 (below) and then dividing by another constant, all in 32bit integer. 
 // This is equivalent to multiplying by floating point coefficient, but is a lot faster, while providing reasonable precision
 #define SENSOR_CHANNEL_COUNTERMETER_1_MULT		1	// multiplier for computing CounterMeter1 normalized reading
 #define SENSOR_CHANNEL_COUNTERMETER_1_DIV		1	// divider for computing CounterMeter1 normalized reading
 
+// More meters can be connected the same way, as SENSOR_CHANNEL_COUNTERMETER_2_* ... SENSOR_CHANNEL_COUNTERMETER_4_*
+
+// Leak and stuck valve detection using the flow rate of the first Counter/Meter, see FlowMonitor.h. Needs the flow rate (MULT and DIV
+// should normalize the meter to 1/10 liter per tick).
+//#define SENSOR_ENABLE_FLOWMON					1
+//#define FLOWMON_MASTER_VALVE_PIN				22		// if defined, master valve relay is driven by this pin and closed on alarm
+//#define FLOWMON_MASTER_VALVE_CLOSED			HIGH	// pin level that closes the master valve
+
 
 
 
@@ -0,0 +1,88 @@
+/*
+        In-memory loopback transport for the SmartGarden remote protocol.
+
+See LoopbackTransport.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "LoopbackTransport.h"
+#include "RProtocolMS.h"
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+
+LoopbackTransport::LoopbackTransport()
+{
+	txFrames = rxFrames = droppedFrames = 0;
+	_head = _count = 0;
+	_peer = 0;
+	_fReady = false;
+}
+
+void LoopbackTransport::begin(uint8_t networkID)
+{
+	_fReady = true;
+	rprotocol.RegisterTransport(networkID, this);
+}
+
+bool LoopbackTransport::Inject(const void *msg, uint8_t mSize)
+{
+	if( (_count >= LOOPBACK_QUEUE_SIZE) || (mSize > RPROTOCOL_MAX_FRAME_SIZE) )
+	{
+		TRACE_ERROR(F("Loopback - cannot queue frame, len %u, queue length %u\n"), uint16_t(mSize), uint16_t(_count));
+		droppedFrames++;
+		return false;
+	}
+
+	uint8_t		tail = (_head + _count) % LOOPBACK_QUEUE_SIZE;
+
+	memcpy(_queue[tail], msg, mSize);
+	_queueLen[tail] = mSize;
+	_count++;
+	return true;
+}
+
+//
+// Hand the frame to the peer (or loop it back). Frame is always "delivered", the callback is called right away.
+//
+bool LoopbackTransport::Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie)
+{
+	TRACE_VERBOSE(F("Loopback - sending frame to station %u, len %u\n"), uint16_t(nStation), uint16_t(mSize));
+
+	txFrames++;
+	if( _peer != 0 )
+		_peer(nStation, (const uint8_t *)msg, mSize);
+	else if( !Inject(msg, mSize) )
+		return false;
+
+	if( callback != 0 )
+		callback(nStation, cookie, true);
+	return true;
+}
+
+//
+// Deliver queued frames. Frames injected while delivering (replies to replies) wait for the next Poll().
+//
+void LoopbackTransport::Poll(void)
+{
+	uint8_t		n = _count;
+	uint8_t		buf[RPROTOCOL_MAX_FRAME_SIZE];
+
+	while( (n > 0) && (_count > 0) )
+	{
+		uint8_t		len = _queueLen[_head];
+
+		memcpy(buf, _queue[_head], len);		// ProcessNewFrame() may inject new frames, free the slot first
+		_head = (_head + 1) % LOOPBACK_QUEUE_SIZE;
+		_count--;
+		n--;
+
+		rxFrames++;
+		rprotocol.ProcessNewFrame(buf, len, 0, this);
+	}
+}
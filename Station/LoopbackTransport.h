@@ -0,0 +1,61 @@
+/*
+        In-memory loopback transport for the SmartGarden remote protocol.
+
+
+Frames sent through the loopback transport are handed to the peer callback, which plays the role of the remote stations.
+The peer replies by calling Inject(), and injected frames are delivered to rprotocol.ProcessNewFrame() on the next Poll().
+Without a peer, sent frames are looped back to the local station.
+
+This allows to run master RProtocol logic against any number of simulated stations in a single process (unit and load tests).
+There is no global instance - test code creates the transport and calls begin() to register it.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _LOOPBACKTRANSPORT_h
+#define _LOOPBACKTRANSPORT_h
+
+#include <inttypes.h>
+#include "Defines.h"
+#include "settings.h"
+#include "SGRProtocol.h"
+#include "Transport.h"
+
+#define LOOPBACK_QUEUE_SIZE		8		// frames waiting for delivery
+
+// Peer callback - receives frames sent through the transport
+typedef void (*PLoopbackPeer)(uint8_t nStation, const uint8_t *msg, uint8_t mSize);
+
+class LoopbackTransport : public NetTransport
+{
+public:
+	LoopbackTransport();
+	void	begin(uint8_t networkID = NETWORK_ID_LOOPBACK);
+	void	SetPeer(PLoopbackPeer peer) { _peer = peer; };
+	bool	Inject(const void *msg, uint8_t mSize);		// queue frame for delivery to the local station
+
+// NetTransport
+	bool	IsReady(void) { return _fReady; };
+	bool	Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie);
+	void	Poll(void);
+	uint8_t	ResolveAddress(uint8_t nStation, uint8_t *pAddress) { *pAddress = nStation; return 1; };
+	uint8_t	MTU(void) { return RPROTOCOL_MAX_FRAME_SIZE; };
+	uint8_t	Flags(void) { return TRANSPORT_FLAGS_RELIABLE | TRANSPORT_FLAGS_DELIVERY_REPORT | TRANSPORT_FLAGS_BROADCAST; };
+
+	uint32_t	txFrames;
+	uint32_t	rxFrames;
+	uint32_t	droppedFrames;		// frames injected while the queue was full
+
+private:
+	uint8_t			_queue[LOOPBACK_QUEUE_SIZE][RPROTOCOL_MAX_FRAME_SIZE];
+	uint8_t			_queueLen[LOOPBACK_QUEUE_SIZE];
+	uint8_t			_head;
+	uint8_t			_count;
+	PLoopbackPeer	_peer;
+	bool			_fReady;
+};
+
+#endif //_LOOPBACKTRANSPORT_h
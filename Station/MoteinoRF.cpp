@@ -21,6 +21,20 @@ another one is the list of last known sequence numbers received from stations on
 
 The above mechanism is intended for point-to-point transmissions, not broadcasts, because it relies on ACK to proceed to the next sequence number.
 
+October 2016 - non-blocking transmit.
+Outgoing packets are placed into the transmit queue and sent by the state machine in loop(), instead of blocking in sendWithRetry().
+Sequence number is assigned when the packet is queued, so retries of the queued packet carry the same sequence number.
+
+October 2016 - per-station link statistics.
+ACK rate, retry histogram, ACK round trip time, duplicates and RSSI are tracked per station, and drive retry count, ACK timeout
+and transmit power (RFM69_ATC) used for that station. Link statistics are available as JSON (json/links).
+
+October 2016 - zero-copy frames.
+RProtocol builds outgoing frames directly in the transmit queue entry, after the sequence number byte, and queue entries are never moved.
+Incoming frames are processed straight from the RFM69 receive buffer. The receive buffer is overwritten when the radio goes back to RX,
+so the ACK is sent with sendACKNow(), which keeps the radio out of RX, and the frame is processed after the ACK is out. Outgoing packets
+are only queued while the frame is processed, the radio is not touched.
+
 
 */
 
@@ -33,12 +47,27 @@ The above mechanism is intended for point-to-point transmissions, not broadcasts
 
 extern int16_t		LastReceivedRSSI;
 
+#ifdef MOTEINORF_ATC
+RFM69_ATC moteinoRF;
+#else
 RFM69 moteinoRF;
+#endif
+
+// Transmit state machine states
+#define MOTEINORF_TX_IDLE			0
+#define MOTEINORF_TX_CSMA			1		// waiting for the channel to become clear
+#define MOTEINORF_TX_AWAIT_ACK		2
 
 
 MoteinoRFClass::MoteinoRFClass()
 {
 	fMoteinoRFReady = false;
+	txCount = 0;
+	for( uint8_t i=0; i<MOTEINORF_TX_QUEUE_SIZE; i++ )
+		txOrder[i] = i;
+	txState = MOTEINORF_TX_IDLE;
+	txCurrent = 0;
+	txStateTime = 0;
 }
 
 void MoteinoRFClass::begin()
@@ -67,6 +96,9 @@ void MoteinoRFClass::begin()
 
 #ifdef IS_RFM69HW
 	moteinoRF.setHighPower(); //required only for RFM69HW!
+#endif
+#ifdef MOTEINORF_ATC
+	moteinoRF.enableAutoPower(MOTEINORF_ATC_TARGET_RSSI);
 #endif
 	//moteinoRF.promiscuous(true);
 
@@ -79,8 +111,16 @@ void MoteinoRFClass::begin()
 		uLastReceivedSNumber[i] = 255;	// reserved counter value, used to synchronize state
 	}
 
+	memset(linkStats, 0, sizeof(linkStats));
+	for( uint8_t i=0; i<MOTEINORF_LINK_STATS_SIZE; i++ )
+	{
+		linkStats[i].ackRate = 100;		// start optimistic, with default retry count and full power
+		linkStats[i].txLevel = 31;
+	}
+
 	SetMoteinoRFFlags(GetMoteinoRFFlags() | NETWORK_FLAGS_ON);	// Mark MoteinoRF network as On
 	fMoteinoRFReady = true;		// and set local readiness flag
+	rprotocol.RegisterTransport(NETWORK_ID_MOTEINORF, this);
 
 	//rprotocol.RegisterARP((void *)&MoteinoRFARPUpdate);			// register ARP callback with the remote protocol
 															// rprotocol will use it to report station=address associations
@@ -97,46 +137,327 @@ failed_ex1:
 
 // Main packet send routine. 
 //
+// The packet is queued for transmission, actual transmission happens in loop().
+// Returns false if the packet cannot be queued. Delivery result is reported through the callback (if provided).
 //
-//
-bool MoteinoRFSendPacket(uint8_t nStation, void *msg, uint8_t mSize)
+bool MoteinoRFSendPacket(uint8_t nStation, void *msg, uint8_t mSize, PMoteinoRFTxCallback callback, uint8_t cookie)
 {
 	if( !MoteinoRF.fMoteinoRFReady )	// check that MoteinoRF is initialized and ready
 		return false;
 
-	if( nStation == STATIONID_BROADCAST ) // broadcast
+	return MoteinoRF.QueuePacket(nStation, msg, mSize, callback, cookie);
+}
+
+bool MoteinoRFClass::Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie)
+{
+	return MoteinoRFSendPacket(nStation, msg, mSize, callback, cookie);
+}
+
+bool MoteinoRFClass::QueuePacket(uint8_t nStation, void *msg, uint8_t mSize, PMoteinoRFTxCallback callback, uint8_t cookie)
+{
+	uint8_t		*pFrame = AllocFrame(nStation, mSize);
+
+	if( pFrame == 0 )
+	{
+// for Master station we want to log transmission errors, while for Remote station should send errors to trace
+// This is required to avoid infine recursive loop on remote station, since attempt to log error will attempt to send error report which may also result in error
+#if (SG_HARDWARE == HW_V16_REMOTE) || (SG_HARDWARE == HW_V17_REMOTE)
+		TRACE_ERROR(F("MoteinoRF - cannot queue packet to station %u, queue length %u\n"), uint16_t(nStation), uint16_t(txCount));
+#else
+		SYSEVT_ERROR(F("MoteinoRF - cannot queue packet to station %u, queue length %u"), uint16_t(nStation), uint16_t(txCount));
+#endif
+		return false;
+	}
+
+	memcpy(pFrame, msg, mSize);
+	return SendFrame(nStation, mSize, callback, cookie);
+}
+
+//
+// Buffer for the next frame to send - data area of the first free queue entry. Returns 0 if the queue is full.
+//
+uint8_t *MoteinoRFClass::AllocFrame(uint8_t nStation, uint8_t mSize)
+{
+	if( (txCount >= MOTEINORF_TX_QUEUE_SIZE) || (mSize >= RF69_MAX_DATA_LEN) )
+		return 0;
+
+	return TxEntry(txCount)->buf + 1;		// first byte is reserved for the sequence number
+}
+
+//
+// Queue the frame built in the AllocFrame() buffer
+//
+bool MoteinoRFClass::SendFrame(uint8_t nStation, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie)
+{
+	if( (txCount >= MOTEINORF_TX_QUEUE_SIZE) || (mSize >= RF69_MAX_DATA_LEN) )
+		return false;
+
+	MoteinoRFTxEntry	*pEntry = TxEntry(txCount);
+
+	pEntry->nStation = nStation;
+	pEntry->len = mSize;
+	pEntry->callback = callback;
+	pEntry->cookie = cookie;
+	pEntry->nextTime = millis();
+	pEntry->attempts = 0;
+
+	if( nStation == STATIONID_BROADCAST ) // broadcast messages don't have sequence numbers and are not acknowledged
 	{
-		TRACE_VERBOSE(F("MoteinoRF - sending broadcast packet, len %u\n"), uint16_t(mSize));
-		moteinoRF.send(RF69_BROADCAST_ADDR,msg, mSize);
+		TRACE_VERBOSE(F("MoteinoRF - queueing broadcast packet, len %u\n"), uint16_t(mSize));
+		pEntry->retries = 0;
 	}
 	else
 	{
-		uint8_t		buf[RF69_MAX_DATA_LEN];
-
 		if( nStation < MAX_STATIONS )						// first byte of the packet is the sequence number
-			buf[0] = MoteinoRF.uNextSNumber[nStation];		// we keep track of sequence numbers per station
+		{
+			pEntry->buf[0] = uNextSNumber[nStation];		// we keep track of sequence numbers per station
+
+			// increase sequence counter for this destination
+			if( uNextSNumber[nStation] == 254 )	uNextSNumber[nStation] = 0;
+			else								uNextSNumber[nStation]++;
+		}
 		else
-			buf[0] = 255;
+			pEntry->buf[0] = 255;
 
-		TRACE_VERBOSE(F("MoteinoRF - sending packet to station %u, SN:%u, len %u\n"), uint16_t(nStation), uint16_t(buf[0]), uint16_t(mSize));
-		memcpy(buf+1, msg, mSize);	// because sequence number is added as the first byte in the transmission, need to allocate new buffer and copy data to it (TODO: fill fix it later)
+		TRACE_VERBOSE(F("MoteinoRF - queueing packet to station %u, SN:%u, len %u\n"), uint16_t(nStation), uint16_t(pEntry->buf[0]), uint16_t(mSize));
+		pEntry->retries = LinkRetries(nStation);
+	}
 
-		bool retFlag = moteinoRF.sendWithRetry(nStation, buf, mSize+1, NETWORK_MOTEINORF_RETRY_COUNT, 200); // num of retries, 200ms wait time
-		// increase sequence counter for this destination
-		if( MoteinoRF.uNextSNumber[nStation] == 254 )	MoteinoRF.uNextSNumber[nStation] = 0;
-		else											MoteinoRF.uNextSNumber[nStation]++;
-		if(!retFlag)
-		{
-// for Master station we want to log transmission errors, while for Remote station should send errors to trace
-// This is required to avoid infine recursive loop on remote station, since attempt to log error will attempt to send error report which may also result in error
+	txCount++;
+	return true;
+}
+
+//
+// Transmission of the current packet is finished, report result and remove the packet from the queue
+//
+void MoteinoRFClass::TxDone(bool fDelivered)
+{
+	MoteinoRFTxEntry	*pEntry = TxEntry(txCurrent);
+	uint8_t				nStation = pEntry->nStation;
+	uint8_t				cookie = pEntry->cookie;
+	PMoteinoRFTxCallback callback = pEntry->callback;
+
+	if( !fDelivered )
+	{
+		if( nStation < MOTEINORF_LINK_STATS_SIZE )
+			linkStats[nStation].txFailed++;
 #if (SG_HARDWARE == HW_V16_REMOTE) || (SG_HARDWARE == HW_V17_REMOTE)
-			TRACE_ERROR(F("MoteinoRF - sendWithRetry returned %d\n"), int16_t(retFlag));
+		TRACE_ERROR(F("MoteinoRF - no ACK from station %u\n"), uint16_t(nStation));
 #else
-			SYSEVT_ERROR(F("MoteinoRF - sendWithRetry returned %d"), int16_t(retFlag));
+		SYSEVT_ERROR(F("MoteinoRF - no ACK from station %u"), uint16_t(nStation));
+#endif
+	}
+
+	// remove the entry from the FIFO, and put it first in the free list
+	uint8_t		freed = txOrder[txCurrent];
+
+	txCount--;
+	for( uint8_t i=txCurrent; i<txCount; i++ )
+		txOrder[i] = txOrder[i+1];
+	txOrder[txCount] = freed;
+	txState = MOTEINORF_TX_IDLE;
+
+	if( callback != 0 )
+		callback(nStation, cookie, fDelivered);		// called last, callback may queue new packets
+}
+
+//
+// Advance transmit state machine by one step
+//
+void MoteinoRFClass::TxStep(void)
+{
+	uint32_t	timeNow = millis();
+
+	if( txState == MOTEINORF_TX_IDLE )
+	{
+		// pick the oldest packet which is due, skipping stations that have older packets still waiting for retry
+		uint8_t  i;
+		for( i=0; i<txCount; i++ )
+		{
+			bool  fBlocked = false;
+			for( uint8_t j=0; j<i; j++ )
+			{
+				if( TxEntry(j)->nStation == TxEntry(i)->nStation )
+					fBlocked = true;
+			}
+			if( !fBlocked && (int32_t(timeNow - TxEntry(i)->nextTime) >= 0) )
+				break;
+		}
+		if( i >= txCount )
+			return;			// nothing to send yet
+
+		txCurrent = i;
+		txState = MOTEINORF_TX_CSMA;
+		txStateTime = timeNow;
+	}
+
+	MoteinoRFTxEntry	*pEntry = TxEntry(txCurrent);
+
+	if( txState == MOTEINORF_TX_CSMA )
+	{
+		bool  fBroadcast = pEntry->nStation == STATIONID_BROADCAST;
+
+#ifdef MOTEINORF_ATC
+		moteinoRF._transmitLevel = fBroadcast ? 31:LinkTxLevel(pEntry->nStation);		// broadcasts go at full power
 #endif
+		rprotocol.StampTimeSync(pEntry->buf+1, pEntry->len);		// time sync goes with the time of the actual transmission
+
+		// after RF69_CSMA_LIMIT_MS of busy channel send anyway, same as RFM69::send() does
+		// broadcasts go without the sequence number
+		if( !moteinoRF.trySend(fBroadcast ? RF69_BROADCAST_ADDR:pEntry->nStation, fBroadcast ? pEntry->buf+1:pEntry->buf, fBroadcast ? pEntry->len:pEntry->len+1,
+								!fBroadcast, (timeNow - txStateTime) >= RF69_CSMA_LIMIT_MS) )
+			return;
+
+		if( fBroadcast )
+		{
+			TxDone(true);
+			return;
+		}
+
+		pEntry->attempts++;
+		if( (pEntry->attempts == 1) && (pEntry->nStation < MOTEINORF_LINK_STATS_SIZE) )
+			linkStats[pEntry->nStation].txPackets++;
+
+		txAckTimeout = LinkAckTimeout(pEntry->nStation);
+		txState = MOTEINORF_TX_AWAIT_ACK;
+		txStateTime = millis();
+		return;
+	}
+
+	if( txState == MOTEINORF_TX_AWAIT_ACK )
+	{
+		if( (timeNow - txStateTime) < txAckTimeout )
+			return;
+
+		LinkTxResult(pEntry->nStation, false, 0);
+
+		if( pEntry->retries == 0 )
+		{
+			TxDone(false);
+			return;
+		}
+
+		TRACE_VERBOSE(F("MoteinoRF - no ACK from station %u, retries left %u\n"), uint16_t(pEntry->nStation), uint16_t(pEntry->retries));
+		pEntry->retries--;
+		pEntry->nextTime = timeNow + MOTEINORF_RETRY_WAIT;
+		txState = MOTEINORF_TX_IDLE;		// let packets to other stations go while this one waits
+	}
+}
+
+//
+//	Link statistics and adaptive transmit policy
+//
+
+// Number of retries for the new packet to the station
+uint8_t MoteinoRFClass::LinkRetries(uint8_t nStation)
+{
+	if( nStation >= MOTEINORF_LINK_STATS_SIZE )
+		return NETWORK_MOTEINORF_RETRY_COUNT;
+
+	uint8_t		ackRate = linkStats[nStation].ackRate;
+
+	if( ackRate >= 90 )	return MOTEINORF_RETRIES_MIN;		// good link, single retry covers occasional loss
+	if( ackRate >= 50 )	return NETWORK_MOTEINORF_RETRY_COUNT;
+	if( ackRate >= 10 )	return MOTEINORF_RETRIES_MAX;		// lossy link, needs more attempts to get through
+	return MOTEINORF_RETRIES_MIN;							// station looks down, don't waste airtime on it
+}
+
+// ACK timeout for the station, SRTT + 4*RTTVAR within [MOTEINORF_ACK_TIMEOUT_MIN, MOTEINORF_ACK_TIMEOUT]
+uint16_t MoteinoRFClass::LinkAckTimeout(uint8_t nStation)
+{
+	if( (nStation >= MOTEINORF_LINK_STATS_SIZE) || (linkStats[nStation].srtt == 0) )
+		return MOTEINORF_ACK_TIMEOUT;
+
+	uint16_t	rto = (linkStats[nStation].srtt >> 3) + linkStats[nStation].rttvar;
+
+	if( rto < MOTEINORF_ACK_TIMEOUT_MIN )	return MOTEINORF_ACK_TIMEOUT_MIN;
+	if( rto > MOTEINORF_ACK_TIMEOUT )		return MOTEINORF_ACK_TIMEOUT;
+	return rto;
+}
+
+uint8_t MoteinoRFClass::LinkTxLevel(uint8_t nStation)
+{
+	if( nStation >= MOTEINORF_LINK_STATS_SIZE )
+		return 31;
+
+	return linkStats[nStation].txLevel;
+}
+
+//
+// Update link statistics with the result of one transmission.
+//
+// rtt is the ACK round trip time in ms, or 0 if there is no valid sample.
+//
+void MoteinoRFClass::LinkTxResult(uint8_t nStation, bool fAcked, uint16_t rtt)
+{
+	if( nStation >= MOTEINORF_LINK_STATS_SIZE )
+		return;
+
+	MoteinoRFLinkStats	*pLink = linkStats + nStation;
+
+	pLink->ackRate = (uint16_t(pLink->ackRate)*7 + (fAcked ? 100:0) + 4) / 8;
+
+	if( fAcked )
+	{
+		uint8_t		nRetries = TxEntry(txCurrent)->attempts - 1;
+
+		pLink->retryHist[nRetries < MOTEINORF_HIST_SIZE ? nRetries:MOTEINORF_HIST_SIZE-1]++;
+
+		if( rtt != 0 )
+		{
+			if( pLink->srtt == 0 )		// first sample
+			{
+				pLink->srtt = rtt << 3;
+				pLink->rttvar = rtt << 1;
+			}
+			else
+			{
+				int16_t		delta = int16_t(rtt) - int16_t(pLink->srtt >> 3);
+
+				pLink->srtt += delta;
+				if( delta < 0 ) delta = -delta;
+				pLink->rttvar += delta - (pLink->rttvar >> 2);
+			}
 		}
+#ifdef MOTEINORF_ATC
+		pLink->txLevel = moteinoRF._transmitLevel;		// RFM69_ATC adjusts the level using RSSI reported in the ACK
+#endif
+	}
+#ifdef MOTEINORF_ATC
+	else
+	{
+		pLink->txLevel = (pLink->txLevel > 31-MOTEINORF_ATC_LOSS_STEP) ? 31:pLink->txLevel+MOTEINORF_ATC_LOSS_STEP;
+	}
+#endif
+}
+
+//
+// Emit link statistics (as JSON). Stations without any traffic are skipped.
+//
+bool MoteinoRFClass::TableLinkStats(FILE* stream_file)
+{
+	bool		fFirst = true;
+
+	fprintf_P(stream_file, PSTR("\n\t \"links\" : ["));
+
+	for( uint8_t i=0; i<MOTEINORF_LINK_STATS_SIZE; i++ )
+	{
+		MoteinoRFLinkStats	*pLink = linkStats + i;
+
+		if( (pLink->txPackets == 0) && (pLink->rssiAvg == 0) )
+			continue;
+
+		fprintf_P(stream_file, PSTR("%s\n\t { \"stationID\": %u, \"txPackets\": %u, \"txFailed\": %u, \"ackRate\": %u, \"retryHist\": ["),
+					fFirst ? "":",", uint16_t(i), pLink->txPackets, pLink->txFailed, uint16_t(pLink->ackRate));
+		for( uint8_t h=0; h<MOTEINORF_HIST_SIZE; h++ )
+			fprintf_P(stream_file, PSTR("%s%u"), h == 0 ? "":", ", pLink->retryHist[h]);
+
+		fprintf_P(stream_file, PSTR("], \"duplicates\": %u, \"rtt\": %u, \"ackTimeout\": %u, \"retries\": %u, \"rssi\": %d, \"txLevel\": %u }"),
+					pLink->duplicates, pLink->srtt >> 3, LinkAckTimeout(i), uint16_t(LinkRetries(i)), pLink->rssiAvg/4, uint16_t(pLink->txLevel));
+		fFirst = false;
 	}
 
+	fprintf_P(stream_file, PSTR("\n\t ]\n"));
 	return true;
 }
 
@@ -151,50 +472,79 @@ void MoteinoRFClass::loop(void)
 {
 	//TRACE_INFO(F("MoteinoRF - loop\n"));
 
+	if( !fMoteinoRFReady )
+		return;
+
 	if( moteinoRF.receiveDone() )
 	{
-		uint8_t		buf[RF69_MAX_DATA_LEN];
-		uint8_t		buf_len = 0;
+		uint8_t		*frame = (uint8_t *)(moteinoRF.DATA);	// radio stays in standby until the next receiveDone(), the buffer is stable
+		uint8_t		frameLen = moteinoRF.DATALEN;
 		uint8_t		senderID = moteinoRF.SENDERID;
 		uint8_t		targetID = moteinoRF.TARGETID;
+		bool		fSendACK = moteinoRF.ACKRequested();
 
-		if( moteinoRF.DATALEN > 5 )
+		// ACK goes out before the frame is processed, so processing time does not add to the sender's ACK round trip time.
+		// sendACKNow() keeps the radio out of RX, the receive buffer stays intact.
+		if( fSendACK )
 		{
-			memcpy(buf, (uint8_t *)(moteinoRF.DATA), moteinoRF.DATALEN);
-			buf_len = moteinoRF.DATALEN;
+#ifdef MOTEINORF_ATC
+			uint8_t		txLevel = moteinoRF._transmitLevel;		// keep the level of the packet waiting for ACK
+
+			moteinoRF._transmitLevel = LinkTxLevel(senderID);
+			moteinoRF.sendACKNow();
+			moteinoRF._transmitLevel = txLevel;
+#else
+			moteinoRF.sendACKNow();
+#endif
+			TRACE_VERBOSE(F("MoteinoRF - ACK requested, sent it.\n"));
 		}
 
-		if( moteinoRF.ACKRequested() )
+		if( moteinoRF.ACK_RECEIVED && (txState == MOTEINORF_TX_AWAIT_ACK) && (senderID == TxEntry(txCurrent)->nStation) )
 		{
-			moteinoRF.sendACK();
-			TRACE_VERBOSE(F("MoteinoRF - ACK requested, sending it.\n"));
+			TRACE_VERBOSE(F("MoteinoRF - received ACK from %d\n"), int16_t(senderID));
+
+			// round trip time is sampled only for first transmissions, ACK to a retry can belong to any of the attempts
+			LinkTxResult(senderID, true, TxEntry(txCurrent)->attempts == 1 ? uint16_t(millis() - txStateTime):0);
+			TxDone(true);
 		}
 
 		LastReceivedRSSI = moteinoRF.RSSI;	// update global RSSI tracker
-		if( buf_len > 5 )	
+		if( senderID < MOTEINORF_LINK_STATS_SIZE )
+		{
+			MoteinoRFLinkStats	*pLink = linkStats + senderID;
+
+			if( pLink->rssiAvg == 0 )	pLink->rssiAvg = LastReceivedRSSI*4;
+			else						pLink->rssiAvg += LastReceivedRSSI - pLink->rssiAvg/4;
+		}
+		if( frameLen > 5 )	
 		{
 			if( targetID == RF69_BROADCAST_ADDR )	// broadcast messages don't have sequence numbers
 			{
-				TRACE_VERBOSE(F("MoteinoRF - received broadcast packet from %d, len=%u\n"), int16_t(senderID), uint16_t(buf_len-1));
-				rprotocol.ProcessNewFrame(buf, buf_len, 0 );	// process incoming packet.
+				TRACE_VERBOSE(F("MoteinoRF - received broadcast packet from %d, len=%u\n"), int16_t(senderID), uint16_t(frameLen));
+				rprotocol.ProcessNewFrame(frame, frameLen, 0, this );	// process incoming packet.
 			}
 			else if( senderID < MAX_STATIONS )	// basic protection to ensure we will not have an overflow. We handle packets only from senders with acceptable addresses (within MAX_STATION)
 			{
-				if( buf[0] != MoteinoRF.uLastReceivedSNumber[senderID] ) // make sure this is not a duplicate packet
+				if( frame[0] != MoteinoRF.uLastReceivedSNumber[senderID] ) // make sure this is not a duplicate packet
 				{
-					if( buf[0] != 255 ) // valid sequence numbers are from 0 to 254
-						MoteinoRF.uLastReceivedSNumber[senderID] = buf[0];	// update last received serial number from that source
+					if( frame[0] != 255 ) // valid sequence numbers are from 0 to 254
+						MoteinoRF.uLastReceivedSNumber[senderID] = frame[0];	// update last received serial number from that source
 
-					TRACE_VERBOSE(F("MoteinoRF - received packet from %d, SN=%u, len=%u\n"), int16_t(senderID), uint16_t(buf[0]), uint16_t(buf_len-1));
-					rprotocol.ProcessNewFrame(buf+1, buf_len-1, 0 );	// process incoming packet. Note: we strip out sequence number
+					TRACE_VERBOSE(F("MoteinoRF - received packet from %d, SN=%u, len=%u\n"), int16_t(senderID), uint16_t(frame[0]), uint16_t(frameLen-1));
+					rprotocol.ProcessNewFrame(frame+1, frameLen-1, 0, this );	// process incoming packet. Note: we strip out sequence number
 				}
 				else
 				{
-					TRACE_VERBOSE(F("MoteinoRF - received duplicate packet from %d, SN=%u\n"), int16_t(senderID), uint16_t(buf[0]));
+					TRACE_VERBOSE(F("MoteinoRF - received duplicate packet from %d, SN=%u\n"), int16_t(senderID), uint16_t(frame[0]));
+					if( senderID < MOTEINORF_LINK_STATS_SIZE )
+						linkStats[senderID].duplicates++;
 				}
 			}
 		}
+
 	}
+
+	TxStep();
 }
 
 
@@ -19,34 +19,128 @@ Copyright 2015 tony-osp (http://tony-osp.dreamwidth.org/)
 
 #include "Defines.h"
 #include "RFM69.h"
+#include "RFM69_ATC.h"
+#include "Transport.h"
+#include <stdio.h>
 
 //#define FREQUENCY     RF69_433MHZ
 //#define FREQUENCY     RF69_868MHZ
 #define MOTEINORF_FREQUENCY       RF69_915MHZ //Match this with the version of your Moteino! (others: RF69_433MHZ, RF69_868MHZ)
 //#define ENCRYPTKEY      "sampleEncryptKey" //has to be same 16 characters/bytes on all nodes, not more not less!
 #define IS_RFM69HW    //uncomment only for RFM69HW! Leave out if you have RFM69W!
+#define MOTEINORF_ATC	// per-destination transmit power control using RFM69_ATC. Comment out to always transmit at full power
 
 // ***TEMPORARY***
 // RFM69 encryption key is statically defined here (16 characters)
 #define MOTEINORF_ENCRYPTKEY	"SmartGarden v1.x"
 
-class MoteinoRFClass
+// Transmit queue.
+//
+// Packets are queued by MoteinoRFSendPacket() and transmitted from loop(), one step per call:
+// carrier sense -> send -> wait for ACK -> retry. While a packet waits for its retry timer, packets to other stations
+// can go first. Packets to the same station are always sent in order.
+//
+// Queue entries don't move - FIFO order is kept in the txOrder[] index, followed by indexes of free entries.
+// RProtocol builds frames directly in the free entry buffer (AllocFrame()/SendFrame()), after the byte reserved for the sequence number.
+//
+#define MOTEINORF_TX_QUEUE_SIZE		6
+#define MOTEINORF_ACK_TIMEOUT		200		// ms to wait for ACK, upper limit of the adaptive ACK timeout
+#define MOTEINORF_ACK_TIMEOUT_MIN	30		// ms, lower limit of the adaptive ACK timeout
+#define MOTEINORF_RETRY_WAIT		100		// ms between ACK timeout and the next attempt to the same station
+
+// Link statistics and adaptive transmit policy.
+//
+// Statistics are kept per destination station. ACK timeout follows the smoothed round trip time of ACKs to first transmissions
+// (RTO = SRTT + 4*RTTVAR), number of retries follows the ACK rate, and transmit power is adjusted by RFM69_ATC
+// using RSSI the destination reports back in ACKs. Lost ACK bumps transmit power up.
+//
+#define MOTEINORF_RETRIES_MIN		1		// retries on good links (ACK rate 90% and up)
+#define MOTEINORF_RETRIES_MAX		6		// retries on lossy links (ACK rate below 50%)
+#define MOTEINORF_HIST_SIZE			4		// retry histogram buckets - delivered with 0, 1, 2, and 3 or more retries
+#define MOTEINORF_ATC_TARGET_RSSI	-80		// dBm, RSSI on the receiving end the power control aims for
+#define MOTEINORF_ATC_LOSS_STEP		4		// transmit power increase after lost ACK
+
+#if (SG_HARDWARE == HW_V16_REMOTE) || (SG_HARDWARE == HW_V17_REMOTE)
+#define MOTEINORF_LINK_STATS_SIZE	4		// remote station talks mostly to the master, save RAM
+#else
+#define MOTEINORF_LINK_STATS_SIZE	MAX_STATIONS
+#endif
+
+struct MoteinoRFLinkStats
+{
+	uint16_t	txPackets;			// packets sent, not counting retries
+	uint16_t	txFailed;			// packets not acknowledged after all retries
+	uint16_t	retryHist[MOTEINORF_HIST_SIZE];		// acknowledged packets by number of retries needed
+	uint16_t	duplicates;			// duplicate packets received from the station
+	uint16_t	srtt;				// smoothed ACK round trip time, ms*8. 0 if there were no samples yet
+	uint16_t	rttvar;				// round trip time variation, ms*4
+	int16_t		rssiAvg;			// moving average of RSSI of packets received from the station, dBm*4. 0 if nothing was received
+	uint8_t		ackRate;			// moving average of ACK rate per transmission, percent
+	uint8_t		txLevel;			// transmit power level for this station, 0-31
+};
+
+// Delivery result callback, called once the packet is ACKed or all retries are exhausted.
+typedef PTransportTxCallback PMoteinoRFTxCallback;
+
+struct MoteinoRFTxEntry
+{
+	uint8_t					nStation;		// destination station
+	uint8_t					len;			// frame length, not counting sequence number
+	uint8_t					retries;		// transmissions left after the current one
+	uint8_t					attempts;		// transmissions done so far
+	uint8_t					cookie;			// caller data passed back to the callback
+	uint32_t				nextTime;		// earliest time of the next transmission attempt
+	PMoteinoRFTxCallback	callback;
+	uint8_t					buf[RF69_MAX_DATA_LEN];	// sequence number followed by the frame
+};
+
+class MoteinoRFClass : public NetTransport
 {
  public:
 	MoteinoRFClass();
 	void begin(void);
 	void loop(void);
 
+// NetTransport
+	bool	IsReady(void) { return fMoteinoRFReady; };
+	bool	Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie);
+	void	Poll(void) { loop(); };
+	uint8_t	ResolveAddress(uint8_t nStation, uint8_t *pAddress) { *pAddress = nStation; return 1; };	// RFM69 node address is the stationID
+	uint8_t	MTU(void) { return RF69_MAX_DATA_LEN-1; };		// one byte is taken by the sequence number
+	uint8_t	Flags(void) { return TRANSPORT_FLAGS_RELIABLE | TRANSPORT_FLAGS_DELIVERY_REPORT | TRANSPORT_FLAGS_BROADCAST; };
+	uint8_t	*AllocFrame(uint8_t nStation, uint8_t mSize);
+	bool	SendFrame(uint8_t nStation, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie);
+
+	bool	QueuePacket(uint8_t nStation, void *msg, uint8_t mSize, PMoteinoRFTxCallback callback, uint8_t cookie);
+	uint8_t	TxQueueLength(void) { return txCount; };
+	bool	TableLinkStats(FILE* stream_file);
+
 	bool	fMoteinoRFReady;			// Flag indicating that XBee is initialized and ready
 	uint8_t	uNextSNumber[MAX_STATIONS];
 	uint8_t	uLastReceivedSNumber[MAX_STATIONS];
 
 private:
+	MoteinoRFTxEntry *TxEntry(uint8_t pos) { return txQueue + txOrder[pos]; };	// queued packet by its position in the FIFO
+	void	TxStep(void);
+	void	TxDone(bool fDelivered);
+	uint8_t	LinkRetries(uint8_t nStation);
+	uint16_t LinkAckTimeout(uint8_t nStation);
+	uint8_t	LinkTxLevel(uint8_t nStation);
+	void	LinkTxResult(uint8_t nStation, bool fAcked, uint16_t rtt);
+
+	MoteinoRFTxEntry	txQueue[MOTEINORF_TX_QUEUE_SIZE];
+	uint8_t				txOrder[MOTEINORF_TX_QUEUE_SIZE];	// txQueue indexes, queued packets in FIFO order first, then free entries
+	uint8_t				txCount;
+	uint8_t				txState;
+	uint8_t				txCurrent;			// FIFO position of the packet being transmitted
+	uint32_t			txStateTime;		// millis() when current state was entered
+	uint16_t			txAckTimeout;		// ACK timeout for the current transmission
 
+	MoteinoRFLinkStats	linkStats[MOTEINORF_LINK_STATS_SIZE];
 };
 
 extern MoteinoRFClass MoteinoRF;
-bool MoteinoRFSendPacket(uint8_t nStation, void *msg, uint8_t mSize);
+bool MoteinoRFSendPacket(uint8_t nStation, void *msg, uint8_t mSize, PMoteinoRFTxCallback callback = 0, uint8_t cookie = 0);
 
 #endif
 
@@ -16,8 +16,8 @@ Copyright 2014-2016 tony-osp (http://tony-osp.dreamwidth.org/)
 #include "core.h"
 #include "settings.h"
 #include "sensors.h"
-#include "XBeeRF.h"
-#include "MoteinoRF.h"
+#include "EventBus.h"
+#include "TimeSync.h"
 
 //#define TRACE_LEVEL			7		// trace everything for this module
 #include "port.h"
@@ -31,40 +31,925 @@ int16_t		LastReceivedRSSI;
 // Local forward declarations
 inline uint16_t		getSingleSensor(uint8_t regAddr);
 
+// Reply to the compound request being collected, see MessageCompound()
+static RMESSAGE_COMPOUND_REPORT	*pCompoundReply = 0;
+static uint8_t					compoundReplyLen;
+
+// Shared frame buffer, used by BeginFrame() when the transport cannot provide its own. Fits the largest message this station builds.
+static uint8_t	txFrame[sizeof(RMESSAGE_SYSREGISTERS_REPORT)+MODBUSMAP_SYSTEM_MAX*2];
+
+// Relay frame buffer, used by SendRelayFrame() when the transport cannot provide its own. Wrapped frame may sit in txFrame.
+static uint8_t	relayFrame[RPROTOCOL_MAX_FRAME_SIZE];
+
+//
+// Transport delivery result for tracked requests. If the station did not ACK the packet there is no point waiting for the response.
+//
+static void RequestDeliveryResult(uint8_t stationID, uint8_t transactionID, bool fDelivered)
+{
+	if( fDelivered )
+		rprotocol.Delivered(stationID, transactionID);
+	else
+		rprotocol.DeliveryFailed(stationID, transactionID);
+}
+
 // 
 // Generic network "send packet" routine, used by all protocol messages.
 //
-// If new types of transport are added, appropriate handler needs to be added to this routine.
+// Frames are handed to the transport of the destination station, see TransmitFrame().
+// For tracked requests transactionID is non-zero, and transports that can detect delivery failure report it back.
+//
+inline bool SendNetworkPacket(uint8_t stationID, void *pMessage, uint8_t mSize, uint8_t transactionID = 0 )
+{
+		// While compound request is processed, replies to its sub-commands are packed into the compound reply
+		if( pCompoundReply != 0 )
+		{
+			RMESSAGE_HEADER *pHeader = (RMESSAGE_HEADER *)pMessage;
+
+			if( (stationID == pCompoundReply->Header.ToUnitID) && (pHeader->TransactionID == pCompoundReply->Header.TransactionID) && (pHeader->FCode != FCODE_SYSEVT_REPORT)
+				&& ((compoundReplyLen + sizeof(RCOMPOUND_SUBHEADER) + pHeader->Length) <= RPROTOCOL_MAX_FRAME_SIZE) )
+			{
+				RCOMPOUND_SUBHEADER *pSub = (RCOMPOUND_SUBHEADER *)(((uint8_t *)pCompoundReply) + compoundReplyLen);
+
+				pSub->Length = pHeader->Length;
+				pSub->FCode = pHeader->FCode;
+				memcpy(pSub+1, pHeader+1, pHeader->Length);
+				compoundReplyLen += sizeof(RCOMPOUND_SUBHEADER) + pHeader->Length;
+				pCompoundReply->NumReplies++;
+				return true;
+			}
+		}
+
+		return rprotocol.TransmitFrame(stationID, pMessage, mSize, transactionID);
+}
+
+
+RProtocolMaster::RProtocolMaster()
+{
+	_ARPAddressUpdate = 0;
+	_nextTransactionID = 1;
+	_numTransports = 0;
+	_txTransport = 0;
+	_batchLen = 0;
+	_fScanReplyPending = false;
+	_neighborCheckTime = _scanTime = _scanReplyTime = 0;
+	_relaySeenNext = 0;
+	_timeSyncInterval = RPROTOCOL_TIMESYNC_MIN;
+	_timeSyncTime = uint32_t(0ul - RPROTOCOL_TIMESYNC_MIN*1000ul);		// first sync as soon as the master has time
+	_fTimeSyncReport = true;								// and it does not stretch the interval yet
+
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+		_pending[i].transactionID = 0;
+
+	for( uint8_t i=0; i<MAX_STATIONS; i++ )
+	{
+		_neighbors[i].state = RNEIGHBOR_UNKNOWN;
+		_neighbors[i].via = i;
+		_neighbors[i].hops = 0;
+	}
+
+	for( uint8_t i=0; i<RPROTOCOL_RELAY_SEEN_SIZE; i++ )
+		_relaySeen[i].origin = STATIONID_BROADCAST;
+}
+
+#ifndef SG_STATION_MASTER	// we send remote master notifications only if this station is not a master by itself
+//
+// Event bus subscriber - report zones state changes caused by local commands to the EvtMaster
+//
+static void EvtMasterOnEvent(const SGEvent *pEvent)
+{
+	if( GetEvtMasterFlags() & EVTMASTER_FLAGS_REPORT_ZONES )
+	{
+		rprotocol.SendZonesReport(0, pEvent->param1, GetEvtMasterStationID(), 0, GetNumZones());	// Note: this would work correctly only on Remote station, with only one station defined
+		TRACE_INFO(F("EvtMaster - reporting zones event to Master\n"));
+	}
+}
+#endif //SG_STATION_MASTER
+
+bool RProtocolMaster::begin(void)
+{
+#ifndef SG_STATION_MASTER
+	eventBus.Subscribe(SGEVT_MASK(SGEVT_ZONES_LOCAL_CMD), EvtMasterOnEvent);
+#else
+	_scanTime = millis() - (RPROTOCOL_SCAN_INTERVAL-RPROTOCOL_SCAN_FIRST)*1000ul;		// first scan shortly after start, once transports are up
+#endif //SG_STATION_MASTER
+
+	// announce this station to its neighbors
+	_scanReplyTo = STATIONID_BROADCAST;
+	_scanReplyTime = millis() + RPROTOCOL_SCAN_FIRST*1000ul + random(RPROTOCOL_SCAN_WINDOW);
+	_fScanReplyPending = true;
+
+	return true;
+}
+
+
+void RProtocolMaster::RegisterARP(void *ptr)
+{
+	TRACE_INFO(F("RProtocol - registering ARP callback\n"));
+	_ARPAddressUpdate = (PARPCallback)ptr;
+}
+
+//
+// Register transport for the network. Transports register themselves when they are initialized.
+//
+bool RProtocolMaster::RegisterTransport(uint8_t networkID, NetTransport *pTransport)
+{
+	for( uint8_t i=0; i<_numTransports; i++ )
+	{
+		if( _transportNetworkID[i] == networkID )
+		{
+			_transports[i] = pTransport;
+			return true;
+		}
+	}
+
+	if( _numTransports >= RPROTOCOL_MAX_TRANSPORTS )
+	{
+		SYSEVT_ERROR(F("RProtocol - cannot register transport for network %u, table is full"), uint16_t(networkID));
+		return false;
+	}
+
+	TRACE_INFO(F("RProtocol - registering transport for network %u\n"), uint16_t(networkID));
+	_transportNetworkID[_numTransports] = networkID;
+	_transports[_numTransports] = pTransport;
+	_numTransports++;
+	return true;
+}
+
+//
+// Find transport to reach the station - from the neighbor cache, station config, or the first registered transport.
+//
+// Returns 0 if there are no transports at all.
+//
+NetTransport *RProtocolMaster::GetTransport(uint8_t stationID)
+{
+	if( _numTransports == 0 )
+		return 0;
+
+	if( stationID < MAX_STATIONS )
+	{
+		if( _neighbors[stationID].state != RNEIGHBOR_UNKNOWN )
+			return _transports[_neighbors[stationID].transport];		// route to the network where the station was heard
+
+		ShortStation	sStation;
+
+		LoadShortStation(stationID, &sStation);
+		if( sStation.stationFlags & STATION_FLAGS_VALID )
+		{
+			for( uint8_t i=0; i<_numTransports; i++ )
+			{
+				if( _transportNetworkID[i] == sStation.networkID )
+					return _transports[i];
+			}
+		}
+	}
+	return _transports[0];		// e.g. EvtMaster is usually not in the stations list of the remote station
+}
+
+// Index of the registered transport, RPROTOCOL_MAX_TRANSPORTS if not found
+uint8_t RProtocolMaster::FindTransport(NetTransport *pTransport)
+{
+	for( uint8_t i=0; i<_numTransports; i++ )
+	{
+		if( _transports[i] == pTransport )
+			return i;
+	}
+	return RPROTOCOL_MAX_TRANSPORTS;
+}
+
+//
+// Send frame to the station through its transport. Broadcasts go out on all transports that support them.
+// Frames to stations reachable only through a relay are wrapped into FCODE_RELAY and sent to the relay.
+//
+bool RProtocolMaster::TransmitFrame(uint8_t stationID, void *pMessage, uint8_t mSize, uint8_t transactionID)
+{
+	if( stationID == STATIONID_BROADCAST )
+	{
+		bool	fSent = false;
+
+		for( uint8_t i=0; i<_numTransports; i++ )
+		{
+			if( _transports[i]->IsReady() && (_transports[i]->Flags() & TRANSPORT_FLAGS_BROADCAST) )
+				fSent |= _transports[i]->Send(stationID, pMessage, mSize, 0, 0);
+		}
+		return fSent;
+	}
+
+	if( IsRelayed(stationID) )
+		return SendRelayFrame(_neighbors[stationID].via, 0, pMessage, mSize);	// delivery to the relay says nothing about the station, no callback
+
+	NetTransport	*pTransport = GetTransport(stationID);
+
+	if( (pTransport == 0) || !pTransport->IsReady() )
+	{
+		TRACE_ERROR(F("RProtocol - no transport to station %u\n"), uint16_t(stationID));
+		return false;
+	}
+
+	if( mSize > pTransport->MTU() )
+	{
+		TRACE_ERROR(F("RProtocol - frame to station %u is too large, %u bytes\n"), uint16_t(stationID), uint16_t(mSize));
+		return false;
+	}
+
+	if( (transactionID != 0) && (pTransport->Flags() & TRANSPORT_FLAGS_DELIVERY_REPORT) )
+	{
+		AwaitDelivery(stationID, transactionID);		// before Send(), the report may come right away
+		return pTransport->Send(stationID, pMessage, mSize, RequestDeliveryResult, transactionID);
+	}
+
+	return pTransport->Send(stationID, pMessage, mSize, 0, 0);
+}
+
+//
+// Get buffer to build outgoing frame in. Frame is sent by EndFrame(), nothing else may be sent in between.
+//
+// Unicast frames go straight into the transport buffer, if the transport offers one. Broadcasts, frames collected into the compound reply,
+// frames to relayed stations and frames to transports without in-place buffers are built in the shared buffer and sent by TransmitFrame().
+//
+uint8_t *RProtocolMaster::BeginFrame(uint8_t stationID, uint8_t mSize)
+{
+	_txTransport = 0;
+
+	if( (stationID != STATIONID_BROADCAST) && (pCompoundReply == 0) && !IsRelayed(stationID) )
+	{
+		NetTransport	*pTransport = GetTransport(stationID);
+
+		if( (pTransport != 0) && pTransport->IsReady() && (mSize <= pTransport->MTU()) )
+		{
+			uint8_t		*pFrame = pTransport->AllocFrame(stationID, mSize);
+
+			if( pFrame != 0 )
+			{
+				_txTransport = pTransport;
+				return pFrame;
+			}
+		}
+	}
+
+	return txFrame;
+}
+
+bool RProtocolMaster::EndFrame(uint8_t stationID, uint8_t mSize, uint8_t transactionID)
+{
+	NetTransport	*pTransport = _txTransport;
+
+	if( pTransport == 0 )
+		return SendNetworkPacket(stationID, txFrame, mSize, transactionID);
+
+	_txTransport = 0;
+	if( (transactionID != 0) && (pTransport->Flags() & TRANSPORT_FLAGS_DELIVERY_REPORT) )
+	{
+		AwaitDelivery(stationID, transactionID);
+		return pTransport->SendFrame(stationID, mSize, RequestDeliveryResult, transactionID);
+	}
+
+	return pTransport->SendFrame(stationID, mSize, 0, 0);
+}
+
+
+//
+//	Outstanding requests tracking
+//
+
+//
+// Allocate pending table entry and TransactionID for the new request.
+//
+// Returns TransactionID to use in the request, or 0 if the table is full (request should be sent untracked).
+//
+uint8_t RProtocolMaster::NewTransaction(uint8_t stationID, uint8_t fCode, PTransactionCallback callback, uint8_t param)
+{
+	RTransaction	*pFree = 0;
+
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		if( _pending[i].transactionID == 0 )
+		{
+			pFree = _pending+i;
+			break;
+		}
+	}
+	if( pFree == 0 )
+	{
+		TRACE_ERROR(F("RProtocol - pending requests table is full, sending untracked request to station %u\n"), uint16_t(stationID));
+		return 0;
+	}
+
+	// Rolling TransactionID, 0 is reserved for unsolicited messages. Skip IDs still in use after the wrap.
+	uint8_t		tid;
+	bool		fInUse;
+	do
+	{
+		tid = _nextTransactionID++;
+		if( _nextTransactionID == 0 ) _nextTransactionID = 1;
+
+		fInUse = false;
+		for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+		{
+			if( _pending[i].transactionID == tid )
+				fInUse = true;
+		}
+	}
+	while( fInUse );
+
+	pFree->transactionID = tid;
+	pFree->stationID = stationID;
+	pFree->fCode = fCode;
+	pFree->retries = (NeighborState(stationID) == RNEIGHBOR_STALE) ? 0:RPROTOCOL_MAX_RETRIES;		// don't waste airtime on stations that are gone
+	pFree->param = param;
+	pFree->size = 0;
+	pFree->timeout = RPROTOCOL_REQUEST_TIMEOUT;
+	pFree->fInTransit = false;
+	pFree->callback = callback;
+
+	return tid;
+}
+
+//
+// Check whether request of the given type to the station is still in flight.
+//
+bool RProtocolMaster::IsPending(uint8_t stationID, uint8_t fCode)
+{
+	return FindPending(stationID, fCode) != 0;
+}
+
+RTransaction *RProtocolMaster::FindPending(uint8_t stationID, uint8_t fCode)
+{
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		if( (_pending[i].transactionID != 0) && (_pending[i].stationID == stationID) && (_pending[i].fCode == fCode) )
+			return &_pending[i];
+	}
+	return 0;
+}
+
+uint8_t RProtocolMaster::NumPendingRequests(void)
+{
+	uint8_t		n = 0;
+
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		if( _pending[i].transactionID != 0 )
+			n++;
+	}
+	return n;
+}
+
+//
+// Send request packet. If the request carries TransactionID allocated by NewTransaction(), keep a copy for re-transmission
+// and start response timer.
+//
+bool RProtocolMaster::SendRequestPacket(uint8_t stationID, void *pMessage, uint8_t mSize)
+{
+	uint8_t			tid = ((RMESSAGE_HEADER *)pMessage)->TransactionID;
+	RTransaction	*pTrans = 0;
+
+	if( tid != 0 )
+	{
+		for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+		{
+			if( (_pending[i].transactionID == tid) && (_pending[i].stationID == stationID) && (_pending[i].size == 0) )
+			{
+				pTrans = _pending+i;
+				break;
+			}
+		}
+	}
+
+	if( pTrans != 0 )
+	{
+		memcpy(pTrans->request, pMessage, min(mSize, sizeof(pTrans->request)));	// larger frames are refused by SendNetworkPacket()
+		pTrans->size = mSize;
+		pTrans->sentTime = millis();
+	}
+
+	if( !SendNetworkPacket(stationID, pMessage, mSize, pTrans != 0 ? tid:0) )
+	{
+		if( pTrans != 0 )
+			CompleteTransaction(stationID, tid, RTRANSACTION_NOT_DELIVERED);	// nothing was sent, let the requester know
+		return false;
+	}
+	return true;
+}
+
+//
+// Queue request for sending. Requests to the same station with the same callback are accumulated in the batch,
+// and sent by FlushRequests() as one FCODE_COMPOUND frame (or as the regular message if there is only one).
+//
+bool RProtocolMaster::QueueRequest(void *pMessage, uint8_t mSize, PTransactionCallback callback, uint8_t param)
+{
+	RMESSAGE_HEADER		*pHeader = (RMESSAGE_HEADER *)pMessage;
+	RMESSAGE_COMPOUND	*pBatch = (RMESSAGE_COMPOUND *)_batch;
+	uint8_t				pduLen = mSize - sizeof(RMESSAGE_HEADER);
+
+	if( _batchLen != 0 )
+	{
+		if( (pBatch->Header.ToUnitID != pHeader->ToUnitID) || (_batchCallback != callback)
+			|| ((_batchLen + sizeof(RCOMPOUND_SUBHEADER) + pduLen) > RPROTOCOL_MAX_FRAME_SIZE) )
+			FlushRequests();
+	}
+
+	if( _batchLen == 0 )
+	{
+		pBatch->Header = *pHeader;
+		_batchLen = sizeof(RMESSAGE_HEADER) + 1;		// header and NumCommands
+		_batchCount = 0;
+		_batchCallback = callback;
+		_batchParam = param;
+	}
+	else if( _batchParam != param )
+		_batchParam = 0x0FF;
+
+	RCOMPOUND_SUBHEADER	*pSub = (RCOMPOUND_SUBHEADER *)(_batch + _batchLen);
+
+	pSub->Length = pduLen;
+	pSub->FCode = pHeader->FCode;
+	memcpy(pSub+1, pHeader+1, pduLen);
+
+	_batchLen += sizeof(RCOMPOUND_SUBHEADER) + pduLen;
+	_batchCount++;
+	return true;
+}
+
+//
+// Send queued requests.
+//
+void RProtocolMaster::FlushRequests(void)
+{
+	RMESSAGE_COMPOUND	*pBatch = (RMESSAGE_COMPOUND *)_batch;
+	uint8_t				mSize = _batchLen;
+
+	if( _batchLen == 0 )
+		return;
+
+	if( _batchCount == 1 )
+	{
+		// single request, convert it back to the regular message
+		RCOMPOUND_SUBHEADER	*pSub = (RCOMPOUND_SUBHEADER *)(pBatch->Data);
+
+		pBatch->Header.FCode = pSub->FCode;
+		pBatch->Header.Length = pSub->Length;
+		mSize = sizeof(RMESSAGE_HEADER) + pSub->Length;
+		memmove(_batch+sizeof(RMESSAGE_HEADER), pSub+1, pSub->Length);		// Note: overwrites sub-header
+	}
+	else
+	{
+		TRACE_INFO(F("RProtocol - sending %u requests to station %u in one frame\n"), uint16_t(_batchCount), uint16_t(pBatch->Header.ToUnitID));
+
+		pBatch->Header.FCode = FCODE_COMPOUND;
+		pBatch->Header.Length = _batchLen - sizeof(RMESSAGE_HEADER);
+		pBatch->NumCommands = _batchCount;
+	}
+
+	_batchLen = 0;
+	pBatch->Header.TransactionID = NewTransaction(pBatch->Header.ToUnitID, pBatch->Header.FCode, _batchCallback, _batchParam);
+	SendRequestPacket(pBatch->Header.ToUnitID, _batch, mSize);
+}
+
+//
+// Complete pending request when matching report or response arrives.
+//
+// Returns false if there is no pending request with this TransactionID.
+//
+bool RProtocolMaster::CompleteTransaction(uint8_t stationID, uint8_t transactionID, uint8_t status)
+{
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		RTransaction *pTrans = _pending+i;
+
+		if( (pTrans->transactionID == transactionID) && (pTrans->stationID == stationID) && (pTrans->size != 0) )
+		{
+			PTransactionCallback	callback = pTrans->callback;
+			uint8_t					fCode = pTrans->fCode;
+			uint8_t					param = pTrans->param;
+
+			TRACE_INFO(F("RProtocol - transaction %u to station %u completed, status %u\n"), uint16_t(transactionID), uint16_t(stationID), uint16_t(status));
+
+			pTrans->transactionID = 0;		// free the entry first, callback may send new requests
+			if( callback != 0 )
+				callback(stationID, fCode, status, param);
+			return true;
+		}
+	}
+
+	TRACE_VERBOSE(F("RProtocol - no pending request for transaction %u from station %u\n"), uint16_t(transactionID), uint16_t(stationID));
+	return false;
+}
+
+// Pending (sent) request with the given TransactionID, or 0
+RTransaction *RProtocolMaster::FindTransaction(uint8_t stationID, uint8_t transactionID)
+{
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		RTransaction *pTrans = _pending+i;
+
+		if( (pTrans->transactionID == transactionID) && (pTrans->stationID == stationID) && (pTrans->size != 0) )
+			return pTrans;
+	}
+	return 0;
+}
+
+//
+// Request is handed to the transport that reports delivery. Response timer waits for the report.
+//
+void RProtocolMaster::AwaitDelivery(uint8_t stationID, uint8_t transactionID)
+{
+	RTransaction	*pTrans = FindTransaction(stationID, transactionID);
+
+	if( pTrans != 0 )
+	{
+		pTrans->fInTransit = true;
+		pTrans->sentTime = millis();
+	}
+}
+
+//
+// Transport reported that the request was delivered (link-level ACK). Start the response timer.
+//
+void RProtocolMaster::Delivered(uint8_t stationID, uint8_t transactionID)
+{
+	RTransaction	*pTrans = FindTransaction(stationID, transactionID);
+
+	if( (pTrans != 0) && pTrans->fInTransit )
+	{
+		pTrans->fInTransit = false;
+		pTrans->sentTime = millis();
+	}
+}
+
+//
+// Transport reported that the request was not delivered (no link-level ACK after all retries).
+//
+void RProtocolMaster::DeliveryFailed(uint8_t stationID, uint8_t transactionID)
+{
+	NeighborLost(stationID);
+	CompleteTransaction(stationID, transactionID, RTRANSACTION_NOT_DELIVERED);
+}
+
+//
+// Process response timers. Timed out requests are re-sent with doubled timeout, and when all retries are exhausted
+// the request is completed with RTRANSACTION_TIMEOUT.
+//
+void RProtocolMaster::CheckPendingRequests(void)
+{
+	uint32_t	timeNow = millis();
+
+	for( uint8_t i=0; i<RPROTOCOL_MAX_PENDING; i++ )
+	{
+		RTransaction *pTrans = _pending+i;
+
+		if( (pTrans->transactionID == 0) || (pTrans->size == 0) )
+			continue;
+
+		if( (timeNow - pTrans->sentTime) < (pTrans->fInTransit ? RPROTOCOL_DELIVERY_TIMEOUT : pTrans->timeout) )
+			continue;
+
+		pTrans->fInTransit = false;			// delivery report was lost, handle it as response timeout
+
+		if( pTrans->retries != 0 )
+		{
+			pTrans->retries--;
+			pTrans->timeout <<= 1;
+			pTrans->sentTime = timeNow;
+
+			TRACE_INFO(F("RProtocol - re-sending transaction %u to station %u\n"), uint16_t(pTrans->transactionID), uint16_t(pTrans->stationID));
+			SendNetworkPacket(pTrans->stationID, pTrans->request, pTrans->size, pTrans->transactionID);
+		}
+		else
+		{
+			PTransactionCallback	callback = pTrans->callback;
+			uint8_t					stationID = pTrans->stationID;
+			uint8_t					fCode = pTrans->fCode;
+			uint8_t					param = pTrans->param;
+
+			TRACE_ERROR(F("RProtocol - no response from station %u, FCode %u\n"), uint16_t(stationID), uint16_t(fCode));
+
+			pTrans->transactionID = 0;
+			NeighborLost(stationID);
+			if( callback != 0 )
+				callback(stationID, fCode, RTRANSACTION_TIMEOUT, param);
+		}
+	}
+}
+
+//
+//	Neighbor cache and stations discovery
+//
+
+uint8_t RProtocolMaster::NeighborState(uint8_t stationID)
+{
+	if( stationID >= MAX_STATIONS )
+		return RNEIGHBOR_UNKNOWN;
+
+	return _neighbors[stationID].state;
+}
+
+uint8_t RProtocolMaster::NeighborVia(uint8_t stationID)
+{
+	if( stationID >= MAX_STATIONS )
+		return stationID;
+
+	return _neighbors[stationID].via;
+}
+
+//
+// Station was heard on the transport
+//
+void RProtocolMaster::UpdateNeighbor(uint8_t stationID, NetTransport *pTransport)
+{
+	uint8_t		transport = FindTransport(pTransport);
+
+	if( (stationID >= MAX_STATIONS) || (transport >= RPROTOCOL_MAX_TRANSPORTS) )
+		return;
+
+	RNeighbor	*pNeighbor = _neighbors + stationID;
+
+	if( (pNeighbor->state != RNEIGHBOR_REACHABLE) || (pNeighbor->transport != transport) || (pNeighbor->hops != 0) )
+		SYSEVT_NOTICE(F("RProtocol - station %u is reachable on network %u"), uint16_t(stationID), uint16_t(_transportNetworkID[transport]));
+
+	pNeighbor->state = RNEIGHBOR_REACHABLE;
+	pNeighbor->transport = transport;
+	pNeighbor->via = stationID;
+	pNeighbor->hops = 0;
+}
+
+//
+// Station did not ACK or did not respond to a request. Requests to it will go without re-transmissions until it is heard again.
+//
+void RProtocolMaster::NeighborLost(uint8_t stationID)
+{
+	if( stationID >= MAX_STATIONS )
+		return;
+
+	RNeighbor	*pNeighbor = _neighbors + stationID;
+
+	if( pNeighbor->state == RNEIGHBOR_STALE )
+		return;
+
+	if( pNeighbor->state == RNEIGHBOR_UNKNOWN )
+	{
+		pNeighbor->transport = FindTransport(GetTransport(stationID));
+		if( pNeighbor->transport >= RPROTOCOL_MAX_TRANSPORTS )
+			return;
+	}
+
+	SYSEVT_NOTICE(F("RProtocol - station %u is not responding"), uint16_t(stationID));
+	pNeighbor->state = RNEIGHBOR_STALE;
+}
+
+//
+// Discovery timers - send pending scan reply, age out neighbors not heard for RPROTOCOL_NEIGHBOR_TIMEOUT, and (master) periodic scan.
+//
+void RProtocolMaster::CheckNeighbors(void)
+{
+	uint32_t	timeNow = millis();
+
+	if( _fScanReplyPending && (int32_t(timeNow - _scanReplyTime) >= 0) )
+	{
+		_fScanReplyPending = false;
+		SendScanReply(_scanReplyTo);
+	}
+
+#ifdef SG_STATION_MASTER
+	if( (timeNow - _scanTime) >= RPROTOCOL_SCAN_INTERVAL*1000ul )
+		ScanStations();
+#endif //SG_STATION_MASTER
+
+	if( (timeNow - _neighborCheckTime) < 1000ul )
+		return;
+
+	_neighborCheckTime = timeNow;
+	for( uint8_t i=0; i<MAX_STATIONS; i++ )
+	{
+		if( (_neighbors[i].state == RNEIGHBOR_REACHABLE) && ((timeNow - uint32_t(runState.sLastContactTime[i])) >= RPROTOCOL_NEIGHBOR_TIMEOUT*1000ul) )
+		{
+			SYSEVT_NOTICE(F("RProtocol - station %u was not heard for %u min, aging out"), uint16_t(i), uint16_t(RPROTOCOL_NEIGHBOR_TIMEOUT/60));
+			_neighbors[i].state = RNEIGHBOR_STALE;
+		}
+	}
+}
+
+//
+// Broadcast SCAN on all transports. Stations reply with SCAN_REPLY, replies update the neighbor cache.
+//
+bool RProtocolMaster::ScanStations(void)
+{
+	_scanTime = millis();
+
+	TRACE_INFO(F("RProtocol - scanning for stations\n"));
+
+	RMESSAGE_SCAN *pMessage = (RMESSAGE_SCAN *)BeginFrame(STATIONID_BROADCAST, sizeof(RMESSAGE_SCAN));
+
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_SCAN;
+	pMessage->Header.ToUnitID = STATIONID_BROADCAST;
+	pMessage->Header.FromUnitID = GetMyStationID();
+	pMessage->Header.Length = sizeof(RMESSAGE_SCAN)-sizeof(RMESSAGE_HEADER);
+	pMessage->Header.TransactionID = 0;
+
+	pMessage->ReplyWindow = RPROTOCOL_SCAN_WINDOW;
+
+	return EndFrame(STATIONID_BROADCAST, sizeof(RMESSAGE_SCAN));
+}
+
+//
+// Reply to the scan after random delay within the reply window, so replies of different stations don't collide.
+// Only one reply is kept pending, later scan replaces the earlier one.
+//
+void RProtocolMaster::ScheduleScanReply(uint8_t toUnitID, uint16_t replyWindow)
+{
+	_scanReplyTo = toUnitID;
+	_scanReplyTime = millis() + (replyWindow != 0 ? random(replyWindow):0);
+	_fScanReplyPending = true;
+}
+
+bool RProtocolMaster::SendScanReply(uint8_t toUnitID)
+{
+	RMESSAGE_SCAN_REPLY *pMessage = (RMESSAGE_SCAN_REPLY *)BeginFrame(toUnitID, sizeof(RMESSAGE_SCAN_REPLY));
+
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_SCAN_REPLY;
+	pMessage->Header.ToUnitID = toUnitID;
+	pMessage->Header.FromUnitID = GetMyStationID();
+	pMessage->Header.Length = sizeof(RMESSAGE_SCAN_REPLY)-sizeof(RMESSAGE_HEADER);
+	pMessage->Header.TransactionID = 0;
+
+	pMessage->StationType = DEFAULT_STATION_TYPE;
+	pMessage->HardwareVersion = SG_HARDWARE;
+	pMessage->FirmwareVersion = SG_FIRMWARE_VERSION;
+	pMessage->NumZones = GetNumZones();
+	pMessage->NumSensors = GetNumSensors();
+
+	return EndFrame(toUnitID, sizeof(RMESSAGE_SCAN_REPLY));
+}
+
+//
+//	Relaying
+//
+
+// Station is reached through a relay
+bool RProtocolMaster::IsRelayed(uint8_t stationID)
+{
+	return (stationID < MAX_STATIONS) && (_neighbors[stationID].state != RNEIGHBOR_UNKNOWN) && (_neighbors[stationID].hops != 0);
+}
+
+//
+// Station was heard through the relay station via (which is a direct neighbor), hops relays away.
+//
+void RProtocolMaster::UpdateRoute(uint8_t stationID, uint8_t via, uint8_t hops)
+{
+	if( (stationID >= MAX_STATIONS) || (via >= MAX_STATIONS) || (stationID == GetMyStationID()) || (stationID == via) )
+		return;
+
+	if( (_neighbors[via].state == RNEIGHBOR_UNKNOWN) || (_neighbors[via].hops != 0) )
+		return;		// next hop must be a direct neighbor, a relay reached through another relay could route back through us
+
+	RNeighbor	*pNeighbor = _neighbors + stationID;
+
+	if( (pNeighbor->state == RNEIGHBOR_REACHABLE) && (pNeighbor->via != via) && (pNeighbor->hops <= hops) )
+		return;		// keep the direct (or shorter) route while it works
+
+	if( (pNeighbor->state != RNEIGHBOR_REACHABLE) || (pNeighbor->via != via) )
+		SYSEVT_NOTICE(F("RProtocol - station %u is reachable via station %u, %u hop(s)"), uint16_t(stationID), uint16_t(via), uint16_t(hops+1));
+
+	pNeighbor->state = RNEIGHBOR_REACHABLE;
+	pNeighbor->transport = _neighbors[via].transport;
+	pNeighbor->via = via;
+	pNeighbor->hops = hops;
+}
+
+//
+// Check relayed frame against recently seen ones, and remember it.
+//
+// Returns true if the same frame was seen within RPROTOCOL_RELAY_DUP_WINDOW (copy re-broadcast by a relay, or unicast frame bounced
+// back by a relay with a stale route).
+//
+bool RProtocolMaster::IsDuplicate(uint8_t *ptr, uint8_t len)
+{
+	uint8_t		origin = ((RMESSAGE_HEADER *)ptr)->FromUnitID;
+	uint16_t	sum = 0;
+	uint32_t	timeNow = millis();
+
+	for( uint8_t i=0; i<len; i++ )
+		sum = ((sum << 1) | (sum >> 15)) + ptr[i];
+
+	for( uint8_t i=0; i<RPROTOCOL_RELAY_SEEN_SIZE; i++ )
+	{
+		if( (_relaySeen[i].origin == origin) && (_relaySeen[i].sum == sum) && ((timeNow - _relaySeen[i].time) < RPROTOCOL_RELAY_DUP_WINDOW) )
+			return true;
+	}
+
+	_relaySeen[_relaySeenNext].origin = origin;
+	_relaySeen[_relaySeenNext].sum = sum;
+	_relaySeen[_relaySeenNext].time = timeNow;
+	_relaySeenNext = (_relaySeenNext + 1) % RPROTOCOL_RELAY_SEEN_SIZE;
+	return false;
+}
+
+//
+// Wrap the frame into FCODE_RELAY and send it to the next hop (STATIONID_BROADCAST - re-broadcast on all transports).
+// The next hop is a direct neighbor, the relay frame goes into the transport buffer when the transport offers one.
 //
-inline bool SendNetworkPacket(uint8_t stationID, void *pMessage, uint8_t mSize )
+bool RProtocolMaster::SendRelayFrame(uint8_t nextHop, uint8_t hopCount, void *pFrame, uint8_t frameLen)
 {
-#ifdef HW_ENABLE_XBEE
-		XBeeSendPacket(stationID, pMessage, mSize);
-#endif //HW_ENABLE_XBEE
+	uint8_t			mSize = sizeof(RMESSAGE_RELAY)-1+frameLen;
+	NetTransport	*pTransport = 0;
+	uint8_t			*pOut = relayFrame;
 
-#ifdef HW_ENABLE_MOTEINORF
-		MoteinoRFSendPacket(stationID, pMessage, mSize);
-#endif //HW_ENABLE_MOTEINORF
+	if( mSize > RPROTOCOL_MAX_FRAME_SIZE )
+	{
+		TRACE_ERROR(F("RProtocol - frame is too large to relay, %u bytes\n"), uint16_t(frameLen));
+		return false;
+	}
 
-		return true;
-}
+	if( nextHop != STATIONID_BROADCAST )
+	{
+		pTransport = GetTransport(nextHop);
+		if( (pTransport == 0) || !pTransport->IsReady() || (mSize > pTransport->MTU()) )
+		{
+			TRACE_ERROR(F("RProtocol - cannot relay frame to station %u\n"), uint16_t(nextHop));
+			return false;
+		}
 
+		uint8_t		*pInPlace = pTransport->AllocFrame(nextHop, mSize);
 
-RProtocolMaster::RProtocolMaster()
-{
-	_ARPAddressUpdate = 0;
+		if( pInPlace != 0 )
+			pOut = pInPlace;
+	}
+
+	RMESSAGE_RELAY	*pMessage = (RMESSAGE_RELAY *)pOut;
+
+	memcpy(pMessage->Data, pFrame, frameLen);
+
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_RELAY;
+	pMessage->Header.ToUnitID = nextHop;
+	pMessage->Header.FromUnitID = GetMyStationID();
+	pMessage->Header.Length = mSize-sizeof(RMESSAGE_HEADER);
+	pMessage->Header.TransactionID = 0;
+	pMessage->HopCount = hopCount;
+
+	if( pTransport == 0 )
+		return TransmitFrame(STATIONID_BROADCAST, pOut, mSize, 0);
+
+	if( pOut != relayFrame )
+		return pTransport->SendFrame(nextHop, mSize, 0, 0);
+
+	return pTransport->Send(nextHop, pOut, mSize, 0, 0);
 }
 
-bool RProtocolMaster::begin(void)
+//
+// Relayed frame. Learn the route to the originating station, then process the frame if it is for this station,
+// and forward it (relay stations only) if it is for another station or it is a broadcast.
+// Forwarding goes first, so the relay adds no more latency than one more transmission.
+//
+void RProtocolMaster::MessageRelay(uint8_t *ptr, uint8_t len)
 {
-	return true;
-}
+	RMESSAGE_RELAY	*pMessage = (RMESSAGE_RELAY *)ptr;
+	RMESSAGE_HEADER	*pHeader = (RMESSAGE_HEADER *)pMessage->Data;
+	uint8_t			frameLen = len - (sizeof(RMESSAGE_RELAY)-1);
+	uint8_t			myStationID = GetMyStationID();
 
+	if( (len < sizeof(RMESSAGE_RELAY)-1+sizeof(RMESSAGE_GENERIC)) || (pHeader->ProtocolID != RPROTOCOL_ID)
+		|| (frameLen != pHeader->Length+sizeof(RMESSAGE_HEADER)) || (pHeader->FCode == FCODE_RELAY) )
+	{
+		SYSEVT_ERROR(F("MessageRelay - bad relayed frame"));
+		return;
+	}
 
-void RProtocolMaster::RegisterARP(void *ptr)
-{
-	TRACE_INFO(F("RProtocol - registering ARP callback\n"));
-	_ARPAddressUpdate = (PARPCallback)ptr;
+	if( (pMessage->Header.ToUnitID != myStationID) && (pMessage->Header.ToUnitID != STATIONID_BROADCAST) )
+		return;				// overheard hop between other stations
+
+	if( pHeader->FromUnitID == myStationID )
+		return;				// own broadcast, re-broadcast by the relay
+
+	if( IsDuplicate(pMessage->Data, frameLen) )
+		return;				// seen already - routes are not learned from copies, and the copy is not forwarded again
+
+	if( pMessage->HopCount != 0 )
+		UpdateRoute(pHeader->FromUnitID, pMessage->Header.FromUnitID, pMessage->HopCount);
+
+	TRACE_INFO(F("MessageRelay - frame from station %u to %u, hop %u\n"), uint16_t(pHeader->FromUnitID), uint16_t(pHeader->ToUnitID), uint16_t(pMessage->HopCount));
+
+	if( (pHeader->ToUnitID != myStationID) && IsRelayEnabled() )
+	{
+		uint8_t		nextHop = pHeader->ToUnitID;
+
+		if( pMessage->HopCount >= RPROTOCOL_MAX_HOPS )
+		{
+			TRACE_INFO(F("MessageRelay - hop limit reached, not forwarding\n"));
+		}
+		else if( (nextHop == STATIONID_BROADCAST) || (nextHop < MAX_STATIONS) )
+		{
+			if( IsRelayed(nextHop) )
+				nextHop = _neighbors[nextHop].via;
+
+			if( nextHop != pMessage->Header.FromUnitID )		// don't bounce the frame back
+				SendRelayFrame(nextHop, pMessage->HopCount+1, pMessage->Data, frameLen);
+		}
+	}
+
+	if( (pHeader->ToUnitID == myStationID) || (pHeader->ToUnitID == STATIONID_BROADCAST) )
+		ProcessNewFrame(pMessage->Data, frameLen, 0);
 }
 
 // Local helper routines
@@ -293,16 +1178,6 @@ bool RProtocolMaster::SendZonesReport(uint8_t transactionID, uint8_t fromUnitID,
 	
 		//TRACE_VERBOSE(F("SendZonesReport - entering\n"));
 
-		RMESSAGE_ZONES_REPORT ReportMessage;
-
-		ReportMessage.Header.ProtocolID = RPROTOCOL_ID;
-		ReportMessage.Header.FCode = FCODE_ZONES_REPORT;
-		ReportMessage.Header.FromUnitID = fromUnitID;
-		ReportMessage.Header.ToUnitID = toUnitID;
-		ReportMessage.Header.TransactionID = transactionID;
-		ReportMessage.Header.Length = 4;	// we assume that we have no more than 8 zones, hence status data is 1 byte
-// Note: since currently we have no more than 8 zones in the Remote station, we hardcode response size
-
 		uint8_t			zonesStatus = 0;
 		uint8_t			stationFlags = 0;
 		
@@ -336,28 +1211,31 @@ bool RProtocolMaster::SendZonesReport(uint8_t transactionID, uint8_t fromUnitID,
 			}
 		}
 
-		ReportMessage.StationFlags = ZONES_REPFLAG_STATION_ENABLED;
-		ReportMessage.FirstZone = firstZone;
-		ReportMessage.NumZones = numZones;
-		ReportMessage.ZonesData[0] = zonesStatus;
+		RMESSAGE_ZONES_REPORT *pReportMessage = (RMESSAGE_ZONES_REPORT *)BeginFrame(toUnitID, sizeof(RMESSAGE_ZONES_REPORT));
 
-		return SendNetworkPacket(toUnitID, (void *)(&ReportMessage), sizeof(ReportMessage) );	// send response with requested zones status bits
-}
+		pReportMessage->Header.ProtocolID = RPROTOCOL_ID;
+		pReportMessage->Header.FCode = FCODE_ZONES_REPORT;
+		pReportMessage->Header.FromUnitID = fromUnitID;
+		pReportMessage->Header.ToUnitID = toUnitID;
+		pReportMessage->Header.TransactionID = transactionID;
+		pReportMessage->Header.Length = 4;	// we assume that we have no more than 8 zones, hence status data is 1 byte
+// Note: since currently we have no more than 8 zones in the Remote station, we hardcode response size
 
+		pReportMessage->StationFlags = ZONES_REPFLAG_STATION_ENABLED;
+		pReportMessage->FirstZone = firstZone;
+		pReportMessage->NumZones = numZones;
+		pReportMessage->ZonesData[0] = zonesStatus;
 
-// Helper routine - send Sensors report
+		return EndFrame(toUnitID, sizeof(RMESSAGE_ZONES_REPORT) );	// send response with requested zones status bits
+}
 
-bool RProtocolMaster::SendSensorsReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstSensor, uint8_t numSensors)
-{
-	if( ((firstSensor+numSensors) > GetNumSensors()) || (numSensors < 1) )
-	{
-		SYSEVT_ERROR(F("SendSensorsReport - wrong input parameters, firstSensor=%d, numSensors=%d"), uint16_t(firstSensor), uint16_t(numSensors));
-		return false;																										// unit ID, Exception Code=2 (Illegal Data Address)
-	}
-	
-//	SYSEVT_ERROR(F("Sending sensors data to station %d"), uint16_t(toUnitID));
 
-	uint8_t		outbuf[sizeof(RMESSAGE_SENSORS_REPORT)+(MAX_SENSORS-1)*2];
+// Helper routine - format Sensors report
+//
+// Returns message size. outbuf should be large enough for numSensors readings, parameters are checked by the caller.
+//
+uint8_t RProtocolMaster::FormatSensorsReport(uint8_t *outbuf, uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstSensor, uint8_t numSensors)
+{
 	RMESSAGE_SENSORS_REPORT *pReportMessage = (RMESSAGE_SENSORS_REPORT*) outbuf;
 
 	pReportMessage->Header.ProtocolID = RPROTOCOL_ID;
@@ -375,8 +1253,41 @@ bool RProtocolMaster::SendSensorsReport(uint8_t transactionID, uint8_t fromUnitI
 	pReportMessage->FirstSensor = firstSensor;
 	pReportMessage->NumSensors = numSensors;
 
-	return SendNetworkPacket(toUnitID, (void *)(outbuf), sizeof(RMESSAGE_SENSORS_REPORT)+(numSensors-1)*2 );
+	return sizeof(RMESSAGE_SENSORS_REPORT)+(numSensors-1)*2;
+}
+
+// Helper routine - send Sensors report
+
+bool RProtocolMaster::SendSensorsReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstSensor, uint8_t numSensors)
+{
+	if( ((firstSensor+numSensors) > GetNumSensors()) || (numSensors < 1) )
+	{
+		SYSEVT_ERROR(F("SendSensorsReport - wrong input parameters, firstSensor=%d, numSensors=%d"), uint16_t(firstSensor), uint16_t(numSensors));
+		return false;
+	}
+
+	uint8_t		*outbuf = BeginFrame(toUnitID, sizeof(RMESSAGE_SENSORS_REPORT)+(numSensors-1)*2);
+	uint8_t		mSize = FormatSensorsReport(outbuf, transactionID, fromUnitID, toUnitID, firstSensor, numSensors);
+
+	return EndFrame(toUnitID, mSize);
+}
+
+//
+// Push all sensor readings of this station to the EvtMaster as unsolicited report.
+//
+// The report carries TransactionID, and the master acknowledges it with RESPONSE_OK. Callback is called when the ACK arrives
+// or when the push fails (no ACK).
+//
+bool RProtocolMaster::PushSensorsReport(uint8_t toUnitID, PTransactionCallback callback)
+{
+	if( GetNumSensors() < 1 )
+		return false;
+
+	// request goes through SendRequestPacket(), which keeps the copy for re-transmission - build it in the shared buffer
+	uint8_t		mSize = FormatSensorsReport(txFrame, 0, GetMyStationID(), toUnitID, 0, GetNumSensors());
 
+	((RMESSAGE_HEADER *)txFrame)->TransactionID = NewTransaction(toUnitID, FCODE_SENSORS_REPORT, callback, 0);
+	return SendRequestPacket(toUnitID, txFrame, mSize);
 }
 
 
@@ -389,8 +1300,7 @@ bool RProtocolMaster::SendSystemRegisters(uint8_t transactionID, uint8_t fromUni
 		SYSEVT_ERROR(F("SendSystemRegisters - wrong input parameters"));
 		return false;																										// unit ID, Exception Code=2 (Illegal Data Address)
 	}
-	uint8_t		outbuf[sizeof(RMESSAGE_SYSREGISTERS_REPORT)+MODBUSMAP_SYSTEM_MAX*2];
-	RMESSAGE_SYSREGISTERS_REPORT *pReportMessage = (RMESSAGE_SYSREGISTERS_REPORT*) outbuf;
+	RMESSAGE_SYSREGISTERS_REPORT *pReportMessage = (RMESSAGE_SYSREGISTERS_REPORT*) BeginFrame(toUnitID, sizeof(RMESSAGE_SYSREGISTERS_REPORT)+numRegisters*2);
 
 	pReportMessage->Header.ProtocolID = RPROTOCOL_ID;
 	pReportMessage->Header.FCode = FCODE_SYSREGISTERS_REPORT;
@@ -408,7 +1318,7 @@ bool RProtocolMaster::SendSystemRegisters(uint8_t transactionID, uint8_t fromUni
 	pReportMessage->FirstRegister = firstRegister;
 	pReportMessage->NumRegisters = numRegisters;
 
-	return SendNetworkPacket(toUnitID, (void *)(outbuf), sizeof(RMESSAGE_SYSREGISTERS_REPORT)+numRegisters*2 );
+	return EndFrame(toUnitID, sizeof(RMESSAGE_SYSREGISTERS_REPORT)+numRegisters*2 );
 }
 
 // Helper routine - notify Master of the system event
@@ -425,13 +1335,13 @@ bool RProtocolMaster::NotifySysEvent(uint8_t eventType, uint32_t timeStamp, uint
 	}
 	TRACE_VERBOSE(F("NotifySysEvent - evtDataLength:%u, str:'%s'\n"), eventDataLength, eventData );
 
-	uint8_t		outbuf[sizeof(RMESSAGE_SYSEVT_REPORT)+SYSEVENT_MAX_STRING_LENGTH];
-	RMESSAGE_SYSEVT_REPORT *pReportMessage = (RMESSAGE_SYSEVT_REPORT*) outbuf;
+	uint8_t		toUnitID = GetEvtMasterStationID();
+	RMESSAGE_SYSEVT_REPORT *pReportMessage = (RMESSAGE_SYSEVT_REPORT*) BeginFrame(toUnitID, sizeof(RMESSAGE_SYSEVT_REPORT)+eventDataLength);
 
 	pReportMessage->Header.ProtocolID = RPROTOCOL_ID;
 	pReportMessage->Header.FCode = FCODE_SYSEVT_REPORT;
 	pReportMessage->Header.FromUnitID = GetMyStationID();
-	pReportMessage->Header.ToUnitID = GetEvtMasterStationID();
+	pReportMessage->Header.ToUnitID = toUnitID;
 	pReportMessage->Header.TransactionID = 0;
 	pReportMessage->Header.Length = eventDataLength + sizeof(RMESSAGE_SYSEVT_REPORT)-sizeof(RMESSAGE_HEADER);
 
@@ -443,7 +1353,7 @@ bool RProtocolMaster::NotifySysEvent(uint8_t eventType, uint32_t timeStamp, uint
 	pReportMessage->EventType = eventType;
 	pReportMessage->NumDataBytes = eventDataLength;
 
-	return SendNetworkPacket(pReportMessage->Header.ToUnitID, (void *)(outbuf), sizeof(RMESSAGE_SYSEVT_REPORT)+eventDataLength );
+	return EndFrame(toUnitID, sizeof(RMESSAGE_SYSEVT_REPORT)+eventDataLength );
 }
 
 
@@ -451,25 +1361,25 @@ bool RProtocolMaster::NotifySysEvent(uint8_t eventType, uint32_t timeStamp, uint
 
 bool RProtocolMaster::SendEvtMasterReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID)
 {
-	RMESSAGE_EVTMASTER_REPORT Message;
+	RMESSAGE_EVTMASTER_REPORT *pMessage = (RMESSAGE_EVTMASTER_REPORT *)BeginFrame(toUnitID, sizeof(RMESSAGE_EVTMASTER_REPORT));
 
-	Message.Header.ProtocolID = RPROTOCOL_ID;
-	Message.Header.FCode = FCODE_EVTMASTER_REPORT;
-	Message.Header.FromUnitID = fromUnitID;
-	Message.Header.ToUnitID = toUnitID;
-	Message.Header.TransactionID = transactionID;
-	Message.Header.Length = sizeof(RMESSAGE_EVTMASTER_REPORT)-sizeof(RMESSAGE_HEADER);	
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_EVTMASTER_REPORT;
+	pMessage->Header.FromUnitID = fromUnitID;
+	pMessage->Header.ToUnitID = toUnitID;
+	pMessage->Header.TransactionID = transactionID;
+	pMessage->Header.Length = sizeof(RMESSAGE_EVTMASTER_REPORT)-sizeof(RMESSAGE_HEADER);	
 
 #ifndef SG_STATION_MASTER	// we send remote master notifications only if this station is not a master by itself
-	Message.EvtFlags = GetEvtMasterFlags();
-	Message.MasterStationID = GetEvtMasterStationID();
+	pMessage->EvtFlags = GetEvtMasterFlags();
+	pMessage->MasterStationID = GetEvtMasterStationID();
 #else
-	Message.EvtFlags = 0;
-	Message.MasterStationID = 0;
+	pMessage->EvtFlags = 0;
+	pMessage->MasterStationID = 0;
 #endif
-	Message.MasterStationAddress = 0;
+	pMessage->MasterStationAddress = 0;
 
-	return SendNetworkPacket(toUnitID, (void *)(&Message), sizeof(Message) );
+	return EndFrame(toUnitID, sizeof(RMESSAGE_EVTMASTER_REPORT) );
 }
 
 
@@ -477,18 +1387,18 @@ bool RProtocolMaster::SendEvtMasterReport(uint8_t transactionID, uint8_t fromUni
 
 bool RProtocolMaster::SendPingReply(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint32_t cookie)
 {
-	RMESSAGE_PING_REPLY Message;
+	RMESSAGE_PING_REPLY *pMessage = (RMESSAGE_PING_REPLY *)BeginFrame(toUnitID, sizeof(RMESSAGE_PING_REPLY));
 
-	Message.Header.ProtocolID = RPROTOCOL_ID;
-	Message.Header.FCode = FCODE_PING_REPLY;
-	Message.Header.FromUnitID = fromUnitID;
-	Message.Header.ToUnitID = toUnitID;
-	Message.Header.TransactionID = transactionID;
-	Message.Header.Length = sizeof(RMESSAGE_PING_REPLY)-sizeof(RMESSAGE_HEADER);	
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_PING_REPLY;
+	pMessage->Header.FromUnitID = fromUnitID;
+	pMessage->Header.ToUnitID = toUnitID;
+	pMessage->Header.TransactionID = transactionID;
+	pMessage->Header.Length = sizeof(RMESSAGE_PING_REPLY)-sizeof(RMESSAGE_HEADER);	
 
-	Message.cookie = cookie;	
+	pMessage->cookie = cookie;	
 
-	return SendNetworkPacket(toUnitID, (void *)(&Message), sizeof(Message) );
+	return EndFrame(toUnitID, sizeof(RMESSAGE_PING_REPLY) );
 }
 	
 
@@ -496,17 +1406,17 @@ bool RProtocolMaster::SendPingReply(uint8_t transactionID, uint8_t fromUnitID, u
 // Helper function - send generic OK response
 bool RProtocolMaster::SendOKResponse(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t FCode)
 {
-	RMESSAGE_RESPONSE_OK  ResponseMessage;
+	RMESSAGE_RESPONSE_OK  *pResponseMessage = (RMESSAGE_RESPONSE_OK *)BeginFrame(toUnitID, sizeof(RMESSAGE_RESPONSE_OK));
 
-	ResponseMessage.Header.ProtocolID = RPROTOCOL_ID;
-	ResponseMessage.Header.FCode = FCODE_RESPONSE_OK;
-	ResponseMessage.Header.FromUnitID = fromUnitID;
-	ResponseMessage.Header.ToUnitID = toUnitID;
-	ResponseMessage.Header.TransactionID = transactionID;
-	ResponseMessage.Header.Length = 1;
+	pResponseMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pResponseMessage->Header.FCode = FCODE_RESPONSE_OK;
+	pResponseMessage->Header.FromUnitID = fromUnitID;
+	pResponseMessage->Header.ToUnitID = toUnitID;
+	pResponseMessage->Header.TransactionID = transactionID;
+	pResponseMessage->Header.Length = 1;
 
-	ResponseMessage.SuccessFCode = FCode;
-	return SendNetworkPacket(toUnitID, (void *)(&ResponseMessage), sizeof(ResponseMessage) );
+	pResponseMessage->SuccessFCode = FCode;
+	return EndFrame(toUnitID, sizeof(RMESSAGE_RESPONSE_OK) );
 }
 
 //
@@ -514,18 +1424,37 @@ bool RProtocolMaster::SendOKResponse(uint8_t transactionID, uint8_t fromUnitID,
 //
 bool RProtocolMaster::SendErrorResponse(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t fCode, uint8_t errorCode)	// send error response with the same transaction ID, 
 {																									// unit ID, FCode=1 and Exception Code=2 (Illegal Data Address)
-	RMESSAGE_RESPONSE_ERROR	Message;
-
-	Message.Header.ProtocolID = RPROTOCOL_ID;
-	Message.Header.TransactionID = transactionID;
-	Message.Header.FCode = FCODE_RESPONSE_ERROR;
-	Message.Header.FromUnitID = fromUnitID;
-	Message.Header.ToUnitID = toUnitID;
-	Message.Header.Length = 2;
+	RMESSAGE_RESPONSE_ERROR	*pMessage = (RMESSAGE_RESPONSE_ERROR *)BeginFrame(toUnitID, sizeof(RMESSAGE_RESPONSE_ERROR));
+
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.TransactionID = transactionID;
+	pMessage->Header.FCode = FCODE_RESPONSE_ERROR;
+	pMessage->Header.FromUnitID = fromUnitID;
+	pMessage->Header.ToUnitID = toUnitID;
+	pMessage->Header.Length = 2;
+
+	pMessage->FailedFCode = fCode;
+	pMessage->ExceptionCode = errorCode;
+	return EndFrame(toUnitID, sizeof(RMESSAGE_RESPONSE_ERROR) );
+}
 
-	Message.FailedFCode = fCode;
-	Message.ExceptionCode = errorCode;
-	return SendNetworkPacket(toUnitID, (void *)(&Message), sizeof(Message) );
+//
+// Tell the master that the clock offset measured on the last time sync was out of tolerance
+//
+bool RProtocolMaster::SendTimeSyncReport(uint8_t toUnitID)
+{
+	RMESSAGE_TIME_SYNC_REPORT	*pMessage = (RMESSAGE_TIME_SYNC_REPORT *)BeginFrame(toUnitID, sizeof(RMESSAGE_TIME_SYNC_REPORT));
+
+	pMessage->Header.ProtocolID = RPROTOCOL_ID;
+	pMessage->Header.FCode = FCODE_TIME_SYNC_REPORT;
+	pMessage->Header.FromUnitID = GetMyStationID();
+	pMessage->Header.ToUnitID = toUnitID;
+	pMessage->Header.TransactionID = 0;
+	pMessage->Header.Length = sizeof(RMESSAGE_TIME_SYNC_REPORT)-sizeof(RMESSAGE_HEADER);
+
+	pMessage->Offset = timeSync.GetOffset();
+	pMessage->Drift = timeSync.GetDrift();
+	return EndFrame(toUnitID, sizeof(RMESSAGE_TIME_SYNC_REPORT));
 }
 
 
@@ -560,6 +1489,7 @@ inline void MessageZonesReport( void *ptr )
 // OK, payload seems to be valid.
 
 	runState.ReportStationZonesStatus(pMessage->Header.FromUnitID, pMessage->ZonesData[0]);
+	eventBus.Publish(SGEVT_REMOTE_ZONES, pMessage->Header.FromUnitID, pMessage->ZonesData[0]);
 }
 
 
@@ -594,6 +1524,7 @@ inline void MessageSensorsReport( void *ptr )
 		sensorsModule.ReportSensorReading(pMessage->Header.FromUnitID, nFirstSensor+i, (int) (pMessage->SensorsData[i]));
 //		SYSEVT_ERROR(F("station=%d after return from ReportSensorReading\n"), (int)(pMessage->Header.FromUnitID));
 	}
+	eventBus.Publish(SGEVT_REMOTE_SENSORS, pMessage->Header.FromUnitID, nSensors);
 }
  
 inline void MessageSystemRegistersReport( void *ptr )
@@ -676,7 +1607,7 @@ inline void MessageResponseError( void *ptr )
 //      RProtocol packets processing routines - FCODE_ZONES_READ
 //
 //      Input:	- stationID for the station to query.
-//				- transactionID to use (can be 0)
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Output	- true if successful, false on failure. 
 //
@@ -689,7 +1620,7 @@ inline void MessageResponseError( void *ptr )
 //              1.      FirstZone to read
 //              2.      The total number of zones to read
 //
-bool RProtocolMaster::SendReadZonesStatus( uint8_t stationID, uint16_t transactionID )
+bool RProtocolMaster::SendReadZonesStatus( uint8_t stationID, PTransactionCallback callback, uint8_t param )
 {
         RMESSAGE_ZONES_READ  Message;
 
@@ -698,12 +1629,12 @@ bool RProtocolMaster::SendReadZonesStatus( uint8_t stationID, uint16_t transacti
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = GetMyStationID();
         Message.Header.Length = sizeof(RMESSAGE_ZONES_READ)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.FirstZone = 0;
 		Message.NumZones = 0x0FF;	// read all station zone channels
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 
@@ -713,7 +1644,7 @@ bool RProtocolMaster::SendReadZonesStatus( uint8_t stationID, uint16_t transacti
 //      Input:	- stationID for the station to query.
 //				- start register
 //				- number of registers to read
-//				- transactionID to use (can be 0)
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Output	- true if successful, false on failure. 
 //
@@ -727,7 +1658,7 @@ bool RProtocolMaster::SendReadZonesStatus( uint8_t stationID, uint16_t transacti
 //              1.      FirstRegister to read 
 //              2.      The total number of registers to read
 //
-bool RProtocolMaster::SendReadSystemRegisters( uint8_t stationID, uint8_t startRegister, uint8_t numRegisters, uint16_t transactionID )
+bool RProtocolMaster::SendReadSystemRegisters( uint8_t stationID, uint8_t startRegister, uint8_t numRegisters, PTransactionCallback callback, uint8_t param )
 {
         RMESSAGE_SYSREGISTERS_READ  Message;
 
@@ -736,12 +1667,12 @@ bool RProtocolMaster::SendReadSystemRegisters( uint8_t stationID, uint8_t startR
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = MY_STATION_ID;
         Message.Header.Length = sizeof(RMESSAGE_SYSREGISTERS_READ)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.FirstRegister = startRegister;
 		Message.NumRegisters = numRegisters;	
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 
@@ -749,7 +1680,7 @@ bool RProtocolMaster::SendReadSystemRegisters( uint8_t stationID, uint8_t startR
 //      RProtocol packets processing routines - FCODE_SENSORS_READ
 //
 //      Input:	- stationID 
-//				- transactionID
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Output	- true for success and false for failure.
 //
@@ -764,7 +1695,7 @@ bool RProtocolMaster::SendReadSystemRegisters( uint8_t stationID, uint8_t startR
 //              2.      The total number of sensors to read 
 //						for this parameter we use "magic" value of 0x0FF, which means "read all sensors"
 //
-bool RProtocolMaster::SendReadSensors( uint8_t stationID, uint16_t transactionID )
+bool RProtocolMaster::SendReadSensors( uint8_t stationID, PTransactionCallback callback, uint8_t param )
 {
         RMESSAGE_SENSORS_READ  Message;
 
@@ -773,12 +1704,12 @@ bool RProtocolMaster::SendReadSensors( uint8_t stationID, uint16_t transactionID
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = MY_STATION_ID;
         Message.Header.Length = sizeof(RMESSAGE_SENSORS_READ)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.FirstSensor = 0;
 		Message.NumSensors = 0x0FF;	
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 
@@ -788,14 +1719,14 @@ bool RProtocolMaster::SendReadSensors( uint8_t stationID, uint16_t transactionID
 //      Input:	- stationID 
 //				- channel/zone to operate
 //				- time to run (min), or 0 for Off
-//				- transactionID
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Output	- true for success and false for failure.
 //
 //      The routine will generate and send request packet.
 //
 //
-bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, uint16_t ttr, uint16_t transactionID )
+bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, uint16_t ttr, PTransactionCallback callback, uint8_t param )
 {
         RMESSAGE_ZONES_SET  Message;
 
@@ -806,7 +1737,7 @@ bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, u
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = MY_STATION_ID;
         Message.Header.Length = sizeof(RMESSAGE_ZONES_SET)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.FirstZone = channel;
 		Message.Ttr = ttr;
@@ -815,7 +1746,7 @@ bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, u
 		Message.ZonesData[0] = 1 << channel;
 		Message.Flags = RMESSAGE_FLAGS_ACK_STD;
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 
@@ -823,7 +1754,7 @@ bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, u
 //	RProtocol packets processing routines - turn off all zones on the station
 //
 //      Input:	- stationID 
-//				- transactionID
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Note: currently we are sending all 8 channels in one go
 //
@@ -831,7 +1762,7 @@ bool RProtocolMaster::SendForceSingleZone( uint8_t stationID, uint8_t channel, u
 //
 //      The routine will generate and send request packet.
 //
-bool RProtocolMaster::SendTurnOffAllZones( uint8_t stationID, uint16_t transactionID )
+bool RProtocolMaster::SendTurnOffAllZones( uint8_t stationID, PTransactionCallback callback, uint8_t param )
 {
         RMESSAGE_ZONES_SET  Message;
 
@@ -840,7 +1771,7 @@ bool RProtocolMaster::SendTurnOffAllZones( uint8_t stationID, uint16_t transacti
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = MY_STATION_ID;
         Message.Header.Length = sizeof(RMESSAGE_ZONES_SET)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.FirstZone = 0;
 		Message.Ttr = 0;
@@ -849,7 +1780,7 @@ bool RProtocolMaster::SendTurnOffAllZones( uint8_t stationID, uint16_t transacti
 		Message.ZonesData[0] = 0;
 		Message.Flags = RMESSAGE_FLAGS_ACK_STD;
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 
@@ -911,7 +1842,7 @@ bool RProtocolMaster::SendSetName( uint8_t stationID, const char *str, uint16_t
 //				- events level to report
 //				- events mask (types of events to report)
 //				- extended flags (zero for now)
-//				- transactionID
+//				- completion callback (can be 0) and parameter to pass to it
 //
 //		Output	- true for success and false for failure.
 //
@@ -924,7 +1855,7 @@ bool RProtocolMaster::SendSetName( uint8_t stationID, const char *str, uint16_t
 //      uint16_t         TransactionID;
 //
 //
-bool RProtocolMaster::SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMask, uint16_t transactionID)
+bool RProtocolMaster::SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMask, PTransactionCallback callback, uint8_t param)
 {
         RMESSAGE_EVTMASTER_SET	Message;
 
@@ -935,17 +1866,17 @@ bool RProtocolMaster::SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMa
         Message.Header.ToUnitID = stationID;
         Message.Header.FromUnitID = MY_STATION_ID;
         Message.Header.Length = sizeof(RMESSAGE_EVTMASTER_SET)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = transactionID;
+		Message.Header.TransactionID = 0;		// assigned when the request is sent
 
         Message.EvtFlags = EVTMASTER_FLAGS_REGISTER_SELF | eventsMask;
 		Message.MasterStationAddress = Message.MasterStationID = 0;
 		Message.Flags = RMESSAGE_FLAGS_ACK_STD;
 
-		return SendNetworkPacket(stationID, (void *)(&Message), sizeof(Message) );
+		return QueueRequest((void *)(&Message), sizeof(Message), callback, param );
 }
 
 //
-//      RProtocol packets processing routines - FCODE_TIME_BROADCAST
+//      RProtocol packets processing routines - FCODE_TIME_SYNC
 //
 //      Input:	- none
 //
@@ -955,20 +1886,39 @@ bool RProtocolMaster::SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMa
 //
 inline void SendTimeBroadcastInt(void)
 {
-	RMESSAGE_TIME_BROADCAST Message;
+		TRACE_INFO(F("Sending time sync\n"));
 
-		TRACE_INFO(F("Sending time broadcast\n"));
+	RMESSAGE_TIME_SYNC *pMessage = (RMESSAGE_TIME_SYNC *)rprotocol.BeginFrame(STATIONID_BROADCAST, sizeof(RMESSAGE_TIME_SYNC));
+	uint16_t			timeMs;
 
-        Message.Header.ProtocolID = RPROTOCOL_ID;
-		Message.Header.FCode = FCODE_TIME_BROADCAST;
-        Message.Header.ToUnitID = STATIONID_BROADCAST;	// broadcast
-        Message.Header.FromUnitID = MY_STATION_ID;
-        Message.Header.Length = sizeof(RMESSAGE_TIME_BROADCAST)-sizeof(RMESSAGE_HEADER);
-		Message.Header.TransactionID = 0;
+        pMessage->Header.ProtocolID = RPROTOCOL_ID;
+		pMessage->Header.FCode = FCODE_TIME_SYNC;
+        pMessage->Header.ToUnitID = STATIONID_BROADCAST;	// broadcast
+        pMessage->Header.FromUnitID = MY_STATION_ID;
+        pMessage->Header.Length = sizeof(RMESSAGE_TIME_SYNC)-sizeof(RMESSAGE_HEADER);
+		pMessage->Header.TransactionID = 0;
+
+		pMessage->timeNow = timeSync.Now(&timeMs);		// transports with transmit queue stamp it again, see StampTimeSync()
+		pMessage->timeMs = timeMs;
+
+		rprotocol.EndFrame(STATIONID_BROADCAST, sizeof(RMESSAGE_TIME_SYNC) );
+}
+
+//
+// Refresh the time stamp of the FCODE_TIME_SYNC frame originated by this station. Transports that queue frames call it right before
+// the frame goes on the air, so the time the frame spent in the queue (carrier sense, other frames waiting for ACK) does not add to
+// the sync error. Other frames are left alone.
+//
+void RProtocolMaster::StampTimeSync(uint8_t *pFrame, uint8_t mSize)
+{
+	RMESSAGE_TIME_SYNC	*pMessage = (RMESSAGE_TIME_SYNC *)pFrame;
+	uint16_t			timeMs;
 
-		Message.timeNow = now();
+	if( (mSize != sizeof(RMESSAGE_TIME_SYNC)) || (pMessage->Header.FCode != FCODE_TIME_SYNC) || (pMessage->Header.FromUnitID != GetMyStationID()) )
+		return;
 
-		SendNetworkPacket(STATIONID_BROADCAST, (void *)(&Message), sizeof(Message) );
+	pMessage->timeNow = timeSync.Now(&timeMs);
+	pMessage->timeMs = timeMs;
 }
 
 //
@@ -1000,7 +1950,28 @@ inline void MessageTimeBroadcast( void *ptr )
 
 // OK, message seems to be valid, set new time
 
-	setTime((time_t) (pMessage->timeNow));
+	timeSync.SetTime((time_t) (pMessage->timeNow));
+	nntpTimeServer.SetLastUpdateTime();
+}
+
+//
+//	RProtocol packets processing routines - FCODE_TIME_SYNC
+//
+//	Clock is slewed towards the master time, see TimeSync.h. Offset out of tolerance is reported back to the master.
+//
+inline void MessageTimeSync( void *ptr )
+{
+	register RMESSAGE_TIME_SYNC  *pMessage = (RMESSAGE_TIME_SYNC *)ptr;
+
+	if( pMessage->Header.Length != (sizeof(RMESSAGE_TIME_SYNC)-sizeof(RMESSAGE_HEADER)) )
+	{
+		SYSEVT_ERROR(F("MessageTimeSync - bad parameters length"));
+		return;
+	}
+
+	if( timeSync.Sync((time_t) (pMessage->timeNow), pMessage->timeMs) )
+		rprotocol.SendTimeSyncReport(pMessage->Header.FromUnitID);
+
 	nntpTimeServer.SetLastUpdateTime();
 }
 
@@ -1166,19 +2137,217 @@ inline void MessageStationsScan( void *ptr )
 {
 	register RMESSAGE_SCAN	*pMessage = (RMESSAGE_SCAN *)ptr;
 
-//	rprotocol.SendResponse(pMessage->Header.TransactionID, rprotocol.myUnitID, FCODE_SCAN_REPLY, 0, 0);	// send confirmation response 
-	
-	return;
+	if( pMessage->Header.Length != (sizeof(RMESSAGE_SCAN)-sizeof(RMESSAGE_HEADER)) )
+	{
+		SYSEVT_ERROR(F("MessageStationsScan - bad parameters length"));
+		return;
+	}
+
+	rprotocol.ScheduleScanReply(pMessage->Header.FromUnitID, pMessage->ReplyWindow);	// reply is sent from loop(), after random delay
+}
+
+//
+//	packets processing routines - SCAN_REPLY
+//
+//	Neighbor cache is already updated by ProcessNewFrame(), just report what was found.
+//
+inline void MessageStationsScanReply( void *ptr )
+{
+	register RMESSAGE_SCAN_REPLY	*pMessage = (RMESSAGE_SCAN_REPLY *)ptr;
+
+	if( pMessage->Header.Length != (sizeof(RMESSAGE_SCAN_REPLY)-sizeof(RMESSAGE_HEADER)) )
+	{
+		SYSEVT_ERROR(F("MessageStationsScanReply - bad parameters length"));
+		return;
+	}
+
+	TRACE_INFO(F("Station %u replied to scan - type %u, hardware %u, firmware %u, %u zones, %u sensors\n"), uint16_t(pMessage->Header.FromUnitID),
+				uint16_t(pMessage->StationType), uint16_t(pMessage->HardwareVersion), uint16_t(pMessage->FirmwareVersion), uint16_t(pMessage->NumZones), uint16_t(pMessage->NumSensors));
+
+#ifdef SG_STATION_MASTER
+	if( pMessage->Header.FromUnitID < MAX_STATIONS )
+	{
+		ShortStation	sStation;
+
+		LoadShortStation(pMessage->Header.FromUnitID, &sStation);
+		if( !(sStation.stationFlags & STATION_FLAGS_VALID) )
+			SYSEVT_NOTICE(F("Found station %u, it is not configured"), uint16_t(pMessage->Header.FromUnitID));
+	}
+
+	if( pMessage->Header.ToUnitID == STATIONID_BROADCAST )
+		rprotocol.ScheduleTimeSync(false);			// station announced itself after start, it needs time
+#endif //SG_STATION_MASTER
+}
+
+#ifdef SG_STATION_MASTER
+//
+//	packets processing routines - TIME_SYNC_REPORT
+//
+inline void MessageTimeSyncReport( void *ptr )
+{
+	register RMESSAGE_TIME_SYNC_REPORT	*pMessage = (RMESSAGE_TIME_SYNC_REPORT *)ptr;
+
+	if( pMessage->Header.Length != (sizeof(RMESSAGE_TIME_SYNC_REPORT)-sizeof(RMESSAGE_HEADER)) )
+	{
+		SYSEVT_ERROR(F("MessageTimeSyncReport - bad parameters length"));
+		return;
+	}
+
+	TRACE_INFO(F("Station %u clock offset %d ms, drift %d ppm\n"), uint16_t(pMessage->Header.FromUnitID), int(pMessage->Offset), int(pMessage->Drift));
+	rprotocol.ScheduleTimeSync(true);
+}
+#endif //SG_STATION_MASTER
+
+
+//
+// Unpack sub-frame of the compound message (FCODE_COMPOUND or FCODE_COMPOUND_REPORT) into standalone message.
+//
+// pPos - offset of the sub-frame in the Data area, advanced to the next sub-frame.
+// Returns standalone message length, or 0 if the sub-frame is malformed.
+//
+static uint8_t UnpackSubFrame(RMESSAGE_COMPOUND *pMessage, uint8_t *pPos, uint8_t *pFrame)
+{
+	RMESSAGE_HEADER		*pHeader = (RMESSAGE_HEADER *)pFrame;
+	RCOMPOUND_SUBHEADER	*pSub = (RCOMPOUND_SUBHEADER *)(pMessage->Data + *pPos);
+	uint8_t				dataLen = pMessage->Header.Length - 1;		// size of the Data area
+
+	if( ((*pPos + sizeof(RCOMPOUND_SUBHEADER)) > dataLen) || ((*pPos + sizeof(RCOMPOUND_SUBHEADER) + pSub->Length) > dataLen)
+		|| ((sizeof(RMESSAGE_HEADER) + pSub->Length) > RPROTOCOL_MAX_FRAME_SIZE) )
+		return 0;
+
+	*pHeader = pMessage->Header;
+	pHeader->FCode = pSub->FCode;
+	pHeader->Length = pSub->Length;
+	memcpy(pHeader+1, pSub+1, pSub->Length);
+
+	*pPos += sizeof(RCOMPOUND_SUBHEADER) + pSub->Length;
+	return sizeof(RMESSAGE_HEADER) + pSub->Length;
+}
+
+//
+//	packets processing routines - compound request
+//
+//	Sub-commands are executed one by one, as if they were received as standalone messages.
+//	Replies they generate are collected by SendNetworkPacket() and sent back as single FCODE_COMPOUND_REPORT.
+//
+inline void MessageCompound( void *ptr )
+{
+	RMESSAGE_COMPOUND	*pMessage = (RMESSAGE_COMPOUND *)ptr;
+	uint8_t				frame[RPROTOCOL_MAX_FRAME_SIZE];
+	uint8_t				reply[RPROTOCOL_MAX_FRAME_SIZE];
+	uint8_t				pos = 0;
+
+	if( pMessage->Header.Length < 1 )
+	{
+		SYSEVT_ERROR(F("MessageCompound - bad parameters length"));
+		return;
+	}
+
+	pCompoundReply = (RMESSAGE_COMPOUND_REPORT *)reply;
+	pCompoundReply->Header.ProtocolID = RPROTOCOL_ID;
+	pCompoundReply->Header.FCode = FCODE_COMPOUND_REPORT;
+	pCompoundReply->Header.TransactionID = pMessage->Header.TransactionID;
+	pCompoundReply->Header.ToUnitID = pMessage->Header.FromUnitID;
+	pCompoundReply->Header.FromUnitID = pMessage->Header.ToUnitID;
+	pCompoundReply->NumReplies = 0;
+	compoundReplyLen = sizeof(RMESSAGE_HEADER) + 1;
+
+	for( uint8_t i=0; i<pMessage->NumCommands; i++ )
+	{
+		uint8_t		len = UnpackSubFrame(pMessage, &pos, frame);
+
+		if( len == 0 )
+		{
+			SYSEVT_ERROR(F("MessageCompound - bad sub-command %u"), uint16_t(i));
+			break;
+		}
+
+		switch( ((RMESSAGE_HEADER *)frame)->FCode )
+		{
+			case FCODE_ZONES_READ:
+			case FCODE_ZONES_SET:
+			case FCODE_SENSORS_READ:
+			case FCODE_EVTMASTER_SET:
+			case FCODE_PING:
+#ifdef SG_RF_TIME_CLIENT
+			case FCODE_TIME_BROADCAST:
+#endif //SG_RF_TIME_CLIENT
+							rprotocol.ProcessNewFrame(frame, len, 0);
+							break;
+
+			default:		// Exception Code=1 (Illegal Function)
+							rprotocol.SendErrorResponse(pMessage->Header.TransactionID, pMessage->Header.ToUnitID, pMessage->Header.FromUnitID, ((RMESSAGE_HEADER *)frame)->FCode, 1);
+							break;
+		}
+	}
+
+	pCompoundReply = 0;
+	if( ((RMESSAGE_COMPOUND_REPORT *)reply)->NumReplies != 0 )
+	{
+		((RMESSAGE_HEADER *)reply)->Length = compoundReplyLen - sizeof(RMESSAGE_HEADER);
+		SendNetworkPacket(pMessage->Header.FromUnitID, reply, compoundReplyLen);
+	}
 }
 
+//
+//	packets processing routines - compound reply
+//
+//	Sub-replies are processed as standalone messages, without TransactionID (the whole compound request is completed by the caller).
+//	Returns false if any of the sub-commands failed.
+//
+inline bool MessageCompoundReport( void *ptr )
+{
+	RMESSAGE_COMPOUND	*pMessage = (RMESSAGE_COMPOUND *)ptr;		// the same layout as RMESSAGE_COMPOUND_REPORT
+	uint8_t				frame[RPROTOCOL_MAX_FRAME_SIZE];
+	uint8_t				pos = 0;
+	bool				fOK = true;
+
+	if( pMessage->Header.Length < 1 )
+	{
+		SYSEVT_ERROR(F("MessageCompoundReport - bad parameters length"));
+		return false;
+	}
+
+	for( uint8_t i=0; i<pMessage->NumCommands; i++ )
+	{
+		uint8_t		len = UnpackSubFrame(pMessage, &pos, frame);
+
+		if( len == 0 )
+		{
+			SYSEVT_ERROR(F("MessageCompoundReport - bad sub-reply %u"), uint16_t(i));
+			return false;
+		}
+
+		RMESSAGE_HEADER *pHeader = (RMESSAGE_HEADER *)frame;
+		pHeader->TransactionID = 0;
+
+		switch( pHeader->FCode )
+		{
+			case FCODE_RESPONSE_ERROR:
+							fOK = false;			// fall through
+			case FCODE_ZONES_REPORT:
+			case FCODE_SENSORS_REPORT:
+			case FCODE_EVTMASTER_REPORT:
+			case FCODE_PING_REPLY:
+			case FCODE_RESPONSE_OK:
+							rprotocol.ProcessNewFrame(frame, len, 0);
+							break;
+
+			default:
+							SYSEVT_ERROR(F("MessageCompoundReport - unexpected sub-reply FCode %u"), uint16_t(pHeader->FCode));
+							break;
+		}
+	}
+	return fOK;
+}
 
 // Process new data frame coming from the network
 // ptr			- pointer to the data block,
 // len			- block length
 // netAddress	- sender's RF network address
-// rssi			- recieving singlal strength indicator
+// pTransport	- transport the frame was received on, updates the neighbor cache. 0 for frames unpacked from compound messages
 //
-void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddress )
+void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddress, NetTransport *pTransport )
 {
         register RMESSAGE_GENERIC *pMessage = (RMESSAGE_GENERIC *)ptr;    // for convenience of interpreting the packet
 
@@ -1218,8 +2387,23 @@ void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddres
 
 		if( (_ARPAddressUpdate != 0) && (pNetAddress != 0) ) _ARPAddressUpdate(pMessage->Header.FromUnitID, pNetAddress);
 
+		if( pTransport != 0 ) UpdateNeighbor(pMessage->Header.FromUnitID, pTransport);
+
+// Broadcasts heard directly. Drop copies re-broadcast by relays, and re-broadcast it if this station is a relay.
+
+		if( (pTransport != 0) && (pMessage->Header.ToUnitID == STATIONID_BROADCAST) && (pMessage->Header.FCode != FCODE_RELAY) )
+		{
+			if( IsDuplicate(ptr, len) )
+				return;
+
+			if( IsRelayEnabled() )
+				SendRelayFrame(STATIONID_BROADCAST, 1, ptr, len);
+		}
+
 		TRACE_INFO(F("ProcessNewFrame - processing packet, FCode: %d\n"), pMessage->Header.FCode);
 
+		uint8_t		replyStatus = RTRANSACTION_OK;		// transaction status, if this is a reply
+
         switch( pMessage->Header.FCode )
         {
 // Standard FCodes
@@ -1247,8 +2431,20 @@ void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddres
                                 MessageResponseError( ptr );
                                 break;
 
+                case FCODE_RESPONSE_OK:
+                                break;			// nothing to do beyond completing the transaction (below)
+
+				case FCODE_COMPOUND_REPORT:
+								if( !MessageCompoundReport( ptr ) )
+									replyStatus = RTRANSACTION_ERROR;
+								break;
+
+				case FCODE_RELAY:
+								MessageRelay( ptr, len );
+								return;
+
                 case FCODE_SCAN_REPLY:
-//                                StationsScanResponse( ptr );
+                                MessageStationsScanReply( ptr );
                                 break;
 
 				case FCODE_EVTMASTER_REPORT:
@@ -1266,7 +2462,16 @@ void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddres
 				case FCODE_TIME_BROADCAST:
 								MessageTimeBroadcast( ptr );
 								break;
+
+				case FCODE_TIME_SYNC:
+								MessageTimeSync( ptr );
+								break;
 #endif //SG_RF_TIME_CLIENT
+#ifdef SG_STATION_MASTER
+				case FCODE_TIME_SYNC_REPORT:
+								MessageTimeSyncReport( ptr );
+								break;
+#endif //SG_STATION_MASTER
 #ifdef SG_STATION_SLAVE
 				case FCODE_ZONES_READ:	
 								MessageZonesRead( ptr );
@@ -1291,12 +2496,43 @@ void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddres
 				case FCODE_SCAN:	
 								MessageStationsScan( ptr );
 								break;
+
+				case FCODE_COMPOUND:
+								MessageCompound( ptr );
+								break;
 	
 #endif //SG_STATION_SLAVE	
 
 				default: 
 								SYSEVT_ERROR(F("Unknown packet received"));
+								return;
+		}
+
+// Reports and responses quote TransactionID of the request, complete it
+
+		if( pMessage->Header.TransactionID != 0 )
+		{
+			switch( pMessage->Header.FCode )
+			{
+				case FCODE_SENSORS_REPORT:
+								// Report that does not answer our request is pushed by the remote station, acknowledge it
+								if( !IsPending(pMessage->Header.FromUnitID, FCODE_SENSORS_READ) || !CompleteTransaction(pMessage->Header.FromUnitID, pMessage->Header.TransactionID, replyStatus) )
+									SendOKResponse(pMessage->Header.TransactionID, pMessage->Header.ToUnitID, pMessage->Header.FromUnitID, FCODE_SENSORS_REPORT);
+								break;
+
+				case FCODE_ZONES_REPORT:
+				case FCODE_SYSREGISTERS_REPORT:
+				case FCODE_EVTMASTER_REPORT:
+				case FCODE_PING_REPLY:
+				case FCODE_RESPONSE_OK:
+				case FCODE_COMPOUND_REPORT:
+								CompleteTransaction(pMessage->Header.FromUnitID, pMessage->Header.TransactionID, replyStatus);
 								break;
+
+				case FCODE_RESPONSE_ERROR:
+								CompleteTransaction(pMessage->Header.FromUnitID, pMessage->Header.TransactionID, RTRANSACTION_ERROR);
+								break;
+			}
 		}
 
         return;
@@ -1311,7 +2547,7 @@ void RProtocolMaster::ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddres
 // Turn On/Off channels
 //
 
-bool RProtocolMaster::ChannelOn( uint8_t stationID, uint8_t chan, uint8_t ttr )
+bool RProtocolMaster::ChannelOn( uint8_t stationID, uint8_t chan, uint8_t ttr, PTransactionCallback callback )
 {
 	{   // limit scope of sStation declaration to save memory during subsequent call
 		ShortStation	sStation;
@@ -1335,15 +2571,15 @@ bool RProtocolMaster::ChannelOn( uint8_t stationID, uint8_t chan, uint8_t ttr )
 
 // OK, everything seems to be good. Send command.
 
-	return SendForceSingleZone( stationID, chan, ttr, 0 );
+	return SendForceSingleZone( stationID, chan, ttr, callback, chan );
 }
 
-bool RProtocolMaster::ChannelOff( uint8_t stationID, uint8_t chan )
+bool RProtocolMaster::ChannelOff( uint8_t stationID, uint8_t chan, PTransactionCallback callback )
 {
-	return ChannelOn( stationID, chan, 0 );
+	return ChannelOn( stationID, chan, 0, callback );
 }
 
-bool RProtocolMaster::AllChannelsOff(uint8_t stationID)
+bool RProtocolMaster::AllChannelsOff(uint8_t stationID, PTransactionCallback callback)
 {
 	{
 		ShortStation	sStation;
@@ -1365,23 +2601,39 @@ bool RProtocolMaster::AllChannelsOff(uint8_t stationID)
 
 // OK, everything seems to be valid. Send command.
 
-	return SendTurnOffAllZones( stationID, 0 );
+	return SendTurnOffAllZones( stationID, callback, 0x0FF );
 }
 
+//
+// Called every second while the master has reliable time. Sync interval is stretched while stations don't report offsets.
+//
 void RProtocolMaster::SendTimeBroadcast(void)
 {
-	static  time_t	nextBroadcastTime = 0;
+	if( (millis() - _timeSyncTime) < _timeSyncInterval*1000ul )
+		return;
+
+	if( !_fTimeSyncReport )
+		_timeSyncInterval = (_timeSyncInterval*2 > RPROTOCOL_TIMESYNC_MAX) ? RPROTOCOL_TIMESYNC_MAX:_timeSyncInterval*2;
 
-	if(nextBroadcastTime <= now()){
+	_fTimeSyncReport = false;
+	_timeSyncTime = millis();
 
-		SendTimeBroadcastInt();
+	SendTimeBroadcastInt();
+}
 
-		nextBroadcastTime = now() + 60; //  every 60 seconds
-	}  
+void RProtocolMaster::ScheduleTimeSync(bool fShorten)
+{
+	if( fShorten )
+	{
+		_fTimeSyncReport = true;
+		_timeSyncInterval = RPROTOCOL_TIMESYNC_MIN;
+	}
 
+	if( (millis() - _timeSyncTime) < (_timeSyncInterval - RPROTOCOL_TIMESYNC_SOON)*1000ul )
+		_timeSyncTime = millis() - (_timeSyncInterval - RPROTOCOL_TIMESYNC_SOON)*1000ul;
 }
 
-bool RProtocolMaster::PollStationSensors(uint8_t stationID)
+bool RProtocolMaster::PollStationSensors(uint8_t stationID, PTransactionCallback callback, uint8_t param)
 {
 	{
 		ShortStation	sStation;
@@ -1399,18 +2651,39 @@ bool RProtocolMaster::PollStationSensors(uint8_t stationID)
 			return false;
 		}
 
-		if( (sStation.networkID != NETWORK_ID_XBEE) && (sStation.networkID != NETWORK_ID_MOTEINORF) )
+		if( !IS_REMOTE_NETWORK(sStation.networkID) )
 		{
-			SYSEVT_ERROR(F("RProtocol PollStationSensors - station %d is of a wrong type (not XBee or RFM69)"), (int)stationID);
+			SYSEVT_ERROR(F("RProtocol PollStationSensors - station %d is of a wrong type (not a remote station)"), (int)stationID);
 			return false;
 		}
 	}
 
+	{
+		RTransaction	*pTrans = FindPending(stationID, FCODE_SENSORS_READ);
+
+		if( pTrans != 0 )
+		{
+			// The reply to the request in flight carries the same readings. The caller gets its completion from that request,
+			// unless the request already reports to somebody else - then the poll is not issued.
+			TRACE_INFO(F("PollStationSensors - previous request to station %d is still in flight\n"), stationID);
+
+			if( callback == 0 )
+				return true;
+
+			if( (pTrans->callback != 0) && (pTrans->callback != callback) )
+				return false;
+
+			pTrans->callback = callback;
+			pTrans->param = param;
+			return true;
+		}
+	}
+
 	TRACE_INFO(F("PollStationSensors - sending request to station %d\n"), stationID);
 
 // OK, everything seems to be ready. Send command.
 
-	return SendReadSensors( stationID, 0 );
+	return SendReadSensors( stationID, callback, param );
 }
 
 bool RProtocolMaster::SubscribeEvents( uint8_t stationID )
@@ -1422,10 +2695,10 @@ bool RProtocolMaster::SubscribeEvents( uint8_t stationID )
 			return false;		// basic protection
 
 		LoadShortStation(stationID, &sStation);
-		if( !(sStation.stationFlags & STATION_FLAGS_ENABLED) || ((sStation.networkID != NETWORK_ID_XBEE) && (sStation.networkID != NETWORK_ID_MOTEINORF)) )
+		if( !(sStation.stationFlags & STATION_FLAGS_ENABLED) || !IS_REMOTE_NETWORK(sStation.networkID) )
 			return false;
 	}
-	return SendRegisterEvtMaster( stationID, EVTMASTER_FLAGS_REPORT_ALL, 0);
+	return SendRegisterEvtMaster( stationID, EVTMASTER_FLAGS_REPORT_ALL );
 }
 
 
@@ -1438,13 +2711,13 @@ bool RProtocolMaster::SubscribeEvents( uint8_t stationID )
 
 void RProtocolMaster::loop(void)
 {
-#ifdef HW_ENABLE_XBEE
-		XBeeRF.loop();
-#endif //HW_ENABLE_XBEE
+		FlushRequests();
+
+		for( uint8_t i=0; i<_numTransports; i++ )
+			_transports[i]->Poll();
 
-#ifdef HW_ENABLE_MOTEINORF
-		MoteinoRF.loop();
-#endif //HW_ENABLE_MOTEINORF
+		CheckPendingRequests();
+		CheckNeighbors();
 }
 
 
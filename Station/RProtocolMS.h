@@ -28,10 +28,101 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 
 
 #include "SGRProtocol.h"        // wire protocol definitions
+#include "Transport.h"
 
-typedef bool (*PTransportCallback)(uint8_t nStation, void *msg, uint8_t mSize);
+#define RPROTOCOL_MAX_TRANSPORTS		4
 typedef bool (*PARPCallback)(uint8_t nStation, uint8_t *pNetAddress);
 
+// Outstanding requests tracking
+//
+// Requests sent through ChannelOn()/AllChannelsOff()/PollStationSensors()/SubscribeEvents() get a non-zero TransactionID
+// and stay in the pending table until the matching report/response arrives, or until all retries are exhausted.
+// If the table is full the request is still sent, but with TransactionID 0 and without tracking.
+// On transports with delivery report the response timer starts when the transport reports the request delivered, so link-level
+// retries do not count against the response timeout (and the request is not re-sent while the link is still retrying it).
+//
+#define RPROTOCOL_MAX_PENDING		8		// max number of requests in flight (across all stations)
+#define RPROTOCOL_REQUEST_TIMEOUT	600		// initial response timeout, ms. Doubled on every retry.
+#define RPROTOCOL_DELIVERY_TIMEOUT	5000	// ms, max wait for the transport delivery report (longer than link-level retries take)
+#define RPROTOCOL_MAX_RETRIES		2		// number of re-transmissions before giving up
+
+// Transaction completion status
+#define RTRANSACTION_OK				0		// report or OK response received
+#define RTRANSACTION_ERROR			1		// FCODE_RESPONSE_ERROR received
+#define RTRANSACTION_TIMEOUT		2		// no response after all retries
+#define RTRANSACTION_NOT_DELIVERED	3		// transport could not deliver the request (no link-level ACK)
+
+// Completion callback. param is the value provided when request was sent (e.g. channel number for zone commands).
+// When requests with different param values are packed into one compound frame, the callback gets param of 0xFF.
+typedef void (*PTransactionCallback)(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param);
+
+// Neighbor cache
+//
+// Stations heard on the network - from scan replies, announcements or any other frame. The entry tells which transport the station
+// was last heard on, and frames to the station are routed by it. Station config (networkID) is used only until the station is heard.
+// Stations not heard for RPROTOCOL_NEIGHBOR_TIMEOUT (or that did not ACK a request) are stale: requests to them are still sent,
+// but without re-transmissions. Master scans the network every RPROTOCOL_SCAN_INTERVAL, and every station announces itself on start.
+//
+#define RPROTOCOL_SCAN_INTERVAL		300		// seconds between network scans (master)
+#define RPROTOCOL_SCAN_FIRST		5		// seconds from start to the first scan, and to the announcement
+#define RPROTOCOL_SCAN_WINDOW		1000	// ms, stations spread their scan replies randomly over this window
+#define RPROTOCOL_NEIGHBOR_TIMEOUT	900		// seconds, station not heard for this long is aged out
+
+#define RNEIGHBOR_UNKNOWN			0		// station was not heard yet, route by station config
+#define RNEIGHBOR_REACHABLE			1
+#define RNEIGHBOR_STALE				2		// aged out or did not ACK, last known transport is still used
+
+struct RNeighbor
+{
+	uint8_t		state;					// RNEIGHBOR_*
+	uint8_t		transport;				// index of the transport the station (or its relay) was heard on
+	uint8_t		via;					// next hop - the station itself, or the relay station it was heard through
+	uint8_t		hops;					// number of relays on the way, 0 for direct neighbors
+};
+
+// Relaying
+//
+// Stations heard through a relay (see FCODE_RELAY) get routed entry in the neighbor cache, frames to them are wrapped and sent to the relay.
+// Direct route is kept while it is reachable, otherwise the route through the last relay (or the shortest one) is used.
+// Routes are learned only through direct neighbors. Copies of relayed frames (broadcasts re-broadcast by relays, unicasts bounced back
+// by a relay with a stale route) are dropped by origin and checksum of the frame, they neither update routes nor get forwarded again.
+// Dup window is shorter than RPROTOCOL_REQUEST_TIMEOUT, so re-transmitted requests are not mistaken for duplicates.
+//
+#define RPROTOCOL_RELAY_SEEN_SIZE	8		// recently seen relayed frames and broadcasts
+#define RPROTOCOL_RELAY_DUP_WINDOW	300		// ms
+
+struct RRelaySeen
+{
+	uint8_t		origin;					// FromUnitID of the broadcast
+	uint16_t	sum;					// frame checksum
+	uint32_t	time;					// millis() when it was seen
+};
+
+// Time sync (master)
+//
+// FCODE_TIME_SYNC is broadcast every RPROTOCOL_TIMESYNC_MIN seconds at first. The interval is doubled after every sync that did not
+// draw offset reports from stations, up to RPROTOCOL_TIMESYNC_MAX. A report drops the interval back to the minimum, and the next
+// sync goes out in RPROTOCOL_TIMESYNC_SOON seconds. So does the sync after a station announcement (station just started).
+//
+#define RPROTOCOL_TIMESYNC_MIN		60		// seconds
+#define RPROTOCOL_TIMESYNC_MAX		960		// seconds
+#define RPROTOCOL_TIMESYNC_SOON		3		// seconds
+
+struct RTransaction
+{
+	uint8_t					transactionID;		// 0 means the entry is free
+	uint8_t					stationID;
+	uint8_t					fCode;				// FCode of the request
+	uint8_t					retries;			// re-transmissions left
+	uint8_t					param;				// opaque parameter passed back to the callback
+	uint8_t					size;				// request size, 0 until the request is sent
+	uint16_t				timeout;			// current timeout, ms
+	uint32_t				sentTime;			// millis() of the last transmission, or of the delivery report
+	bool					fInTransit;			// waiting for the transport delivery report, response timer is not running yet
+	PTransactionCallback	callback;
+	uint8_t					request[RPROTOCOL_MAX_FRAME_SIZE];	// copy of the request for re-transmission (compound frames included)
+};
+
 class RProtocolMaster {
 
 public:
@@ -41,41 +132,127 @@ public:
 
 				void	RegisterARP(void *ptr);
 
+			// Transports. Frames to a station go through the transport registered for the station networkID.
+			// Stations without valid config entry (or without transport for their network) use the first registered transport.
+
+				bool			RegisterTransport(uint8_t networkID, NetTransport *pTransport);
+				NetTransport	*GetTransport(uint8_t stationID);
+				bool			TransmitFrame(uint8_t stationID, void *pMessage, uint8_t mSize, uint8_t transactionID);
+
+			// Outgoing frames are built in place - in the transport buffer when the transport offers one, otherwise in the shared frame buffer.
+			// mSize passed to BeginFrame() is the upper limit, EndFrame() gets the actual size.
+
+				uint8_t			*BeginFrame(uint8_t stationID, uint8_t mSize);
+				bool			EndFrame(uint8_t stationID, uint8_t mSize, uint8_t transactionID = 0);
+
 			// Remote stations commands
 
-				bool	ChannelOn( uint8_t stationID, uint8_t chan, uint8_t ttr);
-				bool	ChannelOff( uint8_t stationID, uint8_t chan);
-				bool	AllChannelsOff(uint8_t stationID);
-				bool	PollStationSensors(uint8_t stationID);
+				bool	ChannelOn( uint8_t stationID, uint8_t chan, uint8_t ttr, PTransactionCallback callback = 0);
+				bool	ChannelOff( uint8_t stationID, uint8_t chan, PTransactionCallback callback = 0);
+				bool	AllChannelsOff(uint8_t stationID, PTransactionCallback callback = 0);
+				bool	PollStationSensors(uint8_t stationID, PTransactionCallback callback = 0, uint8_t param = 0);
 				bool	SubscribeEvents( uint8_t stationID );
 
 
-				bool	SendReadZonesStatus( uint8_t stationID, uint16_t transactionID );
-				bool	SendReadSystemRegisters( uint8_t stationID, uint8_t startRegister, uint8_t numRegisters, uint16_t transactionID );
-				bool	SendReadSensors( uint8_t stationID, uint16_t transactionID );
-				bool	SendForceSingleZone( uint8_t stationID, uint8_t channel, uint16_t ttr, uint16_t transactionID );
-				bool	SendTurnOffAllZones( uint8_t stationID, uint16_t transactionID );
+			// Requests are queued and sent from loop(). Requests to the same station issued back to back are packed into one FCODE_COMPOUND frame.
+
+				bool	SendReadZonesStatus( uint8_t stationID, PTransactionCallback callback = 0, uint8_t param = 0 );
+				bool	SendReadSystemRegisters( uint8_t stationID, uint8_t startRegister, uint8_t numRegisters, PTransactionCallback callback = 0, uint8_t param = 0 );
+				bool	SendReadSensors( uint8_t stationID, PTransactionCallback callback = 0, uint8_t param = 0 );
+				bool	SendForceSingleZone( uint8_t stationID, uint8_t channel, uint16_t ttr, PTransactionCallback callback = 0, uint8_t param = 0 );
+				bool	SendTurnOffAllZones( uint8_t stationID, PTransactionCallback callback = 0, uint8_t param = 0 );
 				bool	SendSetName( uint8_t stationID, const char *str, uint16_t transactionID );
-				bool	SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMask, uint16_t transactionID);
+				bool	SendRegisterEvtMaster( uint8_t stationID, uint8_t eventsMask, PTransactionCallback callback = 0, uint8_t param = 0 );
+				void	FlushRequests(void);
 
-				void	ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddress);
+				void	ProcessNewFrame(uint8_t *ptr, int len, uint8_t *pNetAddress, NetTransport *pTransport = 0);
 
 				void	SendTimeBroadcast(void);
+				void	StampTimeSync(uint8_t *pFrame, uint8_t mSize);	// called by the transport right before the frame is transmitted
+				void	ScheduleTimeSync(bool fShorten);		// sync soon, fShorten - also drop the interval to the minimum
+
+			// Stations discovery
+
+				bool	ScanStations(void);
+				void	ScheduleScanReply(uint8_t toUnitID, uint16_t replyWindow);
+				uint8_t	NeighborState(uint8_t stationID);
+				uint8_t	NeighborVia(uint8_t stationID);				// relay the station is reached through, or the station itself
+				void	UpdateNeighbor(uint8_t stationID, NetTransport *pTransport);
 
 // Client routines
 				bool SendZonesReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstZone, uint8_t numZones);
 				bool SendSensorsReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstSensor, uint8_t numSensors);
+				bool PushSensorsReport(uint8_t toUnitID, PTransactionCallback callback);
 				bool SendSystemRegisters(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstRegister, uint8_t numRegisters);
 				bool SendEvtMasterReport(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID);
 				bool SendPingReply(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint32_t cookie);
 				bool SendOKResponse(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t FCode);
 				bool SendErrorResponse(uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t fCode, uint8_t errorCode);
+				bool SendTimeSyncReport(uint8_t toUnitID);
 
 				bool NotifySysEvent(uint8_t eventType, uint32_t timeStamp, uint16_t seqID, uint8_t flags, uint8_t eventDataLength, uint8_t *eventData);
 
+				uint8_t	NumPendingRequests(void);
+				void	DeliveryFailed(uint8_t stationID, uint8_t transactionID);
+				void	Delivered(uint8_t stationID, uint8_t transactionID);
+
 private:
+				uint8_t	NewTransaction(uint8_t stationID, uint8_t fCode, PTransactionCallback callback, uint8_t param);
+				bool	IsPending(uint8_t stationID, uint8_t fCode);
+				RTransaction *FindPending(uint8_t stationID, uint8_t fCode);
+				bool	SendRequestPacket(uint8_t stationID, void *pMessage, uint8_t mSize);
+				bool	QueueRequest(void *pMessage, uint8_t mSize, PTransactionCallback callback, uint8_t param);
+				bool	CompleteTransaction(uint8_t stationID, uint8_t transactionID, uint8_t status);
+				RTransaction *FindTransaction(uint8_t stationID, uint8_t transactionID);
+				void	AwaitDelivery(uint8_t stationID, uint8_t transactionID);
+				uint8_t	FormatSensorsReport(uint8_t *outbuf, uint8_t transactionID, uint8_t fromUnitID, uint8_t toUnitID, uint8_t firstSensor, uint8_t numSensors);
+				void	CheckPendingRequests(void);
+				void	CheckNeighbors(void);
+				uint8_t	FindTransport(NetTransport *pTransport);
+				void	NeighborLost(uint8_t stationID);
+				bool	SendScanReply(uint8_t toUnitID);
+				bool	IsRelayed(uint8_t stationID);
+				void	UpdateRoute(uint8_t stationID, uint8_t via, uint8_t hops);
+				bool	IsDuplicate(uint8_t *ptr, uint8_t len);
+				bool	SendRelayFrame(uint8_t nextHop, uint8_t hopCount, void *pFrame, uint8_t frameLen);
+				void	MessageRelay(uint8_t *ptr, uint8_t len);
+
 // ARP address update
 				PARPCallback		_ARPAddressUpdate;
+
+// Registered transports
+				NetTransport		*_transports[RPROTOCOL_MAX_TRANSPORTS];
+				uint8_t				_transportNetworkID[RPROTOCOL_MAX_TRANSPORTS];
+				uint8_t				_numTransports;
+				NetTransport		*_txTransport;		// transport holding the frame being built, 0 if it is in the shared buffer
+
+// Neighbor cache and discovery timers
+				RNeighbor			_neighbors[MAX_STATIONS];
+				uint32_t			_neighborCheckTime;		// millis() of the last aging pass
+				uint32_t			_scanTime;				// millis() of the last scan (master)
+				uint32_t			_scanReplyTime;			// millis() when the pending scan reply is due
+				uint8_t				_scanReplyTo;			// destination of the pending scan reply, STATIONID_BROADCAST for the announcement
+				bool				_fScanReplyPending;
+
+// Time sync schedule (master)
+				uint32_t			_timeSyncTime;			// millis() of the last sync
+				uint16_t			_timeSyncInterval;		// seconds
+				bool				_fTimeSyncReport;		// offset report received since the last sync
+
+// Broadcasts seen recently, for duplicate suppression
+				RRelaySeen			_relaySeen[RPROTOCOL_RELAY_SEEN_SIZE];
+				uint8_t				_relaySeenNext;
+
+// Outstanding requests
+				RTransaction		_pending[RPROTOCOL_MAX_PENDING];
+				uint8_t				_nextTransactionID;
+
+// Requests batch, flushed as single message or FCODE_COMPOUND frame
+				uint8_t				_batch[RPROTOCOL_MAX_FRAME_SIZE];
+				uint8_t				_batchLen;			// 0 if there is nothing queued
+				uint8_t				_batchCount;		// number of queued requests
+				uint8_t				_batchParam;
+				PTransactionCallback _batchCallback;
 };
 
 // Modbus holding registers area size
@@ -104,6 +104,13 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #define FCODE_SYSEVT_READ					15
 #define FCODE_SYSEVT_REPORT					16
 
+// Compound (multi-command) frames
+#define FCODE_COMPOUND						17
+#define FCODE_COMPOUND_REPORT				18
+
+// Relayed (multi-hop) frames
+#define FCODE_RELAY							19
+
 // Other
 #define FCODE_SCAN							50
 #define FCODE_SCAN_REPLY					51
@@ -111,6 +118,8 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #define FCODE_PING_REPLY					53
 
 #define FCODE_TIME_BROADCAST				55
+#define FCODE_TIME_SYNC						56
+#define FCODE_TIME_SYNC_REPORT				57
 
 // Response 
 #define FCODE_RESPONSE_OK					127
@@ -537,6 +546,10 @@ struct RMESSAGE_RESPONSE_OK
 
 
 // Extended FCode - SCAN
+//
+// SCAN is broadcast, stations reply with SCAN_REPLY sent directly to the scanning station.
+// To avoid collisions of the replies each station delays its reply by a random time within ReplyWindow.
+//
 struct RMESSAGE_SCAN
 {
 //  Header
@@ -544,10 +557,13 @@ struct RMESSAGE_SCAN
 	
 // PDU
 
-// TODO - need to decide if this message should include any "announcement" parameters (e.g. Master name, capabilities etc).
+	uint16_t	ReplyWindow;		// ms, maximum reply delay
 };
 
 // Extended FCode - SCAN_REPLY
+//
+// Also broadcast (unsolicited) by the station when it starts, to announce itself.
+//
 struct RMESSAGE_SCAN_REPLY
 {
 //  Header
@@ -555,7 +571,11 @@ struct RMESSAGE_SCAN_REPLY
 	
 // PDU
 
-// TODO - need to decide if this message should include any "announcement" parameters (e.g. Master name, capabilities etc).
+	uint8_t		StationType;		// the same values as MREGISTER_STATION_TYPE
+	uint8_t		HardwareVersion;
+	uint8_t		FirmwareVersion;
+	uint8_t		NumZones;
+	uint8_t		NumSensors;
 };
 
 
@@ -596,6 +616,109 @@ struct RMESSAGE_TIME_BROADCAST
 	uint32_t	timeNow;
 };
 
+// Time sync
+//
+// Broadcast by the master, replaces FCODE_TIME_BROADCAST. Carries master time with ms resolution, stations estimate their
+// clock offset and drift from it and slew the clock (see TimeSync.h).
+//
+struct RMESSAGE_TIME_SYNC
+{
+//  Header
+	RMESSAGE_HEADER	Header;
+
+// PDU
+
+	uint32_t	timeNow;
+	uint16_t	timeMs;				// ms into the timeNow second
+};
+
+// Time sync report
+//
+// Sent by the station to the master (FromUnitID of the sync) when the offset measured on sync was out of tolerance.
+// The master syncs more often then.
+//
+struct RMESSAGE_TIME_SYNC_REPORT
+{
+//  Header
+	RMESSAGE_HEADER	Header;
+
+// PDU
+
+	int16_t		Offset;				// ms, positive - station clock was ahead
+	int16_t		Drift;				// ppm, estimated drift, positive - station clock is fast
+};
+
+
+//
+//	FCODE_COMPOUND - several requests to the same station packed into one frame
+//
+//  Data area carries NumCommands sub-commands, each one is RCOMPOUND_SUBHEADER followed by the PDU of the regular request
+//  (the same bytes that follow RMESSAGE_HEADER in the standalone message). 
+//  Supported sub-commands: FCODE_ZONES_READ, FCODE_ZONES_SET, FCODE_SENSORS_READ, FCODE_EVTMASTER_SET, FCODE_PING, FCODE_TIME_BROADCAST.
+//
+//  The station executes sub-commands in order, and replies with single FCODE_COMPOUND_REPORT message carrying TransactionID of the request.
+//  Replies to individual sub-commands (reports, OK or error responses) are packed into the report the same way.
+//  If the reply does not fit into one frame, remaining sub-replies are sent as standalone messages.
+//
+//	Note: whole message (including header) should not exceed RPROTOCOL_MAX_FRAME_SIZE
+//
+#define RPROTOCOL_MAX_FRAME_SIZE		60		// RFM69 frame payload, minus one byte of sequence number
+
+struct RCOMPOUND_SUBHEADER
+{
+	uint8_t		Length;				// PDU length (not including sub-header)
+	uint8_t		FCode;				// Function code of the sub-command
+};
+
+struct RMESSAGE_COMPOUND
+{
+//  Header
+	RMESSAGE_HEADER	Header;
+
+// PDU
+	uint8_t		NumCommands;		// number of sub-commands
+	uint8_t		Data[1];			// sub-commands
+};
+
+//
+//	FCODE_COMPOUND_REPORT - replies to FCODE_COMPOUND sub-commands. Uses the same layout as FCODE_COMPOUND.
+//
+struct RMESSAGE_COMPOUND_REPORT
+{
+//  Header
+	RMESSAGE_HEADER	Header;
+
+// PDU
+	uint8_t		NumReplies;			// number of sub-replies
+	uint8_t		Data[1];			// sub-replies
+};
+
+//
+//	FCODE_RELAY - frame carried through relay stations
+//
+//  Data area is the complete original frame, with FromUnitID of the originating station and ToUnitID of the final destination.
+//  Header of the relay frame addresses one hop: FromUnitID is the station that sent it, ToUnitID is the next hop 
+//  (the destination itself or the next relay), or STATIONID_BROADCAST when broadcast is re-broadcast by the relay.
+//
+//  Station sends the frame wrapped when its route to the destination goes through a relay (routes are learned from relayed frames).
+//  Relay station unwraps the frame addressed to it, and wraps it again for the next hop with HopCount incremented.
+//  Broadcasts heard by the relay (plain or relayed) are re-broadcast once, duplicates are suppressed by every station.
+//  Frames that went through RPROTOCOL_MAX_HOPS relays are not forwarded further.
+//
+//	Note: relay header takes sizeof(RMESSAGE_RELAY)-1 bytes, the original frame should not exceed RPROTOCOL_MAX_FRAME_SIZE minus that
+//
+#define RPROTOCOL_MAX_HOPS				3		// max number of relays between two stations
+
+struct RMESSAGE_RELAY
+{
+//  Header
+	RMESSAGE_HEADER	Header;
+
+// PDU
+	uint8_t		HopCount;			// number of relays the frame went through
+	uint8_t		Data[1];			// original frame
+};
+
 
 // Station types
 //
@@ -0,0 +1,302 @@
+/*
+  Local sensors acquisition scheduler for the SmartGarden system.
+
+See SensorAcq.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "SensorAcq.h"
+#include "SensorBus.h"
+#include "sensors.h"
+#include "settings.h"
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+#ifdef SENSOR_ENABLE_DHT
+// For each DHT (AM2301 or similar) sensor we need to have an object
+static DHT dhtSensors[] = {
+	DHT(DHTPIN, DHTTYPE),
+#ifdef SENSOR_CHANNEL_DHT_2_PIN
+	DHT(SENSOR_CHANNEL_DHT_2_PIN, SENSOR_CHANNEL_DHT_2_TYPE),
+#endif
+#ifdef SENSOR_CHANNEL_DHT_3_PIN
+	DHT(SENSOR_CHANNEL_DHT_3_PIN, SENSOR_CHANNEL_DHT_3_TYPE),
+#endif
+};
+
+struct SensorAcqDHTConfig
+{
+	uint8_t		tempChannel;			// logical channels the DHT readings are mapped to
+	uint8_t		humChannel;
+};
+
+static const SensorAcqDHTConfig saDhtConfig[] = {
+	{ SENSOR_CHANNEL_DHT_TEMPERATURE, SENSOR_CHANNEL_DHT_HUMIDITY },
+#ifdef SENSOR_CHANNEL_DHT_2_PIN
+	{ SENSOR_CHANNEL_DHT_2_TEMPERATURE, SENSOR_CHANNEL_DHT_2_HUMIDITY },
+#endif
+#ifdef SENSOR_CHANNEL_DHT_3_PIN
+	{ SENSOR_CHANNEL_DHT_3_TEMPERATURE, SENSOR_CHANNEL_DHT_3_HUMIDITY },
+#endif
+};
+
+#define SA_NUM_DHT		(sizeof(saDhtConfig)/sizeof(saDhtConfig[0]))
+
+static const char saDhtName1[] PROGMEM = "DHT 1";
+static const char saDhtName2[] PROGMEM = "DHT 2";
+static const char saDhtName3[] PROGMEM = "DHT 3";
+static const char * const saDhtNames[SENSORACQ_MAX_DHT] = { saDhtName1, saDhtName2, saDhtName3 };
+#endif //SENSOR_ENABLE_DHT
+
+#ifdef SENSOR_ENABLE_BMP180
+// For BMP180 sensor we need SFE_BMP180 object, here called "bmp180":
+SFE_BMP180 bmp180;
+#endif
+
+SensorAcq sensorAcq;
+
+
+SensorAcq::SensorAcq()
+{
+	m_pending = 0;
+
+#ifdef SENSOR_ENABLE_BMP180
+	m_bmpDev = SENSORBUS_NO_DEVICE;
+	m_bmpState = SENSORACQ_STATE_IDLE;
+	m_bmpWait = 0;
+	m_bmpStart = 0;
+	m_bmpT = 0;
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+	for( uint8_t n=0; n<SENSORACQ_MAX_DHT; n++ )
+		m_dhtDev[n] = SENSORBUS_NO_DEVICE;
+	m_dhtStart = 0;
+	m_dhtState = SENSORACQ_STATE_IDLE;
+	m_dhtRestarts = 0;
+#endif //SENSOR_ENABLE_DHT
+}
+
+// Initialize sensors (it is important to get calibration values stored on the device).
+void SensorAcq::begin(void)
+{
+#ifdef SENSOR_ENABLE_BMP180
+	if( !bmp180.begin() )
+		TRACE_ERROR(F("BMP180 sensor init failure.\n"));
+	m_bmpDev = sensorBus.Register(PSTR("BMP180"), SENSORBUS_I2C);
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+	for( uint8_t n=0; n<SA_NUM_DHT; n++ )
+	{
+		dhtSensors[n].begin();
+		m_dhtDev[n] = sensorBus.Register(saDhtNames[n], SENSORBUS_ONEWIRE);
+	}
+#endif //SENSOR_ENABLE_DHT
+}
+
+//
+// Start acquisition of all local sensors that need conversion time. BMP180 is started by loop() once it gets the bus.
+//
+// Returns true if at least one acquisition is in progress, LocalReadingsDone() will be called when all are done.
+//
+bool SensorAcq::Start(void)
+{
+	if( m_pending != 0 )
+	{
+		TRACE_ERROR(F("SensorAcq - previous acquisition is still running\n"));
+		return true;
+	}
+
+#ifdef SENSOR_ENABLE_BMP180
+	m_bmpWait = 0;
+	m_bmpStart = millis();
+	m_bmpState = SENSORACQ_STATE_START;
+	m_pending |= SENSORACQ_BMP180;
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+	for( uint8_t n=0; n<SA_NUM_DHT; n++ )
+		m_pending |= SENSORACQ_DHT(n);
+	if( SA_NUM_DHT > 0 )
+		StartDHT(0);							// the next DHT is started when this one is done
+#endif //SENSOR_ENABLE_DHT
+
+	return m_pending != 0;
+}
+
+void SensorAcq::loop(void)
+{
+	if( m_pending == 0 )
+		return;
+
+#ifdef SENSOR_ENABLE_BMP180
+	if( (m_pending & SENSORACQ_BMP180) && PollBMP180() )
+	{
+		m_bmpState = SENSORACQ_STATE_IDLE;
+		m_pending &= ~SENSORACQ_BMP180;
+	}
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+	for( uint8_t n=0; n<SA_NUM_DHT; n++ )
+	{
+		if( !(m_pending & SENSORACQ_DHT(n)) )
+			continue;
+
+		if( PollDHT(n) )
+		{
+			m_dhtState = SENSORACQ_STATE_IDLE;
+			m_pending &= ~SENSORACQ_DHT(n);
+			if( uint8_t(n+1) < SA_NUM_DHT )
+				StartDHT(n+1);
+		}
+		break;									// DHTs are read one at a time
+	}
+#endif //SENSOR_ENABLE_DHT
+
+	if( m_pending == 0 )
+		sensorsModule.LocalReadingsDone();
+}
+
+#ifdef SENSOR_ENABLE_BMP180
+
+//
+// BMP180 - temperature conversion, then pressure conversion (pressure calculation needs the temperature).
+// Each step that talks to the sensor is one bus transaction.
+//
+bool SensorAcq::PollBMP180(void)
+{
+	double		P;
+
+	if( (millis() - m_bmpStart) < m_bmpWait )
+		return false;						// conversion is still running
+
+	if( !sensorBus.Acquire(m_bmpDev) )
+		return false;						// bus is taken on this pass
+
+	if( m_bmpState == SENSORACQ_STATE_START )
+	{
+		m_bmpWait = bmp180.startTemperature();		// returns ms to wait, or 0 on failure
+		sensorBus.Release(m_bmpDev);
+		if( m_bmpWait == 0 )
+		{
+			TRACE_ERROR(F("Failure reading pressure from BMP180.\n"));
+			return true;
+		}
+
+		m_bmpStart = millis();
+		m_bmpState = SENSORACQ_STATE_CONVERT1;
+		return false;
+	}
+
+	if( m_bmpState == SENSORACQ_STATE_CONVERT1 )
+	{
+		if( bmp180.getTemperature(m_bmpT) == 0 )
+		{
+			sensorBus.Release(m_bmpDev);
+			TRACE_ERROR(F("Failure reading pressure from BMP180.\n"));
+			return true;
+		}
+
+		m_bmpWait = bmp180.startPressure(1);	// accuracy 1 which should be relatively fast.
+		sensorBus.Release(m_bmpDev);
+		if( m_bmpWait == 0 )
+		{
+			TRACE_ERROR(F("Failure reading pressure from BMP180.\n"));
+			return true;
+		}
+
+		m_bmpStart = millis();
+		m_bmpState = SENSORACQ_STATE_CONVERT2;
+		return false;
+	}
+
+	if( bmp180.getPressure(P, m_bmpT) == 0 )
+	{
+		sensorBus.Release(m_bmpDev);
+		TRACE_ERROR(F("Failure reading pressure from BMP180.\n"));
+		return true;
+	}
+	sensorBus.Release(m_bmpDev);
+
+	// Sensor reads temp in C, but we want to report temperature in F. Note 0.5 correction for rounding.
+	sensorsModule.ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_BMP180_TEMPERATURE, int((9.0/5.0)*m_bmpT+32.5) );
+	sensorsModule.ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_BMP180_PRESSURE, int(P + 0.5) );
+	return true;
+}
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+
+void SensorAcq::StartDHT(uint8_t n)
+{
+	dhtSensors[n].startRead();					// line is held low, sensor responds once it is released
+	m_dhtStart = millis();
+	m_dhtState = SENSORACQ_STATE_CONVERT1;
+	m_dhtRestarts = 0;
+}
+
+//
+// DHT - read the response once the start signal was long enough. Response is read with interrupts off, one DHT per pass.
+//
+// The start signal is ended only by the pass that reads the response, so a late pass (long web request, SD write) holds
+// the line low for too long - AM2302 does not respond to a start signal longer than ~20ms. If the pass comes after
+// startLowMax() the line is released without reading, and the read is started over SENSORACQ_DHT_RESTART_WAIT later.
+//
+bool SensorAcq::PollDHT(uint8_t n)
+{
+	DHT			*pDht = &dhtSensors[n];
+	uint32_t	elapsed = millis() - m_dhtStart;
+
+	if( m_dhtState == SENSORACQ_STATE_RESTART )
+	{
+		if( elapsed < SENSORACQ_DHT_RESTART_WAIT )
+			return false;
+
+		pDht->startRead();
+		m_dhtStart = millis();
+		m_dhtState = SENSORACQ_STATE_CONVERT1;
+		return false;
+	}
+
+	if( elapsed < pDht->startLowMin() )
+		return false;						// start signal is not long enough yet
+
+	if( elapsed > pDht->startLowMax() )
+	{
+		pDht->cancelRead();
+		if( ++m_dhtRestarts > SENSORACQ_DHT_MAX_RESTARTS )
+		{
+			TRACE_ERROR(F("Failure reading temperature or humidity from DHT %u - start signal too long.\n"), uint16_t(n)+1);
+			return true;
+		}
+
+		TRACE_INFO(F("DHT %u start signal held %lums, restarting\n"), uint16_t(n)+1, elapsed);
+		m_dhtStart = millis();
+		m_dhtState = SENSORACQ_STATE_RESTART;
+		return false;
+	}
+
+	if( !sensorBus.Acquire(m_dhtDev[n]) )
+		return false;						// bus is taken on this pass
+
+	bool	fOk = dhtSensors[n].finishRead();
+
+	sensorBus.Release(m_dhtDev[n]);
+	if( !fOk )
+	{
+		TRACE_ERROR(F("Failure reading temperature or humidity from DHT %u.\n"), uint16_t(n)+1);
+		return true;
+	}
+
+	sensorsModule.ReportSensorReading( GetMyStationID(), saDhtConfig[n].tempChannel, int(dhtSensors[n].temperature(true) + 0.5) );	// convert to int with rounding
+	sensorsModule.ReportSensorReading( GetMyStationID(), saDhtConfig[n].humChannel, int(dhtSensors[n].humidity() + 0.5) );
+	return true;
+}
+#endif //SENSOR_ENABLE_DHT
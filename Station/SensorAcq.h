@@ -0,0 +1,96 @@
+/*
+  Local sensors acquisition scheduler for the SmartGarden system.
+
+  Some local sensors need time between starting a measurement and reading the result - BMP180 needs a few ms for each
+  of its temperature and pressure conversions, DHT needs the start signal (line held low) for DHT_START_LOW ms.
+  Instead of waiting with delay() the drivers are run as state machines: Start() kicks off the measurements and returns,
+  loop() is called on every main loop pass and collects each result once its conversion time has elapsed.
+
+  Readings are reported to sensorsModule as they arrive. When all drivers are done sensorsModule.LocalReadingsDone()
+  is called (remote station pushes its readings to the master then).
+
+  Note: DHT response (40 bits) is still read with interrupts off - bit timing is measured by the CPU. This takes ~5ms,
+  while the 250ms + 20ms waits of the blocking DHT read are gone.
+
+  Up to SENSORACQ_MAX_DHT DHT sensors are supported, each on its own pin. The first one is configured by DHTPIN/DHTTYPE and
+  SENSOR_CHANNEL_DHT_TEMPERATURE/HUMIDITY, the others by SENSOR_CHANNEL_DHT_n_PIN/TYPE/TEMPERATURE/HUMIDITY (n is 2 or 3).
+  DHTs are read one at a time - the start signal of the next DHT begins when the previous one is done, so each line is held
+  low only for its own start signal. The signal is ended by the main loop pass that reads the response; if that pass comes
+  later than the sensor allows (DHT::startLowMax(), ~20ms for AM2302) the line is released and the read is started over.
+
+  Each bus access (BMP180 register access, DHT response read) goes through the bus scheduler (see SensorBus.h), which
+  shares the I2C bus with the LCD and spreads DHT reads over main loop passes.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _SENSORACQ_h
+#define _SENSORACQ_h
+
+#include <inttypes.h>
+#include "Defines.h"
+
+#ifdef SENSOR_ENABLE_BMP180
+#include <SFE_BMP180.h>
+#include <Wire.h>
+#endif
+
+#ifdef SENSOR_ENABLE_DHT
+#include <DHT.h>
+#endif
+
+#define SENSORACQ_MAX_DHT			3
+#define SENSORACQ_DHT_RESTART_WAIT	2000	// ms, sensor may have responded to a late released start signal, it needs 2s between reads
+#define SENSORACQ_DHT_MAX_RESTARTS	2		// start signal restarts before the reading fails
+
+// drivers with acquisition in progress (m_pending bits)
+#define SENSORACQ_BMP180			0x01
+#define SENSORACQ_DHT(n)			(0x02 << (n))		// n is 0-based DHT index
+
+// driver states
+#define SENSORACQ_STATE_IDLE		0
+#define SENSORACQ_STATE_START		1		// waiting for the bus to start the first conversion (BMP180)
+#define SENSORACQ_STATE_CONVERT1	2		// first conversion is running (BMP180 temperature, DHT start signal)
+#define SENSORACQ_STATE_CONVERT2	3		// second conversion is running (BMP180 pressure)
+#define SENSORACQ_STATE_RESTART		4		// start signal was released late, waiting to start over (DHT)
+
+class SensorAcq
+{
+public:
+				SensorAcq();
+
+	void		begin(void);
+	bool		Start(void);						// start acquisition of local sensors, returns immediately. Returns false if nothing to acquire
+	void		loop(void);							// collect results, should be called on every main loop pass
+	bool		IsBusy(void)	{ return m_pending != 0; };
+
+private:
+#ifdef SENSOR_ENABLE_BMP180
+	bool		PollBMP180(void);					// returns true when the driver is done (reading reported or failed)
+
+	uint8_t		m_bmpDev;				// bus scheduler device handle
+	uint8_t		m_bmpState;
+	uint8_t		m_bmpWait;				// ms, conversion time returned by the sensor
+	uint32_t	m_bmpStart;				// millis() when the conversion was started
+	double		m_bmpT;					// temperature in C, pressure calculation needs it
+#endif //SENSOR_ENABLE_BMP180
+
+#ifdef SENSOR_ENABLE_DHT
+	void		StartDHT(uint8_t n);
+	bool		PollDHT(uint8_t n);
+
+	uint8_t		m_dhtDev[SENSORACQ_MAX_DHT];	// bus scheduler device handles
+	uint8_t		m_dhtState;				// state of the DHT being read
+	uint8_t		m_dhtRestarts;			// start signal restarts of the DHT being read
+	uint32_t	m_dhtStart;				// millis() when the start signal began, or when it was released late
+#endif //SENSOR_ENABLE_DHT
+
+	uint8_t		m_pending;				// SENSORACQ_* bits of drivers still acquiring
+};
+
+extern SensorAcq sensorAcq;
+
+#endif //_SENSORACQ_h
@@ -0,0 +1,191 @@
+/*
+  Shared sensor bus scheduler for the SmartGarden system.
+
+See SensorBus.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "SensorBus.h"
+#include <string.h>
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+SensorBusClass sensorBus;
+
+struct SensorBusDevice
+{
+	const char		*pName;				// PROGMEM
+	uint8_t			bus;
+	SensorBusStats	stats;
+};
+
+// Devices register from begin() of their modules, possibly before the constructor of sensorBus ran - state is statically
+// initialized and the constructor does not touch it.
+static SensorBusDevice	sbDevices[SENSORBUS_MAX_DEVICES];
+static uint8_t			sbNumDevices = 0;
+
+static uint8_t			sbOwner[SENSORBUS_NUM_BUSES] = { SENSORBUS_NO_DEVICE, SENSORBUS_NO_DEVICE };		// device in the middle of a transaction
+static uint8_t			sbReserved[SENSORBUS_NUM_BUSES] = { SENSORBUS_NO_DEVICE, SENSORBUS_NO_DEVICE };	// waiting device that goes next
+static uint8_t			sbUsed = 0;				// bit per bus, the bus carried a transaction on this pass
+static uint8_t			sbRequested = 0;		// bit per device, Acquire() was called on this pass
+static uint8_t			sbWaiting = 0;			// bit per device, denied and not served yet
+static uint32_t			sbStart;				// micros() when the current transaction started (one at a time - passes are sequential)
+static uint32_t			sbLastReport = 0;
+
+SensorBusClass::SensorBusClass()
+{
+}
+
+// Next waiting device on the bus after the given one (round robin), or SENSORBUS_NO_DEVICE
+static uint8_t sbNextWaiting(uint8_t bus, uint8_t after)
+{
+	for( uint8_t i=1; i<=sbNumDevices; i++ )
+	{
+		uint8_t		dev = (after + i) % sbNumDevices;
+
+		if( (sbWaiting & (1 << dev)) && (sbDevices[dev].bus == bus) )
+			return dev;
+	}
+	return SENSORBUS_NO_DEVICE;
+}
+
+uint8_t SensorBusClass::Register(const char *pName, uint8_t bus)
+{
+	if( (sbNumDevices >= SENSORBUS_MAX_DEVICES) || (bus >= SENSORBUS_NUM_BUSES) )
+	{
+		TRACE_ERROR(F("SensorBus - cannot register device on bus %u\n"), uint16_t(bus));
+		return SENSORBUS_NO_DEVICE;
+	}
+
+	SensorBusDevice	*pDev = &sbDevices[sbNumDevices];
+
+	memset(pDev, 0, sizeof(SensorBusDevice));
+	pDev->pName = pName;
+	pDev->bus = bus;
+
+	return sbNumDevices++;
+}
+
+//
+// New main loop pass - buses are free again. Devices that stopped asking for the bus are not waiting any more.
+//
+void SensorBusClass::loop(void)
+{
+	sbWaiting &= sbRequested;
+	for( uint8_t bus=0; bus<SENSORBUS_NUM_BUSES; bus++ )
+	{
+		uint8_t		dev = sbReserved[bus];
+
+		if( (dev != SENSORBUS_NO_DEVICE) && !(sbWaiting & (1 << dev)) )
+			sbReserved[bus] = sbNextWaiting(bus, dev);
+	}
+	sbUsed = 0;
+	sbRequested = 0;
+
+	if( (millis() - sbLastReport) >= SENSORBUS_REPORT_INTERVAL )
+	{
+		sbLastReport = millis();
+		for( uint8_t i=0; i<sbNumDevices; i++ )
+		{
+			SensorBusStats	*pStats = &sbDevices[i].stats;
+
+			TRACE_INFO(F("SensorBus - %S: %u transactions, %lums bus time, max %uus, %u deferred\n"), sbDevices[i].pName,
+						pStats->numTransactions, pStats->busTime/1000ul, pStats->maxTime, pStats->numDeferred);
+		}
+	}
+}
+
+bool SensorBusClass::Acquire(uint8_t dev)
+{
+	if( dev >= sbNumDevices )
+		return true;					// device is not registered (table is full), let it run unscheduled
+
+	SensorBusDevice	*pDev = &sbDevices[dev];
+	uint8_t			bus = pDev->bus;
+
+	sbRequested |= (1 << dev);
+
+	if( (sbUsed & (1 << bus)) || (sbOwner[bus] != SENSORBUS_NO_DEVICE) ||
+		((sbReserved[bus] != SENSORBUS_NO_DEVICE) && (sbReserved[bus] != dev)) )
+	{
+		sbWaiting |= (1 << dev);
+		if( sbReserved[bus] == SENSORBUS_NO_DEVICE )
+			sbReserved[bus] = dev;
+		if( pDev->stats.numDeferred != 0xFFFF )
+			pDev->stats.numDeferred++;
+		return false;
+	}
+
+	sbOwner[bus] = dev;
+	sbWaiting &= ~(1 << dev);
+	if( sbReserved[bus] == dev )
+		sbReserved[bus] = sbNextWaiting(bus, dev);		// devices that were denied meanwhile take turns
+	sbStart = micros();
+	return true;
+}
+
+void SensorBusClass::Release(uint8_t dev)
+{
+	if( dev >= sbNumDevices )
+		return;
+
+	SensorBusDevice	*pDev = &sbDevices[dev];
+	uint32_t		t = micros() - sbStart;
+
+	if( sbOwner[pDev->bus] != dev )
+		return;							// Release() without Acquire()
+
+	sbOwner[pDev->bus] = SENSORBUS_NO_DEVICE;
+	sbUsed |= (1 << pDev->bus);
+
+	if( pDev->stats.numTransactions == 0xFFFF )		// keep the average meaningful on overflow
+	{
+		pDev->stats.numTransactions >>= 1;
+		pDev->stats.busTime >>= 1;
+	}
+	pDev->stats.numTransactions++;
+	pDev->stats.busTime += t;
+	if( t > pDev->stats.maxTime )
+		pDev->stats.maxTime = (t > 0xFFFFul) ? 0xFFFF : uint16_t(t);
+}
+
+uint8_t SensorBusClass::GetNumDevices(void)
+{
+	return sbNumDevices;
+}
+
+bool SensorBusClass::GetStats(uint8_t dev, SensorBusStats *pStats)
+{
+	if( dev >= sbNumDevices )
+		return false;
+
+	memcpy(pStats, &sbDevices[dev].stats, sizeof(SensorBusStats));
+	return true;
+}
+
+const char *SensorBusClass::GetName(uint8_t dev)
+{
+	if( dev >= sbNumDevices )
+		return PSTR("");
+
+	return sbDevices[dev].pName;
+}
+
+uint8_t SensorBusClass::GetBus(uint8_t dev)
+{
+	if( dev >= sbNumDevices )
+		return SENSORBUS_NUM_BUSES;
+
+	return sbDevices[dev].bus;
+}
@@ -0,0 +1,69 @@
+/*
+  Shared sensor bus scheduler for the SmartGarden system.
+
+  Several drivers share the same physical resources: BMP180 and the I2C LCD (ST7036) are on the same I2C bus, and DHT sensors
+  (even when connected to different pins) are read bit-banged with interrupts off, so they share the CPU while their response
+  is read. Each driver registers its devices with the scheduler, and wraps each bus transaction (BMP180 register access,
+  DHT response read, LCD screen update) into Acquire()/Release().
+
+  The scheduler grants each bus to one transaction per main loop pass. A device that is denied retries on the next pass, and
+  the bus is reserved for the waiting devices in round robin order, so devices on a busy bus take turns instead of one of them
+  starving the others. This bounds the time a single main loop pass spends on each bus to one transaction, e.g. several DHT reads
+  (~5ms each with interrupts off) are spread over several passes instead of stacking up.
+
+  Note: transfers themselves are still done synchronously by the Wire and DHT libraries - the scheduler interleaves whole
+  transactions, not bytes.
+
+  Bus time (time between Acquire() and Release()) is accumulated per device, together with the number of transactions, the
+  longest transaction and the number of deferrals. Statistics are traced every SENSORBUS_REPORT_INTERVAL.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _SENSORBUS_h
+#define _SENSORBUS_h
+
+#include <inttypes.h>
+#include "Defines.h"
+
+// Buses
+#define SENSORBUS_I2C				0		// Wire - BMP180, I2C LCD
+#define SENSORBUS_ONEWIRE			1		// bit-banged single-wire sensors (DHT), read with interrupts off
+#define SENSORBUS_NUM_BUSES			2
+
+#define SENSORBUS_MAX_DEVICES		6
+#define SENSORBUS_NO_DEVICE			0xFF
+
+#define SENSORBUS_REPORT_INTERVAL	600000ul	// ms, bus time statistics trace interval
+
+struct SensorBusStats
+{
+	uint32_t	busTime;				// us, total time the device held its bus
+	uint16_t	numTransactions;
+	uint16_t	maxTime;				// us, longest transaction
+	uint16_t	numDeferred;			// Acquire() requests denied because the bus was taken or reserved
+};
+
+class SensorBusClass
+{
+public:
+				SensorBusClass();
+
+	uint8_t		Register(const char *pName, uint8_t bus);	// pName is in PROGMEM. Returns device handle, or SENSORBUS_NO_DEVICE
+	void		loop(void);									// start of the main loop pass, should be called on every pass
+
+	bool		Acquire(uint8_t dev);						// returns true if the device may use its bus now, false - retry on the next pass
+	void		Release(uint8_t dev);						// transaction is done
+
+	uint8_t		GetNumDevices(void);
+	bool		GetStats(uint8_t dev, SensorBusStats *pStats);
+	const char	*GetName(uint8_t dev);						// PROGMEM string
+	uint8_t		GetBus(uint8_t dev);
+};
+
+extern SensorBusClass sensorBus;
+
+#endif //_SENSORBUS_h
@@ -0,0 +1,149 @@
+/*
+  Sensor readings validation for the SmartGarden system.
+
+See SensorCheck.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "SensorCheck.h"
+#include "Defines.h"
+#include <string.h>
+#include <stdlib.h>
+
+struct SensorLimits
+{
+	int32_t		minVal;
+	int32_t		maxVal;
+	int16_t		slew;				// max change per minute, 0 - the type steps (counters, rates), range check only
+};
+
+// Indexed by SENSOR_TYPE_*
+static const SensorLimits sensorLimits[] PROGMEM = {
+	{ -2147483647L,	2147483647L,	0 },		// SENSOR_TYPE_NONE
+	{ -60,		160,	2 },		// SENSOR_TYPE_TEMPERATURE, F
+	{ 300,		1100,	1 },		// SENSOR_TYPE_PRESSURE, mbar
+	{ 0,		100,	5 },		// SENSOR_TYPE_HUMIDITY, %
+	{ 0,		65535,	0 },		// SENSOR_TYPE_WATERFLOW, 16 bit counter
+	{ -2147483647L,	2147483647L,	0 },		// SENSOR_TYPE_VOLTAGE
+	{ 0,		65535,	0 },		// SENSOR_TYPE_FLOWRATE, 1/10 liter per minute
+};
+
+#define SC_NUM_TYPES		(sizeof(sensorLimits)/sizeof(sensorLimits[0]))
+
+void SensorCheckReset(SensorCheckState *pState)
+{
+	memset(pState, 0, sizeof(SensorCheckState));
+}
+
+// Median of a small array, the array is sorted in place
+static int16_t scMedian(int16_t *p, uint8_t n)
+{
+	for( uint8_t i=1; i<n; i++ )		// insertion sort, n is at most SENSORCHECK_WINDOW
+	{
+		int16_t		v = p[i];
+		int8_t		j = i - 1;
+
+		while( (j >= 0) && (p[j] > v) )
+		{
+			p[j+1] = p[j];
+			j--;
+		}
+		p[j+1] = v;
+	}
+
+	if( n & 1 )
+		return p[n/2];
+	return int16_t((int32_t(p[n/2-1]) + p[n/2]) / 2);
+}
+
+//
+// Check the reading, see SensorCheck.h.
+//
+//	Input:	lastAccepted, fHaveLast	- last accepted reading of the sensor, if there is one
+//			elapsedMs				- time since the last accepted reading
+//			deadband				- reporting deadband of the sensor type, used as the floor of the slew and Hampel thresholds
+//
+// Returns SENSORCHECK_OK if the reading should be accepted, or the reason of rejection.
+//
+uint8_t SensorCheck(SensorCheckState *pState, uint8_t sensorType, int32_t reading, int32_t lastAccepted, bool fHaveLast, uint32_t elapsedMs, int32_t deadband)
+{
+	SensorLimits	limits;
+	uint8_t			result = SENSORCHECK_OK;
+
+	if( sensorType >= SC_NUM_TYPES )
+		sensorType = SENSOR_TYPE_NONE;
+	memcpy_P(&limits, &sensorLimits[sensorType], sizeof(SensorLimits));
+
+	if( pState->numSamples == 0xFFFF )
+	{
+		pState->numSamples >>= 1;
+		pState->numRejected >>= 1;
+	}
+	pState->numSamples++;
+
+	if( (reading < limits.minVal) || (reading > limits.maxVal) )
+	{
+		pState->numRejected++;
+		return SENSORCHECK_RANGE;			// impossible value, it does not enter the window
+	}
+
+	if( limits.slew == 0 )
+		return SENSORCHECK_OK;
+
+	if( fHaveLast )
+	{
+		int32_t		allowed = int32_t(limits.slew) * int32_t((elapsedMs + 59999ul) / 60000ul) + deadband;
+
+		if( labs(reading - lastAccepted) > allowed )
+			result = SENSORCHECK_SLEW;
+	}
+
+	if( (result == SENSORCHECK_OK) && (pState->count >= 3) )
+	{
+		int16_t		sorted[SENSORCHECK_WINDOW];
+		int16_t		med, mad;
+		int32_t		threshold;
+
+		memcpy(sorted, pState->window, pState->count*sizeof(int16_t));
+		med = scMedian(sorted, pState->count);
+
+		for( uint8_t i=0; i<pState->count; i++ )
+			sorted[i] = int16_t(abs(pState->window[i] - med));
+		mad = scMedian(sorted, pState->count);
+
+		threshold = (int32_t(mad) * 1483L * SENSORCHECK_HAMPEL_K) / 1000L;		// 1.4826*MAD estimates the standard deviation
+		if( threshold < deadband*2 )
+			threshold = deadband*2;
+
+		if( labs(reading - med) > threshold )
+			result = SENSORCHECK_OUTLIER;
+	}
+
+	pState->window[pState->head] = int16_t(reading);
+	pState->head = (pState->head + 1) % SENSORCHECK_WINDOW;
+	if( pState->count < SENSORCHECK_WINDOW )
+		pState->count++;
+
+	if( result != SENSORCHECK_OK )
+		pState->numRejected++;
+
+	return result;
+}
+
+uint16_t SensorCheckBadRate(SensorCheckState *pState)
+{
+	if( pState->numSamples == 0 )
+		return 0;
+
+	return uint16_t((uint32_t(pState->numRejected) * 1000ul) / pState->numSamples);
+}
@@ -0,0 +1,52 @@
+/*
+  Sensor readings validation for the SmartGarden system.
+
+  Each reading goes through three checks before it is stored and logged:
+
+	1. Range - the reading must be within the physical range of the sensor type (e.g. 300..1100 mbar for pressure), this catches
+	   BMP180 zero readings and DHT checksum glitches that slip through.
+	2. Slew - the change since the last accepted reading must not exceed the max rate of change of the sensor type multiplied by
+	   the time between the readings (plus one deadband).
+	3. Hampel filter - the reading is compared with the median of the last SENSORCHECK_WINDOW readings, and is rejected if it is
+	   further from it than SENSORCHECK_HAMPEL_K scaled MADs (median absolute deviation), or two deadbands if MAD is smaller.
+
+  Readings rejected by the slew and Hampel checks still enter the Hampel window, so a real step change is accepted once it
+  persists for more than half of the window, while single spikes are dropped. Counters and flow rates legitimately step,
+  they get the range check only.
+
+  Range and slew limits are defined per sensor type (there is no room for them in the FullSensor EEPROM record).
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _SENSORCHECK_h
+#define _SENSORCHECK_h
+
+#include <inttypes.h>
+
+#define SENSORCHECK_WINDOW			5		// readings in the Hampel window
+#define SENSORCHECK_HAMPEL_K		3		// threshold, in scaled MADs
+
+// Check results
+#define SENSORCHECK_OK				0
+#define SENSORCHECK_RANGE			1		// outside of the sensor type range
+#define SENSORCHECK_SLEW			2		// changed faster than the sensor type can
+#define SENSORCHECK_OUTLIER			3		// rejected by the Hampel filter
+
+struct SensorCheckState
+{
+	int16_t		window[SENSORCHECK_WINDOW];	// recent readings, ring
+	uint8_t		head;
+	uint8_t		count;
+	uint16_t	numSamples;					// readings checked, halved together with numRejected on overflow
+	uint16_t	numRejected;
+};
+
+void		SensorCheckReset(SensorCheckState *pState);
+uint8_t		SensorCheck(SensorCheckState *pState, uint8_t sensorType, int32_t reading, int32_t lastAccepted, bool fHaveLast, uint32_t elapsedMs, int32_t deadband);
+uint16_t	SensorCheckBadRate(SensorCheckState *pState);		// rejected readings per 1000
+
+#endif //_SENSORCHECK_h
@@ -0,0 +1,218 @@
+/*
+  RAM-resident mirror of the hot EEPROM settings for the SmartGarden system.
+
+  See SettingsCache.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "SettingsCache.h"
+#include "eepromMap.h"
+#include <avr/eeprom.h>
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+
+SettingsCacheClass::SettingsCacheClass() : fValid(false), dirtyStations(0), dirtySensors(0)
+{
+	memset(dirtyZones, 0, sizeof(dirtyZones));
+}
+
+void SettingsCacheClass::load(void)
+{
+	numZones = EEPROM.read(ADDR_NUM_ZONES);
+	numSensors = EEPROM.read(ADDR_NUM_SENSORS);
+	numSchedules = EEPROM.read(ADDR_SCHEDULE_COUNT);
+	myStationID = EEPROM.read(ADDR_MY_STATION_ID);
+	evtMasterStationID = EEPROM.read(ADDR_EVTMASTER_STATIONID);
+	eeprom_read_block(&evtMasterFlags, (const void *)ADDR_EVTMASTER_FLAGS, sizeof(evtMasterFlags));
+
+	for( uint8_t i=0; i<MAX_STATIONS; i++ )
+		eeprom_read_block(&stations[i], (const void *)(STATION_OFFSET + STATION_INDEX * i), sizeof(ShortStation));
+
+	for( uint8_t i=0; i<MAX_ZONES; i++ )
+		eeprom_read_block(&zones[i], (const void *)(ZONE_OFFSET + ZONE_INDEX * i), sizeof(ShortZone));
+
+	for( uint8_t i=0; i<MAX_SENSORS; i++ )
+		eeprom_read_block(&sensors[i], (const void *)(SENSOR_OFFSET + SENSOR_INDEX * i), sizeof(ShortSensor));
+
+	{
+		Schedule	sched;		// Note: Schedule is fairly large, keep its scope limited
+
+		for( uint8_t i=0; i<MAX_SCHEDULES; i++ )
+		{
+			eeprom_read_block(&sched, (const void *)(SCHEDULE_OFFSET + SCHEDULE_INDEX * i), sizeof(Schedule));
+			sched.GetShortSchedule(&schedules[i]);
+		}
+	}
+
+	dirtyStations = dirtySensors = 0;
+	memset(dirtyZones, 0, sizeof(dirtyZones));
+}
+
+//
+// Load cache from EEPROM and check configuration. Intended to be called from setup(), after EEPROM is known to be valid.
+//
+// Returns true if the cache was loaded and configuration is consistent, false otherwise.
+// Note: cache is used even if the check fails, configuration errors are reported to let the user rebuild it with ResetEEPROM.
+//
+bool SettingsCacheClass::begin(void)
+{
+	load();
+	fValid = true;
+
+	if( !CheckConsistency() )
+	{
+		SYSEVT_ERROR(F("Settings cache - configuration check failed"));
+		return false;
+	}
+
+	TRACE_INFO(F("Settings cache loaded, %u bytes\n"), uint16_t(sizeof(stations)+sizeof(zones)+sizeof(sensors)+sizeof(schedules)));
+	return true;
+}
+
+//
+// Write one record and read it back.
+//
+// Returns true if EEPROM now holds the record.
+//
+static bool WriteRecord(const void *pRecord, uint16_t addr, uint8_t size)
+{
+	uint8_t		buf[max(sizeof(ShortStation), max(sizeof(ShortZone), sizeof(ShortSensor)))];
+
+	eeprom_update_block(pRecord, (void *)addr, size);
+	eeprom_read_block(buf, (const void *)addr, size);
+
+	if( memcmp(buf, pRecord, size) != 0 )
+	{
+		SYSEVT_ERROR(F("Settings cache - EEPROM write failed at 0x%X"), addr);
+		return false;
+	}
+
+	return true;
+}
+
+//
+// Write back all dirty records.
+//
+// eeprom_update_block() reads each byte first and writes only bytes that differ, so repeated saves of the same data
+// don't wear EEPROM. Every record written is read back and compared with the cached copy, records that did not make it
+// into EEPROM stay dirty and are retried on the next flush.
+//
+void SettingsCacheClass::flush(void)
+{
+	if( !fValid )
+		return;
+
+	if( dirtyStations )
+	{
+		for( uint8_t i=0; i<MAX_STATIONS; i++ )
+		{
+			if( (dirtyStations & (1 << i)) && WriteRecord(&stations[i], STATION_OFFSET + STATION_INDEX * i, sizeof(ShortStation)) )
+				dirtyStations &= ~(1 << i);
+		}
+	}
+
+	if( dirtySensors )
+	{
+		for( uint8_t i=0; i<MAX_SENSORS; i++ )
+		{
+			if( (dirtySensors & (1 << i)) && WriteRecord(&sensors[i], SENSOR_OFFSET + SENSOR_INDEX * i, sizeof(ShortSensor)) )
+				dirtySensors &= ~(1 << i);
+		}
+	}
+
+	for( uint8_t n=0; n<sizeof(dirtyZones); n++ )
+	{
+		if( dirtyZones[n] == 0 )
+			continue;
+
+		for( uint8_t b=0; b<8; b++ )
+		{
+			if( (dirtyZones[n] & (1 << b)) && WriteRecord(&zones[n*8+b], ZONE_OFFSET + ZONE_INDEX * (n*8+b), sizeof(ShortZone)) )
+				dirtyZones[n] &= ~(1 << b);
+		}
+	}
+}
+
+//
+// Switch settings back to direct EEPROM access.
+//
+// Used before bulk EEPROM rebuild (ResetEEPROM). Cache is flushed first, so no pending changes are lost.
+//
+void SettingsCacheClass::invalidate(void)
+{
+	flush();
+	fValid = false;
+}
+
+//
+// Schedules are saved directly into EEPROM (these are large and modified rarely), we just refresh compact copy here.
+//
+void SettingsCacheClass::UpdateSchedule(uint8_t num, const Schedule *pSched)
+{
+	if( !fValid || (num >= MAX_SCHEDULES) )
+		return;
+
+	pSched->GetShortSchedule(&schedules[num]);
+}
+
+//
+// Consistency check.
+//
+// Checks counters and basic relationships between stations, zones and sensors. Cache is not compared with EEPROM here -
+// right after load() it is a copy of the same bytes, written records are verified by flush() instead.
+// Configuration errors are reported, but we don't try to fix it here - ResetEEPROM is the way to rebuild configuration.
+//
+// Returns true if everything is consistent.
+//
+bool SettingsCacheClass::CheckConsistency(void)
+{
+	bool		fRet = true;
+
+	if( !fValid )
+		return true;			// nothing to check
+
+	if( (numZones > MAX_ZONES) || (numSensors > MAX_SENSORS) || (numSchedules > MAX_SCHEDULES) || (myStationID >= MAX_STATIONS) )
+	{
+		SYSEVT_ERROR(F("Settings check - bad counters, zones:%u, sensors:%u, schedules:%u, stationID:%u"), uint16_t(numZones), uint16_t(numSensors), uint16_t(numSchedules), uint16_t(myStationID));
+		fRet = false;
+	}
+
+	for( uint8_t i=0; i<MAX_STATIONS; i++ )
+	{
+		if( stations[i].stationFlags & STATION_FLAGS_VALID )
+		{
+			if( (stations[i].numZoneChannels != 0) && ((stations[i].startZone + stations[i].numZoneChannels) > numZones) )
+			{
+				SYSEVT_ERROR(F("Settings check - station %u zones are out of range"), uint16_t(i));
+				fRet = false;
+			}
+		}
+	}
+
+	for( uint8_t i=0; (i<numZones) && (i<MAX_ZONES); i++ )
+	{
+		if( zones[i].stationID >= MAX_STATIONS )
+		{
+			SYSEVT_ERROR(F("Settings check - zone %u has bad stationID %u"), uint16_t(i), uint16_t(zones[i].stationID));
+			fRet = false;
+		}
+	}
+
+	for( uint8_t i=0; (i<numSensors) && (i<MAX_SENSORS); i++ )
+	{
+		if( sensors[i].sensorStationID >= MAX_STATIONS )
+		{
+			SYSEVT_ERROR(F("Settings check - sensor %u has bad stationID %u"), uint16_t(i), uint16_t(sensors[i].sensorStationID));
+			fRet = false;
+		}
+	}
+
+	return fRet;
+}
+
+SettingsCacheClass settingsCache;
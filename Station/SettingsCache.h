@@ -0,0 +1,76 @@
+/*
+  RAM-resident mirror of the hot EEPROM settings for the SmartGarden system.
+
+  Zones, stations and sensors definitions are consulted on every zone start/stop, every RF request and every JSON response.
+  Reading these from EEPROM one byte at a time is slow, so we keep compact (Short*) forms of these records in RAM.
+  Full records (with names) stay in EEPROM, Load* routines overlay cached part on top of the EEPROM data.
+
+  Cache is loaded at boot by begin(). Until then (and while EEPROM is being rebuilt by ResetEEPROM) settings routines
+  operate directly on EEPROM.
+
+  Modified records are tracked using dirty bitmaps and written back in bulk by flush(), using eeprom_update_block()
+  semantics (only bytes that actually changed are written). Written records are read back, records that failed to
+  write stay dirty.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _SETTINGSCACHE_h
+#define _SETTINGSCACHE_h
+
+#include <inttypes.h>
+#include "Defines.h"
+#include "settings.h"
+
+class SettingsCacheClass
+{
+public:
+				SettingsCacheClass();
+
+	bool		begin(void);				// load cache from EEPROM and check consistency. Called from setup()
+	void		flush(void);				// write back dirty records and verify them
+	void		invalidate(void);			// flush and switch settings back to direct EEPROM access (used by ResetEEPROM)
+	bool		CheckConsistency(void);		// run basic sanity checks of the cached configuration
+
+	void		UpdateSchedule(uint8_t num, const Schedule *pSched);
+
+	bool		fValid;
+
+	uint8_t		numZones;
+	uint8_t		numSensors;
+	uint8_t		numSchedules;
+	uint8_t		myStationID;
+	uint8_t		evtMasterStationID;
+	uint16_t	evtMasterFlags;
+
+	ShortStation	stations[MAX_STATIONS];
+	ShortZone		zones[MAX_ZONES];
+	ShortSensor		sensors[MAX_SENSORS];
+	ShortSchedule	schedules[MAX_SCHEDULES];
+
+	uint16_t	dirtyStations;						// dirty bitmaps, one bit per record
+	uint16_t	dirtySensors;
+	uint8_t		dirtyZones[(MAX_ZONES+7)/8];
+
+	inline void	SetStationDirty(uint8_t n)	{ dirtyStations |= 1 << n; };
+	inline void	SetSensorDirty(uint8_t n)	{ dirtySensors |= 1 << n; };
+	inline void	SetZoneDirty(uint8_t n)		{ dirtyZones[n >> 3] |= 1 << (n & 0x07); };
+
+private:
+	void		load(void);
+};
+
+extern SettingsCacheClass settingsCache;
+
+#if MAX_STATIONS > 16
+#error Settings cache dirty bitmap supports up to 16 stations
+#endif
+
+#if MAX_SENSORS > 16
+#error Settings cache dirty bitmap supports up to 16 sensors
+#endif
+
+#endif //_SETTINGSCACHE_h
@@ -46,6 +46,14 @@ Some of the modules (nntp, tftp and few other pieces) came from Sprinklers_pi co
 #include "LocalBoard.h"
 #include <IniFile.h>
 #include "RProtocolMS.h"
+#include "SettingsCache.h"
+#include "EEJournal.h"
+#include "TimeSync.h"
+#include "SensorAcq.h"
+#include "CounterMeter.h"
+#include "FlowMonitor.h"
+#include "AnalogAcq.h"
+#include "SensorBus.h"
 
 #ifdef SG_WDT_ENABLED
 #include <avr/wdt.h>
@@ -122,6 +130,11 @@ void setup() {
 		ResetEEPROM();	// note: ResetEEPROM will also reset the controller.
 	}
 
+	settingsCache.begin();		// EEPROM is valid at this point, load settings cache
+	eeJournal.begin();			// recover water counters and runtime state
+
+	rprotocol.begin();
+
 #ifdef HW_ENABLE_XBEE
     localUI.lcd_print_line_clear_pgm(PSTR("XBee RF init..."), 1);
 	XBeeRF.begin();
@@ -174,10 +187,15 @@ void setup() {
 }
 
 void loop() {
+	sensorBus.loop();		// new pass - each shared bus carries one transaction per pass
     mainLoop();
     localUI.loop();
 	rprotocol.loop();
 
+#ifdef SG_RF_TIME_CLIENT
+	timeSync.loop();
+#endif //SG_RF_TIME_CLIENT
+
 #ifdef SG_WDT_ENABLED
 	SgWdtReset();
 #endif // SG_WDT_ENABLED
@@ -15,7 +15,10 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #define __STDC_FORMAT_MACROS
 #include "port.h"
 #include "settings.h"
+#include "RProtocolMS.h"
 #include "XBeeRF.h"
+#include "SensorBus.h"
+#include "EventBus.h"
 
 
 // Main SysInfo function
@@ -79,6 +82,7 @@ bool SysInfo(FILE* stream_file)
 	fprintf_P( stream_file, PSTR("<td width=\"200\">Zip</td>\n<td>%lu</td>\n"), GetZip());
 	fprintf_P( stream_file, PSTR("</tr><tr>\n<td>NTPOffset</td>\n<td>%i</td>\n"), (int)GetNTPOffset());
 	fprintf_P( stream_file, PSTR("</tr><tr>\n<td>SeasonalAdj</td>\n<td>%i</td>\n"), (int)GetSeasonalAdjust());
+	fprintf_P( stream_file, PSTR("</tr><tr>\n<td>Events Dropped</td>\n<td>%u</td>\n"), eventBus.GetOverflowCount());
 	fprintf_P( stream_file, PSTR("</tr></table>\n"));
 
 	fprintf_P( stream_file, PSTR("<h3 class=\"auto-style1\">Network</h3>\n"
@@ -134,6 +138,22 @@ bool SysInfo(FILE* stream_file)
 	fprintf_P( stream_file, PSTR("</tr><tr>\n<td>SrDatPin</td>\n<td>%i</td>\n"), (int)(srIO.SrDatPin));
 	fprintf_P( stream_file, PSTR("</tr><tr>\n<td>SrLatPin</td>\n<td>%i</td>\n</tr></table>\n"), (int)(srIO.SrLatPin));
 
+	if( sensorBus.GetNumDevices() != 0 )
+	{
+		fprintf_P( stream_file, PSTR("<h4>Sensor Buses</h4>\n<table align=\"center\" border=\"1\" style=\"border:medium\"><tr class=\"auto-style2\">\n"
+			"<td>Device</td><td>Bus</td><td>Transactions</td><td>Bus Time</td><td>Max</td><td>Deferred</td></tr>\n"));
+		for( uint8_t i=0; i<sensorBus.GetNumDevices(); i++ )
+		{
+			SensorBusStats	stats;
+
+			sensorBus.GetStats(i, &stats);
+			fprintf_P( stream_file, PSTR("<tr class=\"auto-style3\"><td>%S</td><td>%S</td><td>%u</td><td>%lu ms</td><td>%u us</td><td>%u</td></tr>\n"),
+				sensorBus.GetName(i), sensorBus.GetBus(i) == SENSORBUS_I2C ? PSTR("I2C"):PSTR("One-wire"),
+				stats.numTransactions, stats.busTime/1000ul, stats.maxTime, stats.numDeferred);
+		}
+		fprintf_P( stream_file, PSTR("</table>\n"));
+	}
+
 	fprintf_P( stream_file, PSTR("<h3 class=\"auto-style1\">RF Link</h3>\n"));
 
 #ifdef HW_ENABLE_XBEE
@@ -172,11 +192,13 @@ bool SysInfo(FILE* stream_file)
 			else if( fStation.networkID == NETWORK_ID_LOCAL_SERIAL )	strcpy_P(tmp_buf, PSTR("Serial (OS)"));
 			else if( fStation.networkID == NETWORK_ID_XBEE )			strcpy_P(tmp_buf, PSTR("Remote XBee"));
 			else if( fStation.networkID == NETWORK_ID_MOTEINORF )		strcpy_P(tmp_buf, PSTR("Remote RFM69"));
+			else if( fStation.networkID == NETWORK_ID_UDP )				strcpy_P(tmp_buf, PSTR("Remote UDP"));
+			else if( fStation.networkID == NETWORK_ID_LOOPBACK )		strcpy_P(tmp_buf, PSTR("Loopback"));
 			else														strcpy_P(tmp_buf, PSTR("Unknown!"));
 
 			fprintf_P( stream_file, PSTR("<tr class=\"auto-style3\"><td>%i</td><td>%s</td><td>%i</td><td>%s</td>"), i, fStation.name, fStation.numZoneChannels, tmp_buf );
 			
-			if((fStation.networkID == NETWORK_ID_XBEE) || (fStation.networkID == NETWORK_ID_MOTEINORF)  )
+			if( IS_REMOTE_NETWORK(fStation.networkID) )
 			{
 				if( fStation.networkID == NETWORK_ID_XBEE ) 
 					fprintf_P( stream_file, PSTR("<td>%lX:%lX</td>"), XBeeRF.arpTable[i].MSB,XBeeRF.arpTable[i].LSB);
@@ -186,7 +208,10 @@ bool SysInfo(FILE* stream_file)
 				if( runState.sLastContactTime[i] != 0 )
 				{
 					unsigned long c_age = (millis()-runState.sLastContactTime[i]) / (time_t)60000;
-					fprintf_P( stream_file, PSTR("<td>%lu min. ago</td><td>%ddb</td></tr>\n"), c_age, runState.iLastReceivedRSSI[i]);
+					fprintf_P( stream_file, PSTR("<td>%lu min. ago%S"), c_age, rprotocol.NeighborState(i) == RNEIGHBOR_STALE ? PSTR(" (not responding)"):PSTR(""));
+					if( rprotocol.NeighborVia(i) != i )
+						fprintf_P( stream_file, PSTR(", via station %u"), uint16_t(rprotocol.NeighborVia(i)));
+					fprintf_P( stream_file, PSTR("</td><td>%ddb</td></tr>\n"), runState.iLastReceivedRSSI[i]);
 				}
 				else
 				{
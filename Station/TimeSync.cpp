@@ -0,0 +1,193 @@
+/*
+  Clock discipline for the RF time sync of the SmartGarden system.
+
+  See TimeSync.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "Defines.h"
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+#include "TimeSync.h"
+
+
+TimeSyncClass::TimeSyncClass() : m_phase(0), m_slew(0), m_applied(0), m_driftPpm(0), m_driftAcc(0), m_driftTime(0), m_slewTime(0),
+								m_syncTime(0), m_syncOffset(0), m_lastOffset(0), m_fStep(false), m_fSynced(false), m_fDrift(false)
+{
+}
+
+// setTime() starts the new second right away, remember when
+void TimeSyncClass::Adjust(time_t t)
+{
+	setTime(t);
+	m_phase = millis();
+}
+
+//
+// Step the clock (NTP time on the master, legacy FCODE_TIME_BROADCAST on remote stations). Drops the correction in progress,
+// next sync starts over.
+//
+void TimeSyncClass::SetTime(time_t t)
+{
+	Adjust(t);
+	m_slew = 0;
+	m_fStep = false;
+	m_fSynced = false;
+}
+
+time_t TimeSyncClass::Now(uint16_t *pMs)
+{
+	time_t		t;
+
+	do
+	{
+		t = now();
+		*pMs = uint16_t((millis() - m_phase) % 1000ul);
+	} while( t != now() );		// second changed in between, read again
+
+	return t;
+}
+
+//
+// Sync frame received. masterTime and masterMs are the master clock when the frame was built.
+//
+// Returns true if the offset was not expected (beyond the correction in progress by more than TIMESYNC_TOLERANCE),
+// the master should be told to sync more often.
+//
+bool TimeSyncClass::Sync(time_t masterTime, uint16_t masterMs)
+{
+	uint16_t	localMs;
+	time_t		localTime = Now(&localMs);
+	uint32_t	timeNow = millis();
+	uint32_t	ms = uint32_t(masterMs) + TIMESYNC_LATENCY;
+
+	masterTime += ms / 1000ul;					// master clock now
+	ms %= 1000ul;
+
+	int32_t		dSec = int32_t(localTime - masterTime);
+
+	if( dSec > TIMESYNC_OFFSET_LIMIT )			dSec = TIMESYNC_OFFSET_LIMIT;		// keep offset in ms within int32_t, it is stepped anyway
+	else if( dSec < -TIMESYNC_OFFSET_LIMIT )	dSec = -TIMESYNC_OFFSET_LIMIT;
+
+	int32_t		offset = dSec*1000L + int32_t(localMs) - int32_t(ms);
+	int32_t		measured = offset;
+	bool		fReport = m_fSynced && ((offset - m_slew) > TIMESYNC_TOLERANCE || (offset - m_slew) < -TIMESYNC_TOLERANCE);
+
+	if( !m_fSynced || (offset > TIMESYNC_STEP_THRESHOLD) || (offset < -TIMESYNC_STEP_THRESHOLD) )
+	{
+		TRACE_INFO(F("TimeSync - stepping the clock, offset %ld ms\n"), offset);
+
+		Adjust(masterTime);						// starts the second now, ms behind the master
+		m_slew = -int32_t(ms);
+		m_fStep = true;
+		offset = m_slew;
+	}
+	else
+	{
+// Offset growth of the free running clock since the last sync gives the drift
+
+		uint32_t	interval = (timeNow - m_syncTime) / 1000ul;
+
+		if( interval >= 10 )
+		{
+			int32_t		drift = (offset + m_applied - m_syncOffset) * 1000L / int32_t(interval);
+
+			if( drift > TIMESYNC_MAX_DRIFT )		drift = TIMESYNC_MAX_DRIFT;
+			if( drift < -TIMESYNC_MAX_DRIFT )		drift = -TIMESYNC_MAX_DRIFT;
+
+			m_driftPpm = m_fDrift ? m_driftPpm + (drift - m_driftPpm)/4 : drift;
+			m_fDrift = true;
+		}
+
+		TRACE_INFO(F("TimeSync - offset %ld ms, drift %ld ppm\n"), offset, m_driftPpm);
+		m_slew = offset;
+		m_fStep = false;
+	}
+
+	m_lastOffset = (measured > 32767) ? 32767 : ((measured < -32767) ? -32767 : int16_t(measured));
+	m_syncOffset = offset;
+	m_applied = 0;
+	m_syncTime = timeNow;
+	if( !m_fSynced )
+		m_driftTime = timeNow;
+	m_fSynced = true;
+
+	return fReport;
+}
+
+//
+// Drift compensation adds to the pending correction every second. The correction is applied by restarting the current second
+// of the Time library at the right moment: s ms into the second to move the clock back by s, or s ms before the next second
+// to move it forward. At most TIMESYNC_SLEW_MAX ms per second, except for the rest of the step.
+//
+void TimeSyncClass::loop(void)
+{
+	if( !m_fSynced )
+		return;
+
+	uint32_t	timeNow = millis();
+
+	if( (timeNow - m_driftTime) >= 1000ul )
+	{
+		uint32_t	n = (timeNow - m_driftTime) / 1000ul;
+
+		m_driftTime += n * 1000ul;
+		if( m_fDrift )
+		{
+			m_driftAcc += m_driftPpm * int32_t(n);
+
+			int32_t		ms = m_driftAcc / 1000L;
+
+			m_slew += ms;
+			m_driftAcc -= ms * 1000L;
+		}
+	}
+
+	if( (m_slew < TIMESYNC_SLEW_MIN) && (m_slew > -TIMESYNC_SLEW_MIN) )
+		return;
+
+	if( !m_fStep && ((timeNow - m_slewTime) < 1000ul) )
+		return;
+
+	int32_t		s = m_slew;
+
+	if( !m_fStep )
+	{
+		if( s > TIMESYNC_SLEW_MAX )		s = TIMESYNC_SLEW_MAX;
+		if( s < -TIMESYNC_SLEW_MAX )	s = -TIMESYNC_SLEW_MAX;
+	}
+
+	uint16_t	ms;
+	time_t		t = Now(&ms);
+	int32_t		applied;
+
+	if( s > 0 )
+	{
+		if( (int32_t(ms) > s) || (int32_t(ms) + TIMESYNC_SLEW_WINDOW < s) )
+			return;
+
+		Adjust(t);								// this second starts over, the clock goes back by ms
+		applied = ms;
+	}
+	else
+	{
+		if( (int32_t(ms) < 1000L + s) || (int32_t(ms) > 1000L + s + TIMESYNC_SLEW_WINDOW) )
+			return;
+
+		Adjust(t+1);							// next second starts now, the clock goes forward by 1000-ms
+		applied = int32_t(ms) - 1000L;
+	}
+
+	TRACE_VERBOSE(F("TimeSync - adjusted the clock by %ld ms\n"), -applied);
+	m_slew -= applied;
+	m_applied += applied;
+	m_slewTime = timeNow;
+	m_fStep = false;
+}
+
+
+TimeSyncClass timeSync;
@@ -0,0 +1,69 @@
+/*
+  Clock discipline for the RF time sync of the SmartGarden system.
+
+  Time library keeps time in whole seconds, and setTime() restarts the second at the moment of the call. This module keeps track
+  of that moment (the phase), which gives millisecond resolution clock on top of the Time library.
+
+  Master stamps FCODE_TIME_SYNC broadcasts with its time in ms, when the frame leaves the transmit queue (see
+  RProtocolMaster::StampTimeSync()). On receipt the remote station measures its clock offset, corrected for the transmit latency. Small offsets are slewed - the second boundary is moved by up to TIMESYNC_SLEW_MAX ms per second,
+  so the clock never jumps. Large offsets (or the first sync) step the clock.
+
+  Clock drift is estimated from successive syncs (offset growth of the free running clock over the sync interval), smoothed,
+  and compensated continuously between syncs. Station reports its offset to the master when it is out of TIMESYNC_TOLERANCE,
+  the master shortens the sync interval then (see RProtocolMaster::SendTimeBroadcast()).
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _TIMESYNC_h
+#define _TIMESYNC_h
+
+#include <inttypes.h>
+#include <Time.h>
+
+#define TIMESYNC_LATENCY			5		// ms, transmit latency of the sync frame (radio send to receipt, queueing delay is stamped out)
+#define TIMESYNC_STEP_THRESHOLD		1000	// ms, offsets above this are stepped instead of slewed
+#define TIMESYNC_SLEW_MAX			50		// ms, max clock adjustment per second when slewing
+#define TIMESYNC_SLEW_WINDOW		20		// ms, allowed lateness of the adjustment (loop latency)
+#define TIMESYNC_SLEW_MIN			3		// ms, smaller corrections wait until drift compensation adds up
+#define TIMESYNC_TOLERANCE			200		// ms, unexpected offset (beyond the correction in progress) is reported to the master
+#define TIMESYNC_MAX_DRIFT			10000	// ppm, drift estimate limit (ceramic resonators are within 0.5%)
+#define TIMESYNC_OFFSET_LIMIT		2000000L	// seconds, larger offsets are saturated (still stepped and reported)
+
+class TimeSyncClass
+{
+public:
+				TimeSyncClass();
+
+	void		SetTime(time_t t);									// step the clock, use instead of setTime()
+	bool		Sync(time_t masterTime, uint16_t masterMs);			// FCODE_TIME_SYNC received. Returns true if the offset is out of tolerance
+	void		loop(void);											// apply drift compensation and slewing, should be called often
+
+	time_t		Now(uint16_t *pMs);									// now(), and ms into the current second
+	int16_t		GetOffset(void)	{ return m_lastOffset; };			// ms, measured at the last sync (saturated), positive - local clock was ahead
+	int16_t		GetDrift(void)	{ return int16_t(m_driftPpm); };	// ppm, positive - local clock is fast
+
+private:
+	void		Adjust(time_t t);
+
+	uint32_t	m_phase;				// millis() when the current second of the Time library started
+	int32_t		m_slew;					// ms of correction left to apply, positive - move the clock back
+	int32_t		m_applied;				// ms of correction applied since the last sync
+	int32_t		m_driftPpm;
+	int32_t		m_driftAcc;				// us of drift compensation not applied yet
+	uint32_t	m_driftTime;			// millis() of the last drift compensation step
+	uint32_t	m_slewTime;				// millis() of the last slew adjustment
+	uint32_t	m_syncTime;				// millis() of the last sync
+	int32_t		m_syncOffset;			// ms, offset at the last sync
+	int16_t		m_lastOffset;
+	bool		m_fStep;				// m_slew is the rest of the step, apply it at once
+	bool		m_fSynced;				// clock was synced at least once
+	bool		m_fDrift;				// drift estimate is valid
+};
+
+extern TimeSyncClass timeSync;
+
+#endif //_TIMESYNC_h
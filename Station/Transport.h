@@ -0,0 +1,50 @@
+/*
+        Network transport interface for the SmartGarden remote protocol.
+
+
+RProtocol does not talk to the radios directly. Each network (XBee, MoteinoRF, UDP, in-memory loopback) is wrapped into a transport
+object, registered with rprotocol under its networkID (see NETWORK_ID_* in settings.h).
+
+Outgoing frames are routed by the networkID of the destination station. Incoming frames are picked up by the transport in Poll(),
+and passed to rprotocol.ProcessNewFrame().
+
+Transports that keep outgoing frames in their own buffers (e.g. MoteinoRF transmit queue) can let rprotocol build the frame in place:
+AllocFrame() returns the buffer for the next frame, and SendFrame() sends it, without copying the frame.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _TRANSPORT_h
+#define _TRANSPORT_h
+
+#include <inttypes.h>
+
+// Transport capability flags
+#define TRANSPORT_FLAGS_RELIABLE			1	// link-level ACK and re-transmission
+#define TRANSPORT_FLAGS_DELIVERY_REPORT		2	// delivery result is reported through the Send() callback
+#define TRANSPORT_FLAGS_BROADCAST			4	// transport can send frames to STATIONID_BROADCAST
+
+#define TRANSPORT_MAX_ADDRESS_SIZE			8	// largest network address (XBee 64bit)
+
+// Delivery result callback, called once the frame is delivered or the transport gave up
+typedef void (*PTransportTxCallback)(uint8_t nStation, uint8_t cookie, bool fDelivered);
+
+class NetTransport
+{
+public:
+	virtual bool	IsReady(void) = 0;
+	virtual bool	Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie) = 0;
+	virtual void	Poll(void) = 0;								// pick up incoming frames, pass them to rprotocol.ProcessNewFrame()
+	virtual uint8_t	ResolveAddress(uint8_t nStation, uint8_t *pAddress) = 0;	// returns address length, 0 if the station address is not known
+	virtual uint8_t	MTU(void) = 0;								// largest RProtocol frame the transport can carry
+	virtual uint8_t	Flags(void) = 0;							// TRANSPORT_FLAGS_*
+
+// In-place frames. Buffer returned by AllocFrame() stays valid until SendFrame() or the next AllocFrame() call.
+	virtual uint8_t	*AllocFrame(uint8_t nStation, uint8_t mSize) { return 0; };	// 0 if the transport has no buffer to offer
+	virtual bool	SendFrame(uint8_t nStation, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie) { return false; };
+};
+
+#endif //_TRANSPORT_h
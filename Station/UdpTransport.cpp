@@ -0,0 +1,153 @@
+/*
+        UDP transport for the SmartGarden remote protocol.
+
+See UdpTransport.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef ARDUINO
+
+#include "UdpTransport.h"
+#include "RProtocolMS.h"
+
+//#define TRACE_LEVEL			7		// trace everything for this module
+#include "port.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+UdpTransport::UdpTransport()
+{
+	txFrames = rxFrames = txErrors = 0;
+	_socket = -1;
+	_hostAddr = 0;
+	_basePort = UDP_TRANSPORT_BASE_PORT;
+	_myStationID = 0;
+}
+
+//
+// Open the socket on the port of this station and register with rprotocol.
+//
+// Returns false if the socket cannot be opened (e.g. port is in use).
+//
+bool UdpTransport::begin(uint8_t myStationID, const char *host, uint16_t basePort, uint8_t networkID)
+{
+	struct in_addr		addr;
+	struct sockaddr_in	local;
+
+	if( inet_aton(host, &addr) == 0 )
+	{
+		TRACE_ERROR(F("UDP transport - bad host address %s\n"), host);
+		return false;
+	}
+
+	_hostAddr = addr.s_addr;
+	_basePort = basePort;
+	_myStationID = myStationID;
+
+	_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if( _socket < 0 )
+	{
+		TRACE_ERROR(F("UDP transport - cannot create socket\n"));
+		return false;
+	}
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = _hostAddr;
+	local.sin_port = htons(_basePort + myStationID);
+
+	if( (bind(_socket, (struct sockaddr *)&local, sizeof(local)) < 0) || (fcntl(_socket, F_SETFL, O_NONBLOCK) < 0) )
+	{
+		TRACE_ERROR(F("UDP transport - cannot bind to port %u\n"), uint16_t(_basePort + myStationID));
+		end();
+		return false;
+	}
+
+	TRACE_INFO(F("UDP transport - station %u listening on port %u\n"), uint16_t(myStationID), uint16_t(_basePort + myStationID));
+	rprotocol.RegisterTransport(networkID, this);
+	return true;
+}
+
+void UdpTransport::end(void)
+{
+	if( _socket >= 0 )
+		close(_socket);
+	_socket = -1;
+}
+
+bool UdpTransport::SendTo(uint8_t nStation, void *msg, uint8_t mSize)
+{
+	struct sockaddr_in	dest;
+
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = _hostAddr;
+	dest.sin_port = htons(_basePort + nStation);
+
+	if( sendto(_socket, msg, mSize, 0, (struct sockaddr *)&dest, sizeof(dest)) != mSize )
+	{
+		txErrors++;
+		return false;
+	}
+	txFrames++;
+	return true;
+}
+
+//
+// Send the frame as one datagram. UDP gives no delivery indication, callback is not used.
+//
+bool UdpTransport::Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie)
+{
+	if( _socket < 0 )
+		return false;
+
+	if( nStation != STATIONID_BROADCAST )
+		return SendTo(nStation, msg, mSize);
+
+	for( uint8_t i=0; i<STATIONID_BROADCAST; i++ )
+	{
+		if( i != _myStationID )
+			SendTo(i, msg, mSize);
+	}
+	return true;
+}
+
+void UdpTransport::Poll(void)
+{
+	uint8_t		buf[UDP_TRANSPORT_MTU];
+
+	if( _socket < 0 )
+		return;
+
+	for( uint8_t i=0; i<UDP_TRANSPORT_POLL_BURST; i++ )
+	{
+		ssize_t		len = recv(_socket, buf, sizeof(buf), 0);
+
+		if( len <= 0 )
+			return;				// nothing more to read
+
+		rxFrames++;
+		rprotocol.ProcessNewFrame(buf, int(len), 0, this);
+	}
+}
+
+uint8_t UdpTransport::ResolveAddress(uint8_t nStation, uint8_t *pAddress)
+{
+	uint16_t	port = htons(_basePort + nStation);
+
+	memcpy(pAddress, &_hostAddr, 4);
+	memcpy(pAddress+4, &port, 2);
+	return 6;
+}
+
+#endif //ARDUINO
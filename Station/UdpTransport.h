@@ -0,0 +1,61 @@
+/*
+        UDP transport for the SmartGarden remote protocol.
+
+
+Used by host (Linux) builds, to run master and remote stations as separate processes talking RProtocol over UDP.
+Each station listens on its own port, UDP_TRANSPORT_BASE_PORT + stationID, on the same host. One RProtocol frame per datagram.
+Broadcasts are sent to the ports of all other stations.
+
+The transport is not available in Arduino builds.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _UDPTRANSPORT_h
+#define _UDPTRANSPORT_h
+
+#ifndef ARDUINO
+
+#include <inttypes.h>
+#include "Defines.h"
+#include "settings.h"
+#include "Transport.h"
+
+#define UDP_TRANSPORT_BASE_PORT		47800
+#define UDP_TRANSPORT_MTU			250		// RProtocol frame length fits into one byte, leave some room
+#define UDP_TRANSPORT_POLL_BURST	16		// max frames processed per Poll()
+
+class UdpTransport : public NetTransport
+{
+public:
+	UdpTransport();
+	bool	begin(uint8_t myStationID, const char *host = "127.0.0.1", uint16_t basePort = UDP_TRANSPORT_BASE_PORT, uint8_t networkID = NETWORK_ID_UDP);
+	void	end(void);
+
+// NetTransport
+	bool	IsReady(void) { return _socket >= 0; };
+	bool	Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie);
+	void	Poll(void);
+	uint8_t	ResolveAddress(uint8_t nStation, uint8_t *pAddress);		// IPv4 address and port, network byte order
+	uint8_t	MTU(void) { return UDP_TRANSPORT_MTU; };
+	uint8_t	Flags(void) { return TRANSPORT_FLAGS_BROADCAST; };
+
+	uint32_t	txFrames;
+	uint32_t	rxFrames;
+	uint32_t	txErrors;
+
+private:
+	bool		SendTo(uint8_t nStation, void *msg, uint8_t mSize);
+
+	int			_socket;
+	uint32_t	_hostAddr;			// network byte order
+	uint16_t	_basePort;
+	uint8_t		_myStationID;
+};
+
+#endif //ARDUINO
+
+#endif //_UDPTRANSPORT_h
@@ -117,6 +117,7 @@ void XBeeRFClass::begin()
 
 	rprotocol.RegisterARP((void *)&XBeeARPUpdate);			// register ARP callback with the remote protocol
 															// rprotocol will use it to report station=address associations
+	rprotocol.RegisterTransport(NETWORK_ID_XBEE, this);
 
 	return;
 
@@ -346,6 +347,22 @@ bool XBeeSendPacket(uint8_t nStation, void *msg, uint8_t mSize)
 	return true;
 }
 
+// NetTransport send. XBee does not report delivery (TX status is not requested), callback is not used.
+bool XBeeRFClass::Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie)
+{
+	return XBeeSendPacket(nStation, msg, mSize);
+}
+
+// Long (64bit) XBee address of the station, big endian. Stations not in the ARP table are reached by broadcast.
+uint8_t XBeeRFClass::ResolveAddress(uint8_t nStation, uint8_t *pAddress)
+{
+	if( (nStation >= MAX_STATIONS) || (arpTable[nStation].LSB == 0) )
+		return 0;
+
+	memcpy(pAddress, &(arpTable[nStation]), sizeof(LongXBeeAddress));
+	return sizeof(LongXBeeAddress);
+}
+
 
 // Main XBee loop poller. loop() should be called frequently, to allow processing of incoming packets
 //
@@ -387,7 +404,7 @@ void XBeeRFClass::loop(void)
 				}
 
 				TRACE_VERBOSE(F("XBee.loop - processing packet from station %d"), rx16.getRemoteAddress16());
-				rprotocol.ProcessNewFrame(msg+4, msg_len-4, 0 );	// process incoming packet.
+				rprotocol.ProcessNewFrame(msg+4, msg_len-4, 0, this );	// process incoming packet.
 																		// Note: we don't copy the packet, and just use pointer to the packet already in XBee library buffer
 				return;
 		} 
@@ -408,7 +425,7 @@ void XBeeRFClass::loop(void)
 					return;
 				}
 
-				rprotocol.ProcessNewFrame(msg+11, msg_len-11, msg);		// process incoming packet.
+				rprotocol.ProcessNewFrame(msg+11, msg_len-11, msg, this);		// process incoming packet.
 																		// Note: we don't copy the packet, and just use pointer to the packet already in XBee library buffer
 				return;
 		} 
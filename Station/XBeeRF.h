@@ -21,19 +21,30 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 
 #include <XBee.h>
 #include "Defines.h"
+#include "Transport.h"
+
+#define XBEE_MAX_FRAME_SIZE		(MAX_FRAME_DATA_SIZE-11)	// largest RProtocol frame, limited by the XBee library receive buffer minus ZB RX API header
 
 struct LongXBeeAddress {    // note: we are storing long 64bit addresses in XBee format (big endian)
 	uint32_t	MSB;
 	uint32_t	LSB;
 };
 
-class XBeeRFClass
+class XBeeRFClass : public NetTransport
 {
  public:
 	XBeeRFClass();
 	void begin(void);
 	void loop(void);
 
+// NetTransport
+	bool	IsReady(void) { return fXBeeReady; };
+	bool	Send(uint8_t nStation, void *msg, uint8_t mSize, PTransportTxCallback callback, uint8_t cookie);
+	void	Poll(void) { loop(); };
+	uint8_t	ResolveAddress(uint8_t nStation, uint8_t *pAddress);
+	uint8_t	MTU(void) { return XBEE_MAX_FRAME_SIZE; };
+	uint8_t	Flags(void) { return TRANSPORT_FLAGS_RELIABLE | TRANSPORT_FLAGS_BROADCAST; };	// XBee MAC does ACK and retries, but we don't request TX status
+
 	bool	fXBeeReady;			// Flag indicating that XBee is initialized and ready
 	uint8_t	frameIDCounter;		// Rolling counter used to generate FrameID
 
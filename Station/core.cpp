@@ -17,9 +17,14 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #include "LocalBoard.h"
 #include <stdlib.h>
 #include "sensors.h"
+#include "SensorAcq.h"
+#include "AnalogAcq.h"
 #include "XBeeRF.h"
 #include "localUI.h"
 #include "RProtocolMS.h"
+#include "EventBus.h"
+#include "SettingsCache.h"
+#include "EEJournal.h"
 #ifdef ARDUINO
 #include "tftp.h"
 static tftp tftpServer;
@@ -42,6 +47,47 @@ LocalBoardSerial	lBoardSerial;		// local hardware handler for Serially-connected
 
 static uint8_t	zoneStateCache[MAX_ZONES] = {0};
 
+// Update zone state cache entry. Subscribers are notified only when the state itself changes (timer updates are silent).
+//
+static inline void SetZoneState(uint8_t iZone, uint8_t newState)
+{
+	if( (zoneStateCache[iZone] & 0x0F0) != (newState & 0x0F0) )
+		eventBus.Publish(SGEVT_ZONE_STATE, iZone, newState & 0x0F0);
+
+	zoneStateCache[iZone] = newState;
+}
+
+// Completion of remote zone commands.
+//
+// On success the zones report carried in the response has already updated zone state. On error, or when the station did not
+// respond after all retries, affected zones leave "starting"/"stopping" state right away instead of waiting for the timer.
+//
+static void RemoteZoneCommandDone(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t channel)
+{
+	ShortStation	sStation;
+
+	if( status == RTRANSACTION_OK )
+		return;
+
+	SYSEVT_ERROR(F("Station %d did not confirm zone command (%S)"), (int)stationID, status == RTRANSACTION_ERROR ? PSTR("error"):PSTR("timeout"));
+
+	if( stationID >= MAX_STATIONS )
+		return;
+
+	LoadShortStation(stationID, &sStation);
+	for( uint8_t ch=0; ch<sStation.numZoneChannels; ch++ )
+	{
+		uint8_t  z = sStation.startZone + ch;
+
+		if( ((channel != 0x0FF) && (ch != channel)) || (z >= GetNumZones()) )
+			continue;
+
+		uint8_t  state = zoneStateCache[z] & 0x0F0;
+		if( (state == ZONE_STATE_STARTING) || (state == ZONE_STATE_STOPPING) )
+			SetZoneState(z, ZONE_STATE_OFF);
+	}
+}
+
 // Zone handler loop, it is called once a second
 
 void zoneHandlerLoop(void)
@@ -68,7 +114,7 @@ void zoneHandlerLoop(void)
 				{
 					// we reached zero but have not received confirmation, assume that zone did not start.
 					// stop the timer and change the state.
-					zoneStateCache[i] = ZONE_STATE_OFF;
+					SetZoneState(i, ZONE_STATE_OFF);
 				}
 			}
 			else if( z & ZONE_STATE_STOPPING ) 
@@ -83,7 +129,7 @@ void zoneHandlerLoop(void)
 				{
 					// we reached zero but have not received confirmation, assume that zone stopped.
 					// stop the timer and change the state.
-					zoneStateCache[i] = ZONE_STATE_OFF;
+					SetZoneState(i, ZONE_STATE_OFF);
 				}
 			}
 		}
@@ -159,7 +205,7 @@ void runStateClass::TurnOnZone(uint8_t nZone, uint8_t ttr)
 		if( sStation.networkID == NETWORK_ID_LOCAL_PARALLEL )
 		{
 			if( lBoardParallel.ChannelOn(sStation.networkAddress+zone.channel) )
-				zoneStateCache[nZone] = ZONE_STATE_RUNNING;	// parallel stations go directly to running state
+				SetZoneState(nZone, ZONE_STATE_RUNNING);	// parallel stations go directly to running state
 			else
 			{
 				SYSEVT_ERROR(F("TurnOnZone - lBoardParallel returned failure for zone %d"), (uint16_t)nZone);
@@ -172,7 +218,7 @@ void runStateClass::TurnOnZone(uint8_t nZone, uint8_t ttr)
 		else if( sStation.networkID == NETWORK_ID_LOCAL_SERIAL )
 		{
 			if( lBoardSerial.ChannelOn(sStation.networkAddress+zone.channel) )
-				zoneStateCache[nZone] = ZONE_STATE_RUNNING;	// serial stations go directly to running state
+				SetZoneState(nZone, ZONE_STATE_RUNNING);	// serial stations go directly to running state
 			else
 			{
 				SYSEVT_ERROR(F("TurnOnZone - lBoardSerial returned failure for zone %d"), (uint16_t)nZone);
@@ -182,11 +228,11 @@ void runStateClass::TurnOnZone(uint8_t nZone, uint8_t ttr)
 			// Turn on the pump if necessary
 //			lBoard.PumpControl(zone.bPump);
 		}
-		else if( (sStation.networkID == NETWORK_ID_XBEE) || (sStation.networkID == NETWORK_ID_MOTEINORF) )
+		else if( IS_REMOTE_NETWORK(sStation.networkID) )
 		{
-			if( rprotocol.ChannelOn(zone.stationID, zone.channel, ttr) )
+			if( rprotocol.ChannelOn(zone.stationID, zone.channel, ttr, RemoteZoneCommandDone) )
 			{
-				zoneStateCache[nZone] = ZONE_STATE_STARTING + ZONE_STATE_TIMEOUT;	// remote stations go to "starting" state first, and will transition to "running" state when response arrives
+				SetZoneState(nZone, ZONE_STATE_STARTING + ZONE_STATE_TIMEOUT);	// remote stations go to "starting" state first, and will transition to "running" state when response arrives
 			}
 			else
 			{
@@ -242,7 +288,7 @@ void runStateClass::TurnOffZone(uint8_t nZone)
 		{
 			lBoardParallel.ChannelOff( sStation.networkAddress+zone.channel );
 
-			zoneStateCache[nZone] = ZONE_STATE_OFF;	
+			SetZoneState(nZone, ZONE_STATE_OFF);	
 
         // Turn on the pump if necessary
 //			lBoard.PumpControl(zone.bPump);
@@ -251,16 +297,16 @@ void runStateClass::TurnOffZone(uint8_t nZone)
 		{
 			lBoardSerial.ChannelOff( sStation.networkAddress+zone.channel );
 
-			zoneStateCache[nZone] = ZONE_STATE_OFF;	
+			SetZoneState(nZone, ZONE_STATE_OFF);	
 
 			// Turn on the pump if necessary
 //			lBoard.PumpControl(zone.bPump);
 		}
-		else if( (sStation.networkID == NETWORK_ID_XBEE) || (sStation.networkID == NETWORK_ID_MOTEINORF) )
+		else if( IS_REMOTE_NETWORK(sStation.networkID) )
 		{
-			if( rprotocol.ChannelOff(zone.stationID, zone.channel) )
+			if( rprotocol.ChannelOff(zone.stationID, zone.channel, RemoteZoneCommandDone) )
 			{
-				zoneStateCache[nZone] = ZONE_STATE_STOPPING + ZONE_STATE_TIMEOUT;	// remote stations go to "stopping" state first, and will transition to "running" state when response arrives
+				SetZoneState(nZone, ZONE_STATE_STOPPING + ZONE_STATE_TIMEOUT);	// remote stations go to "stopping" state first, and will transition to "running" state when response arrives
 			}
 			else
 			{
@@ -300,10 +346,7 @@ bool runStateClass::StartZone(int iSchedule, uint8_t stationID, uint8_t channel,
 {
 	if( StartZoneWorker(iSchedule, stationID, channel, time2run) )
 	{
-#ifndef SG_STATION_MASTER	// we send remote master notifications only if this station is not a master by itself
-		if( GetEvtMasterFlags() & EVTMASTER_FLAGS_REPORT_ZONES )
-			rprotocol.SendZonesReport(0, stationID, GetEvtMasterStationID(), 0, GetNumZones());	// Note: this would work correctly only on Remote station, with only one station defined
-#endif //SG_STATION_MASTER
+		eventBus.Publish(SGEVT_ZONES_LOCAL_CMD, stationID, 0);		// EvtMaster reporting is handled by the subscriber
 		return true;
 	}
 	else
@@ -366,13 +409,7 @@ void runStateClass::RemoteStopAllZones(void)
 void runStateClass::TurnOffZones()
 {
 		TurnOffZonesWorker();
-#ifndef SG_STATION_MASTER	// we send remote master notifications only if this station is not a master by itself
-		if( GetEvtMasterFlags() & EVTMASTER_FLAGS_REPORT_ZONES )
-		{
-			rprotocol.SendZonesReport(0, GetMyStationID(), GetEvtMasterStationID(), 0, GetNumZones());	// Note: this would work correctly only on Remote station, with only one station defined
-			TRACE_INFO(F("TurnOffZones - reporting event to Master\n"));
-		}
-#endif
+		eventBus.Publish(SGEVT_ZONES_LOCAL_CMD, GetMyStationID(), 0);	// EvtMaster reporting is handled by the subscriber
 }
 
 void runStateClass::TurnOffZonesWorker()
@@ -386,7 +423,10 @@ void runStateClass::TurnOffZonesWorker()
 		}
 		m_iZone = -1;
 		if( m_iSchedule != -1 )
+		{
+			eventBus.Publish(SGEVT_SCHEDULE_STOP, m_iSchedule, 0, m_iWaterUsed);
 			m_iSchedule = -1;
+		}
 }
 
 void runStateClass::ReportZoneStatus(uint8_t stationID, uint8_t channel, uint8_t z_status)
@@ -404,9 +444,9 @@ void runStateClass::ReportZoneStatus(uint8_t stationID, uint8_t channel, uint8_t
 		return;							// channel out of range for this zone
 
 	if( z_status != 0 )
-		zoneStateCache[sStation.startZone+channel] = ZONE_STATE_RUNNING;
+		SetZoneState(sStation.startZone+channel, ZONE_STATE_RUNNING);
 	else
-		zoneStateCache[sStation.startZone+channel] = ZONE_STATE_OFF;
+		SetZoneState(sStation.startZone+channel, ZONE_STATE_OFF);
 }
 
 void runStateClass::ReportStationZonesStatus(uint8_t stationID, uint8_t z_status)
@@ -423,9 +463,9 @@ void runStateClass::ReportStationZonesStatus(uint8_t stationID, uint8_t z_status
 	for( uint8_t i=0; i<sStation.numZoneChannels; i++ )
 	{
 		if( z_status & (1<<i) )
-			zoneStateCache[sStation.startZone+i] = ZONE_STATE_RUNNING;
+			SetZoneState(sStation.startZone+i, ZONE_STATE_RUNNING);
 		else
-			zoneStateCache[sStation.startZone+i] = ZONE_STATE_OFF;
+			SetZoneState(sStation.startZone+i, ZONE_STATE_OFF);
 	}
 }
 
@@ -471,6 +511,7 @@ void runStateClass::StopSchedule(void)
 			
 			m_iZone = -1; // no zone is running
 			LogSchedule(); // log previous schedule since we are stopping it
+			eventBus.Publish(SGEVT_SCHEDULE_STOP, m_iSchedule, 0, m_iWaterUsed);
 			m_iSchedule = -1;
 			m_iWaterUsed = 0;
 		}
@@ -483,6 +524,8 @@ void runStateClass::SetPause(int time2pause)
 		if( m_endPauseMillis != 0 ) 
 		{
 			m_endPauseMillis = 0;	// resume operation
+			eeJournal.Write(JOURNAL_KEY_PAUSE_END, 0);
+			eventBus.Publish(SGEVT_PAUSE, 0, 0, 0);
 			ProcessScheduledEvents();
 		}
 	}
@@ -494,6 +537,8 @@ void runStateClass::SetPause(int time2pause)
 		}
 		m_endPauseMillis = millis() + uint32_t(time2pause)*60000ul;
 		if( m_endPauseMillis == 0 ) m_endPauseMillis = 1;	// account for rare condition when due to overflow new end millis time equals 0 (but we use 0 as a flag here)
+		eeJournal.Write(JOURNAL_KEY_PAUSE_END, now() + uint32_t(time2pause)*60ul);	// persist pause, so that it survives controller reset
+		eventBus.Publish(SGEVT_PAUSE, 0, 0, time2pause);
 		ProcessScheduledEvents();
 	}
 }
@@ -539,6 +584,7 @@ void runStateClass::StartSchedule(bool fQuickSched, int8_t iSched)
 					m_iZone = i;
 					m_startZoneMillis = millis();
 					m_zoneMins = quickSchedule.zone_duration[i];
+					eventBus.Publish(SGEVT_SCHEDULE_START, m_iSchedule, 0);
 					
 					TurnOnZone(i+1, m_zoneMins);
 					return;	// done
@@ -567,6 +613,7 @@ void runStateClass::StartSchedule(bool fQuickSched, int8_t iSched)
 						m_zoneMins = sAdj(sched.zone_duration[i]);
 					else
 						m_zoneMins = sched.zone_duration[i];
+					eventBus.Publish(SGEVT_SCHEDULE_START, m_iSchedule, 0);
 					
 					TurnOnZone(i+1, m_zoneMins);
 					return;	// done
@@ -698,10 +745,10 @@ void runStateClass::ProcessScheduledEvents(void)
 }
 
 // return true if the schedule is enabled and runs today.
-static inline bool IsRunToday(const Schedule & sched, time_t time_now)
+static inline bool IsRunToday(const ShortSchedule & sched, time_t time_now)
 {
         if ((sched.IsEnabled())
-                        && (((sched.IsInterval()) && ((elapsedDays(time_now) % sched.interval) == 0))
+                        && (((sched.IsInterval()) && ((elapsedDays(time_now) % sched.day) == 0))
                                         || (!(sched.IsInterval()) && (sched.day & (0x01 << (weekday(time_now) - 1))))))
                 return true;
         return false;
@@ -733,31 +780,20 @@ bool GetNextEvent(uint8_t *pSchedID, uint8_t *pZoneID, short *pTime)
 
 		for( uint8_t i = 0; i < iNumSchedules; i++ )
         {
-                Schedule sched;
-                LoadSchedule( i, &sched );
-                if( IsRunToday(sched, time_now) )
+                ShortSchedule sched;
+                LoadShortSchedule( i, &sched );		// compact form is served from the settings cache, no EEPROM access
+                if( (sched.firstZone != SCHEDULE_NO_ZONES) && IsRunToday(sched, time_now) )
                 {
                         // now scan events for each of the start times.
                         for( uint8_t j = 0; j <= 3; j++ )
                         {
                                 const short start_time = sched.time[j];	//Note: schedule may have up to 4 start times specified, stored as minutes (since midnight?)
-                                if( start_time != -1 )
+                                if( (start_time != -1) && (start_time<*pTime) && (start_time>=cTime) )
                                 {
-										if( (start_time<*pTime) && (start_time>=cTime) )
-										{
-											for( uint8_t iZone = 0; iZone < MAX_ZONES; iZone++ )
-											{
-												if( sched.zone_duration[iZone] != 0 )
-												{
-													*pTime = start_time;
-													*pZoneID = iZone;
-													*pSchedID = i;
-													fRet = true;
-													
-													break;
-												}
-											}
-										}
+										*pTime = start_time;
+										*pZoneID = sched.firstZone;
+										*pSchedID = i;
+										fRet = true;
                                 }
                         }
                 }
@@ -772,6 +808,7 @@ void mainLoop()
 {
         static bool firstLoop = true;
         static bool bDoneMidnightReset = false;
+        static bool bPauseRestored = false;
         if (firstLoop)
         {
                 firstLoop = false;
@@ -839,6 +876,18 @@ void mainLoop()
 				}
 				else if (hour(timeNow) != 0)
                      bDoneMidnightReset = false;
+
+				// Restore pause state saved before reset, once we have valid time
+				if( !bPauseRestored && (timeStatus() != timeNotSet) )
+				{
+					bPauseRestored = true;
+
+					uint32_t  pauseEnd = eeJournal.Read(JOURNAL_KEY_PAUSE_END);
+					if( pauseEnd > uint32_t(timeNow) + 60ul )
+						runState.SetPause((pauseEnd - timeNow)/60ul);
+					else if( pauseEnd != 0 )
+						eeJournal.Write(JOURNAL_KEY_PAUSE_END, 0);	// pause expired while we were down
+				}
 			}  
 			else if( (tick_counter%10) == 3 )	// one-second block2
 			{
@@ -858,6 +907,7 @@ void mainLoop()
 			else if( (tick_counter%10) == 7 )	// one-second block5
 			{
 				lBoardSerial.loop();			// refresh state of the serial (OS-style) outputs
+				settingsCache.flush();			// write back modified settings
 			}
 	   }
         
@@ -869,6 +919,15 @@ void mainLoop()
         // Process any pending events.
         runState.ProcessScheduledEvents();
 
+        // Deliver state change notifications to subscribers
+        eventBus.loop();
+
+        // Collect local sensor readings once their conversions complete
+        sensorAcq.loop();
+
+        // Filter background ADC samples of analog sensors
+        analogAcq.loop();
+
 #if defined(ARDUINO) && defined(HW_ENABLE_ETHERNET)
         // Process the TFTP Server
         tftpServer.Poll();
@@ -11,9 +11,7 @@ Copyright 2015 tony-osp (http://tony-osp.dreamwidth.org/)
 #ifndef _CORE_h
 #define _CORE_h
 
-#ifdef ARDUINO
 #include "nntp.h"
-#endif
 #include <inttypes.h>
 #include "port.h"
 #include "settings.h"
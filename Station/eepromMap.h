@@ -74,10 +74,18 @@ Copyright 2014-2015 tony-osp (http://tony-osp.dreamwidth.org/)
 #define SENSOR_OFFSET			257
 #define END_OF_SENSORS_BLOCK	641
 
+// Legacy fixed location of the water counters. These are now kept in the EEPROM journal (see EEJournal.h),
+// old values are imported from here only once, when the journal is created.
 #define ADDR_WWCOUNTERS			642			// last 7 days water counters (16bit, one per day of the week)
 #define	ADDR_TOTAL_WCOUNTER		657			// lifetime water counter, 32bit, updated daily
 #define ADDR_D_WWCOUNTERS		661			// date stamps of the WWCOUNTERS updates, 32bit per date stamp, 7 date stamps
 
+// EEPROM journal (wear-leveled ring of log records), spans two free blocks
+#define ADDR_JOURNAL_BLOCK1		143
+#define END_OF_JOURNAL_BLOCK1	256
+#define ADDR_JOURNAL_BLOCK2		642			// Note: overlaps legacy water counters location
+#define END_OF_JOURNAL_BLOCK2	768
+
 #if ZONE_OFFSET + (ZONE_INDEX * MAX_ZONES) > END_OF_ZONE_BLOCK
 #error Number of Zones is too large
 #endif
@@ -86,9 +94,11 @@ Copyright 2014-2015 tony-osp (http://tony-osp.dreamwidth.org/)
 #error Number of Schedules is too large
 #endif
 
+#ifdef ARDUINO		// host builds (see test/) keep the stations table in memory and may simulate more stations
 #if STATION_OFFSET + (STATION_INDEX * MAX_STATIONS) > END_OF_STATION_BLOCK
 #error Number of Stations is too large
 #endif
+#endif //ARDUINO
 
 #if SENSORS_OFFSET + (SENSORS_INDEX * MAX_SENSORS) > END_OF_SENSORS_BLOCK
 #error Number of Sensors is too large
@@ -18,6 +18,7 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 //#define TRACE_LEVEL			6		// all info
 #include "port.h"
 #include "localUI.h"
+#include "AnalogAcq.h"
 
 // local forward declarations
 
@@ -28,9 +29,9 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 
 byte get_keys_now(void)
 {
-  int val = analogRead(KEY_ANALOG_CHANNEL);
+  uint16_t val = analogAcq.GetRaw(KEY_ANALOG_CHANNEL);	// ADC is owned by the background sampling
 
-  if( val < 0 )   return BUTTON_NONE; // strange input value, treat it as NONE
+  if( val == ANALOGACQ_NO_VALUE ) return BUTTON_NONE;   // not sampled yet
 
   if( val < 30 )  return BUTTON_CONFIRM;  // this is Right Key
 //  if( val < 150 ) return BUTTON_UP;
@@ -25,6 +25,8 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #include "core.h"
 #include "settings.h"
 #include "sensors.h"
+#include "EventBus.h"
+#include "SensorBus.h"
 
 // Data members
 byte OSLocalUI::osUI_State = OSUI_STATE_UNDEFINED;
@@ -40,6 +42,17 @@ ST7036 OSLocalUI::lcd( LOCAL_UI_LCD_Y, LOCAL_UI_LCD_X, 0x78 );
 LiquidCrystal OSLocalUI::lcd(PIN_LCD_RS, PIN_LCD_EN, PIN_LCD_D4, PIN_LCD_D5, PIN_LCD_D6, PIN_LCD_D7);
 #endif
 
+static byte fEventRefresh = false;		// set by the event bus subscriber when zones or schedules state changed
+#ifdef USE_I2C_LCD
+static uint8_t lcdBusDev = SENSORBUS_NO_DEVICE;	// I2C LCD shares the bus with BMP180, updates go through the bus scheduler
+#endif
+
+// Event bus subscriber - request UI refresh on the next loop() pass
+static void UIOnEvent(const SGEvent *pEvent)
+{
+	fEventRefresh = true;
+}
+
 extern  uint8_t		LastReceivedStationID;
 extern	int16_t		LastReceivedRSSI;
 
@@ -115,6 +128,7 @@ byte OSLocalUI::begin(void)
 #ifdef USE_I2C_LCD
      lcd.init();         // I2C library uses different init conventions
 	 lcd.clear();
+	 lcdBusDev = sensorBus.Register(PSTR("LCD"), SENSORBUS_I2C);
 #else
 	 lcd.begin(LOCAL_UI_LCD_X, LOCAL_UI_LCD_Y);         // init LCD with desired dimensions
 #endif
@@ -184,6 +198,9 @@ byte OSLocalUI::begin(void)
    digitalWrite(PIN_BUTTON_3, HIGH);
    digitalWrite(PIN_BUTTON_4, HIGH);
 
+   eventBus.Subscribe(SGEVT_MASK(SGEVT_ZONE_STATE) | SGEVT_MASK(SGEVT_SCHEDULE_START) | SGEVT_MASK(SGEVT_SCHEDULE_STOP) | SGEVT_MASK(SGEVT_PAUSE) | SGEVT_MASK(SGEVT_RUN_SCHEDULES)
+                    | SGEVT_MASK(SGEVT_REMOTE_ZONES) | SGEVT_MASK(SGEVT_REMOTE_SENSORS), UIOnEvent);
+
    return true;    // exit, status - success
 }
 
@@ -194,9 +211,21 @@ byte OSLocalUI::begin(void)
   {
     if( osUI_State != OSUI_STATE_ENABLED ) return true; //UI update disabled, nothing to do - exit
 
-// local UI is enabled, call appropriate handler
+// local UI is enabled, call appropriate handler. Force refresh if zones or schedules state changed since the last pass.
 
-     return callHandler(0);
+#ifdef USE_I2C_LCD
+     if( !sensorBus.Acquire(lcdBusDev) ) return true;	// I2C bus is taken on this pass, update on the next one
+#endif
+
+     byte needs_refresh = fEventRefresh;
+     fEventRefresh = false;
+
+     byte rc = callHandler(needs_refresh);
+
+#ifdef USE_I2C_LCD
+     sensorBus.Release(lcdBusDev);
+#endif
+     return rc;
   }
 
   // Force UI refresh.
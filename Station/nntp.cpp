@@ -6,6 +6,7 @@
 
 #include "nntp.h"
 #include "settings.h"
+#include "TimeSync.h"
 #include <Arduino.h>
 #include <EthernetUdp.h>
 
@@ -135,7 +136,7 @@ void nntp::checkTime()
 		if( t != 0)
 		{
 			t += GetNTPOffset()*3600;
-			setTime(t);
+			timeSync.SetTime(t);
 		}
 //		m_nextSyncTime = now() + 300; //  300 = every 5 minutes
 		tLastSync = millis();
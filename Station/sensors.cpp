@@ -28,455 +28,621 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #include <Wire.h>
 #include "XBeeRF.h"
 #include "RProtocolMS.h"
+#include "SensorAcq.h"
+#include "CounterMeter.h"
+#include "FlowMonitor.h"
 
-#ifdef SENSOR_ENABLE_COUNTERMETER
-#include "TimerOne.h"
-#endif //SENSOR_ENABLE_COUNTERMETER
-
-#ifdef SENSOR_ENABLE_THERMISTOR
-#include "thermistor.h"
-#endif
+#include "AnalogConv.h"
+#include "AnalogAcq.h"
+#include "SensorCheck.h"
 
 // external reference
 extern Logging sdlog;
 
-#ifdef SENSOR_ENABLE_DHT
-// For DHT (AM2301 or similar) sensor we need to have an object, here called "dht_sensor"
-DHT dht_sensor(DHTPIN, DHTTYPE);
-#endif
-
-#ifdef SENSOR_ENABLE_BMP180
-// For BMP180 sensor we need SFE_BMP180 object, here called "bmp180":
-SFE_BMP180 bmp180;
-#endif
-
 // maximum ulong value
 #define MAX_ULONG       4294967295
 
-// local forward declarations
-
-byte  bmp180_Read(int *pressure, int *temperature);
-void  pollSensorIsr(void);
-
-// initialization. Intended to be called from setup()
 //
-// returns TRUE on success and FALSE otherwise
+// Load sensors list from EEPROM and generate the list of remote stations to poll.
 //
-byte Sensors::begin(void)
+// When fKeepReadings is true, last readings are preserved for sensors whose configuration did not change.
+//
+void Sensors::LoadSensorsList(bool fKeepReadings)
 {
-
-// Setup sensors list
-
 		uint8_t			numS = GetNumSensors();
-		
-		if( numS != 0 )	
+		FullSensor		fullSensor;
+		ShortSensor		newConfig;
+
+		fLCDSensors = false;
+		for( uint8_t i=0; i<numS; i++ )
 		{
-			for( uint8_t i=0; i<numS; i++ )
+			LoadSensor(i, &fullSensor);
+			memcpy(sensorNames[i], fullSensor.name, MAX_SENSOR_NAME_LENGTH);
+
+			newConfig.sensorType = fullSensor.sensorType;
+			newConfig.flags = fullSensor.flags;
+			newConfig.sensorStationID = fullSensor.sensorStationID;
+			newConfig.sensorChannel = fullSensor.sensorChannel;
+
+			if( !fKeepReadings || (memcmp(&newConfig, &SensorsList[i].config, sizeof(ShortSensor)) != 0) )
 			{
-				LoadShortSensor(i, &SensorsList[i].config);
+				SensorsList[i].config = newConfig;
+				SensorsList[i].lastReading = 0;
+				SensorsList[i].lastReadingTimestamp = (time_t)(MAX_ULONG/2);
+				SensorsList[i].lastPushed = 0;
+				SensorsList[i].interval = SENSORS_POLL_DEFAULT_REPEAT;
+				SensorsList[i].stable = 0;
+				SensorCheckReset(&SensorsList[i].check);
+			}
 
-				if( SensorsList[i].config.sensorType == SENSOR_TYPE_TEMPERATURE )
-				{
-					fLCDSensors = true;
+			if( SensorsList[i].config.sensorType == SENSOR_TYPE_TEMPERATURE )
+			{
+				fLCDSensors = true;
 #ifdef SENSOR_DEFAULT_LCD_TEMPERATURE
-					iLCDTempIndex = SENSOR_DEFAULT_LCD_TEMPERATURE;
+				iLCDTempIndex = SENSOR_DEFAULT_LCD_TEMPERATURE;
 #else // SENSOR_DEFAULT_LCD_TEMPERATURE
-					iLCDTempIndex = i;
+				iLCDTempIndex = i;
 #endif // SENSOR_DEFAULT_LCD_TEMPERATURE
 
-				}
-				else if( SensorsList[i].config.sensorType == SENSOR_TYPE_HUMIDITY )
-				{
-					fLCDSensors = true;
+			}
+			else if( SensorsList[i].config.sensorType == SENSOR_TYPE_HUMIDITY )
+			{
+				fLCDSensors = true;
 #ifdef SENSOR_DEFAULT_LCD_HUMIDITY
-					iLCDHumidIndex = SENSOR_DEFAULT_LCD_HUMIDITY;
+				iLCDHumidIndex = SENSOR_DEFAULT_LCD_HUMIDITY;
 #else // SENSOR_DEFAULT_LCD_HUMIDITY
-					iLCDHumidIndex = i;
+				iLCDHumidIndex = i;
 #endif // SENSOR_DEFAULT_LCD_HUMIDITY
-				}
-				SensorsList[i].lastReading = 0;
-				SensorsList[i].lastReadingTimestamp = (time_t)(MAX_ULONG/2);
 			}
 		}
 
-// generate the list of remote stations to poll
+// generate the list of remote stations to poll, and cache names of these stations
+
+		uint16_t	stationsMap = 0;	// bitmap of stations that have sensors
+		uint16_t	flowMap = 0;		// bitmap of stations that have waterflow sensors
+
+		for( uint8_t s=0; s<numS; s++ )
+		{
+			if( SensorsList[s].config.sensorStationID < MAX_STATIONS )
+			{
+				stationsMap |= 1 << SensorsList[s].config.sensorStationID;
+				if( (SensorsList[s].config.sensorType == SENSOR_TYPE_WATERFLOW) || (SensorsList[s].config.sensorType == SENSOR_TYPE_FLOWRATE) )
+					flowMap |= 1 << SensorsList[s].config.sensorStationID;
+			}
+		}
 
 		numStationsToPoll = 0;
 		for( uint8_t i=0; i<MAX_STATIONS; i++ )
 		{
-			bool fFound = false;
-
-			for( uint8_t s=0; s<numS; s++ )
+			if( stationsMap & (1 << i) )
 			{
-				if( SensorsList[s].config.sensorStationID == i )
-					fFound = true;
+					FullStation		fullStation;
+
+					LoadStation(i, &fullStation);
+					memcpy(stationNames[i], fullStation.name, MAX_SENSOR_NAME_LENGTH);
+
+					SensorsPollState	*pState = &pollList[numStationsToPoll];
+
+					// first polls are spread a little, so that the requests do not all go out on the same pass
+					pState->stationID = i;
+					pState->flags = (flowMap & (1 << i)) ? SENSORS_POLL_FLOW : 0;
+					pState->misses = 0;
+					pState->period = StationInterval(i);
+					pState->nextPoll = millis() + numStationsToPoll*SENSORS_POLL_SPREAD*1000ul;
+					numStationsToPoll++;
 			}
-			if( fFound )
+		}
+
+		BuildIndex(numS);
+
+		numInFlight = 0;		 // replies to requests sent before (re)configuration are ignored
+		fPushRequired = true;	 // push the first sample after (re)configuration
+}
+
+// (stationID, channel) hash, the table is small so a simple mix is good enough
+static inline uint8_t sensorHash(uint8_t stationID, uint8_t sensorChannel)
+{
+	return uint8_t(stationID * 5 + sensorChannel) & (SENSORS_INDEX_SIZE - 1);
+}
+
+//
+// Build (stationID, channel) -> sensor lookup table. Open addressing with linear probing, the table is twice the
+// maximum number of sensors so probe chains stay short.
+//
+void Sensors::BuildIndex(uint8_t numS)
+{
+		memset(sensorIndex, SENSORS_INDEX_EMPTY, sizeof(sensorIndex));
+
+		for( uint8_t i=0; i<numS; i++ )
+		{
+			if( SensorsList[i].config.sensorType == SENSOR_TYPE_NONE )
+				continue;
+
+			if( FindSensor(SensorsList[i].config.sensorStationID, SensorsList[i].config.sensorChannel) != SENSORS_INDEX_EMPTY )
 			{
-					stationsToPollList[numStationsToPoll] = i;
-					numStationsToPoll++;
+				TRACE_ERROR(F("Sensors - duplicate sensor %u, stationID=%u, channel=%u\n"), uint16_t(i), uint16_t(SensorsList[i].config.sensorStationID), uint16_t(SensorsList[i].config.sensorChannel));
+				continue;		// first definition wins, as with the linear lookup
 			}
+
+			uint8_t		slot = sensorHash(SensorsList[i].config.sensorStationID, SensorsList[i].config.sensorChannel);
+
+			while( sensorIndex[slot] != SENSORS_INDEX_EMPTY )
+				slot = (slot + 1) & (SENSORS_INDEX_SIZE - 1);
+
+			sensorIndex[slot] = i;
 		}
+}
 
-		pollMinutesCounter = 0;  // trigger initial sensor read on the first minute poll
-		nPoll = 0;
+uint8_t Sensors::FindSensor(uint8_t stationID, uint8_t sensorChannel)
+{
+	uint8_t		slot = sensorHash(stationID, sensorChannel);
 
-  // If we have local sensor, Initialize it (it is important to get calibration values stored on the device).
+	while( sensorIndex[slot] != SENSORS_INDEX_EMPTY )
+	{
+		uint8_t		i = sensorIndex[slot];
 
-  // Initialize sensors (it is important to get calibration values stored on the device).
+		if( (SensorsList[i].config.sensorStationID == stationID) && (SensorsList[i].config.sensorChannel == sensorChannel) )
+			return i;
+
+		slot = (slot + 1) & (SENSORS_INDEX_SIZE - 1);
+	}
+	return SENSORS_INDEX_EMPTY;
+}
 
-#ifdef SENSOR_ENABLE_BMP180
-     if( !bmp180.begin() ){
-           TRACE_ERROR(F("BMP180 sensor init failure.\n"));
-     }
-#endif  //   SENSOR_ENABLE_BMP180
+//
+// Analog conversion curve configured for the local sensor channel (ANALOG_CURVE_DEFAULT if the sensor is not defined).
+//
+uint8_t Sensors::LocalCurve(uint8_t sensorChannel)
+{
+	uint8_t		i = FindSensor(GetMyStationID(), sensorChannel);
 
-#ifdef SENSOR_ENABLE_DHT
-     dht_sensor.begin();
-#endif
+	if( i == SENSORS_INDEX_EMPTY )
+		return ANALOG_CURVE_DEFAULT;
+
+	return SENSOR_FLAGS_GET_CURVE(SensorsList[i].config.flags);
+}
 
 #ifdef SENSOR_ENABLE_ANALOG
+//
+// Report filtered value of the analog port. Value is converted using the sensor curve if it is set, otherwise it is scaled
+// linearly from the minV..maxV input range (10 bit ADC codes) to the minVal..maxVal output range.
+//
+void Sensors::ReportAnalog(uint8_t n, uint8_t pin, uint8_t sensorChannel, int16_t minV, int16_t maxV, int16_t minVal, int16_t maxVal)
+{
+	uint16_t	adc = analogAcq.GetValue(pin);		// ANALOGACQ_BITS, 4x the 10 bit range
+	int32_t		val;
+	uint8_t		curve;
 
-#ifdef SENSOR_CHANNEL_ANALOG_1_PIN
-	 pinMode(SENSOR_CHANNEL_ANALOG_1_PIN, INPUT);
-#endif //SENSOR_CHANNEL_ANALOG_1_PIN
+	if( adc == ANALOGACQ_NO_VALUE )
+	{
+		TRACE_ERROR(F("Analog sensor#%u - no reading yet\n"), uint16_t(n));
+		return;
+	}
 
-#ifdef SENSOR_CHANNEL_ANALOG_2_PIN
-	 pinMode(SENSOR_CHANNEL_ANALOG_2_PIN, INPUT);
-#endif //SENSOR_CHANNEL_ANALOG_2_PIN
+	TRACE_VERBOSE(F("Analog sensor#%u reading: %u\n"), uint16_t(n), adc);
 
-#ifdef SENSOR_CHANNEL_ANALOG_3_PIN
-	 pinMode(SENSOR_CHANNEL_ANALOG_3_PIN, INPUT);
-#endif //SENSOR_CHANNEL_ANALOG_3_PIN
+	curve = LocalCurve(sensorChannel);
+	if( curve != ANALOG_CURVE_DEFAULT )
+	{
+		val = AnalogConvert(curve, (adc + 2) >> 2);
+	}
+	else
+	{
+		val = adc;
+		if( val < int32_t(minV)*4 ) val = int32_t(minV)*4;
+		if( val > int32_t(maxV)*4 ) val = int32_t(maxV)*4;
 
-#ifdef SENSOR_CHANNEL_ANALOG_4_PIN
-	 pinMode(SENSOR_CHANNEL_ANALOG_4_PIN, INPUT);
-#endif //SENSOR_CHANNEL_ANALOG_4_PIN
+		val = (val - int32_t(minV)*4) * (maxVal - minVal) / ((int32_t(maxV) - minV)*4) + minVal;
+	}
+	TRACE_VERBOSE(F("Analog sensor#%u converted: %d\n"), uint16_t(n), int(val));
 
+	ReportSensorReading( GetMyStationID(), sensorChannel, int(val) );
+}
 #endif //SENSOR_ENABLE_ANALOG
 
-#ifdef SENSOR_ENABLE_COUNTERMETER
-
-// Counter/Meter is handled using timer-driven polling. Polling is done using ISR driven by Arduino timer
+//
+// Re-read sensors configuration at runtime (after live config reload).
+//
+// Only the sensors list and the stations poll list are rebuilt, sensor hardware is not re-initialized.
+//
+void Sensors::ReloadConfig(void)
+{
+		LoadSensorsList(true);
+		TRACE_INFO(F("Sensors - configuration reloaded, %u sensors\n"), uint16_t(GetNumSensors()));
+}
 
-	 Timer1.initialize(10000);			// timer will fire every 10ms (10,000 microseconds)
-	 Timer1.attachInterrupt(pollSensorIsr);	
+// initialization. Intended to be called from setup()
+//
+// returns TRUE on success and FALSE otherwise
+//
+byte Sensors::begin(void)
+{
+		LoadSensorsList(false);
 
-#ifdef SENSOR_CHANNEL_COUNTERMETER_1_PIN
-	 pinMode(SENSOR_CHANNEL_COUNTERMETER_1_PIN, INPUT);
-	 digitalWrite(SENSOR_CHANNEL_COUNTERMETER_1_PIN, HIGH);
-#endif //SENSOR_CHANNEL_COUNTERMETER_1_PIN
+  // If we have local sensor, Initialize it (it is important to get calibration values stored on the device).
 
-#endif //SENSOR_ENABLE_COUNTERMETER
+     sensorAcq.begin();
 
-#ifdef SENSOR_ENABLE_THERMISTOR
-// Thermistor-based temp sensor
+	 analogAcq.begin();				// Analog and thermistor ports are sampled in background by the ADC interrupt
 
-#ifdef SENSOR_CHANNEL_THERMISTOR_1_PIN
-	 pinMode(SENSOR_CHANNEL_THERMISTOR_1_PIN, INPUT);
-#endif
+#ifdef SENSOR_ENABLE_COUNTERMETER
+	 counterMeter.begin();			// Counter/Meter pulses are counted by pin change interrupts
+	 flowMonitor.begin();
+#endif //SENSOR_ENABLE_COUNTERMETER
 
-#endif //SENSOR_ENABLE_THERMISTOR
 
      return true;
 }
 
+// -- Operation --
+
+// Main loop. Intended to be called regularly (once a second) to handle sensors readings. Usually this will be called from Arduino loop()
+void Sensors::loop(void)
+{
 #ifdef SENSOR_ENABLE_COUNTERMETER
+       counterMeter.loop();                   // drain pulse timestamps and update flow rates
+       flowMonitor.loop();                    // leak and stuck valve detection, needs the flow rate every second
+#endif //SENSOR_ENABLE_COUNTERMETER
+
+       PollScheduler();
+}
+
+#ifdef SENSORS_FAST_POLL
+#define SENSORS_POLL_UNIT		1000ul		// debug - 1 sec instead of 1 minute
+#else
+#define SENSORS_POLL_UNIT		60000ul
+#endif //SENSORS_FAST_POLL
 
-// CounterMeter handling logic
-//
-// CounterMeter input comes in the form of pulses counting water flow. The output (reported values) of the CounterMeter is just the running counter of normalized "ticks".
-// However - resolution of the input pulses (amount of water per tick) is specific to each water meter model, while 
-//  the output (reported values) is expected to be normalized to 1/10 liter per tick.
 //
-// The conversion of model-specific input ticks into normalized ticks is done using following logic:
+// Water may be flowing - a zone output is on, or a schedule is between zones. Zones started by the remote master are not tracked
+// by runState, hence the check of the zone outputs.
 //
-//   - Input (raw) ticks are counted using 16-bit unsigned counter that will automatically handle overflow (no special logic required)
-//		- Input (raw) ticks are counted using ISR, and running counter is checked periodically from the main sensor poller 
-//	 - Sensor poller computes number of raw ticks since last check (delta), and then convers this delta into normalized ticks
-//		- Conversion is done using integer multiplication and then division on 32bit numbers - this is a lot faster than float but gives reasonable precision
-//	 - Converted/normalized tick delta is added to the separate normalized 16bit unsigned counter that is reported as output.
+static bool sensorsZoneActive(void)
+{
+	return (runState.getZone() != 0) || (ActiveZoneNum() != -1);
+}
 
-#ifdef SENSOR_CHANNEL_COUNTERMETER_1_PIN
+//
+// Sensors poll scheduler.
+//
+// Every station that has sensors is polled on its own period. Requests to several stations are kept in flight at once (up to
+// SENSORS_POLL_MAX_INFLIGHT), so a slow or unreachable station does not hold up the others. A reply that did not arrive by the
+// station deadline is a miss, the station is re-polled sooner after the first miss and then less often (see PollMissed()).
+//
+// The reporting sensors pipeline will update the dashboard (in-memory last values), and will log the data at the right frequency
+//
+void Sensors::PollScheduler(void)
+{
+	uint32_t	now = millis();
+	bool		fZoneActive = sensorsZoneActive();
 
-volatile uint8_t  fCounterMeter1 = true;	// flag indicating that there was a change in raw counter. Note: we initialize it as true to ensure initial (empty) refresh.
-volatile uint16_t cCounterMeter1 = 0;	// raw/input ticks counter
+	for( uint8_t n=0; n<numStationsToPoll; n++ )
+	{
+		SensorsPollState	*pState = &pollList[n];
 
-uint16_t	normalizedCM1 = 0;		// this is the output/normalized counter
+		// water is flowing - bring waterflow sensors sample forward
+		if( fZoneActive && (pState->flags & SENSORS_POLL_FLOW) && !(pState->flags & SENSORS_POLL_INFLIGHT) && (long(pState->nextPoll - now) > long(SENSORS_SAMPLE_MIN*SENSORS_POLL_UNIT)) )
+			pState->nextPoll = now + SENSORS_SAMPLE_MIN*SENSORS_POLL_UNIT;
 
-#endif //SENSOR_CHANNEL_COUNTERMETER_1_PIN
+		if( pState->flags & SENSORS_POLL_INFLIGHT )
+		{
+			if( long(now - pState->deadline) >= 0 )
+			{
+				TRACE_ERROR(F("Sensors - no reply from station %u by the deadline\n"), uint16_t(pState->stationID));
+				PollMissed(pState);
+			}
+			continue;
+		}
 
-// poll sensor ISR
-void pollSensorIsr(void)
-{
-#ifdef SENSOR_CHANNEL_COUNTERMETER_1_PIN
-// first counter-meter is enabled, poll it and suppress ringing
+		if( long(now - pState->nextPoll) < 0 )
+			continue;
 
-	static		uint8_t		uOldCounterMeter1 = 0;
-	static		uint8_t		urCounterMeter1 = 0;
+		if( pState->stationID == GetMyStationID() )		// poll local sensors
+		{
+			PollLocal();
+			pState->period = StationInterval(pState->stationID);
+			pState->nextPoll = now + pState->period*SENSORS_POLL_UNIT;
+			continue;
+		}
 
-	register	uint8_t		newCounterMeter1;
+		// remote station. Stations pushing their readings are polled only when the readings become stale, except for waterflow
+		// sensors while water is flowing - their pushes are not frequent enough for leak and flow checks.
+		if( !(fZoneActive && (pState->flags & SENSORS_POLL_FLOW)) && IsStationFresh(pState->stationID) )
+		{
+			TRACE_VERBOSE(F("Sensors - readings of station %u are fresh, skipping poll\n"), uint16_t(pState->stationID));
+			pState->period = StationInterval(pState->stationID);
+			pState->nextPoll = now + pState->period*SENSORS_POLL_UNIT;
+			continue;
+		}
 
-	newCounterMeter1 = digitalRead(SENSOR_CHANNEL_COUNTERMETER_1_PIN);
-	if( newCounterMeter1 != uOldCounterMeter1 )
-	{
-		// CounterMeter1 changed. Handle ring suppression.
+		if( numInFlight >= SENSORS_POLL_MAX_INFLIGHT )
+			continue;				// the station stays due and is polled as soon as a reply frees the slot
 
-		if( urCounterMeter1 < SENSOR_COUNTERMETER_RING_DELAY )
+		TRACE_INFO(F("Sensors - readings of station %u are stale, polling\n"), uint16_t(pState->stationID));
+		if( rprotocol.PollStationSensors(pState->stationID, PollResult, n) )
 		{
-			urCounterMeter1++;
+			pState->flags |= SENSORS_POLL_INFLIGHT;
+			pState->deadline = now + SENSORS_POLL_DEADLINE*1000ul;
+			numInFlight++;
 		}
 		else
-		{
-			uOldCounterMeter1 = newCounterMeter1;
-			if( newCounterMeter1 == SENSOR_CHANNEL_COUNTERMETER_1_ACTIVE )
-			{
-				// OK, we detected change to Active state. 
+			PollMissed(pState);
+	}
+}
 
-				cCounterMeter1++;		// increment global counter for this CounterMeter
-				fCounterMeter1 = true;	// and set a flag indicating the value was changed. This flag is checked and reset by the main program.
-			}
-		}
+//
+// Poll missed - the request failed or the reply did not arrive. First miss is re-polled after SENSORS_POLL_RETRY, further
+// misses back the period off, so that unreachable stations do not keep the in-flight slots busy.
+//
+void Sensors::PollMissed(SensorsPollState *pState)
+{
+	if( pState->flags & SENSORS_POLL_INFLIGHT )
+	{
+		pState->flags &= ~SENSORS_POLL_INFLIGHT;
+		numInFlight--;
 	}
-#endif //SENSOR_CHANNEL_COUNTERMETER_1_PIN
 
-}
+	if( pState->misses < 255 )
+		pState->misses++;
 
-#endif //SENSOR_ENABLE_COUNTERMETER
+	if( pState->misses == 1 )
+	{
+		pState->nextPoll = millis() + SENSORS_POLL_RETRY*SENSORS_POLL_UNIT;
+		return;
+	}
 
+	pState->period = uint16_t(StationInterval(pState->stationID)) << min(pState->misses - 1, SENSORS_POLL_MAX_BACKOFF);
+	pState->nextPoll = millis() + pState->period*SENSORS_POLL_UNIT;
 
-// -- Operation --
+	TRACE_INFO(F("Sensors - station %u missed %u polls, polling every %u minutes\n"), uint16_t(pState->stationID), uint16_t(pState->misses), uint16_t(pState->period));
+}
 
-static unsigned long  old_millis = millis() - 60000ul;             // setup initial condition to make it trigger on the first loop
-// Main loop. Intended to be called regularly  to handle sensors readings. Usually this will be called from Arduino loop()
-void Sensors::loop(void)
+// Sensors poll completion. param is the index of the station in the poll list.
+void Sensors::PollResult(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param)
 {
-       unsigned long  new_millis = millis();    // Note: we are using built-in Arduino millis() function instead of now() or time-zone adjusted LocalNow(), because it is a lot faster
-                                                // and for detecting minutes changes it does not make any difference.
+	if( param >= sensorsModule.numStationsToPoll )
+		return;
 
-#ifdef SENSORS_FAST_POLL
-       if( (new_millis - old_millis) >= 1000 ){   // debug - 1 sec instead of 1 minute
-#else
-	   if( (new_millis - old_millis) >= 60000ul ){   // one minute detection
-#endif //SENSORS_FAST_POLL
-             old_millis = new_millis;             
-             poll_MinTimer();             
-       }
+	SensorsPollState	*pState = &sensorsModule.pollList[param];
+
+	if( (pState->stationID != stationID) || !(pState->flags & SENSORS_POLL_INFLIGHT) )
+		return;				// poll list was rebuilt, or the deadline has already passed
+
+	if( status != RTRANSACTION_OK )
+	{
+		TRACE_ERROR(F("Sensors - poll of station %u failed, status %u\n"), uint16_t(stationID), uint16_t(status));
+		sensorsModule.PollMissed(pState);
+		return;
+	}
+
+	pState->flags &= ~SENSORS_POLL_INFLIGHT;
+	sensorsModule.numInFlight--;
+
+	pState->misses = 0;
+	pState->period = sensorsModule.StationInterval(stationID);
+	pState->nextPoll = millis() + pState->period*SENSORS_POLL_UNIT;
 }
 
+// Change of the reading (in sensor units) that is worth reporting to the EvtMaster
+static int32_t sensorDeadband(uint8_t sensorType)
+{
+	switch( sensorType )
+	{
+		case SENSOR_TYPE_TEMPERATURE:	return SENSOR_DEADBAND_TEMPERATURE;
+		case SENSOR_TYPE_PRESSURE:		return SENSOR_DEADBAND_PRESSURE;
+		case SENSOR_TYPE_HUMIDITY:		return SENSOR_DEADBAND_HUMIDITY;
+		case SENSOR_TYPE_WATERFLOW:		return SENSOR_DEADBAND_WATERFLOW;
+		case SENSOR_TYPE_VOLTAGE:		return SENSOR_DEADBAND_VOLTAGE;
+		case SENSOR_TYPE_FLOWRATE:		return SENSOR_DEADBAND_FLOWRATE;
+	}
+	return 0;
+}
 
-// timer worker for sensors polling.
-// This function will be called once a minute, allowing sensors code to read data if required.
 //
-// The reporting sensors pipeline will update the dashboard (in-memory last values), and will log the data at the right frequency
+// Sampling interval of the station - the shortest adaptive interval of its sensors, or SENSORS_SAMPLE_MIN for waterflow sensors while
+// a zone is running.
 //
-void Sensors::poll_MinTimer(void)
+uint8_t Sensors::StationInterval(uint8_t stationID)
 {
-	pollMinutesCounter--;
-	if( pollMinutesCounter <= 0 )  // required repeat interval check
+	uint8_t		numS = GetNumSensors();
+	uint8_t		interval = SENSORS_SAMPLE_MAX;
+	bool		fZoneActive = sensorsZoneActive();
+
+	for( uint8_t i=0; i<numS; i++ )
 	{
-			pollMinutesCounter = SENSORS_POLL_DEFAULT_REPEAT;	// reload counter
-			nPoll = 0;
+		if( SensorsList[i].config.sensorStationID != stationID )
+			continue;
+
+		if( fZoneActive && ((SensorsList[i].config.sensorType == SENSOR_TYPE_WATERFLOW) || (SensorsList[i].config.sensorType == SENSOR_TYPE_FLOWRATE)) )
+			return SENSORS_SAMPLE_MIN;
+
+		if( SensorsList[i].interval < interval )
+			interval = SensorsList[i].interval;
 	}
+	return interval;
+}
 
-	if( nPoll < numStationsToPoll  )			// we will poll remote sensors next minute after the local sensors. Signal to poll remote sensors will be set by the poll minutes counter logic above.
-	{
-		if( stationsToPollList[nPoll] == GetMyStationID() )	// poll local sensors
-		{
+//
+// Adapt sampling interval of the sensor to the change of the reading since the previous sample. The goal is about one deadband of
+// change per sample - large changes halve the interval, stable readings stretch it.
+//
+void Sensors::AdaptInterval(uint8_t i, int32_t sensorReading)
+{
+	SensorStruct	*pS = &SensorsList[i];
+	int32_t			change = labs(sensorReading - pS->lastReading);
+	int32_t			deadband = sensorDeadband(pS->config.sensorType);
 
-// Local sensors
+	if( pS->lastReadingTimestamp == (time_t)(MAX_ULONG/2) )
+		return;				// first sample, nothing to compare with
 
-#ifdef SENSOR_ENABLE_BMP180
+	if( change > deadband*2 )
+	{
+		pS->stable = 0;
+		if( pS->interval > SENSORS_SAMPLE_MIN )
+		{
+			pS->interval = max(pS->interval/2, SENSORS_SAMPLE_MIN);
+			TRACE_VERBOSE(F("Sensors - sensor %u is changing, sampling every %u minutes\n"), uint16_t(i), uint16_t(pS->interval));
+		}
+	}
+	else if( change*2 <= deadband )
+	{
+		if( ++pS->stable >= SENSORS_SAMPLE_STABLE )
+		{
+			pS->stable = 0;
+			if( pS->interval < SENSORS_SAMPLE_MAX )
 			{
-				int  pressure, temperature;
-
-				// read BMP180 sensor           
-				if( bmp180_Read(&pressure, &temperature) == false ){
-            
-					TRACE_ERROR(F("Failure reading pressure from BMP180.\n"));
-				}
-				else
-				{
-					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_BMP180_TEMPERATURE, temperature );	
-					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_BMP180_PRESSURE, pressure );	
-				}
+				pS->interval = min(uint16_t(pS->interval)*2, SENSORS_SAMPLE_MAX);
+				TRACE_VERBOSE(F("Sensors - sensor %u is stable, sampling every %u minutes\n"), uint16_t(i), uint16_t(pS->interval));
 			}
-#endif  //   SENSOR_ENABLE_BMP180
+		}
+	}
+	else
+		pS->stable = 0;
+}
 
-#ifdef SENSOR_ENABLE_DHT
-			{
-				register int  hum, temp;
-
-				// now read DHT sensor
-				float h = dht_sensor.readHumidity();
-                float t = dht_sensor.readTemperature();
-
-				if( isnan(t) || isnan(h) )
-				{
-					TRACE_ERROR(F("Failure reading temperature or humidity from DHT.\n"));
-
-//					// debugging - temporary hardcode some value here
-//					temp = 10; hum = 20;
- 					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_DHT_TEMPERATURE, temp );	
- 					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_DHT_HUMIDITY, hum );	
-				}
-				else
-				{
-					temp = (int) (dht_sensor.convertCtoF(t) + 0.5);      // convert to int with rounding
-					hum = (int) (h + 0.5);
-
- 					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_DHT_TEMPERATURE, temp );	
- 					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_DHT_HUMIDITY, hum );	
-				}
-			}
-#endif  //   SENSOR_ENABLE_DHT
+//
+// Read local sensors. Readings that need conversion time are completed later by sensorAcq.
+//
+void Sensors::PollLocal(void)
+{
+// BMP180 and DHT need conversion time, they are started here and collected by sensorAcq on the following main loop passes
+	bool	fAcquiring = sensorAcq.Start();
 
 #ifdef SENSOR_ENABLE_ANALOG
-			{
-				int32_t		val;
-#ifdef SENSOR_CHANNEL_ANALOG_1_PIN				
-				val = int32_t(analogRead(SENSOR_CHANNEL_ANALOG_1_PIN));
-
-				TRACE_VERBOSE(F("Analog sensor#1 reading: %d\n"), int(val));
-
-				if( val < SENSOR_CHANNEL_ANALOG_1_MINV ) val = SENSOR_CHANNEL_ANALOG_1_MINV;
-				if( val > SENSOR_CHANNEL_ANALOG_1_MAXV ) val = SENSOR_CHANNEL_ANALOG_1_MAXV;
-
-// to increase precision we are up-converting input signal by multiplying it by 16
-// and by multiplying scaling factor by 16 as well. 
-// It is OK, since input signal is guaranteed to be only 10bit (AtMega ADC).				
-				val = (val-SENSOR_CHANNEL_ANALOG_1_MINV)*16;
-				val = val/(((SENSOR_CHANNEL_ANALOG_1_MAXV-SENSOR_CHANNEL_ANALOG_1_MINV)*16)/(SENSOR_CHANNEL_ANALOG_1_MAXVAL-SENSOR_CHANNEL_ANALOG_1_MINVAL));
-				val = val + SENSOR_CHANNEL_ANALOG_1_MINVAL;
-
-				TRACE_VERBOSE(F("Analog sensor#1 converted: %d\n"), int(val));
-				ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_ANALOG_1_CHANNEL, val );	
+#ifdef SENSOR_CHANNEL_ANALOG_1_PIN
+	ReportAnalog(1, SENSOR_CHANNEL_ANALOG_1_PIN, SENSOR_CHANNEL_ANALOG_1_CHANNEL, SENSOR_CHANNEL_ANALOG_1_MINV, SENSOR_CHANNEL_ANALOG_1_MAXV,
+				 SENSOR_CHANNEL_ANALOG_1_MINVAL, SENSOR_CHANNEL_ANALOG_1_MAXVAL);
 #endif //SENSOR_CHANNEL_ANALOG_1_PIN
 
-#ifdef SENSOR_CHANNEL_ANALOG_2_PIN				
-				val = int32_t(analogRead(SENSOR_CHANNEL_ANALOG_2_PIN));
-
-				TRACE_VERBOSE(F("Analog sensor#2 reading: %d\n"), int(val));
-
-				if( val < SENSOR_CHANNEL_ANALOG_2_MINV ) val = SENSOR_CHANNEL_ANALOG_2_MINV;
-				if( val > SENSOR_CHANNEL_ANALOG_2_MAXV ) val = SENSOR_CHANNEL_ANALOG_2_MAXV;
-
-				val = (val-SENSOR_CHANNEL_ANALOG_2_MINV)*16;
-				val = val/(((SENSOR_CHANNEL_ANALOG_2_MAXV-SENSOR_CHANNEL_ANALOG_2_MINV)*16)/(SENSOR_CHANNEL_ANALOG_2_MAXVAL-SENSOR_CHANNEL_ANALOG_2_MINVAL));
-				val = val + SENSOR_CHANNEL_ANALOG_2_MINVAL;
-				ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_ANALOG_2_CHANNEL, val );
+#ifdef SENSOR_CHANNEL_ANALOG_2_PIN
+	ReportAnalog(2, SENSOR_CHANNEL_ANALOG_2_PIN, SENSOR_CHANNEL_ANALOG_2_CHANNEL, SENSOR_CHANNEL_ANALOG_2_MINV, SENSOR_CHANNEL_ANALOG_2_MAXV,
+				 SENSOR_CHANNEL_ANALOG_2_MINVAL, SENSOR_CHANNEL_ANALOG_2_MAXVAL);
 #endif //SENSOR_CHANNEL_ANALOG_2_PIN
-
-			}
 #endif //SENSOR_ENABLE_ANALOG
 
 #ifdef SENSOR_ENABLE_THERMISTOR
-			{
-				int		val;
-#ifdef SENSOR_CHANNEL_THERMISTOR_1_PIN				
-				val = analogRead(SENSOR_CHANNEL_THERMISTOR_1_PIN);
-				TRACE_VERBOSE(F("Thermistor sensor#1 reading: %d\n"), val);
+#ifdef SENSOR_CHANNEL_THERMISTOR_1_PIN
+	{
+		uint16_t	adc = analogAcq.GetValue(SENSOR_CHANNEL_THERMISTOR_1_PIN);
 
-				val = convertTempInt(val);	// this function will convert raw input value into actual temperature in F.
-				TRACE_VERBOSE(F("Thermistor sensor#1 converted: %d\n"), val);
+		if( adc != ANALOGACQ_NO_VALUE )
+		{
+			TRACE_VERBOSE(F("Thermistor sensor#1 reading: %u\n"), adc);
 
-				ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_THERMISTOR_1_CHANNEL, val );	
-#endif //SENSOR_CHANNEL_THERMISTOR_1_PIN
+			// default curve converts the input value into temperature in F. Conversion tables are 10 bit.
+			int		val = AnalogConvert(LocalCurve(SENSOR_CHANNEL_THERMISTOR_1_CHANNEL), (adc + 2) >> 2);
+			TRACE_VERBOSE(F("Thermistor sensor#1 converted: %d\n"), val);
 
-			}
+			ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_THERMISTOR_1_CHANNEL, val );
+		}
+		else
+			TRACE_ERROR(F("Thermistor sensor#1 - no reading yet\n"));
+	}
+#endif //SENSOR_CHANNEL_THERMISTOR_1_PIN
 #endif //SENSOR_ENABLE_THERMISTOR
 
 
 #ifdef SENSOR_ENABLE_COUNTERMETER
-			{
-#ifdef SENSOR_CHANNEL_COUNTERMETER_1_PIN
+	counterMeter.Report();
+#endif //SENSOR_ENABLE_COUNTERMETER
+
+	if( !fAcquiring )
+		LocalReadingsDone();
+}
 
-				TRACE_VERBOSE(F("CounterMeter1 - flag=%d, counter=%d\n"), int(fCounterMeter1), int(cCounterMeter1));
+//
+// Check whether all readings of the station are recent enough to skip polling it.
+//
+bool Sensors::IsStationFresh(uint8_t stationID)
+{
+	uint8_t		numS = GetNumSensors();
 
-				if( fCounterMeter1 )			// CounterMeter1 registered at least one tick since last check, read it
-				{
-					static		uint16_t	oldCM1 = 0;
-					uint16_t	newCM1;
+	for( uint8_t i=0; i<numS; i++ )
+	{
+		if( (SensorsList[i].config.sensorStationID == stationID) && ((millis() - SensorsList[i].lastReadingTimestamp) >= SENSORS_STALE_TIMEOUT*60000UL) )
+			return false;
+	}
+	return true;
+}
 
-					noInterrupts();
-					newCM1 = cCounterMeter1;		// read current tick counter, have to do it under interrupts
-					fCounterMeter1 = false;			// reset the flag 
-					interrupts();
+//
+// Check whether reading of the sensor is stale - older than SENSORS_STALE_TIMEOUT, or than two polling periods of its station
+// if the station is polled less often (after missed polls).
+//
+bool Sensors::IsSensorStale(uint8_t i)
+{
+	uint32_t	timeout = SENSORS_STALE_TIMEOUT*60000UL;
 
-					// calculate normalized change value
-					uint32_t  delta = newCM1 - oldCM1;	// raw change value
-					oldCM1 = newCM1;
+	for( uint8_t n=0; n<numStationsToPoll; n++ )
+	{
+		if( (pollList[n].stationID == SensorsList[i].config.sensorStationID) && (pollList[n].period*2*SENSORS_POLL_UNIT > timeout) )
+			timeout = pollList[n].period*2*SENSORS_POLL_UNIT;
+	}
 
-					delta = delta * SENSOR_CHANNEL_COUNTERMETER_1_MULT;
-					delta = delta / SENSOR_CHANNEL_COUNTERMETER_1_DIV;
-					
-					normalizedCM1 += uint16_t(delta);	// update the normalized counter
+	return (millis() - SensorsList[i].lastReadingTimestamp) >= timeout;
+}
 
-					ReportSensorReading( GetMyStationID(), SENSOR_CHANNEL_COUNTERMETER_1_CHANNEL, (int)normalizedCM1 );	
-				}
-#endif //SENSOR_CHANNEL_COUNTERMETER_1_PIN
-			}
-#endif //SENSOR_ENABLE_COUNTERMETER
+#ifndef SG_STATION_MASTER
 
-		}
-		else
-		{
-			// poll remote stations
+//
+// Push local readings to the EvtMaster if any of them moved by more than its deadband, or if the heartbeat interval expired.
+//
+// Called after local sensors are sampled.
+//
+void Sensors::PushReadings(void)
+{
+	uint8_t		numS = GetNumSensors();
+	bool		fPush = fPushRequired || ((millis() - lastPushTimestamp) >= SENSORS_PUSH_HEARTBEAT*60000UL);
 
-			rprotocol.PollStationSensors(stationsToPollList[nPoll]);
+	if( !(GetEvtMasterFlags() & EVTMASTER_FLAGS_REPORT_SENSORS) || (numS == 0) )
+		return;
+
+	for( uint8_t i=0; (i<numS) && !fPush; i++ )
+	{
+		if( SensorsList[i].config.sensorStationID == GetMyStationID() )
+		{
+			if( labs(SensorsList[i].lastReading - SensorsList[i].lastPushed) > sensorDeadband(SensorsList[i].config.sensorType) )
+				fPush = true;
 		}
+	}
+
+	if( !fPush )
+		return;
 
-		nPoll++;
+	TRACE_INFO(F("Sensors - pushing readings to station %u\n"), uint16_t(GetEvtMasterStationID()));
+
+	fPushRequired = false;
+	if( !rprotocol.PushSensorsReport(GetEvtMasterStationID(), PushResult) )
+	{
+		fPushRequired = true;
+		return;
 	}
+
+	for( uint8_t i=0; i<numS; i++ )
+		SensorsList[i].lastPushed = SensorsList[i].lastReading;
+	lastPushTimestamp = millis();
 }
 
-#ifdef SENSOR_ENABLE_BMP180
+// Push completion. If the master did not acknowledge the push, the next sample is pushed regardless of the deadband.
+void Sensors::PushResult(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param)
+{
+	if( status != RTRANSACTION_OK )
+	{
+		TRACE_ERROR(F("Sensors - push to station %u failed, status %u\n"), uint16_t(stationID), uint16_t(status));
+		sensorsModule.fPushRequired = true;
+	}
+}
+#endif //SG_STATION_MASTER
 
-// Worker function to read bmp180 pressure sensor.
-// Returns true if successful, false if failed.
-byte bmp180_Read(int *pressure, int *temperature)
+//
+// All local readings of this poll are reported. Remote station pushes them to the master now.
+//
+void Sensors::LocalReadingsDone(void)
 {
-           double T,P;
-
-           byte  status = bmp180.startTemperature();
-           if (status != 0){
-
-               delay(status);  // Wait for the measurement to complete
-
-               // Retrieve the completed temperature measurement:
-               // Note that the measurement is stored in the variable T.
-               // Function returns 1 if successful, 0 if failure.
-
-               status = bmp180.getTemperature(T);
-               if (status != 0){
-    
-                    *temperature = (int) ((9.0/5.0)*T+32.5);    // Sensor reads temp in C, but we want to return temperature in F, also converting it to integer (note 0.5 correction for rounding).
-      
-                    // Start pressure measurement:
-                    // The parameter is the oversampling setting, from 0 to 3 (highest res, longest wait).
-                    // If request is successful, the number of ms to wait is returned.
-                    // If request is unsuccessful, 0 is returned.
-
-                    status = bmp180.startPressure(1);    // accuracy 1 which should be relatively fast.
-                    if (status != 0){
-     
-                         delay(status); // Wait for the measurement to complete
-
-                         // Note that the function requires the previous temperature measurement (T).
-
-                         status = bmp180.getPressure(P,T);      // Function returns 1 if successful, 0 if failure.
-                         if (status != 0)   *pressure = (int) (P + 0.5);  // convert it to int. Note 0.5 correction for rounding
-                         else               return false;  // error retrieving pressure measurement
-                    }
-                    else return false;   // error starting pressure measurement
-               }
-               else return false; // error retrieving temperature measurement
-           }
-           else return false;  // error starting temperature measurement
-
-           return  true;
+#ifndef SG_STATION_MASTER
+	PushReadings();
+#endif //SG_STATION_MASTER
 }
-#endif //SENSOR_ENABLE_BMP180
 
 //
 // Sensor readings dispatch and handling
@@ -487,41 +653,42 @@ byte bmp180_Read(int *pressure, int *temperature)
 //
 void Sensors::ReportSensorReading( uint8_t stationID, uint8_t sensorChannel, int32_t sensorReading )
 {
-	uint8_t			numS = GetNumSensors();
+	uint8_t			i = FindSensor(stationID, sensorChannel);
 
-	for( uint8_t i=0; i<numS; i++ )
+	if( i == SENSORS_INDEX_EMPTY )
 	{
-		if( SensorsList[i].config.sensorType != SENSOR_TYPE_NONE )	// just in case check, ensuring that the entry is valid
-		{
-			if( (SensorsList[i].config.sensorStationID == stationID) && (SensorsList[i].config.sensorChannel == sensorChannel) )
-			{
-				// we found our sensor. Store latest reading and log it.
-				
-				SensorsList[i].lastReading = sensorReading;
-				SensorsList[i].lastReadingTimestamp = millis();
-
-				if( iLCDTempIndex == i )
-				{
-					Temperature = sensorReading;
-				}
-				else if( iLCDHumidIndex == i )
-				{
-					Humidity = sensorReading;
-				}
-#ifdef notdef	// I don't want to proactively send sensor readings to Master, let poller pick it up
-				if( GetEvtMasterFlags() & EVTMASTER_FLAGS_REPORT_SENSORS )
-				{
-					rprotocol.SendSensorsReport(0, GetMyStationID(), GetEvtMasterStationID(), i, 1);
-				}
-#endif //notdef
-				sdlog.LogSensorReading( SensorsList[i].config.sensorType, (int)i, sensorReading );
-				return;
-			}
-		}
+		TRACE_ERROR(F("ReportSensorReading - cannot find sensor, stationID=%d, channel=%d\n"), (int)stationID, (int)sensorChannel);
+		return;
 	}
-// scan complete but we have not found the sensor we need.
 
-	TRACE_ERROR(F("ReportSensorReading - cannot find sensor, stationID=%d, channel=%d\n"), (int)stationID, (int)sensorChannel);
+	// we found our sensor. Validate the reading, then store latest reading and log it.
+
+	SensorStruct	*pS = &SensorsList[i];
+	uint8_t			check = SensorCheck(&pS->check, pS->config.sensorType, sensorReading, pS->lastReading, pS->lastReadingTimestamp != (time_t)(MAX_ULONG/2),
+										millis() - pS->lastReadingTimestamp, sensorDeadband(pS->config.sensorType));
+	if( check != SENSORCHECK_OK )
+	{
+		TRACE_ERROR(F("ReportSensorReading - reading %ld of sensor %u rejected, reason %u\n"), sensorReading, uint16_t(i), uint16_t(check));
+
+		pS->stable = 0;			// sample sooner, to confirm the change or to replace the bad reading
+		if( pS->interval > SENSORS_SAMPLE_MIN )
+			pS->interval = max(pS->interval/2, SENSORS_SAMPLE_MIN);
+		return;
+	}
+
+	AdaptInterval(i, sensorReading);
+	SensorsList[i].lastReading = sensorReading;
+	SensorsList[i].lastReadingTimestamp = millis();
+
+	if( iLCDTempIndex == i )
+	{
+		Temperature = sensorReading;
+	}
+	else if( iLCDHumidIndex == i )
+	{
+		Humidity = sensorReading;
+	}
+	sdlog.LogSensorReading(SensorsList[i].config.sensorType, (int)i, sensorReading);	// logged right away, readings are too frequent for the event bus
 }
 
 // Sensors handling
@@ -531,8 +698,6 @@ void Sensors::ReportSensorReading( uint8_t stationID, uint8_t sensorChannel, int
 bool Sensors::TableLastSensorsData(FILE* stream_file)
 {
 		uint8_t			numS = GetNumSensors();
-		FullSensor		fullSensor;
-		FullStation		fullStation;
 		char			tmp_buf[MAX_SENSOR_NAME_LENGTH+1];
 		
 		if( numS == 0 )	// no sensors to display
@@ -545,28 +710,39 @@ bool Sensors::TableLastSensorsData(FILE* stream_file)
 		
         fprintf_P(stream_file, PSTR("\n\t \"sensors\" : [\n"));    // open the list
 
+		tmp_buf[MAX_SENSOR_NAME_LENGTH] = 0;
 		for( uint8_t i=0; i<numS; i++ )
 		{
-			LoadSensor(i, &fullSensor);
-			LoadStation( fullSensor.sensorStationID, &fullStation);
+			ShortSensor		*pSensor = &SensorsList[i].config;
+			const char		*typeName;
 
 			if( i!= 0 )
 				fprintf_P(stream_file, PSTR("\n\t\t },"));	// close previous sensor record if this is not the first one
 			
-			memcpy( tmp_buf, fullSensor.name, 20 );
+			memcpy( tmp_buf, sensorNames[i], MAX_SENSOR_NAME_LENGTH );
             fprintf_P(stream_file, PSTR("\n\t { \n\t\t \"sensorID\": %u,\n\t\t \"sensorName\": \"%s\","), (unsigned int)i, tmp_buf);
 			
-			if( fullSensor.sensorType == SENSOR_TYPE_TEMPERATURE )	  strcpy_P(tmp_buf, PSTR("Temperature"));
-			else if( fullSensor.sensorType == SENSOR_TYPE_HUMIDITY )  strcpy_P(tmp_buf, PSTR("Humidity"));
-			else if( fullSensor.sensorType == SENSOR_TYPE_PRESSURE )  strcpy_P(tmp_buf, PSTR("Pressure"));
-			else if( fullSensor.sensorType == SENSOR_TYPE_WATERFLOW ) strcpy_P(tmp_buf, PSTR("Waterflow"));
-			else if( fullSensor.sensorType == SENSOR_TYPE_VOLTAGE )   strcpy_P(tmp_buf, PSTR("Voltage"));
-			else													  strcpy_P(tmp_buf, PSTR("Unknown"));
-            fprintf_P(stream_file, PSTR("\n\t\t \"sensorType\": \"%s\","), tmp_buf);
-
-			memcpy( tmp_buf, fullStation.name, 20 );
-			fprintf_P(stream_file, PSTR("\n\t\t \"stationID\": %u, \n\t\t \"stationName\": \"%s\","), (unsigned int)(fullSensor.sensorStationID), tmp_buf);
-			fprintf_P(stream_file, PSTR("\n\t\t \"sensorChannel\": %u, \n\t\t \"lastReading\": %ld,\n\t\t \"readingAge\": %lu"), fullSensor.sensorChannel, SensorsList[i].lastReading, (millis() - SensorsList[i].lastReadingTimestamp)/1000);
+			switch( pSensor->sensorType )
+			{
+				case SENSOR_TYPE_TEMPERATURE:	typeName = PSTR("Temperature");		break;
+				case SENSOR_TYPE_HUMIDITY:		typeName = PSTR("Humidity");		break;
+				case SENSOR_TYPE_PRESSURE:		typeName = PSTR("Pressure");		break;
+				case SENSOR_TYPE_WATERFLOW:		typeName = PSTR("Waterflow");		break;
+				case SENSOR_TYPE_VOLTAGE:		typeName = PSTR("Voltage");			break;
+				case SENSOR_TYPE_FLOWRATE:		typeName = PSTR("Flowrate");		break;
+				default:						typeName = PSTR("Unknown");			break;
+			}
+            fprintf_P(stream_file, PSTR("\n\t\t \"sensorType\": \"%S\","), typeName);
+
+			if( pSensor->sensorStationID < MAX_STATIONS )
+				memcpy( tmp_buf, stationNames[pSensor->sensorStationID], MAX_SENSOR_NAME_LENGTH );
+			else
+				tmp_buf[0] = 0;
+			fprintf_P(stream_file, PSTR("\n\t\t \"stationID\": %u, \n\t\t \"stationName\": \"%s\","), (unsigned int)(pSensor->sensorStationID), tmp_buf);
+			fprintf_P(stream_file, PSTR("\n\t\t \"sensorChannel\": %u, \n\t\t \"lastReading\": %ld,\n\t\t \"readingAge\": %lu"), pSensor->sensorChannel, SensorsList[i].lastReading, (millis() - SensorsList[i].lastReadingTimestamp)/1000);
+			fprintf_P(stream_file, PSTR(",\n\t\t \"rejected\": %u,\n\t\t \"badRate\": %u"), SensorsList[i].check.numRejected, SensorCheckBadRate(&SensorsList[i].check));
+			if( pSensor->sensorStationID != GetMyStationID() )
+				fprintf_P(stream_file, PSTR(",\n\t\t \"stale\": %s"), IsSensorStale(i) ? "true":"false");
 		}
         fprintf_P(stream_file, PSTR("\n\t\t }\n\t ]\n"));    // close the last sensor if we emitted and the list
 
@@ -32,21 +32,34 @@ Copyright 2014 tony-osp (http://tony-osp.dreamwidth.org/)
 #include "sdlog.h"
 #include "settings.h"
 #include "Defines.h"
+#include "SensorCheck.h"
 
-#ifdef SENSOR_ENABLE_BMP180
-#include <SFE_BMP180.h>
-#include <Wire.h>
-#endif
+#define SENSORS_INDEX_SIZE		(MAX_SENSORS*2)		// slots of the (stationID, channel) -> sensor hash table, power of 2
+#define SENSORS_INDEX_EMPTY		0xFF
 
-#ifdef SENSOR_ENABLE_DHT
-#include <DHT.h>
-#endif
+// Poll scheduler state of a station that has sensors
+#define SENSORS_POLL_INFLIGHT	0x01		// request is sent, waiting for the reply
+#define SENSORS_POLL_FLOW		0x02		// station has waterflow sensors, sampled faster while a zone is running
+
+struct SensorsPollState
+{
+	uint8_t			stationID;
+	uint8_t			flags;					// SENSORS_POLL_*
+	uint8_t			misses;					// consecutive polls without reply
+	uint16_t		period;					// current polling period, minutes
+	uint32_t		nextPoll;				// millis() of the next poll
+	uint32_t		deadline;				// millis() by which the reply is expected
+};
 
 struct SensorStruct 
 {
 	ShortSensor		config;
 	int32_t			lastReading;
 	time_t			lastReadingTimestamp;
+	int32_t			lastPushed;				// reading last pushed to the EvtMaster (remote station only)
+	uint8_t			interval;				// adaptive sampling interval, minutes
+	uint8_t			stable;					// consecutive samples that changed by less than half of the deadband
+	SensorCheckState	check;				// readings validation state and bad readings counters
 };
 
 class Sensors {
@@ -57,11 +70,15 @@ public:
   
   // -- Setup --
   byte begin(void);                              // initialization. Intended to be called from setup()
+  void ReloadConfig(void);						 // re-read sensors list after live configuration reload, keeps readings of unchanged sensors
 
     // -- Operation --
   void loop(void);								 // Main loop. Intended to be called regularly and frequently to handle sensors reading and logging. Usually  this will be called from Arduino loop()
   
   void ReportSensorReading( uint8_t stationID, uint8_t sensorChannel, int32_t sensorReading );
+  void LocalReadingsDone(void);					 // local sensors acquisition (see SensorAcq) is complete
+  uint8_t FindSensor(uint8_t stationID, uint8_t sensorChannel);	// sensor index, or SENSORS_INDEX_EMPTY if not found
+  bool IsSensorStale(uint8_t i);				 // reading of the sensor is older than its station polling allows for
   bool TableLastSensorsData(FILE* stream_file);
 
 // Data
@@ -73,16 +90,34 @@ public:
 
 private:
 
-	int				pollMinutesCounter;    
-	byte			fPollRemote;
-	uint8_t			numStationsToPoll;
-	uint8_t			stationsToPollList[MAX_STATIONS];
-	uint8_t			nPoll;
+	uint8_t				numStationsToPoll;
+	uint8_t				numInFlight;
+	SensorsPollState	pollList[MAX_STATIONS];
     
 	uint8_t			iLCDTempIndex;
 	uint8_t			iLCDHumidIndex;
 
-	void			poll_MinTimer(void);
+	// Lookup index and names, rebuilt on (re)configuration so that readings and JSON output need no EEPROM access
+	uint8_t			sensorIndex[SENSORS_INDEX_SIZE];
+	char			sensorNames[MAX_SENSORS][MAX_SENSOR_NAME_LENGTH];
+	char			stationNames[MAX_STATIONS][MAX_SENSOR_NAME_LENGTH];		// names of stations that have sensors
+
+	bool			fPushRequired;			// next sample should be pushed regardless of the deadband (first sample, or previous push failed)
+	time_t			lastPushTimestamp;
+
+	void			PollScheduler(void);
+	void			PollLocal(void);
+	void			PollMissed(SensorsPollState *pState);
+	uint8_t			StationInterval(uint8_t stationID);
+	void			AdaptInterval(uint8_t i, int32_t sensorReading);
+	static void		PollResult(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param);
+	void			LoadSensorsList(bool fKeepReadings);
+	void			BuildIndex(uint8_t numS);
+	uint8_t			LocalCurve(uint8_t sensorChannel);
+	void			ReportAnalog(uint8_t n, uint8_t pin, uint8_t sensorChannel, int16_t minV, int16_t maxV, int16_t minVal, int16_t maxVal);
+	bool			IsStationFresh(uint8_t stationID);
+	void			PushReadings(void);
+	static void		PushResult(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param);
 };
 
 extern Sensors sensorsModule;
@@ -14,10 +14,18 @@ Portions came from sprinklers_pi 2013 Richard Zimmerman (schedule settings handl
 #include "port.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <avr/eeprom.h>
 #include "LocalBoard.h"
 #include <IniFile.h>
 #include "LocalUI.h"
 #include "eepromMap.h"
+#include "EventBus.h"
+#include "SettingsCache.h"
+#include "EEJournal.h"
+#include "core.h"
+#include "sensors.h"
+#include "AnalogConv.h"
 
 
 
@@ -39,13 +47,24 @@ void LoadZone(uint8_t num, FullZone * pZone)
                 return;
         for (uint8_t i = 0; i < sizeof(FullZone); i++)
                 *((char*) pZone + i) = EEPROM.read(ZONE_OFFSET + i + ZONE_INDEX * num);
+
+        if( settingsCache.fValid )		// cached part may have changes not written back yet
+                memcpy(pZone, &settingsCache.zones[num], sizeof(ShortZone));
 }
 
 void SaveZone(uint8_t num, const FullZone * pZone)
 {
         if (num < 0 || num >= GetNumZones())
                 return;
-        for (uint8_t i = 0; i < sizeof(FullZone); i++)
+
+        uint8_t i = 0;
+        if( settingsCache.fValid )		// short part goes through the cache, name is written right away
+        {
+                memcpy(&settingsCache.zones[num], pZone, sizeof(ShortZone));
+                settingsCache.SetZoneDirty(num);
+                i = sizeof(ShortZone);
+        }
+        for (; i < sizeof(FullZone); i++)
                 EEPROM.write(ZONE_OFFSET + i + ZONE_INDEX * num, *((char*) pZone + i));
 }
 
@@ -53,6 +72,12 @@ void LoadShortZone(uint8_t num, ShortZone * pZone)
 {
         if (num < 0 || num >= GetNumZones())
                 return;
+
+        if( settingsCache.fValid )
+        {
+                memcpy(pZone, &settingsCache.zones[num], sizeof(ShortZone));
+                return;
+        }
         for (uint8_t i = 0; i < sizeof(ShortZone); i++)
                 *((char*) pZone + i) = EEPROM.read(ZONE_OFFSET + i + ZONE_INDEX * num);
 }
@@ -111,12 +136,21 @@ void LoadStation(uint8_t num, FullStation *pStation)
                 return;
         for (uint8_t i = 0; i < sizeof(FullStation); i++)
                 *((char*) pStation + i) = EEPROM.read(STATION_OFFSET + i + STATION_INDEX * num);
+
+        if( settingsCache.fValid )		// cached part may have changes not written back yet
+                memcpy(pStation, &settingsCache.stations[num], sizeof(ShortStation));
 }
 
 void LoadShortStation(uint8_t num, ShortStation *pStation)
 {
         if( num >= MAX_STATIONS )
                 return;
+
+        if( settingsCache.fValid )
+        {
+                memcpy(pStation, &settingsCache.stations[num], sizeof(ShortStation));
+                return;
+        }
         for (uint8_t i = 0; i < sizeof(ShortStation); i++)
                 *((char*) pStation + i) = EEPROM.read(STATION_OFFSET + i + STATION_INDEX * num);
 }
@@ -125,7 +159,15 @@ void SaveStation(uint8_t num, FullStation * pStation)
 {
         if( num >= MAX_STATIONS )
                 return;
-        for (uint8_t i = 0; i < sizeof(FullStation); i++)
+
+        uint8_t i = 0;
+        if( settingsCache.fValid )		// short part goes through the cache, name is written right away
+        {
+                memcpy(&settingsCache.stations[num], pStation, sizeof(ShortStation));
+                settingsCache.SetStationDirty(num);
+                i = sizeof(ShortStation);
+        }
+        for (; i < sizeof(FullStation); i++)
                 EEPROM.write(STATION_OFFSET + i + STATION_INDEX * num, *((char*) pStation + i));
 }
 
@@ -133,6 +175,13 @@ void SaveShortStation(uint8_t num, ShortStation * pStation)
 {
         if( num >= MAX_STATIONS )
                 return;
+
+        if( settingsCache.fValid )		// deferred write, see settingsCache.flush()
+        {
+                memcpy(&settingsCache.stations[num], pStation, sizeof(ShortStation));
+                settingsCache.SetStationDirty(num);
+                return;
+        }
         for (uint8_t i = 0; i < sizeof(ShortStation); i++)
                 EEPROM.write(STATION_OFFSET + i + STATION_INDEX * num, *((char*) pStation + i));
 }
@@ -144,12 +193,21 @@ void LoadSensor(uint8_t num, FullSensor *pSensor)
                 return;
         for (uint8_t i = 0; i < sizeof(FullSensor); i++)
                 *((char*) pSensor + i) = EEPROM.read(SENSOR_OFFSET + i + SENSOR_INDEX * num);
+
+        if( settingsCache.fValid )		// cached part may have changes not written back yet
+                memcpy(pSensor, &settingsCache.sensors[num], sizeof(ShortSensor));
 }
 
 void LoadShortSensor(uint8_t num, ShortSensor *pSensor)
 {
         if( num >= MAX_SENSORS )
                 return;
+
+        if( settingsCache.fValid )
+        {
+                memcpy(pSensor, &settingsCache.sensors[num], sizeof(ShortSensor));
+                return;
+        }
         for (uint8_t i = 0; i < sizeof(ShortSensor); i++)
                 *((char*) pSensor + i) = EEPROM.read(SENSOR_OFFSET + i + SENSOR_INDEX * num);
 }
@@ -159,7 +217,15 @@ void SaveSensor(uint8_t num, FullSensor * pSensor)
 {
         if( num >= MAX_SENSORS )
                 return;
-        for (uint8_t i = 0; i < sizeof(FullSensor); i++)
+
+        uint8_t i = 0;
+        if( settingsCache.fValid )		// short part goes through the cache, name is written right away
+        {
+                memcpy(&settingsCache.sensors[num], pSensor, sizeof(ShortSensor));
+                settingsCache.SetSensorDirty(num);
+                i = sizeof(ShortSensor);
+        }
+        for (; i < sizeof(FullSensor); i++)
                 EEPROM.write(SENSOR_OFFSET + i + SENSOR_INDEX * num, *((char*) pSensor + i));
 }
 
@@ -167,11 +233,17 @@ void SaveShortSensor(uint8_t num, ShortSensor * pSensor)
 {
         if( num >= MAX_SENSORS )
                 return;
+
+        if( settingsCache.fValid )		// deferred write, see settingsCache.flush()
+        {
+                memcpy(&settingsCache.sensors[num], pSensor, sizeof(ShortSensor));
+                settingsCache.SetSensorDirty(num);
+                return;
+        }
         for (uint8_t i = 0; i < sizeof(ShortSensor); i++)
                 EEPROM.write(SENSOR_OFFSET + i + SENSOR_INDEX * num, *((char*) pSensor + i));
 }
 
-
 Schedule::Schedule() : m_type(0), day(0)
 {
         name[0] = 0;
@@ -191,18 +263,57 @@ void LoadSchedule(uint8_t num, Schedule * pSched)
         }
 }
 
+void LoadShortSchedule(uint8_t num, ShortSchedule * pSched)
+{
+        if (num < 0 || num >= MAX_SCHEDULES)
+                return;
+
+        if( settingsCache.fValid )
+        {
+                *pSched = settingsCache.schedules[num];
+                return;
+        }
+
+        Schedule sched;
+        LoadSchedule(num, &sched);
+        sched.GetShortSchedule(pSched);
+}
+
+void Schedule::GetShortSchedule(ShortSchedule *pShort) const
+{
+        pShort->type = m_type;
+        pShort->day = day;
+        for (uint8_t j = 0; j < 4; j++)
+                pShort->time[j] = time[j];
+
+        pShort->firstZone = SCHEDULE_NO_ZONES;
+        for (uint8_t z = 0; z < MAX_ZONES; z++)
+        {
+                if( zone_duration[z] != 0 )
+                {
+                        pShort->firstZone = z;
+                        break;
+                }
+        }
+}
+
 void SaveSchedule(uint8_t num, const Schedule * pSched)
 {
         if (num < 0 || num >= MAX_SCHEDULES)
                 return;
         for (uint8_t i = 0; i < sizeof(Schedule); i++)
                 EEPROM.write(SCHEDULE_OFFSET + i + SCHEDULE_INDEX * num, *((char*) pSched + i));
+
+        settingsCache.UpdateSchedule(num, pSched);
 }
 
 
 
 uint8_t GetNumZones(void)
 {
+	if( settingsCache.fValid )
+		return settingsCache.numZones;
+
 	return EEPROM.read(ADDR_NUM_ZONES);
 }
 
@@ -220,6 +331,7 @@ uint8_t GetPumpChannel(void)
 void SetNumZones(uint8_t numZones)
 {
 	EEPROM.write(ADDR_NUM_ZONES, numZones);
+	settingsCache.numZones = numZones;
 }
 
 void SetPumpStation(uint8_t pumpStation)
@@ -379,36 +491,33 @@ void SetMoteinoRFAddr(uint8_t addr)
 	EEPROM.write(ADDR_NETWORK_MOTEINORF_NODEID, addr);
 }
 
+// Station relays frames of other stations if relaying is enabled on any of its networks
+bool IsRelayEnabled(void)
+{
+	return ((GetXBeeFlags() | GetMoteinoRFFlags()) & NETWORK_FLAGS_RELAY) ? true:false;
+}
+
 
 // other settings
 
 uint8_t GetMyStationID(void)
 {
+	if( settingsCache.fValid )
+		return settingsCache.myStationID;
+
 	return EEPROM.read(ADDR_MY_STATION_ID);
 }
 
 void SetMyStationID(uint8_t stationID)
 {
 	EEPROM.write(ADDR_MY_STATION_ID, stationID);
+	settingsCache.myStationID = stationID;
 }
 
-inline void setEEPROM2bytes(int addr, uint16_t value)
-{
-	register uint8_t vh = (value & 0x0FF00) >> 8;
-	register uint8_t vl = value & 0x0FF;
-
-	EEPROM.write(addr, vl);
-	EEPROM.write(addr+1, vh);
-}
-
-inline uint16_t getEEPROM2bytes(int addr)
-{
-	register uint16_t val;
-
-	val =  EEPROM.read(addr+1) << 8;
-	val += EEPROM.read(addr);
-	return val;
-}
+//
+// Water counters are updated often, so these are kept in the wear-leveled EEPROM journal (see EEJournal.h).
+// Each day of the week has one journal record, holding both the counter and the day number of the last update.
+//
 
 void SetWWCounter(uint8_t cID, uint16_t value)
 {
@@ -416,12 +525,12 @@ void SetWWCounter(uint8_t cID, uint16_t value)
 
 	if( cID > 6 ) return;	// basic protection - range checking
 
-	setEEPROM2bytes(ADDR_WWCOUNTERS+cID*2, value);
+	eeJournal.Write(JOURNAL_KEY_WWCOUNTER+cID, (eeJournal.Read(JOURNAL_KEY_WWCOUNTER+cID) & 0xFFFF0000ul) | value);
 }
 
 inline uint16_t internalGetWWCounter(uint8_t cID)
 {
-	return getEEPROM2bytes(ADDR_WWCOUNTERS+cID*2);
+	return uint16_t(eeJournal.Read(JOURNAL_KEY_WWCOUNTER+cID));
 }
 
 inline void checkWWCounter(uint8_t cID)
@@ -434,8 +543,7 @@ inline void checkWWCounter(uint8_t cID)
 	if( (day(t)!=day(last_t)) || (month(t)!=month(last_t)) || (year(t)!=year(last_t)) )
 	{
 		SetTotalWCounter(GetTotalWCounter() + uint32_t(internalGetWWCounter(dow)/100));	// note: running water counters are in 1/100 GPM, while lifetime water counter is in GPM
-		SetWCounterDate(dow,t);
-		SetWWCounter(dow, 0);
+		eeJournal.Write(JOURNAL_KEY_WWCOUNTER+dow, uint32_t(elapsedDays(t)) << 16);		// new date stamp and zero counter, in one journal record
 	}
 }
 
@@ -447,49 +555,27 @@ uint16_t GetWWCounter(uint8_t cID)
 	return internalGetWWCounter(cID);
 }
 
-
-inline void setEEPROM4bytes(int addr, uint32_t *pVal)
-{
-	register uint8_t *pB = (uint8_t *) pVal;
-
-	EEPROM.write(addr, pB[0]);
-	EEPROM.write(addr+1, pB[1]);
-	EEPROM.write(addr+2, pB[2]);
-	EEPROM.write(addr+3, pB[3]);
-}
-
-inline uint32_t getEEPROM4bytes(int addr)
-{
-	uint32_t val;
-	register uint8_t *pB;
-	pB = (uint8_t *) &val;
-
-	pB[0] = EEPROM.read(addr);
-	pB[1] = EEPROM.read(addr+1);
-	pB[2] = EEPROM.read(addr+2);
-	pB[3] = EEPROM.read(addr+3);
-
-	return val;
-}
-
 void SetTotalWCounter(uint32_t val)
 {
-	setEEPROM4bytes(ADDR_TOTAL_WCOUNTER, &val);
+	eeJournal.Write(JOURNAL_KEY_TOTAL_WCOUNTER, val);
 }
 
 uint32_t GetTotalWCounter(void)
 {
-	return getEEPROM4bytes(ADDR_TOTAL_WCOUNTER);
+	return eeJournal.Read(JOURNAL_KEY_TOTAL_WCOUNTER);
 }
 
+// Note: date stamps are stored with one day resolution
 uint32_t GetWCounterDate(uint8_t cID)
 {
-	return getEEPROM4bytes(ADDR_D_WWCOUNTERS+cID*4);
+	return (eeJournal.Read(JOURNAL_KEY_WWCOUNTER+cID) >> 16) * SECS_PER_DAY;
 }
 
 void SetWCounterDate(uint8_t cID, uint32_t val)
 {
-	setEEPROM4bytes(ADDR_D_WWCOUNTERS+cID*4, &val);
+	if( cID > 6 ) return;
+
+	eeJournal.Write(JOURNAL_KEY_WWCOUNTER+cID, (uint32_t(elapsedDays(val)) << 16) | internalGetWWCounter(cID));
 }
 
 
@@ -564,7 +650,7 @@ bool SetSchedule(const KVPairs & key_value_pairs)
                 else if ((key[0] == 't') && (key[2] == 0) && ((key[1] >= '1') && (key[1] <= '4')))
                 {
                         const char * colon_loc = strstr(value, ":");
-                        if (colon_loc > 0)
+                        if (colon_loc != NULL)
                         {
                                 int hour = strtol(value, NULL, 10);
                                 int minute = strtol(colon_loc + 1, NULL, 10);
@@ -813,490 +899,870 @@ bool SetSettings(const KVPairs & key_value_pairs)
 }
 
 
-//  Load EEPROM from an INI file
+#ifdef HW_ENABLE_SD
 //
-//	This operation is performed to rebuild IO topology or change other hardware config.
-//	When completed successfully this process will fully populate EEPROM (including signature).
+// Single-pass device.ini import.
 //
-//	Returns true if all required settings were loaded from ini file, and false otherwise.
-//  Note: When particular setting(s) are missing from ini file, defaults are used instead.
+// device.ini is read in one sequential pass (IniFile::browse()), and each key is dispatched through the iniKeys table
+// into the IniImport staging structure. Once the whole file is read, staged values are written into EEPROM using the same
+// order, defaults and validation rules as the original per-key import.
+//
+// Sensor names don't fit the staging structure. EEPROM slot of a sensor is known only once all sensors are validated, so names
+// are read by a second pass over the file (iniWriteSensorNames()), which writes each name directly into the slot of its sensor.
+// Slots of skipped sensors are not touched, same as with the per-key import.
 //
-void ResetEEPROM()
-{
-#ifdef SG_WDT_ENABLED
-	wdt_disable();
-#endif // SG_WDT_ENABLED
-
-	bool  retcode = true;
-
-	const size_t bufferLen = 128;
-	char buffer[bufferLen];			// Temp buffer for ini file processing. Must be big enough to hold one line
-	char		tmpb[16];			// worker buffer
-
-	strcpy_P(buffer, PSTR(EEPROM_INI_FILE));	// to avoid wasting space use common buffer for the file name init
-	IniFile ini(buffer);
 
-	localUI.lcd_print_line_clear_pgm(PSTR("Resetting EEPROM"), 1);
+// ini file sections
+#define INI_SECT_NETWORK			0
+#define INI_SECT_SYSTEM				1
+#define INI_SECT_LOCALCHANNELS		2
+#define INI_SECT_PARALLELIOMAP		3
+#define INI_SECT_SERIALIOMAP		4
+#define INI_SECT_STATIONS			5
+#define INI_SECT_STATION			6		// [StationN]
+#define INI_SECT_SENSORS			7
+#define INI_SECT_SENSOR				8		// [SensorN]
+#define INI_SECT_XBEE				9
+#define INI_SECT_RFM69				10
+#define INI_SECT_UNKNOWN			0xFF
+
+// value types
+#define INI_TYPE_IP					0		// dotted IP address, stored as uint32_t
+#define INI_TYPE_U16				1		// number, truncated to 16 bits
+#define INI_TYPE_YESNO				2		// Yes/yes/YES -> 1, anything else -> 0
+#define INI_TYPE_POLARITY			3		// Positive/Negative -> OT_DIRECT_POS/OT_DIRECT_NEG, anything else -> OT_NONE
+#define INI_TYPE_NETWORK			4		// Parallel/Serial/XBee/RFM69 -> NETWORK_ID_*, anything else -> NETWORK_ID_INVALID
+#define INI_TYPE_SENSORTYPE			5		// Temperature/Pressure/Humidity/Waterflow/Voltage/Flowrate -> SENSOR_TYPE_*, anything else -> SENSOR_TYPE_NONE
+#define INI_TYPE_NAME				6		// sensor name, only its presence is recorded (see iniWriteSensorNames())
+
+struct IniStationDef						// [StationN]
+{
+	uint16_t	stationID;
+	uint16_t	numChannels;
+	uint16_t	netAddr;
+	uint8_t		netID;
+	uint8_t		fRAccess;
+	uint8_t		present;					// bitmap of keys found in the section
+};
+
+struct IniSensorDef							// [SensorN]
+{
+	uint16_t	station;
+	uint16_t	channel;
+	uint16_t	curve;
+	uint8_t		type;
+	uint8_t		present;
+};
+
+struct IniImport
+{
+	uint32_t	ip;							// IP addresses are kept as uint32_t to keep IniImport plain data
+	uint32_t	subnet;
+	uint32_t	gateway;
+	uint32_t	ntpServer;
+	uint16_t	webPort;
+	uint16_t	zip;
+	uint16_t	seasonalAdj;
+	uint16_t	numParallel;
+	uint16_t	numSerial;
+	uint8_t		parallelPolarity;
+	uint16_t	srClkPin;
+	uint16_t	srNoePin;
+	uint16_t	srDatPin;
+	uint16_t	srLatPin;
+	uint16_t	numStations;
+	uint16_t	myStationID;
+	uint16_t	numSensors;
+	uint8_t		xbeeEnabled;
+	uint16_t	xbeePort;
+	uint16_t	xbeeSpeed;
+	uint16_t	xbeePANID;
+	uint16_t	xbeeChan;
+	uint8_t		xbeeRelay;
+	uint8_t		rfmEnabled;
+	uint16_t	rfmPANID;
+	uint8_t		rfmRelay;
+
+	uint32_t	present;					// bitmap of global keys found in the file, one bit per iniKeys entry
 
-#ifndef HW_ENABLE_SD
-//
-// SD is not enabled, so we have to create default config. 
-//
-	ResetEEPROM_NoSD(DEFAULT_STATION_ID);
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+	uint8_t		zoneToIOMap[LOCAL_NUM_DIRECT_CHANNELS];
+	uint16_t	ioMapPresent;
+#endif //LOCAL_NUM_DIRECT_CHANNELS
 
-#else // HW_ENABLE_SD
-	if( !ini.open() )
+	IniStationDef	stations[MAX_STATIONS];
+	IniSensorDef	sensors[MAX_SENSORS];
+};
+
+#define INI_NO_SLOT					0xFF
+
+struct IniNamePass							// context of the sensor names pass
+{
+	uint8_t		slot[MAX_SENSORS];			// EEPROM slot of the [SensorN] sensor (N-1), or INI_NO_SLOT if the sensor is skipped
+	uint16_t	seen;						// bitmap of names written, first occurrence of the key wins
+	bool		fChanged;					// at least one name was different from EEPROM
+};
+
+#define INI_LINE_LENGTH				128		// ini file line buffer, must be big enough to hold one line
+
+// Work area of the import. ResetEEPROM and ReloadConfig are called from the web server handler, deep in the stack already,
+// so this is kept static rather than on the stack. Only one import runs at a time.
+static struct
+{
+	char			line[INI_LINE_LENGTH];
+	IniImport		imp;
+	IniNamePass		names;
+	ShortStation	stations[MAX_STATIONS];		// new stations table built by ReloadConfig
+} iniWork;
+
+struct IniKeyDef
+{
+	char		key[17];
+	uint8_t		section;
+	uint8_t		type;
+	uint8_t		offset;						// offset of the target field in IniImport, IniStationDef or IniSensorDef
+	uint8_t		bit;						// presence bit
+};
+
+#define INI_STATION_KEY_ID			0
+#define INI_STATION_KEY_CHANNELS	1
+#define INI_STATION_KEY_NETWORK		2
+#define INI_STATION_KEY_ADDRESS		3
+#define INI_STATION_KEY_RACCESS		4
+
+#define INI_SENSOR_KEY_TYPE			0
+#define INI_SENSOR_KEY_STATION		1
+#define INI_SENSOR_KEY_CHANNEL		2
+#define INI_SENSOR_KEY_NAME			3
+#define INI_SENSOR_KEY_CURVE		4
+
+#define INI_KEY_IP					0
+#define INI_KEY_SUBNET				1
+#define INI_KEY_GATEWAY				2
+#define INI_KEY_WEBPORT				3
+#define INI_KEY_NTPSERVER			4
+#define INI_KEY_ZIP					5
+#define INI_KEY_SEASONALADJ			6
+#define INI_KEY_NUMPARALLEL			7
+#define INI_KEY_NUMSERIAL			8
+#define INI_KEY_POLARITY			9
+#define INI_KEY_SRCLKPIN			10
+#define INI_KEY_SRNOEPIN			11
+#define INI_KEY_SRDATPIN			12
+#define INI_KEY_SRLATPIN			13
+#define INI_KEY_NUMSTATIONS			14
+#define INI_KEY_MYSTATIONID			15
+#define INI_KEY_NUMSENSORS			16
+#define INI_KEY_XBEE_ENABLED		17
+#define INI_KEY_XBEE_PORT			18
+#define INI_KEY_XBEE_SPEED			19
+#define INI_KEY_XBEE_PANID			20
+#define INI_KEY_XBEE_CHANNEL		21
+#define INI_KEY_RFM_ENABLED			22
+#define INI_KEY_RFM_PANID			23
+#define INI_KEY_XBEE_RELAY			24
+#define INI_KEY_RFM_RELAY			25
+
+#define INI_PRESENT(p, k)			((p)->present & (uint32_t(1) << (k)))
+
+static const IniKeyDef iniKeys[] PROGMEM = {
+	{"IP",				INI_SECT_NETWORK,		INI_TYPE_IP,		offsetof(IniImport, ip),			INI_KEY_IP},
+	{"Subnet",			INI_SECT_NETWORK,		INI_TYPE_IP,		offsetof(IniImport, subnet),		INI_KEY_SUBNET},
+	{"Gateway",			INI_SECT_NETWORK,		INI_TYPE_IP,		offsetof(IniImport, gateway),		INI_KEY_GATEWAY},
+	{"WebPort",			INI_SECT_NETWORK,		INI_TYPE_U16,		offsetof(IniImport, webPort),		INI_KEY_WEBPORT},
+	{"NTPServer",		INI_SECT_NETWORK,		INI_TYPE_IP,		offsetof(IniImport, ntpServer),		INI_KEY_NTPSERVER},
+	{"Zip",				INI_SECT_SYSTEM,		INI_TYPE_U16,		offsetof(IniImport, zip),			INI_KEY_ZIP},
+	{"SeasonalAdj",		INI_SECT_SYSTEM,		INI_TYPE_U16,		offsetof(IniImport, seasonalAdj),	INI_KEY_SEASONALADJ},
+	{"NumParallel",		INI_SECT_LOCALCHANNELS,	INI_TYPE_U16,		offsetof(IniImport, numParallel),	INI_KEY_NUMPARALLEL},
+	{"NumSerial",		INI_SECT_LOCALCHANNELS,	INI_TYPE_U16,		offsetof(IniImport, numSerial),		INI_KEY_NUMSERIAL},
+	{"ParallelPolarity",INI_SECT_LOCALCHANNELS,	INI_TYPE_POLARITY,	offsetof(IniImport, parallelPolarity),	INI_KEY_POLARITY},
+	{"SrClkPin",		INI_SECT_SERIALIOMAP,	INI_TYPE_U16,		offsetof(IniImport, srClkPin),		INI_KEY_SRCLKPIN},
+	{"SrNoePin",		INI_SECT_SERIALIOMAP,	INI_TYPE_U16,		offsetof(IniImport, srNoePin),		INI_KEY_SRNOEPIN},
+	{"SrDatPin",		INI_SECT_SERIALIOMAP,	INI_TYPE_U16,		offsetof(IniImport, srDatPin),		INI_KEY_SRDATPIN},
+	{"SrLatPin",		INI_SECT_SERIALIOMAP,	INI_TYPE_U16,		offsetof(IniImport, srLatPin),		INI_KEY_SRLATPIN},
+	{"NumStations",		INI_SECT_STATIONS,		INI_TYPE_U16,		offsetof(IniImport, numStations),	INI_KEY_NUMSTATIONS},
+	{"MyStationID",		INI_SECT_STATIONS,		INI_TYPE_U16,		offsetof(IniImport, myStationID),	INI_KEY_MYSTATIONID},
+	{"NumSensors",		INI_SECT_SENSORS,		INI_TYPE_U16,		offsetof(IniImport, numSensors),	INI_KEY_NUMSENSORS},
+	{"Enabled",			INI_SECT_XBEE,			INI_TYPE_YESNO,		offsetof(IniImport, xbeeEnabled),	INI_KEY_XBEE_ENABLED},
+	{"Port",			INI_SECT_XBEE,			INI_TYPE_U16,		offsetof(IniImport, xbeePort),		INI_KEY_XBEE_PORT},
+	{"Speed",			INI_SECT_XBEE,			INI_TYPE_U16,		offsetof(IniImport, xbeeSpeed),		INI_KEY_XBEE_SPEED},
+	{"PANID",			INI_SECT_XBEE,			INI_TYPE_U16,		offsetof(IniImport, xbeePANID),		INI_KEY_XBEE_PANID},
+	{"Channel",			INI_SECT_XBEE,			INI_TYPE_U16,		offsetof(IniImport, xbeeChan),		INI_KEY_XBEE_CHANNEL},
+	{"Relay",			INI_SECT_XBEE,			INI_TYPE_YESNO,		offsetof(IniImport, xbeeRelay),		INI_KEY_XBEE_RELAY},
+	{"Enabled",			INI_SECT_RFM69,			INI_TYPE_YESNO,		offsetof(IniImport, rfmEnabled),	INI_KEY_RFM_ENABLED},
+	{"PANID",			INI_SECT_RFM69,			INI_TYPE_U16,		offsetof(IniImport, rfmPANID),		INI_KEY_RFM_PANID},
+	{"Relay",			INI_SECT_RFM69,			INI_TYPE_YESNO,		offsetof(IniImport, rfmRelay),		INI_KEY_RFM_RELAY},
+
+	{"StationID",		INI_SECT_STATION,		INI_TYPE_U16,		offsetof(IniStationDef, stationID),		INI_STATION_KEY_ID},
+	{"NumChannels",		INI_SECT_STATION,		INI_TYPE_U16,		offsetof(IniStationDef, numChannels),	INI_STATION_KEY_CHANNELS},
+	{"NetworkID",		INI_SECT_STATION,		INI_TYPE_NETWORK,	offsetof(IniStationDef, netID),			INI_STATION_KEY_NETWORK},
+	{"NetworkAddress",	INI_SECT_STATION,		INI_TYPE_U16,		offsetof(IniStationDef, netAddr),		INI_STATION_KEY_ADDRESS},
+	{"RAccess",			INI_SECT_STATION,		INI_TYPE_YESNO,		offsetof(IniStationDef, fRAccess),		INI_STATION_KEY_RACCESS},
+
+	{"Type",			INI_SECT_SENSOR,		INI_TYPE_SENSORTYPE,	offsetof(IniSensorDef, type),		INI_SENSOR_KEY_TYPE},
+	{"Station",			INI_SECT_SENSOR,		INI_TYPE_U16,		offsetof(IniSensorDef, station),		INI_SENSOR_KEY_STATION},
+	{"Channel",			INI_SECT_SENSOR,		INI_TYPE_U16,		offsetof(IniSensorDef, channel),		INI_SENSOR_KEY_CHANNEL},
+	{"Name",			INI_SECT_SENSOR,		INI_TYPE_NAME,		0,									INI_SENSOR_KEY_NAME},
+	{"Curve",			INI_SECT_SENSOR,		INI_TYPE_U16,		offsetof(IniSensorDef, curve),			INI_SENSOR_KEY_CURVE},
+};
+
+// Map section name to the section ID. For [StationN] and [SensorN] also returns N (numbered from 1).
+static uint8_t iniSection(const char *section, uint8_t *pIndex)
+{
+	*pIndex = 0;
+
+	if( strcasecmp_P(section, PSTR("Network")) == 0 )			return INI_SECT_NETWORK;
+	if( strcasecmp_P(section, PSTR("System")) == 0 )			return INI_SECT_SYSTEM;
+	if( strcasecmp_P(section, PSTR("LocalChannels")) == 0 )		return INI_SECT_LOCALCHANNELS;
+	if( strcasecmp_P(section, PSTR("ParallelIOMap")) == 0 )		return INI_SECT_PARALLELIOMAP;
+	if( strcasecmp_P(section, PSTR("SerialIOMap")) == 0 )		return INI_SECT_SERIALIOMAP;
+	if( strcasecmp_P(section, PSTR("Stations")) == 0 )			return INI_SECT_STATIONS;
+	if( strcasecmp_P(section, PSTR("Sensors")) == 0 )			return INI_SECT_SENSORS;
+	if( strcasecmp_P(section, PSTR("XBee")) == 0 )				return INI_SECT_XBEE;
+	if( strcasecmp_P(section, PSTR("RFM69")) == 0 )				return INI_SECT_RFM69;
+
+	if( (strncasecmp_P(section, PSTR("Station"), 7) == 0) && isdigit(section[7]) )
 	{
-		SYSEVT_ERROR(F("LoadIniEEPROM - error opening device ini file"));
-
-		retcode = false;
+		*pIndex = atoi(section+7);
+		return INI_SECT_STATION;
+	}
+	if( (strncasecmp_P(section, PSTR("Sensor"), 6) == 0) && isdigit(section[6]) )
+	{
+		*pIndex = atoi(section+6);
+		return INI_SECT_SENSOR;
 	}
 
-// OK, we successfully opened device ini file. Read config and populate EEPROM.
-	TRACE_INFO(F("Loading EEPROM from device ini file.\n"));
-
-// First we need to write signature and zero out various configs (that are not loaded from ini file)
-
-		const char * const sHeader = EEPROM_SHEADER;
+	return INI_SECT_UNKNOWN;
+}
 
-        for (int i = 0; i <= 3; i++)			// write current signature
-                EEPROM.write(i, sHeader[i]);
-        
-		SetNumSchedules(0);
-		SetEvtMasterFlags(0);
-		SetEvtMasterStationID(0);
+// IniFile::browse() handler - dispatch one key into IniImport
+static bool iniImportHandler(const char *section, const char *key, const char *value, void *ctx)
+{
+	IniImport	*pImport = (IniImport *)ctx;
+	uint8_t		index;
+	uint8_t		sect = iniSection(section, &index);
+	uint8_t		*pBase;
+	IniKeyDef	def;
 
-// Validate ini file to ensure we can successfully read it (check max string length)
+	if( sect == INI_SECT_UNKNOWN )
+		return true;
 
-		if( !ini.validate(buffer, bufferLen) )
+	if( sect == INI_SECT_PARALLELIOMAP )
+	{
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+		if( (strncasecmp_P(key, PSTR("Chan"), 4) == 0) && isdigit(key[4]) )
 		{
-			SYSEVT_ERROR(F("LoadIniEEPROM - ini file failed validation"));
+			uint8_t	chan = atoi(key+4);		// In ini file channels are numbered from 1
 
-			retcode = false;
+			if( (chan >= 1) && (chan <= LOCAL_NUM_DIRECT_CHANNELS) && !(pImport->ioMapPresent & (1 << (chan-1))) )
+			{
+				pImport->zoneToIOMap[chan-1] = atol(value);
+				pImport->ioMapPresent |= 1 << (chan-1);
+			}
 		}
+#endif //LOCAL_NUM_DIRECT_CHANNELS
+		return true;
+	}
 
-// And this is the actual device config load from ini file
+	if( sect == INI_SECT_STATION )
+	{
+		if( (index < 1) || (index > MAX_STATIONS) )
+			return true;
+		pBase = (uint8_t *) &pImport->stations[index-1];
+	}
+	else if( sect == INI_SECT_SENSOR )
+	{
+		if( (index < 1) || (index > MAX_SENSORS) )
+			return true;
+		pBase = (uint8_t *) &pImport->sensors[index-1];
+	}
+	else
+		pBase = (uint8_t *) pImport;
 
-		IPAddress ip;
+	for( uint8_t i=0; i<sizeof(iniKeys)/sizeof(iniKeys[0]); i++ )
+	{
+		memcpy_P(&def, &iniKeys[i], sizeof(def));
+		if( (def.section != sect) || (strcasecmp(key, def.key) != 0) )
+			continue;
 
-		if( ini.getIPAddress_P(PSTR("Network"), PSTR("IP"), buffer, bufferLen, ip) )
-			SetIP(ip);
-		else 
+		// first occurrence of the key wins, same as IniFile::getValue()
+		if( sect == INI_SECT_STATION )
 		{
-			SetIP(IPAddress(10, 0, 1, 36));		// default IP address
-			retcode = false;
+			if( pImport->stations[index-1].present & (1 << def.bit) )	return true;
+			pImport->stations[index-1].present |= 1 << def.bit;
 		}
-  
-		if( ini.getIPAddress_P(PSTR("Network"), PSTR("Subnet"), buffer, bufferLen, ip) )
-			SetNetmask(ip);
-		else
+		else if( sect == INI_SECT_SENSOR )
 		{
-			SetNetmask(IPAddress(255, 255, 255, 0));	// default Subnet
-			retcode = false;
+			if( pImport->sensors[index-1].present & (1 << def.bit) )	return true;
+			pImport->sensors[index-1].present |= 1 << def.bit;
 		}
-		
-		if( ini.getIPAddress_P(PSTR("Network"), PSTR("Gateway"), buffer, bufferLen, ip) )
-			SetGateway(ip);
 		else
 		{
-			SetGateway(IPAddress(10, 0, 1, 1));		// default gateway
-			retcode = false;
+			if( INI_PRESENT(pImport, def.bit) )	return true;
+			pImport->present |= uint32_t(1) << def.bit;
 		}
 
-		uint16_t	u16;
-		if( ini.getValue_P(PSTR("Network"), PSTR("WebPort"), buffer, bufferLen, u16) )
-			SetWebPort(u16);
-		else
+		uint8_t	*pField = pBase + def.offset;
+		switch( def.type )
 		{
-			SetWebPort(80);			// default HTTP port
-			retcode = false;
-		}
+		case INI_TYPE_IP:
+			{
+				IPAddress	ip = decodeIP(value);
 
-		if( ini.getIPAddress_P(PSTR("Network"), PSTR("NTPServer"), buffer, bufferLen, ip) )
-			SetNTPIP(ip);
-		else
-		{
-			SetNTPIP(IPAddress(204,9,54,119));	// default NTP server
-			retcode = false;
+				if( ip == INADDR_NONE )
+					pImport->present &= ~(uint32_t(1) << def.bit);		// invalid address, use default
+				else
+					*((uint32_t *)pField) = uint32_t(ip);
+			}
+			break;
+
+		case INI_TYPE_U16:
+			*((uint16_t *)pField) = uint16_t(atol(value));
+			break;
+
+		case INI_TYPE_YESNO:
+			*pField = (strcmp_P(value, PSTR("Yes")) == 0) || (strcmp_P(value, PSTR("yes")) == 0) || (strcmp_P(value, PSTR("YES")) == 0);
+			break;
+
+		case INI_TYPE_POLARITY:
+			if( strcmp_P(value, PSTR("Negative")) == 0 )		*pField = OT_DIRECT_NEG;
+			else if( strcmp_P(value, PSTR("Positive")) == 0 )	*pField = OT_DIRECT_POS;
+			else												*pField = OT_NONE;
+			break;
+
+		case INI_TYPE_NETWORK:
+			if( strcmp_P(value, PSTR("Parallel")) == 0 )		*pField = NETWORK_ID_LOCAL_PARALLEL;
+			else if( strcmp_P(value, PSTR("Serial")) == 0 )		*pField = NETWORK_ID_LOCAL_SERIAL;
+			else if( strcmp_P(value, PSTR("XBee")) == 0 )		*pField = NETWORK_ID_XBEE;
+			else if( strcmp_P(value, PSTR("RFM69")) == 0 )		*pField = NETWORK_ID_MOTEINORF;
+			else if( strcmp_P(value, PSTR("UDP")) == 0 )		*pField = NETWORK_ID_UDP;
+			else if( strcmp_P(value, PSTR("Loopback")) == 0 )	*pField = NETWORK_ID_LOOPBACK;
+			else												*pField = NETWORK_ID_INVALID;
+			break;
+
+		case INI_TYPE_SENSORTYPE:
+			if( strcmp_P(value, PSTR("Temperature")) == 0 )		*pField = SENSOR_TYPE_TEMPERATURE;
+			else if( strcmp_P(value, PSTR("Pressure")) == 0 )	*pField = SENSOR_TYPE_PRESSURE;
+			else if( strcmp_P(value, PSTR("Humidity")) == 0 )	*pField = SENSOR_TYPE_HUMIDITY;
+			else if( strcmp_P(value, PSTR("Waterflow")) == 0 )	*pField = SENSOR_TYPE_WATERFLOW;
+			else if( strcmp_P(value, PSTR("Voltage")) == 0 )	*pField = SENSOR_TYPE_VOLTAGE;
+			else if( strcmp_P(value, PSTR("Flowrate")) == 0 )	*pField = SENSOR_TYPE_FLOWRATE;
+			else												*pField = SENSOR_TYPE_NONE;
+			break;
+
+		case INI_TYPE_NAME:
+			break;
 		}
+		return true;
+	}
 
-		SetWUIP(INADDR_NONE);		// we don't pre-populate Weather Underground IP address
-		SetApiKey("");				// we don't pre-populate API key for WU
-        SetPWS("");
-        SetUsePWS(false);
-
-		int		i16;
-		if( ini.getValue_P(PSTR("System"), PSTR("NTPOffset"), buffer, bufferLen, i16) )
-			SetNTPOffset(-8);
-		else
-		{
-			SetNTPOffset(i16);
-			retcode = false;
-		}
+	return true;		// unknown key, ignore it
+}
 
-		if( ini.getValue_P(PSTR("System"), PSTR("Zip"), buffer, bufferLen, u16) )
-			SetZip(u16);
-		else
-		{
-			SetZip(0);
-			retcode = false;
-		}
+// Read device.ini in one pass, calling handler for every key. Returns false if the file can't be opened or read.
+static bool iniReadFile(IniFileHandler handler, void *ctx)
+{
+	char	*buffer = iniWork.line;			// Temp buffer for ini file processing
 
-		if( ini.getValue_P(PSTR("System"), PSTR("SeasonalAdj"), buffer, bufferLen, i16) )
-			SetSeasonalAdjust(i16);
-		else
-		{
-			SetSeasonalAdjust(100);
-			retcode = false;
-		}
+	strcpy_P(buffer, PSTR(EEPROM_INI_FILE));	// to avoid wasting space use common buffer for the file name init
+	IniFile ini(buffer);
 
-		SetRunSchedules(false);		// no schedules
+	if( !ini.open() )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - error opening device ini file"));
+		return false;
+	}
 
-		SetOT(OT_NONE);	
+// Read the whole ini file in one pass. This also validates it (max string length).
 
-// Local channels
+	if( !ini.browse(handler, ctx, buffer, INI_LINE_LENGTH) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - ini file failed validation"));
+		return false;
+	}
+	return true;
+}
 
-		uint16_t	parChannels = 0;
-		if( !ini.getValue_P(PSTR("LocalChannels"), PSTR("NumParallel"), buffer, bufferLen, parChannels) )
-		{
-			parChannels = 0;
-		}
-		TRACE_INFO(F("LoadIniEEPROM - %d parallel channels\n"), parChannels );
-		SetNumIOChannels(parChannels);
+// IniFile::browse() handler of the sensor names pass - write Name of [SensorN] into the EEPROM slot of that sensor
+static bool iniNameHandler(const char *section, const char *key, const char *value, void *ctx)
+{
+	IniNamePass	*pPass = (IniNamePass *)ctx;
+	uint8_t		index;
 
-#ifdef LOCAL_NUM_DIRECT_CHANNELS
-		if( parChannels > LOCAL_NUM_DIRECT_CHANNELS ) 
-		{
-			SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to %d"), parChannels, LOCAL_NUM_DIRECT_CHANNELS );
-			parChannels = LOCAL_NUM_DIRECT_CHANNELS;	// basic protection to constrain the maximum number of parallel channels
-		}
-#else
-		if( parChannels > 0 )
-		{
-			SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to 0"), parChannels );
-			parChannels = 0;	// basic protection to constrain the maximum number of parallel channels
-		}
-#endif
+	if( (iniSection(section, &index) != INI_SECT_SENSOR) || (strcasecmp_P(key, PSTR("Name")) != 0) )
+		return true;
 
-		if( parChannels != 0 ){
-#ifdef LOCAL_NUM_DIRECT_CHANNELS
+	if( (index < 1) || (index > MAX_SENSORS) || (pPass->slot[index-1] == INI_NO_SLOT) || (pPass->seen & (1u << (index-1))) )
+		return true;
+	pPass->seen |= 1u << (index-1);
 
-			uint16_t	ioPin;
-			uint8_t		zoneToIOMap[LOCAL_NUM_DIRECT_CHANNELS] = PARALLEL_PIN_OUT_MAP;
+	// names are zero padded, and written only if different (these live in EEPROM only, settings cache has no names)
+	int		addr = SENSOR_OFFSET + SENSOR_INDEX*pPass->slot[index-1] + offsetof(FullSensor, name);
 
-			for( uint16_t i=0; i<parChannels; i++ )
-			{
-				sprintf_P(tmpb, PSTR("Chan%u"), i+1);	// In ini file channels are numbered from 1
-				if( ini.getValue("ParallelIOMap", tmpb, buffer, bufferLen, ioPin) )
-					zoneToIOMap[i] = ioPin;
-			}
+	for( uint8_t j=0; j<MAX_SENSOR_NAME_LENGTH; j++ )
+	{
+		char	c = 0;
 
-			SaveZoneIOMap( zoneToIOMap );
+		if( (j < MAX_SENSOR_NAME_LENGTH-1) && *value )
+			c = *value++;
 
-			if( ini.getValue_P(PSTR("LocalChannels"), PSTR("ParallelPolarity"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-			{
-				if( strcmp_P(tmpb, PSTR("Negative")) == 0 )
-					SetOT(OT_DIRECT_NEG);		
-				else if( strcmp_P(tmpb, PSTR("Positive")) == 0 )
-					SetOT(OT_DIRECT_POS);		
-			}
-			else
-			{
-				SetOT(OT_DIRECT_POS);		
-			}
-#else //LOCAL_NUM_DIRECT_CHANNELS
-			SYSEVT_ERROR(F("LoadIniEEPROM - LOCAL_NUM_DIRECT_CHANNELS is not defined but device.ini specifies non-zero number of Parallel channels."));
-			parChannels = 0;	// basic protection to constrain the maximum number of parallel channels
-#endif //LOCAL_NUM_DIRECT_CHANNELS
-		}
-		
-		uint16_t	serChannels = 0;
-		if( ini.getValue_P(PSTR("LocalChannels"), PSTR("NumSerial"), buffer, bufferLen, serChannels) )
-			SetNumOSChannels(serChannels);
-		else
+		if( EEPROM.read(addr+j) != uint8_t(c) )
 		{
-			SetNumOSChannels(0);
+			EEPROM.write(addr+j, c);
+			pPass->fChanged = true;
 		}
+	}
+	return true;
+}
 
-		if( serChannels != 0 ){
+//
+// Second pass over the file - write names of the imported sensors. pPass->slot should be filled in by the caller.
+//
+// Returns true if any name was changed.
+//
+static bool iniWriteSensorNames(IniNamePass *pPass)
+{
+	pPass->seen = 0;
+	pPass->fChanged = false;
 
-			SrIOMapStruct  srIoMap; 
+	if( !iniReadFile(iniNameHandler, pPass) )
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read sensor names"));
 
-			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrClkPin"), buffer, bufferLen, u16) )
-				srIoMap.SrClkPin = u16;
-			else
-				srIoMap.SrClkPin = 30;
+	return pPass->fChanged;
+}
 
-			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrNoePin"), buffer, bufferLen, u16) )
-				srIoMap.SrNoePin = u16;
-			else
-				srIoMap.SrNoePin = 29;
+// Number of parallel channels, constrained by the hardware
+static uint16_t iniParallelChannels(const IniImport *pImport)
+{
+	uint16_t	parChannels = pImport->numParallel;
 
-			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrDatPin"), buffer, bufferLen, u16) )
-				srIoMap.SrDatPin = u16;
-			else
-				srIoMap.SrDatPin = 28;
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+	if( parChannels > LOCAL_NUM_DIRECT_CHANNELS ) 
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to %d"), parChannels, LOCAL_NUM_DIRECT_CHANNELS );
+		parChannels = LOCAL_NUM_DIRECT_CHANNELS;	// basic protection to constrain the maximum number of parallel channels
+	}
+#else
+	if( parChannels > 0 )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to 0"), parChannels );
+		parChannels = 0;	// basic protection to constrain the maximum number of parallel channels
+	}
+#endif
+	return parChannels;
+}
 
-			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrLatPin"), buffer, bufferLen, u16) )
-				srIoMap.SrLatPin = u16;
-			else
-				srIoMap.SrLatPin = 27;
+// Local IO type. Defaults to Positive when parallel channels are present but ParallelPolarity is not specified.
+static EOT iniParallelOT(const IniImport *pImport, uint16_t parChannels)
+{
+	if( INI_PRESENT(pImport, INI_KEY_POLARITY) && (pImport->parallelPolarity != OT_NONE) )
+		return EOT(pImport->parallelPolarity);
 
-			SaveSrIOMap(&srIoMap);
-		}
+	if( (parChannels != 0) && !INI_PRESENT(pImport, INI_KEY_POLARITY) )
+		return OT_DIRECT_POS;
 
-// Load Stations info
+	return OT_NONE;
+}
 
-// First let's zero out stations block
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+// Parallel IO map - hardware default, with channels specified in the ini file replaced
+static void iniMakeIOMap(const IniImport *pImport, uint16_t parChannels, uint8_t *pMap)
+{
+	const uint8_t	defaultMap[LOCAL_NUM_DIRECT_CHANNELS] = PARALLEL_PIN_OUT_MAP;
 
-		FullStation  fullStation;
-		memset(&fullStation,0,sizeof(fullStation));
+	for( uint16_t i=0; i<LOCAL_NUM_DIRECT_CHANNELS; i++ )
+	{
+		if( (i < parChannels) && (pImport->ioMapPresent & (1 << i)) )
+			pMap[i] = pImport->zoneToIOMap[i];
+		else
+			pMap[i] = defaultMap[i];
+	}
+}
+#endif //LOCAL_NUM_DIRECT_CHANNELS
 
-		for( uint8_t u=0; u<MAX_STATIONS; u++ )
-				SaveStation(u, &fullStation);
+static void iniMakeSrIOMap(const IniImport *pImport, SrIOMapStruct *pMap)
+{
+	pMap->SrClkPin = INI_PRESENT(pImport, INI_KEY_SRCLKPIN) ? pImport->srClkPin : 30;
+	pMap->SrNoePin = INI_PRESENT(pImport, INI_KEY_SRNOEPIN) ? pImport->srNoePin : 29;
+	pMap->SrDatPin = INI_PRESENT(pImport, INI_KEY_SRDATPIN) ? pImport->srDatPin : 28;
+	pMap->SrLatPin = INI_PRESENT(pImport, INI_KEY_SRLATPIN) ? pImport->srLatPin : 27;
+}
 
+static uint16_t iniNumStations(const IniImport *pImport)
+{
+	if( pImport->numStations >= MAX_STATIONS )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Stations %d. Number should be <16"), pImport->numStations);
+		return 0;
+	}
+	return pImport->numStations;
+}
 
-		uint16_t	numStations = 0;
-		if( ini.getValue_P(PSTR("Stations"), PSTR("NumStations"), buffer, bufferLen, numStations) )
-		{
-			if( numStations >= MAX_STATIONS )
-			{
-				SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Stations %d. Number should be <16"), numStations);
-				numStations = 0;
-			}
-		}
-		else
-		{
-			numStations = 0;
-		}
+static uint8_t iniMyStationID(const IniImport *pImport)
+{
+	if( !INI_PRESENT(pImport, INI_KEY_MYSTATIONID) )
+		return DEFAULT_STATION_ID;
 
-		uint8_t	myStationID;
-		u16 = DEFAULT_STATION_ID;
-		if( ini.getValue_P(PSTR("Stations"), PSTR("MyStationID"), buffer, bufferLen, u16) )
-		{
-			if( u16 >= MAX_STATIONS )
-			{
-				SYSEVT_ERROR(F("LoadIniEEPROM - invalid MyStationID %d. Number should be <16"), u16);
-				u16 = DEFAULT_STATION_ID;
-			}
-		}
-//		SYSEVT_ERROR(F("MyStationID=%d\n"), u16);
-		myStationID = u16;
-		SetMyStationID(myStationID);
+	if( pImport->myStationID >= MAX_STATIONS )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - invalid MyStationID %d. Number should be <16"), pImport->myStationID);
+		return DEFAULT_STATION_ID;
+	}
+	return pImport->myStationID;
+}
 
-		TRACE_INFO(F("LoadIniEEPROM - numStations=%d"), numStations);
-		if( numStations != 0 )	// We have at least one Station defined in the ini file
+//
+// Build station record from [StationN] section (i is numbered from 0).
+//
+// Returns false if the section is incomplete or invalid, the station should be skipped in this case.
+// On success the station should be saved at pDef->stationID.
+//
+static bool iniMakeStation(uint16_t i, const IniStationDef *pDef, FullStation *pStation)
+{
+	uint16_t	numChannels = pDef->numChannels;
+
+	TRACE_INFO(F("Reading station Station%u\n"), i+1);
+
+	if( !(pDef->present & (1 << INI_STATION_KEY_ID)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get StationID for station %d"), i);
+		return false;
+	}
+
+	if( pDef->stationID >= MAX_STATIONS )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - invalid StationID %d. Number should be <16"), pDef->stationID);
+		return false;
+	}
+
+	if( !(pDef->present & (1 << INI_STATION_KEY_CHANNELS)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NumChannels for Station %d"), i);
+		return false;
+	}
+	if( numChannels > 8 )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - NumChannels too high for Station %d, truncating to 8"), i);
+		numChannels = 8;
+	}
+
+	if( !(pDef->present & (1 << INI_STATION_KEY_NETWORK)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkID for Station %d"), i);
+		return false;
+	}
+	if( pDef->netID == NETWORK_ID_INVALID )
+	{
+		SYSEVT_ERROR(F("NetworkID not recognized for station %d, skipping the station"), i+1);
+		return false;
+	}
+	TRACE_INFO(F("Got NetworkID code %d for Station %d\n"), pDef->netID, i+1);
+
+	if( !(pDef->present & (1 << INI_STATION_KEY_ADDRESS)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkAddress for Station %d"), i);
+		return false;
+	}
+
+	if( !(pDef->present & (1 << INI_STATION_KEY_RACCESS)) )
+		SYSEVT_ERROR(F("LoadIniEEPROM - no RAccess statement, assuming no remote access for Station %d"), i);
+
+	memset(pStation, 0, sizeof(FullStation));
+	if( pDef->fRAccess )	// allow remote access (via RF) to this station
+		pStation->stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED | STATION_FLAGS_RSTATUS | STATION_FLAGS_RCONTROL;
+	else
+		pStation->stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED;
+
+	pStation->networkID = pDef->netID;
+	pStation->networkAddress = pDef->netAddr;
+	pStation->numZoneChannels = numChannels;
+
+	sprintf_P(pStation->name, PSTR("Station %d"), pDef->stationID);
+	return true;
+}
+
+// Location of zone z (stationID << 4 | channel). Zones are generated in stations order, from enabled stations only.
+static uint8_t iniZoneLoc(const ShortStation *pStations, uint8_t z)
+{
+	for( uint8_t st=0; st<MAX_STATIONS; st++ )
+	{
+		if( !(pStations[st].stationFlags & STATION_FLAGS_VALID) || !(pStations[st].stationFlags & STATION_FLAGS_ENABLED) )
+			continue;
+
+		if( z < pStations[st].numZoneChannels )
+			return (st << 4) | z;
+		z -= pStations[st].numZoneChannels;
+	}
+	return 0;
+}
+
+static uint16_t iniNumSensors(const IniImport *pImport)
+{
+	if( pImport->numSensors >= MAX_SENSORS )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Sensors %d. Number should be <%d."), pImport->numSensors, (int)MAX_SENSORS);
+		return 0;
+	}
+	return pImport->numSensors;
+}
+
+//
+// Build sensor record from [SensorN] section (i is numbered from 1).
+//
+// Returns false if the section is incomplete or invalid, the sensor should be skipped in this case.
+// Name is left empty if the section has one, it is written by iniWriteSensorNames() once all sensors are saved.
+//
+static bool iniMakeSensor(const IniImport *pImport, uint16_t i, FullSensor *pSensor)
+{
+	const IniSensorDef	*pDef = &pImport->sensors[i-1];
+
+	if( !(pDef->present & (1 << INI_SENSOR_KEY_TYPE)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Type for Sensor%d"), i);
+		return false;
+	}
+	TRACE_INFO(F("Reading Sensor%d, type=%d\n"), i, pDef->type);
+
+	if( pDef->type == SENSOR_TYPE_NONE )
+	{
+		SYSEVT_ERROR(F("Sensor%d type not recognized - skipping it"), i);
+		return false;
+	}
+
+	if( !(pDef->present & (1 << INI_SENSOR_KEY_STATION)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Station for Sensor %d"), i);
+		return false;
+	}
+	if( pDef->station > MAX_STATIONS )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - Sensor Station too high for Sensor%d"), i);
+		return false;
+	}
+
+	if( !(pDef->present & (1 << INI_SENSOR_KEY_CHANNEL)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Channel for Sensor%d"), i);
+		return false;
+	}
+	if( pDef->channel > 254 )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - Channel is too high for Sensor%d"), i);
+		return false;
+	}
+
+	memset(pSensor, 0, sizeof(FullSensor));
+	if( !(pDef->present & (1 << INI_SENSOR_KEY_NAME)) )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Name for Sensor%d"), i);
+		sprintf_P(pSensor->name, PSTR("Sensor %u:%u"), pDef->station, pDef->channel);	// if no name provided - generate default
+	}
+
+	pSensor->sensorType = pDef->type;
+	pSensor->sensorChannel = pDef->channel;
+	pSensor->sensorStationID = pDef->station;
+	pSensor->flags = 0;	
+
+	if( pDef->present & (1 << INI_SENSOR_KEY_CURVE) )
+	{
+		if( pDef->curve >= ANALOG_NUM_CURVES )
 		{
+			SYSEVT_ERROR(F("LoadIniEEPROM - Curve is too high for Sensor%d, using default"), i);
+		}
+		else
+			pSensor->flags |= SENSOR_FLAGS_CURVE(pDef->curve);
+	}
+	return true;
+}
 
-			char			keyName[16];
-			char			sectionName[16];
-			uint16_t		stationID;
-			uint16_t		netID;
-			uint16_t		numChannels = 0;
-			uint16_t		netAddr;
-			uint8_t			fEnableRAccess = false;
+#endif // HW_ENABLE_SD
 
-			for( uint16_t i=0; i<numStations; i++ )
-			{
+// Default name of the zone. Formatted into a buffer sized for the worst case, out of range numbers are truncated
+// instead of overflowing the zone name.
+//
+static void MakeZoneName(FullZone *pZone, uint8_t zoneIndex)
+{
+	char	name[28];		// "Zone 65535, Loc FFFF:65535"
 
-				sprintf_P(sectionName, PSTR("Station%u"), i+1);	// In ini file channels are numbered from 1
-				strcpy_P(keyName, PSTR("StationID"));
-				TRACE_INFO(F("Reading station %s\n"), sectionName);
-				freeMemory();
+	sprintf_P(name, PSTR("Zone %d, Loc %X:%d"), uint16_t(zoneIndex+1), uint16_t(pZone->stationID), uint16_t(pZone->channel+1));
+	strncpy(pZone->name, name, sizeof(pZone->name) - 1);
+	pZone->name[sizeof(pZone->name) - 1] = 0;
+}
 
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, stationID) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get StationID for station %d"), i);
-					goto skip_Station;
-				}
+//  Load EEPROM from an INI file
+//
+//	This operation is performed to rebuild IO topology or change other hardware config.
+//	When completed successfully this process will fully populate EEPROM (including signature).
+//
+//  Note: When particular setting(s) are missing from ini file, defaults are used instead.
+//
+void ResetEEPROM()
+{
+	settingsCache.invalidate();		// EEPROM is rebuilt from scratch, switch settings to direct EEPROM access
 
-				if( stationID >= MAX_STATIONS )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - invalid StationID %d. Number should be <16"), stationID);
-					goto skip_Station;
-				}
+#ifdef SG_WDT_ENABLED
+	wdt_disable();
+#endif // SG_WDT_ENABLED
 
-				strcpy_P(keyName, PSTR("NumChannels"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, numChannels) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NumChannels for Station %d"), i);
-					goto skip_Station;
-				}
-				if( numChannels > 8 )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - NumChannels too high for Station %d, truncating to 8"), i);
-					numChannels = 8;
-				}
+	localUI.lcd_print_line_clear_pgm(PSTR("Resetting EEPROM"), 1);
 
-				strcpy_P(keyName, PSTR("NetworkID"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkID for Station %d, error code: %d"), i, ini.getError());
-					goto skip_Station;
-				}
-				if( strcmp_P(tmpb, PSTR("Parallel")) == 0 )
-					netID = NETWORK_ID_LOCAL_PARALLEL;
-				else if( strcmp_P(tmpb, PSTR("Serial")) == 0 )
-					netID = NETWORK_ID_LOCAL_SERIAL;
-				else if( strcmp_P(tmpb, PSTR("XBee")) == 0 )
-					netID = NETWORK_ID_XBEE;
-				else if( strcmp_P(tmpb, PSTR("RFM69")) == 0 )
-					netID = NETWORK_ID_MOTEINORF;
-				else
-				{
-					SYSEVT_ERROR(F("NetworkID not recognized for station %d, skipping the station"), i+1);
-					goto skip_Station;
-				}
-				TRACE_INFO(F("Got NetworkID of %s (code %d) for Station %d\n"), tmpb, netID, i+1);
+#ifndef HW_ENABLE_SD
+//
+// SD is not enabled, so we have to create default config. 
+//
+	ResetEEPROM_NoSD(DEFAULT_STATION_ID);
 
-				strcpy_P(keyName, PSTR("NetworkAddress"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, netAddr) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkAddress for Station %d"), i);
-					goto skip_Station;
-				}
+#else // HW_ENABLE_SD
 
-				fEnableRAccess = false;
-				strcpy_P(keyName, PSTR("RAccess"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - no RAccess statement, assuming no remote access for Station %d"), i);
-				}
-				else
-				{
-					if( (strcmp_P(tmpb, PSTR("Yes")) == 0) || (strcmp_P(tmpb, PSTR("yes")) == 0) || (strcmp_P(tmpb, PSTR("YES")) == 0))
-						fEnableRAccess = true;
-				}
+	TRACE_INFO(F("Loading EEPROM from device ini file.\n"));
 
-				memset(&fullStation,0,sizeof(fullStation));
-				if( fEnableRAccess )	// allow remote access (via RF) to this station
-					fullStation.stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED | STATION_FLAGS_RSTATUS | STATION_FLAGS_RCONTROL;
-				else
-					fullStation.stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED;
+// First we need to write signature and zero out various configs (that are not loaded from ini file)
 
-				fullStation.networkID = netID;
-				fullStation.networkAddress = netAddr;
-				fullStation.numZoneChannels = numChannels;
+		const char * const sHeader = EEPROM_SHEADER;
 
-				sprintf_P(fullStation.name, PSTR("Station %d"), stationID);
+		for (int i = 0; i <= 3; i++)			// write current signature
+			EEPROM.write(i, sHeader[i]);
 
-				SaveStation(stationID, &fullStation);	// save the station
+		SetNumSchedules(0);
+		SetEvtMasterFlags(0);
+		SetEvtMasterStationID(0);
 
-				SYSEVT_ERROR(F("LoadIniEEPROM - Saving station %d, NumChannels %d, netID %d, netAddr %d"), (int)stationID, (int)numChannels, (int)netID, (int)netAddr);
-skip_Station:;
-			}
+// Read device ini file. If it can't be read, defaults are used for everything.
+
+		IniImport	&imp = iniWork.imp;
+		memset(&imp, 0, sizeof(imp));
+
+		iniReadFile(iniImportHandler, &imp);		// errors are reported by iniReadFile, defaults are used for missing settings
+
+// And this is the actual device config load, from values staged by the ini file pass
+
+		if( INI_PRESENT(&imp, INI_KEY_IP) )
+			SetIP(IPAddress(imp.ip));
+		else
+			SetIP(IPAddress(10, 0, 1, 36));		// default IP address
+  
+		if( INI_PRESENT(&imp, INI_KEY_SUBNET) )
+			SetNetmask(IPAddress(imp.subnet));
+		else
+			SetNetmask(IPAddress(255, 255, 255, 0));	// default Subnet
+		
+		if( INI_PRESENT(&imp, INI_KEY_GATEWAY) )
+			SetGateway(IPAddress(imp.gateway));
+		else
+			SetGateway(IPAddress(10, 0, 1, 1));		// default gateway
+
+		if( INI_PRESENT(&imp, INI_KEY_WEBPORT) )
+			SetWebPort(imp.webPort);
+		else
+			SetWebPort(80);			// default HTTP port
+
+		if( INI_PRESENT(&imp, INI_KEY_NTPSERVER) )
+			SetNTPIP(IPAddress(imp.ntpServer));
+		else
+			SetNTPIP(IPAddress(204,9,54,119));	// default NTP server
+
+		SetWUIP(INADDR_NONE);		// we don't pre-populate Weather Underground IP address
+		SetApiKey("");				// we don't pre-populate API key for WU
+        SetPWS("");
+        SetUsePWS(false);
+
+		SetNTPOffset(-8);			// Note: NTPOffset from the ini file was never applied, keep the same behavior
+
+		if( INI_PRESENT(&imp, INI_KEY_ZIP) )
+			SetZip(imp.zip);
+		else
+			SetZip(0);
+
+		if( INI_PRESENT(&imp, INI_KEY_SEASONALADJ) )
+			SetSeasonalAdjust(imp.seasonalAdj);
+		else
+			SetSeasonalAdjust(100);
+
+		SetRunSchedules(false);		// no schedules
+
+// Local channels
+
+		uint16_t	parChannels = imp.numParallel;
+
+		TRACE_INFO(F("LoadIniEEPROM - %d parallel channels\n"), parChannels );
+		SetNumIOChannels(parChannels);
+
+		parChannels = iniParallelChannels(&imp);
+		SetOT(iniParallelOT(&imp, parChannels));
+
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+		if( parChannels != 0 ){
+
+			uint8_t		zoneToIOMap[LOCAL_NUM_DIRECT_CHANNELS];
+
+			iniMakeIOMap(&imp, parChannels, zoneToIOMap);
+			SaveZoneIOMap( zoneToIOMap );
 		}
+#endif //LOCAL_NUM_DIRECT_CHANNELS
+		
+		uint16_t	serChannels = imp.numSerial;
+		SetNumOSChannels(serChannels);
 
-		if( ini.getValue_P(PSTR("LocalChannels"), PSTR("ParallelPolarity"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-		{
-			if( strcmp_P(tmpb, PSTR("Negative")) == 0 )
-				SetOT(OT_DIRECT_NEG);		
-			else if( strcmp_P(tmpb, PSTR("Positive")) == 0 )
-				SetOT(OT_DIRECT_POS);		
+		if( serChannels != 0 ){
+
+			SrIOMapStruct  srIoMap; 
+
+			iniMakeSrIOMap(&imp, &srIoMap);
+			SaveSrIOMap(&srIoMap);
 		}
 
-		// Sensors definitions
-		uint16_t	numSensors = 0;
-		SetNumSensors(0);	// initial default
+// Load Stations info
 
-		if( ini.getValue_P(PSTR("Sensors"), PSTR("NumSensors"), buffer, bufferLen, numSensors) )
+// First let's zero out stations block
+
+		FullStation  fullStation;
+		memset(&fullStation,0,sizeof(fullStation));
+
+		for( uint8_t u=0; u<MAX_STATIONS; u++ )
+				SaveStation(u, &fullStation);
+
+		uint16_t	numStations = iniNumStations(&imp);
+
+		SetMyStationID(iniMyStationID(&imp));
+
+		TRACE_INFO(F("LoadIniEEPROM - numStations=%d"), numStations);
+		for( uint16_t i=0; i<numStations; i++ )
 		{
-			if( numSensors >= MAX_SENSORS )
-			{
-				SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Sensors %d. Number should be <%d."), numSensors, (int)MAX_SENSORS);
-				numSensors = 0;
-			}
+			if( !iniMakeStation(i, &imp.stations[i], &fullStation) )
+				continue;
+
+			SaveStation(imp.stations[i].stationID, &fullStation);	// save the station
+
+			SYSEVT_ERROR(F("LoadIniEEPROM - Saving station %d, NumChannels %d, netID %d, netAddr %d"), (int)imp.stations[i].stationID, (int)fullStation.numZoneChannels, (int)fullStation.networkID, (int)fullStation.networkAddress);
 		}
 
+		// Sensors definitions
+		uint16_t	numSensors = iniNumSensors(&imp);
+		SetNumSensors(0);	// initial default
+
 		TRACE_INFO(F("numSensors=%d\n"), numSensors);
 
 		if( numSensors != 0 )	// We have at least one Sensor defined in the ini file
 		{
-
-			char			keyName[16];
-			char			sectionName[16];
-			uint8_t			sensType;
 			uint8_t			sensID = 0;
-			uint16_t			sensStation;
-			uint16_t			sensChannel;
+			FullSensor		fullSens;
+			IniNamePass		&names = iniWork.names;
 
+			memset(names.slot, INI_NO_SLOT, sizeof(names.slot));
 			for( uint16_t i=1; i<=numSensors; i++ )
 			{
+				if( !iniMakeSensor(&imp, i, &fullSens) )
+					continue;
 
-				sprintf_P(sectionName, PSTR("Sensor%d"), i);	
-				strcpy_P(keyName, PSTR("Type"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Type for Sensor%d"), i);
-					goto skip_Sensor;
-				}
-				TRACE_INFO(F("Reading Sensor%d, type=%s\n"), i, tmpb);
-
-				if( strcmp_P(tmpb, PSTR("Temperature")) == 0 )
-					sensType = SENSOR_TYPE_TEMPERATURE;
-				else if( strcmp_P(tmpb, PSTR("Pressure")) == 0 )
-					sensType = SENSOR_TYPE_PRESSURE;
-				else if( strcmp_P(tmpb, PSTR("Humidity")) == 0 )
-					sensType = SENSOR_TYPE_HUMIDITY;
-				else if( strcmp_P(tmpb, PSTR("Waterflow")) == 0 )
-					sensType = SENSOR_TYPE_WATERFLOW;
-				else if( strcmp_P(tmpb, PSTR("Voltage")) == 0 )
-					sensType = SENSOR_TYPE_VOLTAGE;
-				else
-				{
-					SYSEVT_ERROR(F("Sensor%d type not recognized - skipping it"), i);
-					goto skip_Sensor;
-				}
-
-				strcpy_P(keyName, PSTR("Station"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, sensStation) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Station for Sensor %d"), i);
-					goto skip_Sensor;
-				}
-				if( sensStation > MAX_STATIONS )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - Sensor Station too high for Sensor%d"), i);
-					goto skip_Sensor;
-				}
-
-				strcpy_P(keyName, PSTR("Channel"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, sensChannel) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Channel for Sensor%d"), i);
-					goto skip_Sensor;
-				}
-				if( sensChannel > 254 )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - Channel is too high for Sensor%d"), i);
-					goto skip_Sensor;
-				}
-
-				strcpy_P(keyName, PSTR("Name"));
-				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
-				{
-					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Name for Sensor%d"), i);
-					sprintf_P(tmpb, PSTR("Sensor %u:%u"), sensStation, sensChannel);	// if no name provided - generate default
-				}
-
-				{
-					FullSensor  fullSens;
-
-					fullSens.sensorType = sensType;
-					fullSens.sensorChannel = sensChannel;
-					fullSens.sensorStationID = sensStation;
-					fullSens.flags = 0;	
-					memcpy(fullSens.name, tmpb, 20);	// sensor name is limited to 20 ASCII chars, and we just copy the block. If the actual name is shorter, it will have null in it.
-
-					SaveSensor(sensID, &fullSens);	// save the sensor
+				SaveSensor(sensID, &fullSens);	// save the sensor
+				names.slot[i-1] = sensID;
 
-					SYSEVT_ERROR(F("LoadIniEEPROM - Saving sensor %d"), (int)sensID);
+				SYSEVT_ERROR(F("LoadIniEEPROM - Saving sensor %d"), (int)sensID);
 
-					sensID++;
-				}
-skip_Sensor:;
+				sensID++;
 			}
 			SetNumSensors(sensID);
+			iniWriteSensorNames(&names);
 			TRACE_INFO(F("LoadIniEEPROM - saved %d sensors"), sensID);
 		}
 
@@ -1323,7 +1789,7 @@ skip_Sensor:;
 						zone.waterFlowRate = ZONE_DEFAULT_FLOWRATE;
 						zone.stationID = st;
 						zone.channel = j;
-						sprintf_P(zone.name, PSTR("Zone %d, Loc %X:%d"), uint16_t(zoneIndex+1), uint16_t(zone.stationID), uint16_t(zone.channel+1));
+						MakeZoneName(&zone, zoneIndex);
 						
 						TRACE_VERBOSE(F("Created zone %d, \"%s\"\n"), (uint8_t)(zoneIndex + 1), zone.name);
 						
@@ -1339,61 +1805,33 @@ skip_Sensor:;
 // Load XBee config
 
 		SetXBeeFlags(0);	// XBee disabled by default
-		if( ini.getValue_P(PSTR("XBee"), PSTR("Enabled"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+		if( INI_PRESENT(&imp, INI_KEY_XBEE_ENABLED) && imp.xbeeEnabled )
 		{
-			if( !strcmp_P(tmpb, PSTR("Yes")) || !strcmp_P(tmpb, PSTR("yes")) ){
 // XBee enabled
-				SetXBeeFlags(NETWORK_FLAGS_ENABLED);
-					
-				if( ini.getValue_P(PSTR("XBee"), PSTR("Port"), buffer, bufferLen, u16 ) )
-					SetXBeePort(u16);
-				else
-					SetXBeePort(NETWORK_XBEE_DEFAULT_PORT);
-
-				if( ini.getValue_P(PSTR("XBee"), PSTR("Speed"), buffer, bufferLen, u16 ) )
-					SetXBeePortSpeed(u16);
-				else
-					SetXBeePortSpeed(NETWORK_XBEE_DEFAULT_SPEED);
-
-				if( ini.getValue_P(PSTR("XBee"), PSTR("PANID"), buffer, bufferLen, u16 ) )
-					SetXBeePANID(u16);
-				else
-					SetXBeePANID(NETWORK_XBEE_DEFAULT_PANID);
+			SetXBeeFlags(NETWORK_FLAGS_ENABLED | ((INI_PRESENT(&imp, INI_KEY_XBEE_RELAY) && imp.xbeeRelay) ? NETWORK_FLAGS_RELAY:0));
 
-				if( ini.getValue_P(PSTR("XBee"), PSTR("Channel"), buffer, bufferLen, u16 ) )
-					SetXBeeChan(u16);
-				else
-					SetXBeeChan(NETWORK_XBEE_DEFAULT_CHAN);
-			}
+			SetXBeePort(INI_PRESENT(&imp, INI_KEY_XBEE_PORT) ? imp.xbeePort : NETWORK_XBEE_DEFAULT_PORT);
+			SetXBeePortSpeed(INI_PRESENT(&imp, INI_KEY_XBEE_SPEED) ? imp.xbeeSpeed : NETWORK_XBEE_DEFAULT_SPEED);
+			SetXBeePANID(INI_PRESENT(&imp, INI_KEY_XBEE_PANID) ? imp.xbeePANID : NETWORK_XBEE_DEFAULT_PANID);
+			SetXBeeChan(INI_PRESENT(&imp, INI_KEY_XBEE_CHANNEL) ? imp.xbeeChan : NETWORK_XBEE_DEFAULT_CHAN);
 		}
 
 // Load MoteinoRF config
 
 		SetMoteinoRFFlags(0);	// MoteinoRF disabled by default
-		if( ini.getValue_P(PSTR("RFM69"), PSTR("Enabled"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+		if( INI_PRESENT(&imp, INI_KEY_RFM_ENABLED) && imp.rfmEnabled )
 		{
-			if( !strcmp_P(tmpb, PSTR("Yes")) || !strcmp_P(tmpb, PSTR("yes")) ){
-// XBee enabled
-				SetMoteinoRFFlags(NETWORK_FLAGS_ENABLED);
-					
-				if( ini.getValue_P(PSTR("RFM69"), PSTR("PANID"), buffer, bufferLen, u16 ) )
-					SetMoteinoRFPANID(u16);
-				else
-					SetMoteinoRFPANID(NETWORK_MOTEINORF_DEFAULT_PANID);
+// MoteinoRF enabled
+			SetMoteinoRFFlags(NETWORK_FLAGS_ENABLED | ((INI_PRESENT(&imp, INI_KEY_RFM_RELAY) && imp.rfmRelay) ? NETWORK_FLAGS_RELAY:0));
 
-				SetMoteinoRFAddr(GetMyStationID());		// for MoteinoRF NodeID == StationID
-			}
+			SetMoteinoRFPANID(INI_PRESENT(&imp, INI_KEY_RFM_PANID) ? imp.rfmPANID : NETWORK_MOTEINORF_DEFAULT_PANID);
+			SetMoteinoRFAddr(GetMyStationID());		// for MoteinoRF NodeID == StationID
 		}
 
 
-// Reset running water counters
+// Reset running water counters and runtime state
 
-		for( uint8_t ii=0; ii<7; ii++ )
-		{
-			SetWWCounter(ii,0);
-			SetWCounterDate(ii,0);
-		}
-		SetTotalWCounter(0);
+		eeJournal.Format();
 
 		localUI.lcd_print_line_clear_pgm(PSTR("EEPROM reloaded"), 0);
 		localUI.lcd_print_line_clear_pgm(PSTR("Rebooting..."), 1);
@@ -1404,8 +1842,285 @@ skip_Sensor:;
 
 }
 
+//
+//  Live configuration reload.
+//
+//	Reads device ini file and applies changes to local channels, stations, zones and sensors without resetting the controller.
+//	Only records that actually differ are written, and only affected modules are re-initialized: local parallel and serial
+//	boards when their IO config changed, Sensors module when sensors list changed. Running schedule is stopped only when
+//	zone topology or local IO config changed, otherwise it keeps running.
+//
+//	Zones are generated from stations in the same order as ResetEEPROM does. Zones that keep the same station:channel
+//	mapping are not touched, so user-edited zone names, flow rates and enabled state survive the reload.
+//
+//	Network, system and RF settings are not reloaded. Changes to StationID or RF config are reported (CONFIG_CHANGED_REBOOT),
+//	factory reset is required to apply these.
+//
+//	Returns bitmap of CONFIG_CHANGED_* flags, or CONFIG_RELOAD_FAILED if device ini file can't be read.
+//
+uint8_t ReloadConfig(void)
+{
+#ifndef HW_ENABLE_SD
+	return CONFIG_RELOAD_FAILED;
+#else // HW_ENABLE_SD
+	IniImport		&imp = iniWork.imp;
+	IniNamePass		&names = iniWork.names;
+	ShortStation	*stations = iniWork.stations;
+	uint8_t			numZones = 0;
+	uint8_t			changes = 0;
+	FullStation		fullStation;
+
+	memset(&imp, 0, sizeof(imp));
+
+	TRACE_INFO(F("Reloading config from device ini file.\n"));
+
+	if( !iniReadFile(iniImportHandler, &imp) )
+		return CONFIG_RELOAD_FAILED;
+
+// Local channels
+
+	uint16_t	parChannels = iniParallelChannels(&imp);
+	EOT			ot = iniParallelOT(&imp, parChannels);
+
+	if( (uint8_t(imp.numParallel) != GetNumIOChannels()) || (ot != GetOT()) )
+		changes |= CONFIG_CHANGED_PARALLEL;
+
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+	uint8_t		zoneToIOMap[LOCAL_NUM_DIRECT_CHANNELS];
+
+	if( parChannels != 0 )
+	{
+		uint8_t		curIOMap[LOCAL_NUM_DIRECT_CHANNELS];
+
+		iniMakeIOMap(&imp, parChannels, zoneToIOMap);
+		LoadZoneIOMap(curIOMap);
+		if( memcmp(zoneToIOMap, curIOMap, LOCAL_NUM_DIRECT_CHANNELS) != 0 )
+			changes |= CONFIG_CHANGED_PARALLEL;
+	}
+#endif //LOCAL_NUM_DIRECT_CHANNELS
+
+	SrIOMapStruct	srIoMap;
+
+	if( uint8_t(imp.numSerial) != GetNumOSChannels() )
+		changes |= CONFIG_CHANGED_SERIAL;
+
+	if( imp.numSerial != 0 )
+	{
+		SrIOMapStruct	curSrIoMap;
+
+		iniMakeSrIOMap(&imp, &srIoMap);
+		LoadSrIOMap(&curSrIoMap);
+		if( memcmp(&srIoMap, &curSrIoMap, sizeof(SrIOMapStruct)) != 0 )
+			changes |= CONFIG_CHANGED_SERIAL;
+	}
+
+// Stations and zones. Build new stations table in RAM, generate zones from it and compare both with the current config.
+
+	memset(stations, 0, sizeof(iniWork.stations));
+
+	uint16_t	numStations = iniNumStations(&imp);
+	for( uint16_t i=0; i<numStations; i++ )
+	{
+		if( iniMakeStation(i, &imp.stations[i], &fullStation) )
+			memcpy(&stations[imp.stations[i].stationID], &fullStation, sizeof(ShortStation));		// ShortStation is the head of FullStation
+	}
+
+	for( uint8_t st=0; st<MAX_STATIONS; st++ )
+	{
+		if( (stations[st].stationFlags & STATION_FLAGS_VALID) && (stations[st].stationFlags & STATION_FLAGS_ENABLED) )
+		{
+			for( uint8_t j=0; (j<stations[st].numZoneChannels) && (numZones<MAX_ZONES); j++ )
+			{
+				if( j == 0 )
+					stations[st].startZone = numZones;
+
+				numZones++;
+			}
+		}
+	}
+
+	uint16_t	stationsChanged = 0;
+	for( uint8_t st=0; st<MAX_STATIONS; st++ )
+	{
+		ShortStation	curStation;
+
+		LoadShortStation(st, &curStation);
+		if( memcmp(&curStation, &stations[st], sizeof(ShortStation)) != 0 )
+			stationsChanged |= 1 << st;
+	}
+	if( stationsChanged )
+		changes |= CONFIG_CHANGED_STATIONS;
+
+	uint8_t		curNumZones = GetNumZones();
+	if( numZones != curNumZones )
+		changes |= CONFIG_CHANGED_ZONES;
+
+	for( uint8_t z=0; (z<numZones) && !(changes & CONFIG_CHANGED_ZONES); z++ )
+	{
+		ShortZone		curZone;
+		uint8_t			loc = iniZoneLoc(stations, z);
+
+		LoadShortZone(z, &curZone);
+		if( (curZone.stationID != (loc >> 4)) || (curZone.channel != (loc & 0x0F)) )
+			changes |= CONFIG_CHANGED_ZONES;
+	}
+
+	if( (iniMyStationID(&imp) != GetMyStationID())
+		|| ((INI_PRESENT(&imp, INI_KEY_XBEE_ENABLED) && imp.xbeeEnabled) != IsXBeeEnabled())
+		|| ((INI_PRESENT(&imp, INI_KEY_RFM_ENABLED) && imp.rfmEnabled) != IsMoteinoRFEnabled()) )
+	{
+		SYSEVT_ERROR(F("ReloadConfig - StationID or RF config changed, factory reset is required to apply it"));
+		changes |= CONFIG_CHANGED_REBOOT;
+	}
+
+// Relaying is checked for every received frame, it can be switched on the fly
+
+	uint8_t		netFlags = GetXBeeFlags() & ~NETWORK_FLAGS_RELAY;
+
+	if( INI_PRESENT(&imp, INI_KEY_XBEE_RELAY) && imp.xbeeRelay )
+		netFlags |= NETWORK_FLAGS_RELAY;
+	if( netFlags != GetXBeeFlags() )
+		SetXBeeFlags(netFlags);
+
+	netFlags = GetMoteinoRFFlags() & ~NETWORK_FLAGS_RELAY;
+	if( INI_PRESENT(&imp, INI_KEY_RFM_RELAY) && imp.rfmRelay )
+		netFlags |= NETWORK_FLAGS_RELAY;
+	if( netFlags != GetMoteinoRFFlags() )
+		SetMoteinoRFFlags(netFlags);
+
+// Stop affected outputs before changing the config they are driven by
+
+	if( changes & (CONFIG_CHANGED_PARALLEL | CONFIG_CHANGED_SERIAL | CONFIG_CHANGED_STATIONS | CONFIG_CHANGED_ZONES) )
+	{
+		runState.StopSchedule();
+		runState.TurnOffZones();
+	}
+
+// Apply changes
+
+	if( changes & CONFIG_CHANGED_PARALLEL )
+	{
+		SetNumIOChannels(imp.numParallel);
+		SetOT(ot);
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+		if( parChannels != 0 )
+			SaveZoneIOMap(zoneToIOMap);
+#endif //LOCAL_NUM_DIRECT_CHANNELS
+	}
+
+	if( changes & CONFIG_CHANGED_SERIAL )
+	{
+		SetNumOSChannels(imp.numSerial);
+		if( imp.numSerial != 0 )
+			SaveSrIOMap(&srIoMap);
+	}
+
+	for( uint8_t st=0; st<MAX_STATIONS; st++ )
+	{
+		if( !(stationsChanged & (1 << st)) )
+			continue;
+
+		memset(&fullStation, 0, sizeof(fullStation));
+		memcpy(&fullStation, &stations[st], sizeof(ShortStation));
+		if( fullStation.stationFlags & STATION_FLAGS_VALID )
+			sprintf_P(fullStation.name, PSTR("Station %d"), st);
+
+		SaveStation(st, &fullStation);
+		TRACE_INFO(F("ReloadConfig - updated station %d\n"), st);
+	}
+
+	if( changes & CONFIG_CHANGED_ZONES )
+	{
+		SetNumZones(numZones);			// first, SaveZone() ignores zones past the current count
+
+		for( uint8_t z=0; z<numZones; z++ )
+		{
+			ShortZone		curZone;
+			uint8_t			loc = iniZoneLoc(stations, z);
+
+			if( z < curNumZones )
+			{
+				LoadShortZone(z, &curZone);
+				if( (curZone.stationID == (loc >> 4)) && (curZone.channel == (loc & 0x0F)) )
+					continue;			// same mapping, keep user settings of this zone
+			}
+
+			FullZone	zone = {0};
+
+			zone.bEnabled = 1;
+			zone.waterFlowRate = ZONE_DEFAULT_FLOWRATE;
+			zone.stationID = loc >> 4;
+			zone.channel = loc & 0x0F;
+			MakeZoneName(&zone, z);
+
+			SaveZone(z, &zone);
+			TRACE_INFO(F("ReloadConfig - updated zone %d, \"%s\"\n"), uint16_t(z+1), zone.name);
+		}
+	}
+
+// Sensors. These don't need any preparation, just compare and write changed records.
+
+	uint16_t	numSensors = iniNumSensors(&imp);
+	uint8_t		sensID = 0;
+
+	memset(names.slot, INI_NO_SLOT, sizeof(names.slot));
+	for( uint16_t i=1; i<=numSensors; i++ )
+	{
+		FullSensor		newSensor, curSensor;
+		bool			fNamed = imp.sensors[i-1].present & (1 << INI_SENSOR_KEY_NAME);	// name is compared by the names pass
+
+		if( !iniMakeSensor(&imp, i, &newSensor) )
+			continue;
+
+		names.slot[i-1] = sensID;
+		if( sensID < GetNumSensors() )
+		{
+			LoadSensor(sensID, &curSensor);
+			if( (memcmp(&curSensor, &newSensor, sizeof(ShortSensor)) == 0) && (fNamed || (strncmp(curSensor.name, newSensor.name, MAX_SENSOR_NAME_LENGTH) == 0)) )
+			{
+				sensID++;
+				continue;
+			}
+		}
+
+		SaveSensor(sensID, &newSensor);
+		TRACE_INFO(F("ReloadConfig - updated sensor %d\n"), sensID);
+		changes |= CONFIG_CHANGED_SENSORS;
+		sensID++;
+	}
+	if( sensID != GetNumSensors() )
+	{
+		SetNumSensors(sensID);
+		changes |= CONFIG_CHANGED_SENSORS;
+	}
+	if( iniWriteSensorNames(&names) )
+		changes |= CONFIG_CHANGED_SENSORS;
+
+	settingsCache.flush();
+
+// Re-initialize affected modules
+
+	if( changes & CONFIG_CHANGED_PARALLEL )
+		lBoardParallel.begin();
+
+	if( changes & CONFIG_CHANGED_SERIAL )
+		lBoardSerial.begin();
+
+	if( changes & CONFIG_CHANGED_SENSORS )
+		sensorsModule.ReloadConfig();
+
+	if( changes & (CONFIG_CHANGED_STATIONS | CONFIG_CHANGED_ZONES) )
+		ReloadEvents();
+
+	SYSEVT_NOTICE(F("Config reloaded, changes: 0x%x"), uint16_t(changes));
+	return changes;
+#endif // HW_ENABLE_SD
+}
+
 void 	ResetEEPROM_NoSD(uint8_t  defStationID)
 {
+	settingsCache.invalidate();		// EEPROM is rebuilt from scratch, switch settings to direct EEPROM access
+
 #ifndef HW_ENABLE_SD
 		TRACE_INFO(F("Loading EEPROM using default config (no device.ini file).\n"));
 
@@ -1514,6 +2229,46 @@ void 	ResetEEPROM_NoSD(uint8_t  defStationID)
 
 				SaveSensor(sensID, &fullSens);	// save the sensor
 				sensID++;
+
+#ifdef SENSOR_CHANNEL_DHT_2_PIN
+				fullSens.sensorType = SENSOR_TYPE_TEMPERATURE;
+				fullSens.sensorChannel = SENSOR_CHANNEL_DHT_2_TEMPERATURE;
+				fullSens.sensorStationID = defStationID;
+				fullSens.flags = 0;	
+				sprintf_P(fullSens.name, PSTR("Sensor %u:%u"), uint16_t(defStationID), SENSOR_CHANNEL_DHT_2_TEMPERATURE);	
+
+				SaveSensor(sensID, &fullSens);	// save the sensor
+				sensID++;
+
+				fullSens.sensorType = SENSOR_TYPE_HUMIDITY;
+				fullSens.sensorChannel = SENSOR_CHANNEL_DHT_2_HUMIDITY;
+				fullSens.sensorStationID = defStationID;
+				fullSens.flags = 0;	
+				sprintf_P(fullSens.name, PSTR("Sensor %u:%u"), uint16_t(defStationID), SENSOR_CHANNEL_DHT_2_HUMIDITY);	
+
+				SaveSensor(sensID, &fullSens);	// save the sensor
+				sensID++;
+#endif // SENSOR_CHANNEL_DHT_2_PIN
+
+#ifdef SENSOR_CHANNEL_DHT_3_PIN
+				fullSens.sensorType = SENSOR_TYPE_TEMPERATURE;
+				fullSens.sensorChannel = SENSOR_CHANNEL_DHT_3_TEMPERATURE;
+				fullSens.sensorStationID = defStationID;
+				fullSens.flags = 0;	
+				sprintf_P(fullSens.name, PSTR("Sensor %u:%u"), uint16_t(defStationID), SENSOR_CHANNEL_DHT_3_TEMPERATURE);	
+
+				SaveSensor(sensID, &fullSens);	// save the sensor
+				sensID++;
+
+				fullSens.sensorType = SENSOR_TYPE_HUMIDITY;
+				fullSens.sensorChannel = SENSOR_CHANNEL_DHT_3_HUMIDITY;
+				fullSens.sensorStationID = defStationID;
+				fullSens.flags = 0;	
+				sprintf_P(fullSens.name, PSTR("Sensor %u:%u"), uint16_t(defStationID), SENSOR_CHANNEL_DHT_3_HUMIDITY);	
+
+				SaveSensor(sensID, &fullSens);	// save the sensor
+				sensID++;
+#endif // SENSOR_CHANNEL_DHT_3_PIN
 			}
 #endif // SENSOR_ENABLE_DHT
 
@@ -1626,7 +2381,7 @@ void 	ResetEEPROM_NoSD(uint8_t  defStationID)
 						zone.waterFlowRate = ZONE_DEFAULT_FLOWRATE;
 						zone.stationID = st;
 						zone.channel = j;
-						sprintf_P(zone.name, PSTR("Zone %d, Loc %X:%d"), uint16_t(zoneIndex + 1), uint16_t(zone.stationID), uint16_t(zone.channel+1));
+						MakeZoneName(&zone, zoneIndex);
 						
 						TRACE_VERBOSE(F("Created zone %d, \"%s\""), uint16_t(zoneIndex + 1), zone.name);
 						
@@ -1658,14 +2413,9 @@ void 	ResetEEPROM_NoSD(uint8_t  defStationID)
 		SetMoteinoRFAddr(GetMyStationID());		// for MoteinoRF NodeID == StationID
 #endif //HW_ENABLE_MOTEINORF
 
-// Reset running water counters
+// Reset running water counters and runtime state
 
-		for( uint8_t ii=0; ii<7; ii++ )
-		{
-			SetWWCounter(ii,0);
-			SetWCounterDate(ii,0);
-		}
-		SetTotalWCounter(0);
+		eeJournal.Format();
 
 // show message and reboot
 		localUI.lcd_print_line_clear_pgm(PSTR("EEPROM reloaded"), 0);
@@ -1681,10 +2431,14 @@ void 	ResetEEPROM_NoSD(uint8_t  defStationID)
 void SetNumSchedules(const uint8_t iNum)
 {
         EEPROM.write(ADDR_SCHEDULE_COUNT, iNum);
+        settingsCache.numSchedules = iNum;
 }
 
 uint8_t GetNumSchedules()
 {
+        if( settingsCache.fValid )
+                return settingsCache.numSchedules;
+
         return EEPROM.read(ADDR_SCHEDULE_COUNT);
 }
 
@@ -1780,8 +2534,11 @@ void GetPWS(char * key)
 
 void SetPWS(const char * key)
 {
-        for (int i=0; i<11; i++)
+        int i = 0;
+        for (; (i<11) && key[i]; i++)
                 EEPROM.write(ADDR_PWS+i, key[i]);
+        for (; i<11; i++)					// zero padded, shorter keys used to copy whatever followed the string
+                EEPROM.write(ADDR_PWS+i, 0);
 }
 
 void GetApiKey(char * key)
@@ -1827,6 +2584,8 @@ bool GetRunSchedules()
 void SetRunSchedules(bool value)
 {
         uint8_t current = EEPROM.read(ADDR_OP1);
+        if( bool(current & 0x01) != value )
+                eventBus.Publish(SGEVT_RUN_SCHEDULES, value, 0);
         if (value)
                 EEPROM.write(ADDR_OP1, current | 0x01);
         else
@@ -1924,12 +2683,16 @@ int GetNumEnabledZones()
 
 uint8_t GetNumSensors(void)
 {
+	if( settingsCache.fValid )
+		return settingsCache.numSensors;
+
 	return EEPROM.read(ADDR_NUM_SENSORS);
 }
 
 void SetNumSensors(uint8_t numSensors)
 {
 	EEPROM.write(ADDR_NUM_SENSORS, numSensors);
+	settingsCache.numSensors = numSensors;
 }
 
 // get number of valid and enabled stations
@@ -1953,6 +2716,9 @@ uint16_t GetEvtMasterFlags(void)
 {
 	uint16_t flags;
 
+	if( settingsCache.fValid )
+		return settingsCache.evtMasterFlags;
+
 	flags = EEPROM.read(ADDR_EVTMASTER_FLAGS+1) << 8;
 	flags += EEPROM.read(ADDR_EVTMASTER_FLAGS);
 
@@ -1961,6 +2727,9 @@ uint16_t GetEvtMasterFlags(void)
 
 uint8_t  GetEvtMasterStationID(void)
 {
+	if( settingsCache.fValid )
+		return settingsCache.evtMasterStationID;
+
 	return EEPROM.read(ADDR_EVTMASTER_STATIONID);
 }
 
@@ -1971,11 +2740,13 @@ void SetEvtMasterFlags(uint16_t flags)
 
 	EEPROM.write(ADDR_EVTMASTER_FLAGS+1, flagsH);
 	EEPROM.write(ADDR_EVTMASTER_FLAGS, flagsL);
+	settingsCache.evtMasterFlags = flags;
 }
 
 void SetEvtMasterStationID(uint8_t stationID)
 {
 	EEPROM.write(ADDR_EVTMASTER_STATIONID, stationID);
+	settingsCache.evtMasterStationID = stationID;
 }
 
 
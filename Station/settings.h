@@ -30,6 +30,21 @@ Portions came from sprinklers_pi code by Richard Zimmerman
 
 #define NETWORK_FLAGS_ENABLED		1	// 1 - indicates that the network is enabled (config)
 #define NETWORK_FLAGS_ON			2	// 1 - indicates that the network is running (runtime state)
+#define NETWORK_FLAGS_RELAY			4	// 1 - station relays frames of other stations on this network (config)
+
+// Compact form of the Schedule record, enough to find the next scheduled event without loading full schedules
+struct ShortSchedule
+{
+	uint8_t		type;					// schedule type flags, same as Schedule::m_type
+	uint8_t		day;					// day mask or interval, same as Schedule::day
+	short		time[4];				// start times, minutes since midnight, or -1 if not used
+	uint8_t		firstZone;				// first zone in this schedule with non-zero duration, or SCHEDULE_NO_ZONES
+
+	bool IsEnabled() const { return type & 0x01; }
+	bool IsInterval() const { return type & 0x02; }
+};
+
+#define SCHEDULE_NO_ZONES		0xFF
 
 class Schedule
 {
@@ -51,6 +66,7 @@ public:
 	void SetEnabled(bool val) { m_type = val ? (m_type | 0x01) : (m_type & ~0x01); }
 	void SetInterval(bool val) { m_type = val ? (m_type | 0x02) : (m_type & ~0x02); }
 	void SetWAdj(bool val) { m_type = val ? (m_type | 0x04) : (m_type & ~0x04); }
+	void GetShortSchedule(ShortSchedule *pShort) const;
 };
 
 // Zone definition structure
@@ -108,6 +124,12 @@ struct ShortSensor
 #define SENSOR_FLAGS_DASHBOARD		16	// this sensor should be shown on Sensors Dashboard
 #define SENSOR_FLAGS_HOMEPAGE		32	// this sensor should be shown on the Home page
 
+// Analog conversion curve of the sensor (ANALOG_CURVE_*, see AnalogConv.h). Bits 4-5 are taken, so the curve is split:
+// bits 0-1 of the curve are kept in flag bits 2-3, bit 2 of the curve in flag bit 6.
+#define SENSOR_FLAGS_CURVE_MASK		0x4C
+#define SENSOR_FLAGS_GET_CURVE(flags)	((((flags) >> 2) & 0x03) | (((flags) >> 4) & 0x04))
+#define SENSOR_FLAGS_CURVE(curve)	uint8_t((((curve) & 0x03) << 2) | (((curve) & 0x04) << 4))
+
 
 //	Station definition structure. This structure reflects station definition in EEPROM.
 //
@@ -151,8 +173,12 @@ struct ShortStation
 #define NETWORK_ID_LOCAL_SERIAL		1	// hardware connection to the master controller - OpenSprinkler
 #define NETWORK_ID_XBEE				10	// XBee RF
 #define NETWORK_ID_MOTEINORF		11	// RFM (Moteino standard) RF
+#define NETWORK_ID_UDP				12	// UDP datagrams, used by host (Linux) simulation builds
+#define NETWORK_ID_LOOPBACK			13	// in-memory loopback, used for testing
 #define NETWORK_ID_INVALID			255	// 
 
+#define IS_REMOTE_NETWORK(id)		(((id) >= NETWORK_ID_XBEE) && ((id) <= NETWORK_ID_LOOPBACK))	// station is reached through RProtocol transport
+
 #define STATION_FLAGS_VALID  		1	// 1 - indicates that this Station structure is filled in and valid
 #define STATION_FLAGS_ENABLED		2	// 1 - indicates that this Station is enabled
 #define STATION_FLAGS_RSTATUS		4	// 1 - indicates that this station status could be queried remotely (via RF network)
@@ -209,6 +235,7 @@ void SetPWS(const char * key);
 bool GetUsePWS();
 void SetUsePWS(bool value);
 void LoadSchedule(uint8_t num, Schedule * pSched);
+void LoadShortSchedule(uint8_t num, ShortSchedule * pSched);
 void LoadZone(uint8_t num, FullZone * pZone);
 void LoadShortZone(uint8_t index, ShortZone * pZone);
 
@@ -256,7 +283,10 @@ inline uint8_t GetStationNetworkID(uint8_t num)
         if( num >= MAX_STATIONS )
                 return NETWORK_ID_INVALID;
 
-        return EEPROM.read(STATION_OFFSET + STATION_STRUCT_OFFSET_NETWORKID + STATION_INDEX * num);	// Note: networkID offset in the structure is 1 ***structure dependency!***
+        ShortStation	sStation;
+
+        LoadShortStation(num, &sStation);		// served from the settings cache once it is loaded
+        return sStation.networkID;
 }
 
 
@@ -304,6 +334,8 @@ void SetMoteinoRFFlags(uint8_t flags);
 void SetMoteinoRFPANID(uint8_t panID);
 void SetMoteinoRFAddr(uint8_t addr);
 
+bool IsRelayEnabled(void);
+
 
 // KV Pairs Setters
 bool SetSchedule(const KVPairs & key_value_pairs);
@@ -316,6 +348,16 @@ bool SetOneZones(const KVPairs & key_value_pairs);
 bool IsFirstBoot();
 void ResetEEPROM();
 void 	ResetEEPROM_NoSD(uint8_t  defStationID);
+uint8_t ReloadConfig(void);
+
+// ReloadConfig() results
+#define CONFIG_CHANGED_PARALLEL		0x01	// local parallel channels config
+#define CONFIG_CHANGED_SERIAL		0x02	// local serial channels config
+#define CONFIG_CHANGED_STATIONS		0x04
+#define CONFIG_CHANGED_ZONES		0x08
+#define CONFIG_CHANGED_SENSORS		0x10
+#define CONFIG_CHANGED_REBOOT		0x40	// StationID or RF config changed, these are not applied without factory reset
+#define CONFIG_RELOAD_FAILED		0x80
 
 // For storing info related to the Quick Schedule
 extern Schedule quickSchedule;
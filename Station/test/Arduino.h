@@ -0,0 +1,8 @@
+#ifndef _ARDUINO_COMPAT_H
+#define _ARDUINO_COMPAT_H
+
+// Some modules include Arduino.h directly, host builds use the same minimal environment
+
+#include "WProgram.h"
+
+#endif
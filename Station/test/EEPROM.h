@@ -0,0 +1,23 @@
+#ifndef _EEPROM_COMPAT_H
+#define _EEPROM_COMPAT_H
+
+// EEPROM of the host builds is a RAM array of the ATmega2560 EEPROM size, see host_eeprom.cpp
+
+#include <stdint.h>
+
+#define HOST_EEPROM_SIZE	4096
+
+extern uint8_t hostEEPROM[HOST_EEPROM_SIZE];
+
+void hostEEPROMCheck(int addr, int len);		// aborts on access outside of the EEPROM
+
+class EEPROMClass
+{
+public:
+	uint8_t read(int addr) { hostEEPROMCheck(addr, 1); return hostEEPROM[addr]; };
+	void write(int addr, uint8_t value) { hostEEPROMCheck(addr, 1); hostEEPROM[addr] = value; };
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
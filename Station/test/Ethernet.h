@@ -0,0 +1,32 @@
+#ifndef _ETHERNET_COMPAT_H
+#define _ETHERNET_COMPAT_H
+
+// Ethernet is not used by the host builds, just enough for the Station headers and IniFile
+
+#include <stdint.h>
+#include <string.h>
+
+class IPAddress
+{
+public:
+	IPAddress() { _addr[0] = _addr[1] = _addr[2] = _addr[3] = 0; };
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _addr[0] = a; _addr[1] = b; _addr[2] = c; _addr[3] = d; };
+	IPAddress(uint32_t addr) { memcpy(_addr, &addr, 4); };
+	operator uint32_t() const { uint32_t addr; memcpy(&addr, _addr, 4); return addr; };
+	bool operator==(const IPAddress &ip) const { return memcmp(_addr, ip._addr, 4) == 0; };
+	uint8_t operator[](int i) const { return _addr[i]; };
+	uint8_t& operator[](int i) { return _addr[i]; };
+
+private:
+	uint8_t _addr[4];
+};
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+class EthernetClient
+{
+};
+
+class EthernetServer;
+
+#endif
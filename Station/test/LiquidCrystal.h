@@ -0,0 +1,10 @@
+#ifndef _LIQUIDCRYSTAL_COMPAT_H
+#define _LIQUIDCRYSTAL_COMPAT_H
+
+// LCD is not used by the host builds, just enough for localUI.h
+
+class LiquidCrystal
+{
+};
+
+#endif
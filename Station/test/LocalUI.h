@@ -0,0 +1,8 @@
+#ifndef _LOCALUI_COMPAT_H
+#define _LOCALUI_COMPAT_H
+
+// Some modules include localUI.h as LocalUI.h, which works only on case-insensitive file systems
+
+#include "localUI.h"
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _SDFAT_COMPAT_H
+#define _SDFAT_COMPAT_H
+
+// SD card of the host builds is the current directory, just enough for the Station headers and IniFile
+
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+
+class SdBaseFile
+{
+public:
+	SdBaseFile(void) : _f(NULL) { };
+
+	bool open(const char *filename, uint8_t mode)
+	{
+		close();
+		if( filename[0] == '/' )		// SD root
+			filename++;
+		_f = fopen(filename, (mode & O_WRONLY) ? "r+" : "r");
+		return _f != NULL;
+	};
+	void close(void) { if( _f != NULL ) fclose(_f); _f = NULL; };
+	bool isOpen(void) const { return _f != NULL; };
+
+	bool seekSet(uint32_t pos) { return (_f != NULL) && (fseek(_f, pos, SEEK_SET) == 0); };
+	int read(void *buf, size_t n) { return (_f != NULL) ? int(fread(buf, 1, n, _f)) : -1; };
+	int available(void)
+	{
+		if( _f == NULL )
+			return 0;
+
+		long	pos = ftell(_f);
+
+		fseek(_f, 0, SEEK_END);
+		long	size = ftell(_f);
+		fseek(_f, pos, SEEK_SET);
+		return int(size - pos);
+	};
+
+private:
+	FILE *_f;
+};
+
+class SdFile : public SdBaseFile
+{
+};
+
+class SdFat
+{
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _Time_h
+#define _Time_h
+
+// Arduino Time library API for the host builds. time_t is the host one, the clock is implemented by the host build.
+
+#include <inttypes.h>
+#include <time.h>
+
+typedef enum {timeNotSet, timeNeedsSync, timeSet
+}  timeStatus_t ;
+
+#define SECS_PER_MIN  (60UL)
+#define SECS_PER_HOUR (3600UL)
+#define SECS_PER_DAY  (SECS_PER_HOUR * 24UL)
+
+#define numberOfSeconds(_time_) (_time_ % SECS_PER_MIN)
+#define numberOfMinutes(_time_) ((_time_ / SECS_PER_MIN) % SECS_PER_MIN)
+#define numberOfHours(_time_) (( _time_% SECS_PER_DAY) / SECS_PER_HOUR)
+#define elapsedDays(_time_) ( _time_ / SECS_PER_DAY)
+#define elapsedSecsToday(_time_)  (_time_ % SECS_PER_DAY)
+#define previousMidnight(_time_) (( _time_ / SECS_PER_DAY) * SECS_PER_DAY)
+
+int     hour(time_t t);
+int     minute(time_t t);
+int     second(time_t t);
+int     day(time_t t);
+int     weekday(time_t t);
+int     month(time_t t);
+int     year(time_t t);
+time_t  now();
+void    setTime(time_t t);
+void    adjustTime(long adjustment);
+timeStatus_t timeStatus();
+
+#endif /* _Time_h */
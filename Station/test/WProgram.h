@@ -0,0 +1,70 @@
+#ifndef _WPROGRAM_COMPAT_H
+#define _WPROGRAM_COMPAT_H
+
+// Minimal Arduino environment for building Station modules on the host
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// No separate program memory on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) ((const __FlashStringHelper *)(s))
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word_near(addr) (*(const uint16_t *)(addr))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define strncasecmp_P strncasecmp
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define fprintf_P fprintf
+#define printf_P printf
+
+typedef char prog_char;
+typedef const char *PGM_P;
+class __FlashStringHelper;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+// Host time base, implemented by the host build
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(unsigned long ms);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// Serial-like output for trace_setup()
+class Stream
+{
+};
+
+#endif
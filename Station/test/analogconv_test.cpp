@@ -0,0 +1,95 @@
+/*
+  Host test of the analog conversion curves.
+
+  Thermistor curve is compared against the original linear scan implementation for all 1024 ADC codes,
+  B3950 curve against the Beta formula. Probe curves are checked for end points and monotonicity.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../AnalogConv.h"
+#include "thermistor_ref.h"
+
+static int errors = 0;
+
+static void check(const char *name, int code, int expected, int actual)
+{
+	if( expected != actual )
+	{
+		printf("%s: ADC %d, expected %d, got %d\n", name, code, expected, actual);
+		errors++;
+	}
+}
+
+int main(void)
+{
+	int		compared = 0;
+
+	for( int code=0; code<1024; code++ )
+	{
+		int		ref = convertTempIntRef(code);
+		int		f = AnalogConvert(ANALOG_CURVE_THERM10K_F, code);
+
+		check("default curve", code, f, AnalogConvert(ANALOG_CURVE_DEFAULT, code));
+
+		check("thermistor F", code, ref, f);
+		compared++;
+
+		// C curve should agree with F curve within the rounding of both
+		if( (f != ANALOG_UNDER_RANGE) && (f != ANALOG_OVER_RANGE) )
+		{
+			int		c = AnalogConvert(ANALOG_CURVE_THERM10K_C, code);
+			int		cFromF = (f - 32) * 10 / 18;
+
+			if( abs(c - cFromF) > 1 )
+				check("thermistor C", code, cFromF, c);
+		}
+		else
+			check("thermistor C range", code, f, AnalogConvert(ANALOG_CURVE_THERM10K_C, code));
+	}
+
+	// B3950 thermistor, C within 1 degree of the Beta formula
+	for( int code=89; code<=865; code++ )
+	{
+		double	r = 10000.0 * (1023.0 - code) / code;
+		double	t = 1.0 / (1.0/298.15 + log(r/10000.0)/3950.0) - 273.15;
+		int		c = AnalogConvert(ANALOG_CURVE_B3950_C, code);
+		int		f = AnalogConvert(ANALOG_CURVE_B3950_F, code);
+
+		if( fabs(c - t) > 1.0 )
+			check("B3950 C", code, int(t), c);
+		if( fabs(f - (t*1.8 + 32)) > 2.0 )
+			check("B3950 F", code, int(t*1.8 + 32), f);
+	}
+	check("B3950 under range", 88, ANALOG_UNDER_RANGE, AnalogConvert(ANALOG_CURVE_B3950_C, 88));
+	check("B3950 over range", 866, ANALOG_OVER_RANGE, AnalogConvert(ANALOG_CURVE_B3950_F, 866));
+
+	// Soil moisture goes from 100% down to 0% as the reading goes up
+	check("soil wet", 280, 100, AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, 280));
+	check("soil dry", 556, 0, AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, 556));
+	check("soil under range", 279, ANALOG_UNDER_RANGE, AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, 279));
+	check("soil over range", 557, ANALOG_OVER_RANGE, AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, 557));
+	for( int code=281; code<=556; code++ )
+		if( AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, code) > AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, code-1) )
+			check("soil monotonic", code, AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, code-1), AnalogConvert(ANALOG_CURVE_SOIL_MOISTURE, code));
+
+	// Pressure transducers, 0.5V is zero pressure, 4.5V is full scale, open wire is under range
+	check("psi zero", 102, 0, AnalogConvert(ANALOG_CURVE_PRESSURE_PSI, 102));
+	check("psi mid", 512, 50, AnalogConvert(ANALOG_CURVE_PRESSURE_PSI, 512));
+	check("psi full", 921, 100, AnalogConvert(ANALOG_CURVE_PRESSURE_PSI, 921));
+	check("psi open wire", 0, ANALOG_UNDER_RANGE, AnalogConvert(ANALOG_CURVE_PRESSURE_PSI, 0));
+	check("psi over range", 922, ANALOG_OVER_RANGE, AnalogConvert(ANALOG_CURVE_PRESSURE_PSI, 922));
+	check("kPa zero", 102, 0, AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, 102));
+	check("kPa full", 921, 1200, AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, 921));
+	for( int code=103; code<=921; code++ )
+		if( AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, code) < AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, code-1) )
+			check("kPa monotonic", code, AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, code-1), AnalogConvert(ANALOG_CURVE_PRESSURE_KPA, code));
+
+	check("unknown curve", 500, AnalogConvert(ANALOG_CURVE_DEFAULT, 500), AnalogConvert(ANALOG_NUM_CURVES, 500));
+
+	printf("%d ADC codes compared, %d errors\n", compared, errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+#ifndef _AVR_EEPROM_COMPAT_H
+#define _AVR_EEPROM_COMPAT_H
+
+// avr-libc EEPROM API on top of the host EEPROM array, see host_eeprom.cpp
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint16_t eeprom_read_word(const uint16_t *p);
+uint32_t eeprom_read_dword(const uint32_t *p);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+
+void eeprom_update_byte(uint8_t *p, uint8_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _AVR_WDT_COMPAT_H
+#define _AVR_WDT_COMPAT_H
+
+// No watchdog on the host
+
+#define wdt_disable()
+#define wdt_reset()
+#define wdt_enable(t)
+
+#endif
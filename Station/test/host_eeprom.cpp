@@ -0,0 +1,63 @@
+/*
+        Host (Linux) EEPROM.
+
+EEPROM is a RAM array, accessed through the Arduino EEPROM library API (EEPROM.h) and the avr-libc API (avr/eeprom.h).
+EEPROM addresses are offsets in the array. Access outside of the EEPROM aborts the program.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "EEPROM.h"
+#include "avr/eeprom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint8_t		hostEEPROM[HOST_EEPROM_SIZE];
+EEPROMClass	EEPROM;
+
+void hostEEPROMCheck(int addr, int len)
+{
+	if( (addr >= 0) && (len >= 0) && (addr + len <= HOST_EEPROM_SIZE) )
+		return;
+
+	fprintf(stderr, "EEPROM access out of range - address %d, length %d\n", addr, len);
+	abort();
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+	uint16_t	value;
+
+	eeprom_read_block(&value, p, sizeof(value));
+	return value;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *p)
+{
+	uint32_t	value;
+
+	eeprom_read_block(&value, p, sizeof(value));
+	return value;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	hostEEPROMCheck(int(intptr_t(src)), int(n));
+	memcpy(dst, hostEEPROM + intptr_t(src), n);
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	eeprom_update_block(&value, p, 1);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	hostEEPROMCheck(int(intptr_t(dst)), int(n));
+	memcpy(hostEEPROM + intptr_t(dst), src, n);
+}
@@ -0,0 +1,266 @@
+/*
+        Host (Linux) environment for the Station modules.
+
+See host_station.h for the description.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "host_station.h"
+#include "settings.h"
+#include "core.h"
+#include "sensors.h"
+#include "sdlog.h"
+
+#include <time.h>
+#include <unistd.h>
+
+runStateClass	runState;
+Sensors			sensorsModule;
+nntp			nntpTimeServer;
+
+uint32_t		hostSensorReports = 0;
+
+static uint8_t	hostStationID = 0;
+static uint8_t	hostNumStations = 0;
+static uint8_t	hostNetworkID = NETWORK_ID_UDP;
+static bool		hostTrace = false;
+static uint8_t	hostEvtMasterID = 0;
+static uint16_t	hostEvtMasterFlags = 0;
+static long		hostTimeOffset = 0;		// seconds, set by setTime()/adjustTime()
+
+void HostStationSetup(uint8_t myStationID, uint8_t numStations, uint8_t networkID, bool fTrace)
+{
+	hostStationID = myStationID;
+	hostNumStations = numStations;
+	hostNetworkID = networkID;
+	hostTrace = fTrace;
+
+	for( uint8_t i=0; i<HOST_NUM_SENSORS; i++ )
+		sensorsModule.SensorsList[i].lastReading = myStationID*100 + i;
+
+	srandom(getpid());
+}
+
+// Arduino time base. millis() and micros() wrap around at 32 bits, as on AVR.
+
+static uint64_t hostMicros(void)
+{
+	struct timespec		ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec)*1000000ull + ts.tv_nsec/1000;
+}
+
+uint32_t millis(void)
+{
+	return uint32_t(hostMicros()/1000ull);
+}
+
+uint32_t micros(void)
+{
+	return uint32_t(hostMicros());
+}
+
+void delay(unsigned long ms)
+{
+	usleep(ms*1000ul);
+}
+
+long random(long howbig)
+{
+	if( howbig <= 0 )
+		return 0;
+	return ::random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+	if( howsmall >= howbig )
+		return howsmall;
+	return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+	srandom(seed);
+}
+
+// Time library
+
+time_t now()
+{
+	return time(0) + hostTimeOffset;
+}
+
+void setTime(time_t t)
+{
+	hostTimeOffset = long(t - time(0));
+}
+
+void adjustTime(long adjustment)
+{
+	hostTimeOffset += adjustment;
+}
+
+timeStatus_t timeStatus()
+{
+	return timeSet;
+}
+
+// Trace and system log go to stderr, prefixed with the station ID
+
+static void hostLog(const char *fmt, va_list args)
+{
+	if( !hostTrace )
+		return;
+
+	fprintf(stderr, "[%u] ", hostStationID);
+	vfprintf(stderr, fmt, args);
+	if( fmt[0] && (fmt[strlen(fmt)-1] != '\n') )
+		fputc('\n', stderr);
+}
+
+void trace(const char *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	hostLog(fmt, args);
+	va_end(args);
+}
+
+void trace(const __FlashStringHelper *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	hostLog((const char *)fmt, args);
+	va_end(args);
+}
+
+void syslog_evt(uint8_t event_type, const char *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	hostLog(fmt, args);
+	va_end(args);
+}
+
+void syslog_evt(uint8_t event_type, const __FlashStringHelper *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	hostLog((const char *)fmt, args);
+	va_end(args);
+}
+
+// Settings
+
+uint8_t GetMyStationID(void)
+{
+	return hostStationID;
+}
+
+void LoadShortStation(uint8_t num, ShortStation *pStation)
+{
+	memset(pStation, 0, sizeof(ShortStation));
+	if( (num == 0) || (num > hostNumStations) || (num == hostStationID) )
+		return;
+
+	pStation->stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED | STATION_FLAGS_RSTATUS | STATION_FLAGS_RCONTROL;
+	pStation->networkID = hostNetworkID;
+	pStation->numZoneChannels = HOST_NUM_ZONES;
+	pStation->startZone = 0;
+	pStation->networkAddress = num;
+}
+
+uint8_t GetNumZones(void)
+{
+	return HOST_NUM_ZONES;
+}
+
+uint8_t GetNumSensors(void)
+{
+	return HOST_NUM_SENSORS;
+}
+
+uint8_t GetZoneState(uint8_t iNum)
+{
+	return 0;
+}
+
+uint16_t GetXBeePANID(void)
+{
+	return 0;
+}
+
+bool IsRelayEnabled(void)
+{
+	return false;
+}
+
+uint16_t GetEvtMasterFlags(void)
+{
+	return hostEvtMasterFlags;
+}
+
+uint8_t GetEvtMasterStationID(void)
+{
+	return hostEvtMasterID;
+}
+
+void SetEvtMasterFlags(uint16_t flags)
+{
+	hostEvtMasterFlags = flags;
+}
+
+void SetEvtMasterStationID(uint8_t stationID)
+{
+	hostEvtMasterID = stationID;
+}
+
+// Run state - simulated stations have no zone outputs
+
+runStateClass::runStateClass()
+{
+}
+
+bool runStateClass::RemoteStartZone(int iSchedule, uint8_t stationID, uint8_t channel, uint8_t time2run)
+{
+	return true;
+}
+
+void runStateClass::RemoteStopAllZones(void)
+{
+}
+
+void runStateClass::ReportStationZonesStatus(uint8_t stationID, uint8_t z_status)
+{
+}
+
+// Sensors
+
+void Sensors::ReportSensorReading(uint8_t stationID, uint8_t sensorChannel, int32_t sensorReading)
+{
+	hostSensorReports++;
+}
+
+// NTP
+
+nntp::nntp(void)
+{
+}
+
+nntp::~nntp(void)
+{
+}
+
+void nntp::SetLastUpdateTime(void)
+{
+}
@@ -0,0 +1,28 @@
+/*
+        Host (Linux) environment for the Station modules.
+
+Replaces settings, run state, sensors, NTP and system log of the real station with minimal in-memory versions, so RProtocol
+and the transports can run as plain Linux processes (see rprotocol_sim.cpp).
+
+Stations 1..numStations are configured as remote stations on the given network, each with HOST_NUM_ZONES zones and
+HOST_NUM_SENSORS sensors.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#ifndef _HOST_STATION_h
+#define _HOST_STATION_h
+
+#include <inttypes.h>
+
+#define HOST_NUM_ZONES		4
+#define HOST_NUM_SENSORS	2
+
+void HostStationSetup(uint8_t myStationID, uint8_t numStations, uint8_t networkID, bool fTrace);
+
+extern uint32_t hostSensorReports;		// sensor readings received from remote stations
+
+#endif //_HOST_STATION_h
@@ -0,0 +1,611 @@
+/*
+        Per-key device.ini import - reference for ini_import_test.
+
+This is ResetEEPROM() as it was before the single pass import: one IniFile::getValue() lookup per key, values written
+into EEPROM as they are read. It is kept here to check that the single pass import writes the same EEPROM image.
+
+Changes against the original code:
+  - keys and values added to the import later (UDP and Loopback networks, Flowrate sensors, sensor Curve, XBee and RFM69
+    Relay) are looked up the same way
+  - sensor names are read into a zero filled buffer of MAX_SENSOR_NAME_LENGTH, as the single pass import does (the original
+    copied 20 bytes out of a 16 byte stack buffer)
+  - NTPOffset is always -8, as it was in practice (getValue() overloads with a typed value never fail)
+  - water counters are reset by formatting the EEPROM journal, settings cache is invalidated first
+  - LCD messages and the reboot at the end are left out
+
+Note: typed IniFile::getValue() overloads do not detect missing keys, so the original import took leftovers of the line
+buffer for keys missing from the file. Test files should define all keys this code reads, except Curve and Relay.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "settings.h"
+#include "port.h"
+#include <string.h>
+#include <stdlib.h>
+#include <IniFile.h>
+#include "eepromMap.h"
+#include "SettingsCache.h"
+#include "EEJournal.h"
+#include "sdlog.h"
+#include "AnalogConv.h"
+
+void SaveZone(uint8_t num, const FullZone * pZone);		// settings.cpp
+
+static bool iniYes(const IniFile &ini, const char *section, const char *key, char *buffer, size_t bufferLen)
+{
+	if( !ini.getValue(section, key, buffer, bufferLen) )
+		return false;
+
+	return (strcmp_P(buffer, PSTR("Yes")) == 0) || (strcmp_P(buffer, PSTR("yes")) == 0) || (strcmp_P(buffer, PSTR("YES")) == 0);
+}
+
+void ResetEEPROM_PerKey(void)
+{
+	settingsCache.invalidate();
+
+	bool  retcode = true;
+
+	const size_t bufferLen = 128;
+	char buffer[bufferLen];			// Temp buffer for ini file processing. Must be big enough to hold one line
+	char		tmpb[MAX_SENSOR_NAME_LENGTH];	// worker buffer, sized for sensor names (19 chars, as the single pass import)
+
+	strcpy_P(buffer, PSTR(EEPROM_INI_FILE));	// to avoid wasting space use common buffer for the file name init
+	IniFile ini(buffer);
+
+	if( !ini.open() )
+	{
+		SYSEVT_ERROR(F("LoadIniEEPROM - error opening device ini file"));
+
+		retcode = false;
+	}
+
+// OK, we successfully opened device ini file. Read config and populate EEPROM.
+	TRACE_INFO(F("Loading EEPROM from device ini file.\n"));
+
+// First we need to write signature and zero out various configs (that are not loaded from ini file)
+
+		const char * const sHeader = EEPROM_SHEADER;
+
+        for (int i = 0; i <= 3; i++)			// write current signature
+                EEPROM.write(i, sHeader[i]);
+        
+		SetNumSchedules(0);
+		SetEvtMasterFlags(0);
+		SetEvtMasterStationID(0);
+
+// Validate ini file to ensure we can successfully read it (check max string length)
+
+		if( !ini.validate(buffer, bufferLen) )
+		{
+			SYSEVT_ERROR(F("LoadIniEEPROM - ini file failed validation"));
+
+			retcode = false;
+		}
+
+// And this is the actual device config load from ini file
+
+		IPAddress ip;
+
+		if( ini.getIPAddress_P(PSTR("Network"), PSTR("IP"), buffer, bufferLen, ip) )
+			SetIP(ip);
+		else 
+		{
+			SetIP(IPAddress(10, 0, 1, 36));		// default IP address
+			retcode = false;
+		}
+  
+		if( ini.getIPAddress_P(PSTR("Network"), PSTR("Subnet"), buffer, bufferLen, ip) )
+			SetNetmask(ip);
+		else
+		{
+			SetNetmask(IPAddress(255, 255, 255, 0));	// default Subnet
+			retcode = false;
+		}
+		
+		if( ini.getIPAddress_P(PSTR("Network"), PSTR("Gateway"), buffer, bufferLen, ip) )
+			SetGateway(ip);
+		else
+		{
+			SetGateway(IPAddress(10, 0, 1, 1));		// default gateway
+			retcode = false;
+		}
+
+		uint16_t	u16;
+		if( ini.getValue_P(PSTR("Network"), PSTR("WebPort"), buffer, bufferLen, u16) )
+			SetWebPort(u16);
+		else
+		{
+			SetWebPort(80);			// default HTTP port
+			retcode = false;
+		}
+
+		if( ini.getIPAddress_P(PSTR("Network"), PSTR("NTPServer"), buffer, bufferLen, ip) )
+			SetNTPIP(ip);
+		else
+		{
+			SetNTPIP(IPAddress(204,9,54,119));	// default NTP server
+			retcode = false;
+		}
+
+		SetWUIP(INADDR_NONE);		// we don't pre-populate Weather Underground IP address
+		SetApiKey("");				// we don't pre-populate API key for WU
+        SetPWS("");
+        SetUsePWS(false);
+
+		int		i16;
+		SetNTPOffset(-8);			// NTPOffset was never applied from the ini file
+
+		if( ini.getValue_P(PSTR("System"), PSTR("Zip"), buffer, bufferLen, u16) )
+			SetZip(u16);
+		else
+		{
+			SetZip(0);
+			retcode = false;
+		}
+
+		if( ini.getValue_P(PSTR("System"), PSTR("SeasonalAdj"), buffer, bufferLen, i16) )
+			SetSeasonalAdjust(i16);
+		else
+		{
+			SetSeasonalAdjust(100);
+			retcode = false;
+		}
+
+		SetRunSchedules(false);		// no schedules
+
+		SetOT(OT_NONE);	
+
+// Local channels
+
+		uint16_t	parChannels = 0;
+		if( !ini.getValue_P(PSTR("LocalChannels"), PSTR("NumParallel"), buffer, bufferLen, parChannels) )
+		{
+			parChannels = 0;
+		}
+		TRACE_INFO(F("LoadIniEEPROM - %d parallel channels\n"), parChannels );
+		SetNumIOChannels(parChannels);
+
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+		if( parChannels > LOCAL_NUM_DIRECT_CHANNELS ) 
+		{
+			SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to %d"), parChannels, LOCAL_NUM_DIRECT_CHANNELS );
+			parChannels = LOCAL_NUM_DIRECT_CHANNELS;	// basic protection to constrain the maximum number of parallel channels
+		}
+#else
+		if( parChannels > 0 )
+		{
+			SYSEVT_ERROR(F("LoadIniEEPROM - specified number of Parallel channels %d too high, truncating it to 0"), parChannels );
+			parChannels = 0;	// basic protection to constrain the maximum number of parallel channels
+		}
+#endif
+
+		if( parChannels != 0 ){
+#ifdef LOCAL_NUM_DIRECT_CHANNELS
+
+			uint16_t	ioPin;
+			uint8_t		zoneToIOMap[LOCAL_NUM_DIRECT_CHANNELS] = PARALLEL_PIN_OUT_MAP;
+
+			for( uint16_t i=0; i<parChannels; i++ )
+			{
+				sprintf_P(tmpb, PSTR("Chan%u"), i+1);	// In ini file channels are numbered from 1
+				if( ini.getValue("ParallelIOMap", tmpb, buffer, bufferLen, ioPin) )
+					zoneToIOMap[i] = ioPin;
+			}
+
+			SaveZoneIOMap( zoneToIOMap );
+
+			if( ini.getValue_P(PSTR("LocalChannels"), PSTR("ParallelPolarity"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+			{
+				if( strcmp_P(tmpb, PSTR("Negative")) == 0 )
+					SetOT(OT_DIRECT_NEG);		
+				else if( strcmp_P(tmpb, PSTR("Positive")) == 0 )
+					SetOT(OT_DIRECT_POS);		
+			}
+			else
+			{
+				SetOT(OT_DIRECT_POS);		
+			}
+#else //LOCAL_NUM_DIRECT_CHANNELS
+			SYSEVT_ERROR(F("LoadIniEEPROM - LOCAL_NUM_DIRECT_CHANNELS is not defined but device.ini specifies non-zero number of Parallel channels."));
+			parChannels = 0;	// basic protection to constrain the maximum number of parallel channels
+#endif //LOCAL_NUM_DIRECT_CHANNELS
+		}
+		
+		uint16_t	serChannels = 0;
+		if( ini.getValue_P(PSTR("LocalChannels"), PSTR("NumSerial"), buffer, bufferLen, serChannels) )
+			SetNumOSChannels(serChannels);
+		else
+		{
+			SetNumOSChannels(0);
+		}
+
+		if( serChannels != 0 ){
+
+			SrIOMapStruct  srIoMap; 
+
+			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrClkPin"), buffer, bufferLen, u16) )
+				srIoMap.SrClkPin = u16;
+			else
+				srIoMap.SrClkPin = 30;
+
+			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrNoePin"), buffer, bufferLen, u16) )
+				srIoMap.SrNoePin = u16;
+			else
+				srIoMap.SrNoePin = 29;
+
+			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrDatPin"), buffer, bufferLen, u16) )
+				srIoMap.SrDatPin = u16;
+			else
+				srIoMap.SrDatPin = 28;
+
+			if( ini.getValue_P(PSTR("SerialIOMap"), PSTR("SrLatPin"), buffer, bufferLen, u16) )
+				srIoMap.SrLatPin = u16;
+			else
+				srIoMap.SrLatPin = 27;
+
+			SaveSrIOMap(&srIoMap);
+		}
+
+// Load Stations info
+
+// First let's zero out stations block
+
+		FullStation  fullStation;
+		memset(&fullStation,0,sizeof(fullStation));
+
+		for( uint8_t u=0; u<MAX_STATIONS; u++ )
+				SaveStation(u, &fullStation);
+
+
+		uint16_t	numStations = 0;
+		if( ini.getValue_P(PSTR("Stations"), PSTR("NumStations"), buffer, bufferLen, numStations) )
+		{
+			if( numStations >= MAX_STATIONS )
+			{
+				SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Stations %d. Number should be <16"), numStations);
+				numStations = 0;
+			}
+		}
+		else
+		{
+			numStations = 0;
+		}
+
+		uint8_t	myStationID;
+		u16 = DEFAULT_STATION_ID;
+		if( ini.getValue_P(PSTR("Stations"), PSTR("MyStationID"), buffer, bufferLen, u16) )
+		{
+			if( u16 >= MAX_STATIONS )
+			{
+				SYSEVT_ERROR(F("LoadIniEEPROM - invalid MyStationID %d. Number should be <16"), u16);
+				u16 = DEFAULT_STATION_ID;
+			}
+		}
+//		SYSEVT_ERROR(F("MyStationID=%d\n"), u16);
+		myStationID = u16;
+		SetMyStationID(myStationID);
+
+		TRACE_INFO(F("LoadIniEEPROM - numStations=%d"), numStations);
+		if( numStations != 0 )	// We have at least one Station defined in the ini file
+		{
+
+			char			keyName[16];
+			char			sectionName[16];
+			uint16_t		stationID;
+			uint16_t		netID;
+			uint16_t		numChannels = 0;
+			uint16_t		netAddr;
+			uint8_t			fEnableRAccess = false;
+
+			for( uint16_t i=0; i<numStations; i++ )
+			{
+
+				sprintf_P(sectionName, PSTR("Station%u"), i+1);	// In ini file channels are numbered from 1
+				strcpy_P(keyName, PSTR("StationID"));
+				TRACE_INFO(F("Reading station %s\n"), sectionName);
+				freeMemory();
+
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, stationID) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get StationID for station %d"), i);
+					goto skip_Station;
+				}
+
+				if( stationID >= MAX_STATIONS )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - invalid StationID %d. Number should be <16"), stationID);
+					goto skip_Station;
+				}
+
+				strcpy_P(keyName, PSTR("NumChannels"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, numChannels) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NumChannels for Station %d"), i);
+					goto skip_Station;
+				}
+				if( numChannels > 8 )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - NumChannels too high for Station %d, truncating to 8"), i);
+					numChannels = 8;
+				}
+
+				strcpy_P(keyName, PSTR("NetworkID"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkID for Station %d, error code: %d"), i, ini.getError());
+					goto skip_Station;
+				}
+				if( strcmp_P(tmpb, PSTR("Parallel")) == 0 )
+					netID = NETWORK_ID_LOCAL_PARALLEL;
+				else if( strcmp_P(tmpb, PSTR("Serial")) == 0 )
+					netID = NETWORK_ID_LOCAL_SERIAL;
+				else if( strcmp_P(tmpb, PSTR("XBee")) == 0 )
+					netID = NETWORK_ID_XBEE;
+				else if( strcmp_P(tmpb, PSTR("RFM69")) == 0 )
+					netID = NETWORK_ID_MOTEINORF;
+				else if( strcmp_P(tmpb, PSTR("UDP")) == 0 )
+					netID = NETWORK_ID_UDP;
+				else if( strcmp_P(tmpb, PSTR("Loopback")) == 0 )
+					netID = NETWORK_ID_LOOPBACK;
+				else
+				{
+					SYSEVT_ERROR(F("NetworkID not recognized for station %d, skipping the station"), i+1);
+					goto skip_Station;
+				}
+				TRACE_INFO(F("Got NetworkID of %s (code %d) for Station %d\n"), tmpb, netID, i+1);
+
+				strcpy_P(keyName, PSTR("NetworkAddress"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, netAddr) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read NetworkAddress for Station %d"), i);
+					goto skip_Station;
+				}
+
+				fEnableRAccess = false;
+				strcpy_P(keyName, PSTR("RAccess"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - no RAccess statement, assuming no remote access for Station %d"), i);
+				}
+				else
+				{
+					if( (strcmp_P(tmpb, PSTR("Yes")) == 0) || (strcmp_P(tmpb, PSTR("yes")) == 0) || (strcmp_P(tmpb, PSTR("YES")) == 0))
+						fEnableRAccess = true;
+				}
+
+				memset(&fullStation,0,sizeof(fullStation));
+				if( fEnableRAccess )	// allow remote access (via RF) to this station
+					fullStation.stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED | STATION_FLAGS_RSTATUS | STATION_FLAGS_RCONTROL;
+				else
+					fullStation.stationFlags = STATION_FLAGS_VALID | STATION_FLAGS_ENABLED;
+
+				fullStation.networkID = netID;
+				fullStation.networkAddress = netAddr;
+				fullStation.numZoneChannels = numChannels;
+
+				sprintf_P(fullStation.name, PSTR("Station %d"), stationID);
+
+				SaveStation(stationID, &fullStation);	// save the station
+
+				SYSEVT_ERROR(F("LoadIniEEPROM - Saving station %d, NumChannels %d, netID %d, netAddr %d"), (int)stationID, (int)numChannels, (int)netID, (int)netAddr);
+skip_Station:;
+			}
+		}
+
+		if( ini.getValue_P(PSTR("LocalChannels"), PSTR("ParallelPolarity"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+		{
+			if( strcmp_P(tmpb, PSTR("Negative")) == 0 )
+				SetOT(OT_DIRECT_NEG);		
+			else if( strcmp_P(tmpb, PSTR("Positive")) == 0 )
+				SetOT(OT_DIRECT_POS);		
+		}
+
+		// Sensors definitions
+		uint16_t	numSensors = 0;
+		SetNumSensors(0);	// initial default
+
+		if( ini.getValue_P(PSTR("Sensors"), PSTR("NumSensors"), buffer, bufferLen, numSensors) )
+		{
+			if( numSensors >= MAX_SENSORS )
+			{
+				SYSEVT_ERROR(F("LoadIniEEPROM - invalid number of Sensors %d. Number should be <%d."), numSensors, (int)MAX_SENSORS);
+				numSensors = 0;
+			}
+		}
+
+		TRACE_INFO(F("numSensors=%d\n"), numSensors);
+
+		if( numSensors != 0 )	// We have at least one Sensor defined in the ini file
+		{
+
+			char			keyName[16];
+			char			sectionName[16];
+			uint8_t			sensType;
+			uint8_t			sensID = 0;
+			uint16_t			sensStation;
+			uint16_t			sensChannel;
+
+			for( uint16_t i=1; i<=numSensors; i++ )
+			{
+
+				sprintf_P(sectionName, PSTR("Sensor%d"), i);	
+				strcpy_P(keyName, PSTR("Type"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Type for Sensor%d"), i);
+					goto skip_Sensor;
+				}
+				TRACE_INFO(F("Reading Sensor%d, type=%s\n"), i, tmpb);
+
+				if( strcmp_P(tmpb, PSTR("Temperature")) == 0 )
+					sensType = SENSOR_TYPE_TEMPERATURE;
+				else if( strcmp_P(tmpb, PSTR("Pressure")) == 0 )
+					sensType = SENSOR_TYPE_PRESSURE;
+				else if( strcmp_P(tmpb, PSTR("Humidity")) == 0 )
+					sensType = SENSOR_TYPE_HUMIDITY;
+				else if( strcmp_P(tmpb, PSTR("Waterflow")) == 0 )
+					sensType = SENSOR_TYPE_WATERFLOW;
+				else if( strcmp_P(tmpb, PSTR("Voltage")) == 0 )
+					sensType = SENSOR_TYPE_VOLTAGE;
+				else if( strcmp_P(tmpb, PSTR("Flowrate")) == 0 )
+					sensType = SENSOR_TYPE_FLOWRATE;
+				else
+				{
+					SYSEVT_ERROR(F("Sensor%d type not recognized - skipping it"), i);
+					goto skip_Sensor;
+				}
+
+				strcpy_P(keyName, PSTR("Station"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, sensStation) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Station for Sensor %d"), i);
+					goto skip_Sensor;
+				}
+				if( sensStation > MAX_STATIONS )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - Sensor Station too high for Sensor%d"), i);
+					goto skip_Sensor;
+				}
+
+				strcpy_P(keyName, PSTR("Channel"));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, sensChannel) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - cannot read Channel for Sensor%d"), i);
+					goto skip_Sensor;
+				}
+				if( sensChannel > 254 )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - Channel is too high for Sensor%d"), i);
+					goto skip_Sensor;
+				}
+
+				strcpy_P(keyName, PSTR("Name"));
+				memset(tmpb, 0, sizeof(tmpb));
+				if( !ini.getValue(sectionName, keyName, buffer, bufferLen, tmpb, sizeof(tmpb)) )
+				{
+					SYSEVT_ERROR(F("LoadIniEEPROM - Cannot get Name for Sensor%d"), i);
+					sprintf_P(tmpb, PSTR("Sensor %u:%u"), sensStation, sensChannel);	// if no name provided - generate default
+				}
+
+				{
+					FullSensor  fullSens;
+
+					memset(&fullSens, 0, sizeof(fullSens));
+					fullSens.sensorType = sensType;
+					fullSens.sensorChannel = sensChannel;
+					fullSens.sensorStationID = sensStation;
+					fullSens.flags = 0;	
+					memcpy(fullSens.name, tmpb, 20);	// sensor name is limited to 20 ASCII chars, and we just copy the block. If the actual name is shorter, it will have null in it.
+
+					strcpy_P(keyName, PSTR("Curve"));
+					if( ini.getValue(sectionName, keyName, buffer, bufferLen) && (uint16_t(atol(buffer)) < ANALOG_NUM_CURVES) )
+						fullSens.flags |= SENSOR_FLAGS_CURVE(uint16_t(atol(buffer)));
+
+					SaveSensor(sensID, &fullSens);	// save the sensor
+
+					SYSEVT_ERROR(F("LoadIniEEPROM - Saving sensor %d"), (int)sensID);
+
+					sensID++;
+				}
+skip_Sensor:;
+			}
+			SetNumSensors(sensID);
+			TRACE_INFO(F("LoadIniEEPROM - saved %d sensors"), sensID);
+		}
+
+// Now let's iterate through Stations and fill in Zones list
+
+		FullZone zone = {0};
+		uint8_t	 zoneIndex = 0;
+
+		for( int st=0; st<MAX_STATIONS; st++ )
+		{
+			LoadStation(st,&fullStation);
+
+			if( (fullStation.stationFlags & STATION_FLAGS_VALID) && (fullStation.stationFlags & STATION_FLAGS_ENABLED) )
+			{
+				for( uint8_t j=0; j<fullStation.numZoneChannels; j++ )
+				{
+						if( j == 0 ){
+
+							fullStation.startZone = zoneIndex;			// save starting zone# back reference
+							SaveStation(st, &fullStation);		// in Station entity
+						}
+
+						zone.bEnabled = 1;
+						zone.waterFlowRate = ZONE_DEFAULT_FLOWRATE;
+						zone.stationID = st;
+						zone.channel = j;
+						sprintf_P(zone.name, PSTR("Zone %d, Loc %X:%d"), uint16_t(zoneIndex+1), uint16_t(zone.stationID), uint16_t(zone.channel+1));
+						
+						TRACE_VERBOSE(F("Created zone %d, \"%s\"\n"), (uint8_t)(zoneIndex + 1), zone.name);
+						
+						SaveZone(zoneIndex, &zone);
+						zoneIndex++;
+				}
+			}
+		}
+
+		SetNumZones(zoneIndex);
+		TRACE_INFO(F("LoadIniEEPROM - Generated %d Zones\n"), zoneIndex);
+
+// Load XBee config
+
+		SetXBeeFlags(0);	// XBee disabled by default
+		if( ini.getValue_P(PSTR("XBee"), PSTR("Enabled"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+		{
+			if( !strcmp_P(tmpb, PSTR("Yes")) || !strcmp_P(tmpb, PSTR("yes")) ){
+// XBee enabled
+				SetXBeeFlags(NETWORK_FLAGS_ENABLED | (iniYes(ini, "XBee", "Relay", buffer, bufferLen) ? NETWORK_FLAGS_RELAY:0));
+					
+				if( ini.getValue_P(PSTR("XBee"), PSTR("Port"), buffer, bufferLen, u16 ) )
+					SetXBeePort(u16);
+				else
+					SetXBeePort(NETWORK_XBEE_DEFAULT_PORT);
+
+				if( ini.getValue_P(PSTR("XBee"), PSTR("Speed"), buffer, bufferLen, u16 ) )
+					SetXBeePortSpeed(u16);
+				else
+					SetXBeePortSpeed(NETWORK_XBEE_DEFAULT_SPEED);
+
+				if( ini.getValue_P(PSTR("XBee"), PSTR("PANID"), buffer, bufferLen, u16 ) )
+					SetXBeePANID(u16);
+				else
+					SetXBeePANID(NETWORK_XBEE_DEFAULT_PANID);
+
+				if( ini.getValue_P(PSTR("XBee"), PSTR("Channel"), buffer, bufferLen, u16 ) )
+					SetXBeeChan(u16);
+				else
+					SetXBeeChan(NETWORK_XBEE_DEFAULT_CHAN);
+			}
+		}
+
+// Load MoteinoRF config
+
+		SetMoteinoRFFlags(0);	// MoteinoRF disabled by default
+		if( ini.getValue_P(PSTR("RFM69"), PSTR("Enabled"), buffer, bufferLen, tmpb, sizeof(tmpb)-1) )
+		{
+			if( !strcmp_P(tmpb, PSTR("Yes")) || !strcmp_P(tmpb, PSTR("yes")) ){
+// XBee enabled
+				SetMoteinoRFFlags(NETWORK_FLAGS_ENABLED | (iniYes(ini, "RFM69", "Relay", buffer, bufferLen) ? NETWORK_FLAGS_RELAY:0));
+					
+				if( ini.getValue_P(PSTR("RFM69"), PSTR("PANID"), buffer, bufferLen, u16 ) )
+					SetMoteinoRFPANID(u16);
+				else
+					SetMoteinoRFPANID(NETWORK_MOTEINORF_DEFAULT_PANID);
+
+				SetMoteinoRFAddr(GetMyStationID());		// for MoteinoRF NodeID == StationID
+			}
+		}
+
+
+// Reset running water counters and runtime state
+
+		eeJournal.Format();
+
+
+}
@@ -0,0 +1,242 @@
+/*
+        device.ini import test on the Linux host.
+
+Imports each ini file twice - with the per-key reference import (ini_import_ref.cpp, the import as it was before the single
+pass import) and with ResetEEPROM() of settings.cpp - and compares the EEPROM images the two leave behind.
+
+    ini_import_test [-v] <file.ini>...
+
+The file is copied to device.ini in the current directory (SD root of the host build). Both imports start from the same
+EEPROM contents, once with erased EEPROM (0xFF) and once with EEPROM filled with a pseudo-random pattern, so bytes the import
+should not leave behind (e.g. staged data in unused records) show up as differences. ReloadConfig() of the same file is then
+expected to find nothing to change.
+
+Exit status is 0 if all images match.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "settings.h"
+#include "SettingsCache.h"
+#include "core.h"
+#include "sensors.h"
+#include "sdlog.h"
+#include "LocalBoard.h"
+#include "localUI.h"
+#include "nntp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void ResetEEPROM_PerKey(void);			// ini_import_ref.cpp
+
+#define TEST_MAX_DIFFS			16		// differing ranges reported per import
+
+static bool		testTrace = false;
+
+//
+// Station environment of settings.cpp
+//
+
+LocalBoardParallel	lBoardParallel;
+LocalBoardSerial	lBoardSerial;
+OSLocalUI			localUI;
+runStateClass		runState;
+Sensors				sensorsModule;
+nntp				nntpTimeServer;
+
+LocalBoardParallel::LocalBoardParallel()	{}
+bool LocalBoardParallel::begin(void)		{ return true; }
+LocalBoardSerial::LocalBoardSerial()		{}
+bool LocalBoardSerial::begin(void)			{ return true; }
+
+void OSLocalUI::lcd_print_line_clear_pgm(const prog_char *str, byte line)
+{
+}
+
+runStateClass::runStateClass()						{}
+void runStateClass::StopSchedule(void)				{}
+void runStateClass::ProcessScheduledEvents(void)	{}
+void runStateClass::TurnOffZones(void)				{}
+
+void Sensors::ReloadConfig(void)			{}
+
+nntp::nntp(void)							{}
+nntp::~nntp(void)							{}
+void nntp::flagCheckTime(void)				{}
+
+void ReloadEvents(bool bAllEvents)			{}
+uint8_t GetZoneState(uint8_t iNum)			{ return ZONE_STATE_OFF; }
+void freeMemory()							{}
+void sysreset()								{}		// import is done, the test takes the EEPROM image instead
+void delay(unsigned long ms)				{}
+
+time_t now()								{ return 0; }
+int day(time_t t)							{ return 1; }
+int month(time_t t)							{ return 1; }
+int year(time_t t)							{ return 2016; }
+int weekday(time_t t)						{ return 1; }
+
+static void testLog(const char *fmt, va_list args)
+{
+	if( !testTrace )
+		return;
+
+	vfprintf(stderr, fmt, args);
+	if( fmt[0] && (fmt[strlen(fmt)-1] != '\n') )
+		fputc('\n', stderr);
+}
+
+void syslog_evt(uint8_t event_type, const char *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	testLog(fmt, args);
+	va_end(args);
+}
+
+void syslog_evt(uint8_t event_type, const __FlashStringHelper *fmt, ...)
+{
+	va_list		args;
+
+	va_start(args, fmt);
+	testLog((const char *)fmt, args);
+	va_end(args);
+}
+
+//
+// Test
+//
+
+static bool CopyFile(const char *from, const char *to)
+{
+	FILE	*in = fopen(from, "r");
+	FILE	*out = in ? fopen(to, "w") : NULL;
+	char	buf[512];
+	size_t	n;
+
+	if( out == NULL )
+	{
+		if( in != NULL )
+			fclose(in);
+		return false;
+	}
+
+	while( (n = fread(buf, 1, sizeof(buf), in)) > 0 )
+		fwrite(buf, 1, n, out);
+
+	fclose(in);
+	fclose(out);
+	return true;
+}
+
+static void FillEEPROM(bool fRandom, uint8_t *pImage)
+{
+	uint32_t	x = 12345;
+
+	for( int i=0; i<HOST_EEPROM_SIZE; i++ )
+	{
+		x = x*1103515245ul + 12345ul;
+		hostEEPROM[i] = fRandom ? uint8_t(x >> 16) : 0xFF;
+	}
+	memcpy(pImage, hostEEPROM, HOST_EEPROM_SIZE);
+}
+
+// Returns number of differing bytes, reports the first TEST_MAX_DIFFS differing ranges
+static int CompareImages(const uint8_t *pRef, const uint8_t *pNew)
+{
+	int		numDiff = 0;
+	int		numRanges = 0;
+
+	for( int i=0; i<HOST_EEPROM_SIZE; )
+	{
+		if( pRef[i] == pNew[i] )
+		{
+			i++;
+			continue;
+		}
+
+		int		start = i;
+
+		while( (i < HOST_EEPROM_SIZE) && (pRef[i] != pNew[i]) )
+			i++;
+		numDiff += i - start;
+
+		if( ++numRanges <= TEST_MAX_DIFFS )
+		{
+			printf("  offset %4d, %3d bytes:", start, i - start);
+			for( int j=start; (j<i) && (j<start+8); j++ )
+				printf(" %02X/%02X", pRef[j], pNew[j]);
+			printf("%s\n", (i - start > 8) ? " ..." : "");
+		}
+	}
+	return numDiff;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t	initial[HOST_EEPROM_SIZE], ref[HOST_EEPROM_SIZE];
+	int				numFailed = 0;
+
+	if( (argc > 1) && (strcmp(argv[1], "-v") == 0) )
+	{
+		testTrace = true;
+		argc--;
+		argv++;
+	}
+
+	if( argc < 2 )
+	{
+		fprintf(stderr, "Usage: ini_import_test [-v] <file.ini>...\n");
+		return 2;
+	}
+
+	for( int f=1; f<argc; f++ )
+	{
+		if( !CopyFile(argv[f], EEPROM_INI_FILE + 1) )
+		{
+			perror(argv[f]);
+			return 1;
+		}
+
+		for( uint8_t r=0; r<2; r++ )			// erased EEPROM, then pseudo-random contents
+		{
+			FillEEPROM(r != 0, initial);
+			ResetEEPROM_PerKey();
+			memcpy(ref, hostEEPROM, HOST_EEPROM_SIZE);
+
+			memcpy(hostEEPROM, initial, HOST_EEPROM_SIZE);
+			ResetEEPROM();
+
+			int		numDiff = CompareImages(ref, hostEEPROM);
+
+			printf("%s, %s EEPROM: %s", argv[f], r ? "random" : "erased", numDiff ? "FAILED" : "images match");
+			if( numDiff )
+				printf(", %d bytes differ", numDiff);
+			printf("\n");
+
+			if( numDiff )
+				numFailed++;
+
+			settingsCache.begin();				// station reboots after ResetEEPROM()
+
+			uint8_t		changes = ReloadConfig();
+
+			numDiff = CompareImages(ref, hostEEPROM);
+			if( changes || numDiff )
+			{
+				printf("%s, %s EEPROM: ReloadConfig FAILED, changes 0x%02X, %d bytes differ\n", argv[f], r ? "random" : "erased", changes, numDiff);
+				numFailed++;
+			}
+		}
+	}
+
+	unlink(EEPROM_INI_FILE + 1);
+	return numFailed ? 1 : 0;
+}
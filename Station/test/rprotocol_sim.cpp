@@ -0,0 +1,280 @@
+/*
+        RProtocol load test on the Linux host.
+
+Built twice - as rprotocol_master (SG_HARDWARE == HW_HOST_MASTER) and as rprotocol_remote (SG_HARDWARE == HW_HOST_REMOTE).
+
+    rprotocol_master [-v] loopback <numStations> <numRequests>
+Master polls sensors of numStations simulated stations through LoopbackTransport, in one process. Loopback peer plays the
+stations and replies on the next pass of the main loop.
+
+    rprotocol_master [-v] udp <numStations> <numRequests>
+Master starts numStations rprotocol_remote processes and polls their sensors over UdpTransport.
+
+    rprotocol_remote [-v] <stationID> <numStations>
+Remote station, normally started by the master. Runs until killed or until the master exits.
+
+Master keeps up to RPROTOCOL_MAX_PENDING requests in flight (one per station), and reports throughput and request latency.
+Exit status is 0 if all requests completed OK.
+
+
+Creative Commons Attribution-ShareAlike 3.0 license
+Copyright 2016 tony-osp (http://tony-osp.dreamwidth.org/)
+
+*/
+
+#include "host_station.h"
+#include "RProtocolMS.h"
+#include "UdpTransport.h"
+#include "LoopbackTransport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_IDLE_SLEEP		200			// us, main loop sleep
+#define SIM_START_DELAY		300			// ms, time for remote processes to open their ports
+#define SIM_TIME_LIMIT		120			// seconds
+
+static UdpTransport			udp;
+
+#if SG_HARDWARE == HW_HOST_MASTER
+
+static LoopbackTransport	loopback;
+
+static uint8_t		simNumStations;
+static uint32_t		simNumOK = 0;
+static uint32_t		simNumFailed = 0;
+static uint32_t		simInFlight = 0;
+static uint64_t		simLatencySum = 0;		// us
+static uint32_t		simLatencyMax = 0;		// us
+static bool			simPending[MAX_STATIONS];
+static uint32_t		simSentTime[MAX_STATIONS];	// micros()
+
+// Requests received by the simulated stations, answered on the next loop pass
+static uint8_t		simRequestFrom[MAX_STATIONS];
+static uint8_t		simRequestTID[MAX_STATIONS];
+static uint8_t		simNumRequests = 0;
+
+static void SimPollDone(uint8_t stationID, uint8_t fCode, uint8_t status, uint8_t param)
+{
+	if( (stationID >= MAX_STATIONS) || !simPending[stationID] )
+		return;
+
+	uint32_t	t = micros() - simSentTime[stationID];
+
+	simPending[stationID] = false;
+	simInFlight--;
+	if( status == RTRANSACTION_OK )
+	{
+		simNumOK++;
+		simLatencySum += t;
+		if( t > simLatencyMax )
+			simLatencyMax = t;
+	}
+	else
+	{
+		simNumFailed++;
+		fprintf(stderr, "Station %u: request failed, status %u\n", stationID, status);
+	}
+}
+
+//
+// Loopback peer - frames sent by the master to the simulated stations. Sensors requests are answered from SimReplies(),
+// frames to the master itself (replies of the simulated stations) are delivered back to it.
+//
+static void SimPeer(uint8_t nStation, const uint8_t *msg, uint8_t mSize)
+{
+	RMESSAGE_HEADER		*pHeader = (RMESSAGE_HEADER *)msg;
+
+	if( nStation == GetMyStationID() )
+	{
+		loopback.Inject(msg, mSize);
+		return;
+	}
+
+	if( (nStation >= MAX_STATIONS) || (mSize < sizeof(RMESSAGE_HEADER)) || (pHeader->FCode != FCODE_SENSORS_READ) )
+		return;			// scans, time broadcasts - simulated stations do not reply
+
+	if( simNumRequests < MAX_STATIONS )
+	{
+		simRequestFrom[simNumRequests] = nStation;
+		simRequestTID[simNumRequests] = pHeader->TransactionID;
+		simNumRequests++;
+	}
+}
+
+static void SimReplies(void)
+{
+	for( uint8_t i=0; i<simNumRequests; i++ )
+		rprotocol.SendSensorsReport(simRequestTID[i], simRequestFrom[i], GetMyStationID(), 0, HOST_NUM_SENSORS);
+
+	simNumRequests = 0;
+}
+
+static pid_t StartRemote(const char *path, uint8_t stationID, bool fTrace)
+{
+	char	id[8], num[8];
+	pid_t	pid = fork();
+
+	if( pid != 0 )
+		return pid;
+
+	snprintf(id, sizeof(id), "%u", stationID);
+	snprintf(num, sizeof(num), "%u", simNumStations);
+	if( fTrace )
+		execl(path, path, "-v", id, num, (char *)0);
+	else
+		execl(path, path, id, num, (char *)0);
+
+	perror(path);
+	_exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	bool		fTrace = false;
+	bool		fUdp;
+	uint32_t	numRequests;
+	uint32_t	numSent = 0;
+	pid_t		remotes[MAX_STATIONS];
+	char		remotePath[256];
+
+	if( (argc > 1) && (strcmp(argv[1], "-v") == 0) )
+	{
+		fTrace = true;
+		argc--;
+		argv++;
+	}
+
+	if( (argc != 4) || ((strcmp(argv[1], "udp") != 0) && (strcmp(argv[1], "loopback") != 0)) ||
+		(atoi(argv[2]) < 1) || (atoi(argv[2]) >= MAX_STATIONS) || (atol(argv[3]) < 1) )
+	{
+		fprintf(stderr, "Usage: rprotocol_master [-v] udp|loopback <numStations, 1..%u> <numRequests>\n", MAX_STATIONS-1);
+		return 2;
+	}
+	fUdp = (strcmp(argv[1], "udp") == 0);
+	simNumStations = atoi(argv[2]);
+	numRequests = atol(argv[3]);
+
+	HostStationSetup(0, simNumStations, fUdp ? NETWORK_ID_UDP : NETWORK_ID_LOOPBACK, fTrace);
+	memset(simPending, 0, sizeof(simPending));
+
+	if( fUdp )
+	{
+		const char	*pSlash = strrchr(argv[0], '/');
+
+		snprintf(remotePath, sizeof(remotePath), "%.*srprotocol_remote", pSlash ? int(pSlash - argv[0] + 1) : 0, argv[0]);
+		if( !udp.begin(0) )
+		{
+			fprintf(stderr, "Cannot open UDP port %u\n", UDP_TRANSPORT_BASE_PORT);
+			return 1;
+		}
+		for( uint8_t i=1; i<=simNumStations; i++ )
+			remotes[i] = StartRemote(remotePath, i, fTrace);
+		delay(SIM_START_DELAY);
+	}
+	else
+	{
+		loopback.SetPeer(SimPeer);
+		loopback.begin();
+	}
+	rprotocol.begin();
+
+	uint32_t	startTime = millis();
+	uint8_t		next = 1;
+
+	while( (simNumOK + simNumFailed) < numRequests )
+	{
+		while( (numSent < numRequests) && (simInFlight < RPROTOCOL_MAX_PENDING) )
+		{
+			for( uint8_t i=0; (i<simNumStations) && simPending[next]; i++ )
+				next = (next % simNumStations) + 1;
+			if( simPending[next] )
+				break;
+
+			simPending[next] = true;
+			simSentTime[next] = micros();
+			simInFlight++;
+			numSent++;
+			rprotocol.PollStationSensors(next, SimPollDone);
+			next = (next % simNumStations) + 1;
+		}
+
+		rprotocol.loop();
+		if( fUdp )
+			usleep(SIM_IDLE_SLEEP);
+		else
+			SimReplies();
+
+		if( (millis() - startTime) > SIM_TIME_LIMIT*1000ul )
+		{
+			fprintf(stderr, "Time limit exceeded\n");
+			break;
+		}
+	}
+
+	uint32_t	elapsed = millis() - startTime;
+
+	if( fUdp )
+	{
+		for( uint8_t i=1; i<=simNumStations; i++ )
+		{
+			kill(remotes[i], SIGTERM);
+			waitpid(remotes[i], 0, 0);
+		}
+	}
+
+	printf("%s: %u stations, %lu requests - %lu OK, %lu failed, %lu sensor readings received\n", fUdp ? "UDP" : "Loopback",
+			simNumStations, (unsigned long)numRequests, (unsigned long)simNumOK, (unsigned long)simNumFailed, (unsigned long)hostSensorReports);
+	printf("%.0f requests/s, latency avg %.2f ms, max %.2f ms\n", (simNumOK + simNumFailed)*1000.0/(elapsed ? elapsed : 1),
+			simNumOK ? simLatencySum/1000.0/simNumOK : 0.0, simLatencyMax/1000.0);
+	if( fUdp )
+		printf("%lu frames sent, %lu received, %lu send errors\n", (unsigned long)udp.txFrames, (unsigned long)udp.rxFrames, (unsigned long)udp.txErrors);
+	else
+		printf("%lu frames sent, %lu received, %lu dropped\n", (unsigned long)loopback.txFrames, (unsigned long)loopback.rxFrames, (unsigned long)loopback.droppedFrames);
+
+	return ((simNumOK == numRequests) && (simNumFailed == 0)) ? 0 : 1;
+}
+
+#else //HW_HOST_MASTER
+
+int main(int argc, char *argv[])
+{
+	bool		fTrace = false;
+	pid_t		master = getppid();
+
+	if( (argc > 1) && (strcmp(argv[1], "-v") == 0) )
+	{
+		fTrace = true;
+		argc--;
+		argv++;
+	}
+
+	if( (argc != 3) || (atoi(argv[1]) < 1) || (atoi(argv[1]) >= MAX_STATIONS) )
+	{
+		fprintf(stderr, "Usage: rprotocol_remote [-v] <stationID, 1..%u> <numStations>\n", MAX_STATIONS-1);
+		return 2;
+	}
+
+	uint8_t		stationID = atoi(argv[1]);
+
+	HostStationSetup(stationID, atoi(argv[2]), NETWORK_ID_UDP, fTrace);
+	if( !udp.begin(stationID) )
+	{
+		fprintf(stderr, "Cannot open UDP port %u\n", UDP_TRANSPORT_BASE_PORT + stationID);
+		return 1;
+	}
+	rprotocol.begin();
+
+	while( getppid() == master )
+	{
+		rprotocol.loop();
+		usleep(SIM_IDLE_SLEEP);
+	}
+	return 0;
+}
+
+#endif //HW_HOST_MASTER
@@ -1,15 +1,14 @@
 /*
+  Reference thermistor conversion - the linear table scan that AnalogConv replaced, kept verbatim
+  (except for the function name, the initial result value and the last entry check) to check the new converter against it.
 
-Thermistor - based temp sensor support routine for SmartGarden system.
-
-Temp conversion function is taken from: https://github.com/EasternStarGeek/Fun-with-Thermistors
-
-Note:	the LUT and original code logic produces temp readings in Celsius, final conversion to Fahrenheit is done at the last step, 
-		by multiplying C value by 1.8 (directly in the map() call), and then adding 32.
+  Note: the original leaves the result uninitialized when the reading equals the last table entry, the reference
+  returns the temperature of the last entry (69C) in this case.
 
 */
 
-#include "thermistor.h"
+#include "WProgram.h"
+#include "thermistor_ref.h"
 
 const uint16_t LUT_Therm[90] PROGMEM = {
     105, 110, 116, 121, 127, 133, 139, 145, 152, 159,   // -20C to -11C 
@@ -23,7 +22,7 @@ const uint16_t LUT_Therm[90] PROGMEM = {
     820, 826, 832, 837, 843, 848, 853, 858, 863, 867    //  60C to 69C 
   };
 
-int convertTempInt (int intputVal)  {
+int convertTempIntRef (int intputVal)  {
 
   /*
   This function converts a Thermistor reading into a corresponding temperature in degrees C.
@@ -49,7 +48,7 @@ int convertTempInt (int intputVal)  {
    between the two closest entries is performed to give a finer output resolution.
    */
    
-  int _tempF;  // Intermediate results and final Temperature return value
+  int _tempF = THERM_REF_UNDEFINED;  // Intermediate results and final Temperature return value
   uint16_t ADC_Lo;   // The Lower ADC matching value
   uint16_t ADC_Hi;   // The Higher ADC matching value
   int Temp_Lo;  // The Lower whole-number matching temperature
@@ -63,6 +62,8 @@ int convertTempInt (int intputVal)  {
     _tempF = -999;  // Under-range dummy value
   else if (thermValue > pgm_read_word_near(&LUT_Therm[89]) )
     _tempF = 999;  // Over-range dummy value
+  else if (thermValue == pgm_read_word_near(&LUT_Therm[89]) )
+    _tempF = int(69*180/100l)+32;  // Last entry, the loop below does not find it
   else {
 
     // if Sensor Value is within range...
@@ -0,0 +1,8 @@
+#ifndef _THERMISTOR_REF_H
+#define _THERMISTOR_REF_H
+
+#define THERM_REF_UNDEFINED		-32768
+
+int convertTempIntRef (int intputVal);
+
+#endif
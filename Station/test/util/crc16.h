@@ -0,0 +1,22 @@
+#ifndef _UTIL_CRC16_COMPAT_H
+#define _UTIL_CRC16_COMPAT_H
+
+// avr-libc CRC functions used by the Station modules, C equivalents from the avr-libc documentation
+
+#include <stdint.h>
+
+static inline uint8_t _crc8_ccitt_update(uint8_t inCrc, uint8_t inData)
+{
+	uint8_t		data = inCrc ^ inData;
+
+	for( uint8_t i=0; i<8; i++ )
+	{
+		if( (data & 0x80) != 0 )
+			data = (data << 1) ^ 0x07;
+		else
+			data <<= 1;
+	}
+	return data;
+}
+
+#endif
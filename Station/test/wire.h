@@ -0,0 +1,6 @@
+#ifndef _WIRE_COMPAT_H
+#define _WIRE_COMPAT_H
+
+// I2C is not used by the host builds
+
+#endif
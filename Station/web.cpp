@@ -17,10 +17,25 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "sensors.h"
+#include "EventBus.h"
+#include "SettingsCache.h"
+#ifdef HW_ENABLE_MOTEINORF
+#include "MoteinoRF.h"
+#endif
 
 
 bool SysInfo(FILE* stream_file);
 
+// State change sequence number. It is incremented by the event bus subscriber on any zone/schedule/pause change,
+// allowing web clients to poll json/state?seq=N cheaply and fetch full state only when something actually changed.
+static uint16_t webStateSeq = 1;
+
+static void WebOnEvent(const SGEvent *pEvent)
+{
+	webStateSeq++;
+	if( webStateSeq == 0 ) webStateSeq = 1;		// 0 is never used, so that clients can use it to request full state
+}
+
 
 web::web(void)
 		: m_server(0)
@@ -36,6 +51,8 @@ web::~web(void)
 
 bool web::Init()
 {
+	eventBus.Subscribe(SGEVT_MASK(SGEVT_ZONE_STATE) | SGEVT_MASK(SGEVT_SCHEDULE_START) | SGEVT_MASK(SGEVT_SCHEDULE_STOP) | SGEVT_MASK(SGEVT_PAUSE) | SGEVT_MASK(SGEVT_RUN_SCHEDULES), WebOnEvent);
+
 	uint16_t port = GetWebPort();
 	if ((port > 65000) || (port < 80))
 		port = 80;
@@ -155,6 +172,16 @@ static void JSONSensorsNow(FILE * stream_file)
 
 }
 
+#ifdef HW_ENABLE_MOTEINORF
+static void JSONLinks(FILE * stream_file)
+{
+	ServeHeader(stream_file, 200, PSTR("OK"), false, PSTR("text/plain"));
+
+	fprintf_P(stream_file, PSTR("{"));
+	MoteinoRF.TableLinkStats(stream_file);
+	fprintf_P(stream_file, PSTR("}"));
+}
+#endif //HW_ENABLE_MOTEINORF
 
 static void JSONWWCounters(const KVPairs & key_value_pairs, FILE * stream_file)
 {
@@ -341,8 +368,19 @@ static void JSONState(const KVPairs & key_value_pairs, FILE * stream_file)
 {
 	ServeHeader(stream_file, 200, PSTR("OK"), false, PSTR("text/plain"));
 
+	// If the client already has the current state (seq matches), send short reply
+	for (int i = 0; i < key_value_pairs.num_pairs; i++)
+	{
+		if( (strcmp_P(key_value_pairs.keys[i], PSTR("seq")) == 0) && (uint16_t(atol(key_value_pairs.values[i])) == webStateSeq) )
+		{
+			fprintf_P(stream_file, PSTR("{\n\t\"seq\" : \"%u\",\n\t\"changed\" : \"off\"\n}"), webStateSeq);
+			return;
+		}
+	}
+
+	fprintf_P(stream_file, PSTR("{\n\t\"seq\" : \"%u\",\n\t\"changed\" : \"on\","), webStateSeq);
 	fprintf_P(stream_file,
-			PSTR("{\n\t\"version\" : \"%u\",\n\t\"run\" : \"%s\",\n\t\"zones\" : \"%d\",\n\t\"schedules\" : \"%d\",\n\t\"stations\" : \"%d\",\n\t\"timenow\" : \"%lu\",\n\t\"locationZip\" : \"%lu\","),
+			PSTR("\n\t\"version\" : \"%u\",\n\t\"run\" : \"%s\",\n\t\"zones\" : \"%d\",\n\t\"schedules\" : \"%d\",\n\t\"stations\" : \"%d\",\n\t\"timenow\" : \"%lu\",\n\t\"locationZip\" : \"%lu\","),
 			uint16_t(SG_FIRMWARE_VERSION), GetRunSchedules() ? "on" : "off", GetNumEnabledZones(), int(GetNumSchedules()), int(GetNumStations()), now(), GetZip());
 	
 	if( runState.isPaused() )
@@ -902,6 +940,13 @@ void web::ProcessWebClients()
 				     ResetEEPROM();
 				     ServeHeader(pFile, 200, PSTR("OK"), false);
 			     }
+			     else if (strcmp_P(xP4, PSTR("reload")) == 0)
+			     {
+				     if (ReloadConfig() != CONFIG_RELOAD_FAILED)
+					     ServeHeader(pFile, 200, PSTR("OK"), false);
+				     else
+					     ServeError(pFile);
+			     }
 			     else if (strcmp_P(xP4, PSTR("reset")) == 0)
 			     {
 				     ServeHeader(pFile, 200, PSTR("OK"), false);
@@ -960,6 +1005,12 @@ void web::ProcessWebClients()
 			     {
 					JSONWWCounters(key_value_pairs, pFile);
 			     }
+#ifdef HW_ENABLE_MOTEINORF
+			     else if (strcmp_P(xP5, PSTR("links")) == 0)
+			     {
+					JSONLinks(pFile);
+			     }
+#endif //HW_ENABLE_MOTEINORF
 
             }
 			// Access sysinfo page
@@ -1012,7 +1063,10 @@ void web::ProcessWebClients()
 		client.stop();
 
 		if (bReset)
+		{
+			settingsCache.flush();		// don't lose pending settings changes
 			sysreset();
+		}
 	}
 }
 
@@ -22,31 +22,36 @@ void DHT::begin(void) {
 
 //boolean S == Scale.  True == Farenheit; False == Celcius
 float DHT::readTemperature(bool S) {
+  if (read())
+    return temperature(S);
+
+  Serial.print("Read fail");
+  return NAN;
+}
+
+float DHT::temperature(bool S) {
   float f;
 
-  if (read()) {
-    switch (_type) {
-    case DHT11:
-      f = data[2];
-      if(S)
-      	f = convertCtoF(f);
-      	
-      return f;
-    case DHT22:
-    case DHT21:
-      f = data[2] & 0x7F;
-      f *= 256;
-      f += data[3];
-      f /= 10;
-      if (data[2] & 0x80)
-	f *= -1;
-      if(S)
-	f = convertCtoF(f);
-
-      return f;
-    }
+  switch (_type) {
+  case DHT11:
+    f = data[2];
+    if(S)
+      f = convertCtoF(f);
+
+    return f;
+  case DHT22:
+  case DHT21:
+    f = data[2] & 0x7F;
+    f *= 256;
+    f += data[3];
+    f /= 10;
+    if (data[2] & 0x80)
+      f *= -1;
+    if(S)
+      f = convertCtoF(f);
+
+    return f;
   }
-  Serial.print("Read fail");
   return NAN;
 }
 
@@ -55,30 +60,33 @@ float DHT::convertCtoF(float c) {
 }
 
 float DHT::readHumidity(void) {
+  if (read())
+    return humidity();
+
+  Serial.print("Read fail");
+  return NAN;
+}
+
+float DHT::humidity(void) {
   float f;
-  if (read()) {
-    switch (_type) {
-    case DHT11:
-      f = data[0];
-      return f;
-    case DHT22:
-    case DHT21:
-      f = data[0];
-      f *= 256;
-      f += data[1];
-      f /= 10;
-      return f;
-    }
+
+  switch (_type) {
+  case DHT11:
+    f = data[0];
+    return f;
+  case DHT22:
+  case DHT21:
+    f = data[0];
+    f *= 256;
+    f += data[1];
+    f /= 10;
+    return f;
   }
-  Serial.print("Read fail");
   return NAN;
 }
 
 
 boolean DHT::read(void) {
-  uint8_t laststate = HIGH;
-  uint8_t counter = 0;
-  uint8_t j = 0, i;
   unsigned long currenttime;
 
   // pull the pin high and wait 250 milliseconds
@@ -95,18 +103,40 @@ boolean DHT::read(void) {
     //delay(2000 - (currenttime - _lastreadtime));
   }
   firstreading = false;
-  /*
-    Serial.print("Currtime: "); Serial.print(currenttime);
-    Serial.print(" Lasttime: "); Serial.print(_lastreadtime);
-  */
+
+  startRead();
+  delay(DHT_START_LOW);
+  return finishRead();
+}
+
+void DHT::startRead(void) {
   _lastreadtime = millis();
 
   data[0] = data[1] = data[2] = data[3] = data[4] = 0;
-  
+
   // now pull it low for ~20 milliseconds
   pinMode(_pin, OUTPUT);
   digitalWrite(_pin, LOW);
-  delay(20);
+}
+
+void DHT::cancelRead(void) {
+  digitalWrite(_pin, HIGH);
+  pinMode(_pin, INPUT);
+}
+
+uint8_t DHT::startLowMin(void) {
+  return (_type == DHT11) ? DHT_START_LOW : DHT22_START_LOW;
+}
+
+uint8_t DHT::startLowMax(void) {
+  return (_type == DHT11) ? DHT11_START_MAX : DHT22_START_MAX;
+}
+
+boolean DHT::finishRead(void) {
+  uint8_t laststate = HIGH;
+  uint8_t counter = 0;
+  uint8_t j = 0, i;
+
   cli();
   digitalWrite(_pin, HIGH);
   delayMicroseconds(40);
@@ -138,16 +168,6 @@ boolean DHT::read(void) {
   }
 
   sei();
-  
-  /*
-  Serial.println(j, DEC);
-  Serial.print(data[0], HEX); Serial.print(", ");
-  Serial.print(data[1], HEX); Serial.print(", ");
-  Serial.print(data[2], HEX); Serial.print(", ");
-  Serial.print(data[3], HEX); Serial.print(", ");
-  Serial.print(data[4], HEX); Serial.print(" =? ");
-  Serial.println(data[0] + data[1] + data[2] + data[3], HEX);
-  */
 
   // check we read 40 bits and that the checksum matches
   if ((j >= 40) && 
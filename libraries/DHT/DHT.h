@@ -15,6 +15,15 @@ written by Adafruit Industries
 // how many timing transitions we need to keep track of. 2 * number bits + extra
 #define MAXTIMINGS 85
 
+// how long the start signal (line pulled low) must be held, ms
+#define DHT_START_LOW 20
+
+// start signal limits of the non-blocking reading, ms. DHT11 needs at least 18ms,
+// AM2301/AM2302 need 1..20ms and may not respond to a longer one.
+#define DHT11_START_MAX 40
+#define DHT22_START_LOW 2
+#define DHT22_START_MAX 18
+
 #define DHT11 11
 #define DHT22 22
 #define DHT21 21
@@ -35,5 +44,18 @@ class DHT {
   float convertCtoF(float);
   float readHumidity(void);
 
+  // non-blocking reading: startRead() pulls the line low and returns,
+  // finishRead() must be called between startLowMin() and startLowMax() ms later
+  // and reads the response. If it is too late, cancelRead() releases the line instead
+  // (the sensor may still respond, wait 2s before the next startRead()).
+  // temperature()/humidity() decode the last reading without touching the sensor.
+  void startRead(void);
+  boolean finishRead(void);
+  void cancelRead(void);
+  uint8_t startLowMin(void);
+  uint8_t startLowMax(void);
+  float temperature(bool S=false);
+  float humidity(void);
+
 };
 #endif
@@ -336,6 +336,93 @@ bool IniFile::getMACAddress(const char* section, const char* key,
   return true;
 }
 
+bool IniFile::browse(IniFileHandler handler, void* ctx,
+		     char* buffer, size_t len) const
+{
+  char section[INI_FILE_MAX_SECTION_LEN+1];
+  size_t fill = 0;
+  bool eof = false;
+
+  if (!_file.isOpen()) {
+    _error = errorFileNotOpen;
+    return false;
+  }
+  if (len < 3) {
+    _error = errorBufferTooSmall;
+    return false;
+  }
+  if (!_file.seekSet(0)) {
+    _error = errorSeekError;
+    return false;
+  }
+
+  section[0] = '\0';
+  while (1) {
+    // Top up the buffer, the file is read strictly sequentially
+    if (!eof && fill < len-1) {
+      int n = _file.read(buffer + fill, len - 1 - fill);
+      if (n <= 0)
+	eof = true;
+      else
+	fill += n;
+    }
+    if (fill == 0)
+      break;
+
+    size_t lineLen = 0;
+    while (lineLen < fill && buffer[lineLen] != '\n' && buffer[lineLen] != '\r')
+      ++lineLen;
+
+    size_t consumed;
+    if (lineLen < fill) {
+      // end of line, skip optional newline of the other sort
+      char otherNewline = (buffer[lineLen] == '\n' ? '\r' : '\n');
+      consumed = lineLen + 1;
+      if (consumed < fill && buffer[consumed] == otherNewline)
+	++consumed;
+    }
+    else if (eof)
+      consumed = fill;			// last line without a newline
+    else {
+      buffer[len-1] = '\0';
+      _error = errorBufferTooSmall;
+      return false;
+    }
+    buffer[lineLen] = '\0';
+
+    char *cp = skipWhiteSpace(buffer);
+    if (*cp == '[') {
+      // Start of section
+      cp = skipWhiteSpace(cp + 1);
+      char *ep = strchr(cp, ']');
+      if (ep != NULL)
+	*ep = '\0';
+      removeTrailingWhiteSpace(cp);
+      strncpy(section, cp, INI_FILE_MAX_SECTION_LEN);
+      section[INI_FILE_MAX_SECTION_LEN] = '\0';
+    }
+    else if (*cp != '\0' && !isCommentChar(*cp)) {
+      char *ep = strchr(cp, '=');
+      if (ep != NULL) {
+	*ep = '\0';
+	removeTrailingWhiteSpace(cp);
+	char *vp = skipWhiteSpace(ep + 1);
+	removeTrailingWhiteSpace(vp);
+	if (!handler(section, cp, vp, ctx)) {
+	  _error = errorNoError;
+	  return true;
+	}
+      }
+    }
+
+    memmove(buffer, buffer + consumed, fill - consumed);
+    fill -= consumed;
+  }
+
+  _error = errorNoError;
+  return true;
+}
+
 //int8_t IniFile::readLine(SdBaseFile &file, char *buffer, size_t len, uint32_t &pos)
 IniFile::error_t IniFile::readLine(SdBaseFile &file, char *buffer, size_t len, uint32_t &pos)
 {
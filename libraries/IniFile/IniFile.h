@@ -5,11 +5,21 @@
 // 8.3 filename instead and 8.3 directory with a leading slash
 #define INI_FILE_MAX_FILENAME_LEN 26
 
+// Maximum length for section name passed to browse() handler, excluding NULL char
+#define INI_FILE_MAX_SECTION_LEN 20
+
 #include "SdFat.h"
 #include "Ethernet.h"
 
 class IniFileState;
 
+// Handler called by IniFile::browse() for every key. Section is the
+// current section name ("" before the first section). Key and value
+// are trimmed and point into the working buffer, so they are only
+// valid during the call. Return false to stop browsing.
+typedef bool (*IniFileHandler)(const char* section, const char* key,
+			       const char* value, void* ctx);
+
 class IniFile {
 public:
   enum error_t {
@@ -104,6 +114,13 @@ public:
   bool getMACAddress(const char* section, const char* key,
 			char* buffer, size_t len, uint8_t mac[6]) const;
 
+  // Read the whole file in a single sequential pass, calling handler
+  // for every key. Much faster than a series of getValue() calls when
+  // most of the file is needed, since getValue() rescans the file from
+  // the start on every call. Buffer must be able to hold one line.
+  bool browse(IniFileHandler handler, void* ctx,
+	      char* buffer, size_t len) const;
+
   // Utility function to read a line from a file, make available to all
   //static int8_t readLine(SdBaseFile &file, char *buffer, size_t len, uint32_t &pos);
   static error_t readLine(SdBaseFile &file, char *buffer, size_t len, uint32_t &pos);
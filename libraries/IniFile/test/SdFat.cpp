@@ -0,0 +1,46 @@
+#include "SdFat.h"
+
+unsigned long SdBaseFile::bytesRead = 0;
+unsigned long SdBaseFile::seekCount = 0;
+
+bool SdBaseFile::open(const char *filename, uint8_t mode)
+{
+  close();
+  _f = fopen(filename, (mode & O_WRONLY) ? "r+" : "r");
+  return _f != NULL;
+}
+
+void SdBaseFile::close(void)
+{
+  if (_f != NULL)
+    fclose(_f);
+  _f = NULL;
+}
+
+bool SdBaseFile::seekSet(uint32_t pos)
+{
+  if (_f == NULL)
+    return false;
+  ++seekCount;
+  return fseek(_f, pos, SEEK_SET) == 0;
+}
+
+int SdBaseFile::read(void *buf, size_t n)
+{
+  if (_f == NULL)
+    return -1;
+  size_t r = fread(buf, 1, n, _f);
+  bytesRead += r;
+  return r;
+}
+
+int SdBaseFile::available(void)
+{
+  if (_f == NULL)
+    return 0;
+  long cur = ftell(_f);
+  fseek(_f, 0, SEEK_END);
+  long sz = ftell(_f);
+  fseek(_f, cur, SEEK_SET);
+  return sz - cur;
+}
@@ -0,0 +1,33 @@
+#ifndef _SDFAT_H
+#define _SDFAT_H
+
+// Minimal host replacement for the SdFat library, just enough for
+// IniFile to run on top of stdio.
+
+#include "arduino_compat.h"
+
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+
+class SdBaseFile {
+public:
+  SdBaseFile(void) : _f(NULL) { };
+
+  bool open(const char *filename, uint8_t mode);
+  void close(void);
+  bool isOpen(void) const { return _f != NULL; };
+
+  bool seekSet(uint32_t pos);
+  int read(void *buf, size_t n);
+  int available(void);
+
+  // Statistics for all files, used by the benchmark
+  static unsigned long bytesRead;
+  static unsigned long seekCount;
+
+private:
+  FILE *_f;
+};
+
+#endif
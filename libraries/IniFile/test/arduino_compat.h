@@ -11,13 +11,17 @@
 
 #include <string.h>
 
-typedef unsigned char uint8_t;
-typedef unsigned short uint16_t;
-typedef unsigned long uint32_t;
+#include <stdint.h>
 typedef bool boolean;
 //#define uint8_t unsigned char
 
 #define FILE_READ O_RDONLY
 #define FILE_WRITE (O_RDWR | O_CREAT)
 
+// No separate program memory on the host
+#define PSTR(s) (s)
+#define strcpy_P strcpy
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+
 #endif
@@ -0,0 +1,203 @@
+// Benchmark: device.ini import using per-key getValue() lookups (as
+// done by the original ResetEEPROM) versus a single browse() pass.
+//
+// Both paths must extract identical values for every key the import
+// asks for. The EEPROM image the import writes is compared against the
+// per-key import by Station/test/ini_import_test. Run as "make bench", which copies the Station device.ini
+// here (IniFile limits the filename length), or directly:
+//   ./ini_bench [device.ini] [iterations]
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+#include "IniFile.h"
+
+using namespace std;
+
+typedef map<string, string> ValueMap;
+
+struct Stats {
+  unsigned long bytesRead;
+  unsigned long seekCount;
+};
+
+static string makeKey(const char *section, const char *key)
+{
+  string s = string(section) + "/" + key;
+  for (size_t i = 0; i < s.size(); ++i)
+    s[i] = tolower(s[i]);
+  return s;
+}
+
+// Look up one key the way the original import does, remember the
+// result (value or "not found").
+static void lookup(const IniFile &ini, const char *section, const char *key,
+		   char *buffer, size_t len, ValueMap &found, vector<string> &keys)
+{
+  string k = makeKey(section, key);
+  keys.push_back(k);
+  if (ini.getValue(section, key, buffer, len))
+    found[k] = buffer;
+}
+
+// Same sequence of lookups as the original ResetEEPROM. Number of
+// [StationN] and [SensorN] sections depends on the values read.
+static void importPerKey(const IniFile &ini, ValueMap &found, vector<string> &keys)
+{
+  const size_t len = 128;
+  char buffer[len];
+  char section[24];    // "Station" or "Sensor" and any number
+  static const char *network[] = {"IP", "Subnet", "Gateway", "WebPort", "NTPServer"};
+  static const char *system[] = {"NTPOffset", "Zip", "SeasonalAdj"};
+  static const char *serial[] = {"SrClkPin", "SrNoePin", "SrDatPin", "SrLatPin"};
+  static const char *station[] = {"StationID", "NumChannels", "NetworkID", "NetworkAddress", "RAccess"};
+  static const char *sensor[] = {"Type", "Station", "Channel", "Name"};
+
+  ini.validate(buffer, len);
+
+  for (size_t i = 0; i < sizeof(network)/sizeof(network[0]); ++i)
+    lookup(ini, "Network", network[i], buffer, len, found, keys);
+  for (size_t i = 0; i < sizeof(system)/sizeof(system[0]); ++i)
+    lookup(ini, "System", system[i], buffer, len, found, keys);
+
+  lookup(ini, "LocalChannels", "NumParallel", buffer, len, found, keys);
+  int numParallel = atoi(found[makeKey("LocalChannels", "NumParallel")].c_str());
+  for (int i = 0; i < numParallel; ++i) {
+    char key[16];
+    snprintf(key, sizeof(key), "Chan%u", i+1);
+    lookup(ini, "ParallelIOMap", key, buffer, len, found, keys);
+  }
+  if (numParallel != 0)
+    lookup(ini, "LocalChannels", "ParallelPolarity", buffer, len, found, keys);
+
+  lookup(ini, "LocalChannels", "NumSerial", buffer, len, found, keys);
+  if (atoi(found[makeKey("LocalChannels", "NumSerial")].c_str()) != 0)
+    for (size_t i = 0; i < sizeof(serial)/sizeof(serial[0]); ++i)
+      lookup(ini, "SerialIOMap", serial[i], buffer, len, found, keys);
+
+  lookup(ini, "Stations", "NumStations", buffer, len, found, keys);
+  lookup(ini, "Stations", "MyStationID", buffer, len, found, keys);
+  int numStations = atoi(found[makeKey("Stations", "NumStations")].c_str());
+  for (int i = 0; i < numStations; ++i) {
+    snprintf(section, sizeof(section), "Station%u", i+1);
+    for (size_t j = 0; j < sizeof(station)/sizeof(station[0]); ++j)
+      lookup(ini, section, station[j], buffer, len, found, keys);
+  }
+  lookup(ini, "LocalChannels", "ParallelPolarity", buffer, len, found, keys);
+
+  lookup(ini, "Sensors", "NumSensors", buffer, len, found, keys);
+  int numSensors = atoi(found[makeKey("Sensors", "NumSensors")].c_str());
+  for (int i = 1; i <= numSensors; ++i) {
+    snprintf(section, sizeof(section), "Sensor%d", i);
+    for (size_t j = 0; j < sizeof(sensor)/sizeof(sensor[0]); ++j)
+      lookup(ini, section, sensor[j], buffer, len, found, keys);
+  }
+
+  lookup(ini, "XBee", "Enabled", buffer, len, found, keys);
+  if (found[makeKey("XBee", "Enabled")] == "Yes") {
+    lookup(ini, "XBee", "Port", buffer, len, found, keys);
+    lookup(ini, "XBee", "Speed", buffer, len, found, keys);
+    lookup(ini, "XBee", "PANID", buffer, len, found, keys);
+    lookup(ini, "XBee", "Channel", buffer, len, found, keys);
+  }
+  lookup(ini, "RFM69", "Enabled", buffer, len, found, keys);
+  if (found[makeKey("RFM69", "Enabled")] == "Yes")
+    lookup(ini, "RFM69", "PANID", buffer, len, found, keys);
+}
+
+static bool collect(const char *section, const char *key, const char *value, void *ctx)
+{
+  ValueMap &values = *(ValueMap *)ctx;
+  string k = makeKey(section, key);
+  if (values.find(k) == values.end())	// getValue() returns the first match
+    values[k] = value;
+  return true;
+}
+
+static void importSinglePass(const IniFile &ini, ValueMap &values)
+{
+  const size_t len = 128;
+  char buffer[len];
+
+  ini.browse(collect, &values, buffer, len);
+}
+
+static double elapsedUs(clock_t start, int iterations)
+{
+  return double(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+  char defaultFile[] = "device.ini";
+  char *filename = argc > 1 ? argv[1] : defaultFile;
+  int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+  IniFile ini(filename);
+  if (!ini.open()) {
+    cout << "Cannot open " << filename << endl;
+    return 1;
+  }
+
+  // Correctness: every key looked up by the per-key import must have
+  // the same value (or be missing) in the single pass result.
+  ValueMap perKey, singlePass;
+  vector<string> keys;
+  importPerKey(ini, perKey, keys);
+  importSinglePass(ini, singlePass);
+
+  int mismatches = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ValueMap::const_iterator a = perKey.find(keys[i]);
+    ValueMap::const_iterator b = singlePass.find(keys[i]);
+    bool fa = a != perKey.end(), fb = b != singlePass.end();
+    if (fa != fb || (fa && a->second != b->second)) {
+      cout << "Mismatch for " << keys[i] << ": \""
+	   << (fa ? a->second : "<missing>") << "\" vs \""
+	   << (fb ? b->second : "<missing>") << "\"" << endl;
+      ++mismatches;
+    }
+  }
+  cout << keys.size() << " lookups, " << perKey.size() << " keys found, "
+       << mismatches << " mismatches" << endl;
+
+  // Cost of one import, in file reads and CPU time
+  Stats s1, s2;
+
+  SdBaseFile::bytesRead = SdBaseFile::seekCount = 0;
+  clock_t start = clock();
+  for (int i = 0; i < iterations; ++i) {
+    ValueMap m;
+    keys.clear();
+    importPerKey(ini, m, keys);
+  }
+  double t1 = elapsedUs(start, iterations);
+  s1.bytesRead = SdBaseFile::bytesRead / iterations;
+  s1.seekCount = SdBaseFile::seekCount / iterations;
+
+  SdBaseFile::bytesRead = SdBaseFile::seekCount = 0;
+  start = clock();
+  for (int i = 0; i < iterations; ++i) {
+    ValueMap m;
+    importSinglePass(ini, m);
+  }
+  double t2 = elapsedUs(start, iterations);
+  s2.bytesRead = SdBaseFile::bytesRead / iterations;
+  s2.seekCount = SdBaseFile::seekCount / iterations;
+
+  cout << "per-key getValue(): " << s1.bytesRead << " bytes read, "
+       << s1.seekCount << " seeks, " << t1 << " us per import" << endl;
+  cout << "single pass browse(): " << s2.bytesRead << " bytes read, "
+       << s2.seekCount << " seeks, " << t2 << " us per import" << endl;
+
+  if (mismatches) {
+    cout << "BENCHMARK FAILED" << endl;
+    return 1;
+  }
+  cout << "BENCHMARK PASSED" << endl;
+  return 0;
+}
@@ -270,6 +270,27 @@ bool RFM69::sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferS
   return false;
 }
 
+//*** Tony-osp ***
+// Non-blocking version of send(). Does a single carrier sense check instead of spinning for up to RF69_CSMA_LIMIT_MS,
+// and returns false if the channel is busy - the caller should try again later (or pass force=true once its own CSMA
+// time limit expired). After the frame is sent the radio goes back to RX, so the ACK can be picked up by receiveDone().
+// Any received packet must be read before calling trySend(), otherwise it will be discarded.
+bool RFM69::trySend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool force)
+{
+  if (!force && !canSend())
+  {
+    if (_mode != RF69_MODE_RX)  // carrier sense works in RX mode only
+    {
+      writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+      receiveBegin();
+    }
+    return false;
+  }
+  sendFrame(toAddress, buffer, bufferSize, requestACK, false);
+  receiveBegin();
+  return true;
+}
+
 // should be polled immediately after sending a packet with ACK request
 bool RFM69::ACKReceived(uint8_t fromNodeID) {
   if (receiveDone()){
@@ -296,6 +317,18 @@ void RFM69::sendACK(const void* buffer, uint8_t bufferSize) {
   RSSI = _RSSI; // restore payload RSSI
 }
 
+//*** Tony-osp ***
+// sendACK() variant that does not go through RX for carrier sense. The radio goes from standby straight to TX and back to standby,
+// so the received packet (DATA, DATALEN, SENDERID etc.) stays intact and can be processed after the ACK is out.
+// The channel carried the packet being ACKed a moment ago, and the sender is listening for the ACK, so carrier sense is skipped.
+// The radio stays in standby, receiveDone() puts it back to RX.
+void RFM69::sendACKNow(const void* buffer, uint8_t bufferSize) {
+  ACK_REQUESTED = 0;
+  int16_t _RSSI = RSSI;
+  sendFrame(SENDERID, buffer, bufferSize, false, true);
+  RSSI = _RSSI;
+}
+
 // internal function
 void RFM69::sendFrame(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
 {
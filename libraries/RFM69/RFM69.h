@@ -104,10 +104,12 @@ class RFM69 {
     bool canSend();
     virtual void send(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false);
     virtual bool sendWithRetry(uint8_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2, uint8_t retryWaitTime=40); // 40ms roundtrip req for 61byte packets
+    bool trySend(uint8_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, bool force=false); // non-blocking send, single carrier sense check
     virtual bool receiveDone();
     bool ACKReceived(uint8_t fromNodeID);
     bool ACKRequested();
     virtual void sendACK(const void* buffer = "", uint8_t bufferSize=0);
+    virtual void sendACKNow(const void* buffer = "", uint8_t bufferSize=0); // ACK without carrier sense, keeps the received packet
     uint32_t getFrequency();
     void setFrequency(uint32_t freqHz);
     void encrypt(const char* key);
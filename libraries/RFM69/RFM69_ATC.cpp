@@ -39,13 +39,13 @@ volatile uint8_t RFM69_ATC::ACK_RSSI_REQUESTED;  // new type of flag on ACK_REQU
 //=============================================================================
 // initialize() - some extra initialization before calling base class
 //=============================================================================
-bool RFM69_ATC::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID) {
+bool RFM69_ATC::initialize(uint8_t freqBand, uint8_t nodeID, uint8_t networkID, bool fUseInterrupts) {
   _targetRSSI = 0;        // TomWS1: default to disabled
   _ackRSSI = 0;           // TomWS1: no existing response at init time
   ACK_RSSI_REQUESTED = 0; // TomWS1: init to none
   //_powerBoost = false;    // TomWS1: require someone to explicitly turn boost on!
   _transmitLevel = 31;    // TomWS1: match default value in PA Level register
-  return RFM69::initialize(freqBand, nodeID, networkID);  // use base class to initialize most everything
+  return RFM69::initialize(freqBand, nodeID, networkID, fUseInterrupts);  // use base class to initialize most everything
 }
 
 //=============================================================================
@@ -80,6 +80,15 @@ void RFM69_ATC::sendACK(const void* buffer, uint8_t bufferSize) {
   RSSI = _RSSI; // restore payload RSSI
 }
 
+//*** Tony-osp ***
+// sendACKNow() - ACK without carrier sense, keeps the received packet (see RFM69::sendACKNow())
+void RFM69_ATC::sendACKNow(const void* buffer, uint8_t bufferSize) {
+  ACK_REQUESTED = 0;
+  int16_t _RSSI = RSSI;
+  sendFrame(SENDERID, buffer, bufferSize, false, true, ACK_RSSI_REQUESTED, _RSSI);
+  RSSI = _RSSI;
+}
+
 //=============================================================================
 // sendFrame() - the basic version is used to match the RFM69 prototype so we can extend it
 //=============================================================================